@@ -1,6 +1,9 @@
+#include <limits>
+
 #include "stage.h"
 #include "actor.h"
 #include "animation.h"
+#include "camera.h"
 
 #ifdef KGLT_GL_VERSION_2X
 #include "renderers/gl2x/buffer_object.h"
@@ -26,6 +29,10 @@ Actor::Actor(ActorID id, Stage* stage, MeshID mesh):
 }
 
 Actor::~Actor() {
+    submesh_created_connection_.disconnect();
+    submesh_destroyed_connection_.disconnect();
+    bounds_changed_connection_.disconnect();
+
     delete shared_vertex_animation_buffer_;
     shared_vertex_animation_buffer_ = nullptr;
 }
@@ -42,6 +49,16 @@ void Actor::remove_material_id_override() {
     }
 }
 
+void Actor::set_render_priority(RenderPriority value) {
+    if(value == render_priority_) {
+        return;
+    }
+
+    RenderPriority old = render_priority_;
+    render_priority_ = value;
+    signal_render_priority_changed_(id(), old, value);
+}
+
 VertexData* Actor::get_shared_data() const {
     if(has_animated_mesh()) {
         return shared_vertex_animation_buffer_;
@@ -78,8 +95,10 @@ void Actor::set_mesh(MeshID mesh) {
     if(!mesh) {
         submesh_created_connection_.disconnect();
         submesh_destroyed_connection_.disconnect();
+        bounds_changed_connection_.disconnect();
         clear_subactors();
         mesh_.reset();
+        ++world_bounds_version_;
         return;
     }
 
@@ -113,6 +132,10 @@ void Actor::set_mesh(MeshID mesh) {
     }
 
     //Watch the mesh for changes to its submeshes so we can adapt to it
+    submesh_created_connection_.disconnect();
+    submesh_destroyed_connection_.disconnect();
+    bounds_changed_connection_.disconnect();
+
     submesh_created_connection_ = mesh_->signal_submesh_created().connect(
         [=](MeshID m, SubMesh* s) {
             rebuild_subactors();
@@ -125,6 +148,20 @@ void Actor::set_mesh(MeshID mesh) {
         }
     );
 
+    // May be fired from a worker filling in the mesh
+    bounds_changed_connection_ = mesh_->signal_bounds_changed().connect(
+        [=](MeshID m) {
+            ++world_bounds_version_;
+        }
+    );
+    ++world_bounds_version_;
+
+    {
+        // Levels picked for the old mesh mean nothing for this one
+        std::lock_guard<std::mutex> lock(lod_lock_);
+        lod_levels_.clear();
+    }
+
     //Rebuild the subactors to match the meshes submeshes
     rebuild_subactors();
 
@@ -138,6 +175,52 @@ void Actor::do_update(double dt) {
     }
 }
 
+uint32_t Actor::select_lod(CameraPtr camera) {
+    auto mesh = mesh_;
+    if(!mesh || mesh->lod_count() < 2 || mesh->is_animated()) {
+        return 0;
+    }
+
+    /* Use the bounding sphere of the box so the result doesn't change as the actor rotates */
+    AABB local = aabb();
+    Vec3 centre = local.centre();
+    float radius = (Vec3(local.max) - Vec3(local.min)).length() * 0.5f;
+
+    Mat4 transform = absolute_transformation();
+    kmVec3Transform(&centre, &centre, &transform);
+
+    float value = 0.0f;
+    const Mat4& camera_transform = camera->transform();
+
+    if(mesh->lod_metric() == LOD_METRIC_DISTANCE) {
+        Vec3 eye(camera_transform.mat[12], camera_transform.mat[13], camera_transform.mat[14]);
+        value = (centre - eye).length();
+    } else {
+        /* The projected diameter as a fraction of the viewport height. w is the view space
+         * depth for perspective projections and 1 for orthographic ones */
+        Mat4 view_projection;
+        kmMat4Multiply(&view_projection, &camera->projection_matrix(), &camera->view_matrix());
+
+        const float* m = view_projection.mat;
+        float w = m[3] * centre.x + m[7] * centre.y + m[11] * centre.z + m[15];
+
+        value = (w > 0.0001f) ? (camera->projection_matrix().mat[5] * radius) / w : std::numeric_limits<float>::max();
+    }
+
+    std::lock_guard<std::mutex> lock(lod_lock_);
+
+    uint32_t& level = lod_levels_[camera->id()];
+    level = mesh->select_lod(value, std::min(level, mesh->lod_count() - 1));
+    return level;
+}
+
+uint32_t Actor::lod_level(CameraID camera_id) const {
+    std::lock_guard<std::mutex> lock(lod_lock_);
+
+    auto it = lod_levels_.find(camera_id);
+    return (it == lod_levels_.end()) ? 0 : it->second;
+}
+
 void Actor::refresh_animation_state(uint32_t current_frame, uint32_t next_frame, float interp) {
     if(!shared_vertex_animation_buffer_) {
         // The animation buffer hasn't been configured yet
@@ -183,12 +266,23 @@ const AABB Actor::aabb() const {
 }
 
 const AABB Actor::transformed_aabb() const {
-    AABB box = aabb(); //Get the untransformed one
+    // Culling calls this from worker threads, once it's cached there's nothing to lock
+    uint32_t version = world_bounds_version_.load(std::memory_order_acquire);
+    if(world_bounds_cached_version_.load(std::memory_order_acquire) == version) {
+        return world_bounds_;
+    }
+
+    std::lock_guard<std::mutex> lock(world_bounds_lock_);
+
+    // Another thread may have got here first
+    version = world_bounds_version_.load(std::memory_order_acquire);
+    if(world_bounds_cached_version_.load(std::memory_order_relaxed) != version) {
+        // Anything marked stale from here on bumps the version again, so isn't lost
+        world_bounds_ = aabb().transformed(absolute_transformation());
+        world_bounds_cached_version_.store(version, std::memory_order_release);
+    }
 
-    auto pos = absolute_position();
-    kmVec3Add(&box.min, &box.min, &pos);
-    kmVec3Add(&box.max, &box.max, &pos);
-    return box;
+    return world_bounds_;
 }
 
 void Actor::ask_owner_for_destruction() {
@@ -261,7 +355,7 @@ void SubActor::_update_vertex_array_object() {
     } else {
         // If there is no animated mesh, then just do the normal thing and
         // update the submesh buffer if necessary
-        submesh()->_update_vertex_array_object();
+        active_submesh()->_update_vertex_array_object();
     }
 }
 
@@ -269,7 +363,7 @@ void SubActor::_bind_vertex_array_object() {
     if(parent_.has_animated_mesh()) {
         vertex_array_object_->bind();
     } else {
-        submesh()->_bind_vertex_array_object();
+        active_submesh()->_bind_vertex_array_object();
     }
 }
 #endif
@@ -322,6 +416,25 @@ const SubMesh *SubActor::submesh() const {
     return submesh_.get();
 }
 
+void SubActor::_apply_lod(uint32_t level) {
+    if(level == lod_level_) {
+        return;
+    }
+
+    lod_level_ = level;
+    lod_submesh_.reset();
+
+    auto mesh = parent_.mesh_;
+    if(!level || !mesh || level >= mesh->lod_count()) {
+        return;
+    }
+
+    // Fall back to the full detail submesh if the LOD doesn't have a counterpart
+    if(SubMesh* replacement = mesh->lod_mesh(level)->submesh(submesh()->name())) {
+        lod_submesh_ = replacement->shared_from_this();
+    }
+}
+
 void Actor::each(std::function<void (uint32_t, SubActor*)> callback) {
     uint32_t i = 0;
     for(auto subactor: subactors_) {
@@ -335,11 +448,11 @@ VertexData* SubActor::get_vertex_data() const {
         return parent_.shared_vertex_animation_buffer_;
     }
 
-    return submesh()->vertex_data.get();
+    return active_submesh()->vertex_data.get();
 }
 
 IndexData* SubActor::get_index_data() const {
-    return submesh()->index_data.get();
+    return active_submesh()->index_data.get();
 }
 
 }
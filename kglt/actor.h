@@ -1,6 +1,10 @@
 #ifndef ENTITY_H
 #define ENTITY_H
 
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
 #include "generic/identifiable.h"
 #include "generic/managed.h"
 #include "generic/relation.h"
@@ -57,7 +61,9 @@ public:
     void ask_owner_for_destruction();
 
     RenderPriority render_priority() const { return render_priority_; }
-    void set_render_priority(RenderPriority value) { render_priority_ = value;}
+
+    /* Render groups are sorted by priority first, so the subactors are regrouped when it changes */
+    void set_render_priority(RenderPriority value);
 
     unicode __unicode__() const {
         if(has_name()) {
@@ -68,6 +74,9 @@ public:
     }
 
     const AABB aabb() const;
+
+    /* The mesh bounds in world space. This is cached, and only recalculated after the transform
+     * is marked dirty or the mesh's bounds change */
     const AABB transformed_aabb() const;
 
     void each(std::function<void (uint32_t, SubActor*)> callback);
@@ -76,6 +85,7 @@ public:
     typedef sig::signal<void (ActorID, SubActor*)> SubActorDestroyedCallback;
     typedef sig::signal<void (ActorID, SubActor*, MaterialID, MaterialID)> SubActorMaterialChangedCallback;
     typedef sig::signal<void (ActorID)> MeshChangedCallback;
+    typedef sig::signal<void (ActorID, RenderPriority, RenderPriority)> RenderPriorityChangedCallback;
 
     SubActorCreatedCallback& signal_subactor_created() {
         return signal_subactor_created_;
@@ -91,6 +101,10 @@ public:
 
     MeshChangedCallback& signal_mesh_changed() { return signal_mesh_changed_; }
 
+    RenderPriorityChangedCallback& signal_render_priority_changed() {
+        return signal_render_priority_changed_;
+    }
+
     void set_renderable_culling_mode(RenderableCullingMode mode) {
         culling_mode_ = mode;
     }
@@ -103,6 +117,16 @@ public:
         return mesh_ && mesh_->is_animated();
     }
 
+    /*
+     * Picks the level of detail of this actor's mesh for the camera, from the projected size of
+     * (or distance to) the actor's bounds and the level last picked for the same camera. Called
+     * during culling, which may run on a worker thread. Animated meshes always use level 0.
+     */
+    uint32_t select_lod(CameraPtr camera);
+
+    /* The level last picked for the camera */
+    uint32_t lod_level(CameraID camera_id) const;
+
 private:
     VertexData* get_shared_data() const;
 
@@ -125,19 +149,33 @@ private:
     RenderPriority render_priority_;
     RenderableCullingMode culling_mode_ = RENDERABLE_CULLING_MODE_PARTITIONER;
 
+    mutable std::mutex lod_lock_;
+    std::unordered_map<CameraID, uint32_t> lod_levels_;
+
     SubActorCreatedCallback signal_subactor_created_;
     SubActorDestroyedCallback signal_subactor_destroyed_;
     SubActorMaterialChangedCallback signal_subactor_material_changed_;
     MeshChangedCallback signal_mesh_changed_;
+    RenderPriorityChangedCallback signal_render_priority_changed_;
 
     void do_update(double dt);
     void clear_subactors();
     void rebuild_subactors();
     sig::connection submesh_created_connection_;
     sig::connection submesh_destroyed_connection_;
+    sig::connection bounds_changed_connection_;
 
     friend class SubActor;
 
+    /* Bumped whenever the world bounds go stale, the cache is clean while the version it was
+     * calculated at matches */
+    std::atomic<uint32_t> world_bounds_version_ = {1};
+    mutable std::atomic<uint32_t> world_bounds_cached_version_ = {0};
+    mutable std::mutex world_bounds_lock_;
+    mutable AABB world_bounds_;
+
+    void world_transform_dirtied() override { ++world_bounds_version_; }
+
     void refresh_animation_state(uint32_t current_frame, uint32_t next_frame, float interp);
 };
 
@@ -153,28 +191,24 @@ public:
     void override_material_id(MaterialID material);
     void remove_material_id_override();
 
-    const MeshArrangement arrangement() const { return submesh()->arrangement(); }
+    const MeshArrangement arrangement() const { return active_submesh()->arrangement(); }
 
 #ifdef KGLT_GL_VERSION_2X
     void _update_vertex_array_object();
     void _bind_vertex_array_object();
 #endif
 
+    uint32_t _select_lod(CameraPtr camera) override { return parent_.select_lod(camera); }
+    void _apply_lod(uint32_t level) override;
+
     RenderPriority render_priority() const { return parent_.render_priority(); }
-    Mat4 final_transformation() const { return parent_.absolute_transformation(); }
+    Mat4 final_transformation() const { return parent_.interpolated_transformation(); }
     const bool is_visible() const { return parent_.is_visible(); }
 
     /* BoundableAndTransformable interface implementation */
 
     const AABB transformed_aabb() const {
-        AABB local = aabb();
-        Mat4 transform = parent_.absolute_transformation();
-
-        //Transform local by the transformation matrix of the parent
-        kmVec3Transform(&local.min, &local.min, &transform);
-        kmVec3Transform(&local.max, &local.max, &transform);
-
-        return local;
+        return aabb().transformed(parent_.absolute_transformation());
     }
 
     const AABB aabb() const {
@@ -187,6 +221,10 @@ public:
     SubMesh* submesh();
     const SubMesh* submesh() const;
 
+    /* The submesh being drawn, which is submesh() unless a coarser LOD has been applied */
+    SubMesh* active_submesh() { return (lod_submesh_) ? lod_submesh_.get() : submesh(); }
+    const SubMesh* active_submesh() const { return (lod_submesh_) ? lod_submesh_.get() : submesh(); }
+
 
     /* These properties are inherited by both the SubMeshInterface and RenderableInterface
      * and both perform the same action, so we pull the SubMeshInterface ones into scope */
@@ -200,6 +238,9 @@ private:
     std::shared_ptr<SubMesh> submesh_;
     MaterialPtr material_;
 
+    uint32_t lod_level_ = 0;
+    std::shared_ptr<SubMesh> lod_submesh_;
+
     sig::connection submesh_material_changed_connection_;
 
 #ifdef KGLT_GL_VERSION_2X
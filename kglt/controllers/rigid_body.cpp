@@ -286,6 +286,7 @@ Body::~Body() {
 bool Body::init() {
     body_ = simulation_->acquire_body(this);
     build_collider(collider_type_);
+    record_synced_transform();
 
     return true;
 }
@@ -294,6 +295,11 @@ void Body::cleanup() {
     simulation_->release_body(this);
 }
 
+void Body::record_synced_transform() {
+    synced_position_ = object_->absolute_position();
+    synced_rotation_ = object_->absolute_rotation();
+}
+
 void Body::move_to(const Vec3& position) {
     auto xform = simulation_->body_transform(this);
     simulation_->set_body_transform(
@@ -303,10 +309,25 @@ void Body::move_to(const Vec3& position) {
     );
 }
 
+void Body::do_pre_fixed_update(double dt) {
+    Vec3 position = object_->absolute_position();
+    Quaternion rotation = object_->absolute_rotation();
+
+    // If the object is where the simulation left it there's nothing to do
+    float rotation_change = 1.0f - fabs(kmQuaternionDot(&synced_rotation_, &rotation));
+    if((synced_position_ - position).length_squared() < kmEpsilon && rotation_change < kmEpsilon) {
+        return;
+    }
+
+    simulation_->set_body_transform(this, position, rotation);
+    record_synced_transform();
+}
+
 void Body::do_post_fixed_update(double dt) {
     auto xform = simulation_->body_transform(this);
     object_->set_absolute_position(xform.first);
     object_->set_absolute_rotation(xform.second);
+    record_synced_transform();
 }
 
 void Body::build_collider(ColliderType collider) {
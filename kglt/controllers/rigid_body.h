@@ -155,6 +155,14 @@ namespace impl {
         RigidBodySimulation::ptr simulation_;
         ColliderType collider_type_;
 
+        /* The transform last written to the object by the simulation. If the object no longer
+         * matches it at the next step then something else (e.g. game code in update()) moved it,
+         * so the body is teleported to match rather than the move being overwritten */
+        Vec3 synced_position_;
+        Quaternion synced_rotation_;
+        void record_synced_transform();
+
+        void do_pre_fixed_update(double dt) override;
         void do_post_fixed_update(double dt) override;
 
         void build_collider(ColliderType collider);
@@ -2,5 +2,7 @@
 #define ADDITIONAL_H
 
 #include "kglt/extra/sprite_strip_loader.h"
+#include "kglt/extra/terrain.h"
+#include "kglt/extra/tilemap.h"
 
 #endif // ADDITIONAL_H
@@ -0,0 +1,523 @@
+#include <cmath>
+#include <algorithm>
+
+#include "terrain.h"
+
+#include "../camera.h"
+#include "../mesh.h"
+#include "../stage.h"
+#include "../actor.h"
+#include "../loader.h"
+#include "../texture.h"
+#include "../material.h"
+#include "../window_base.h"
+
+namespace kglt {
+namespace extra {
+
+Terrain::Terrain(StagePtr stage, CameraID camera, const unicode& heightmap_file, const HeightmapSpecification& spec, const TerrainLODSpecification& lod):
+    stage_(stage),
+    camera_id_(camera),
+    spec_(spec),
+    lod_(lod) {
+
+    TextureID texture_id = stage->assets->new_texture();
+    auto texture = stage->assets->texture(texture_id);
+    stage->window->loader_for("texture", heightmap_file)->into(*texture);
+
+    // Match the orientation of the heightmap loader
+    texture->flip_vertically();
+
+    std::vector<float> heights(texture->width() * texture->height());
+
+    auto& data = texture->data();
+    auto stride = texture->bpp() / 8;
+    for(uint32_t i = 0; i < heights.size(); ++i) {
+        heights[i] = float(data[i * stride]) / 256.0f;
+    }
+
+    build(heights, texture->width(), texture->height());
+
+    stage->assets->delete_texture(texture_id);
+}
+
+Terrain::Terrain(StagePtr stage, CameraID camera, const std::vector<float>& heights, uint32_t width, uint32_t depth, const HeightmapSpecification& spec, const TerrainLODSpecification& lod):
+    stage_(stage),
+    camera_id_(camera),
+    spec_(spec),
+    lod_(lod) {
+
+    build(heights, width, depth);
+}
+
+Terrain::~Terrain() {
+    update_connection_.disconnect();
+
+    for(auto& node: nodes_) {
+        if(node.resident) {
+            evict(node);
+        }
+    }
+}
+
+void Terrain::build(const std::vector<float>& heights, uint32_t width, uint32_t depth) {
+    if(width < 2 || depth < 2 || heights.size() < width * depth) {
+        throw std::logic_error("Terrain heightmaps must be at least 2x2");
+    }
+
+    if(!lod_.chunk_size || (lod_.chunk_size & (lod_.chunk_size - 1))) {
+        throw std::logic_error("Terrain chunk size must be a power of two");
+    }
+
+    width_ = width;
+    depth_ = depth;
+
+    float range = spec_.max_height - spec_.min_height;
+
+    heights_.resize(width * depth);
+    for(uint32_t i = 0; i < heights_.size(); ++i) {
+        heights_[i] = spec_.min_height + (range * heights[i]);
+    }
+
+    // Same as the heightmap loader, each iteration averages every height with its neighbours
+    for(uint32_t iteration = 0; iteration < spec_.smooth_iterations; ++iteration) {
+        std::vector<float> smoothed(heights_.size());
+
+        for(int32_t z = 0; z < depth_; ++z) {
+            for(int32_t x = 0; x < width_; ++x) {
+                float total = 0.0f;
+                uint32_t count = 0;
+
+                for(int32_t dz = -1; dz <= 1; ++dz) {
+                    for(int32_t dx = -1; dx <= 1; ++dx) {
+                        int32_t nx = x + dx, nz = z + dz;
+                        if(nx >= 0 && nx < width_ && nz >= 0 && nz < depth_) {
+                            total += heights_[(nz * width_) + nx];
+                            ++count;
+                        }
+                    }
+                }
+
+                smoothed[(z * width_) + x] = total / float(count);
+            }
+        }
+
+        heights_.swap(smoothed);
+    }
+
+    // The root is the smallest power of two multiple of the chunk size covering the whole map
+    int32_t cells = std::max(width_, depth_) - 1;
+    int32_t root_size = lod_.chunk_size;
+    while(root_size < cells) {
+        root_size *= 2;
+    }
+
+    nodes_.clear();
+    level_count_ = 0;
+    build_node(0, 0, 0, root_size);
+
+    stage_->window->jobs->parallel_for(0, nodes_.size(), [this](uint32_t i) {
+        calculate_error(nodes_[i]);
+    });
+
+    /* Children are always stored after their parent, so walking backwards makes sure a node
+     * is never considered more accurate than anything beneath it */
+    for(int32_t i = int32_t(nodes_.size()) - 1; i >= 0; --i) {
+        Node& node = nodes_[i];
+        for(auto child: node.children) {
+            if(child >= 0) {
+                node.error = std::max(node.error, nodes_[child].error);
+            }
+        }
+    }
+
+    material_ = stage_->assets->material(stage_->assets->clone_default_material());
+
+    update_connection_ = stage_->window->signal_frame_started().connect(
+        std::bind(&Terrain::update, this)
+    );
+}
+
+int32_t Terrain::build_node(uint32_t level, int32_t x, int32_t z, int32_t size) {
+    int32_t index = nodes_.size();
+
+    Node node;
+    node.level = level;
+    node.x = x;
+    node.z = z;
+    node.step = size / lod_.chunk_size;
+    nodes_.push_back(node);
+
+    level_count_ = std::max(level_count_, level + 1);
+
+    if(node.step > 1) {
+        int32_t half = size / 2;
+        for(uint32_t i = 0; i < 4; ++i) {
+            int32_t child_x = x + ((i % 2) * half);
+            int32_t child_z = z + ((i / 2) * half);
+
+            // Nothing to draw past the edge of the map
+            if(child_x >= width_ - 1 || child_z >= depth_ - 1) {
+                continue;
+            }
+
+            int32_t child = build_node(level + 1, child_x, child_z, half);
+            nodes_[index].children[i] = child;
+        }
+    }
+
+    return index;
+}
+
+void Terrain::calculate_error(Node& node) const {
+    const int32_t size = node.step * lod_.chunk_size;
+    const int32_t end_x = std::min(node.x + size, width_ - 1);
+    const int32_t end_z = std::min(node.z + size, depth_ - 1);
+
+    node.min_height = node.max_height = height(node.x, node.z);
+    node.error = 0.0f;
+
+    for(int32_t z = node.z; z <= end_z; ++z) {
+        for(int32_t x = node.x; x <= end_x; ++x) {
+            float actual = height(x, z);
+            node.min_height = std::min(node.min_height, actual);
+            node.max_height = std::max(node.max_height, actual);
+
+            if(node.step == 1) {
+                continue;
+            }
+
+            // Interpolate between the vertices of this node's grid surrounding the texel
+            int32_t grid_x = node.x + (((x - node.x) / node.step) * node.step);
+            int32_t grid_z = node.z + (((z - node.z) / node.step) * node.step);
+            float fx = float(x - grid_x) / float(node.step);
+            float fz = float(z - grid_z) / float(node.step);
+
+            float top = height(grid_x, grid_z) + (height(grid_x + node.step, grid_z) - height(grid_x, grid_z)) * fx;
+            float bottom = height(grid_x, grid_z + node.step) + (height(grid_x + node.step, grid_z + node.step) - height(grid_x, grid_z + node.step)) * fx;
+            float approximation = top + (bottom - top) * fz;
+
+            node.error = std::max(node.error, std::abs(approximation - actual));
+        }
+    }
+}
+
+Vec3 Terrain::position(int32_t x, int32_t z) const {
+    x = std::max(0, std::min(x, width_ - 1));
+    z = std::max(0, std::min(z, depth_ - 1));
+
+    // Centred on the origin, as the heightmap loader does
+    float x_offset = (spec_.spacing * float(width_)) * 0.5f;
+    float z_offset = (spec_.spacing * float(depth_)) * 0.5f;
+
+    return Vec3(
+        (float(x) * spec_.spacing) - x_offset,
+        height(x, z),
+        (float(z) * spec_.spacing) - z_offset
+    );
+}
+
+float Terrain::height_at(float x, float z) const {
+    float x_offset = (spec_.spacing * float(width_)) * 0.5f;
+    float z_offset = (spec_.spacing * float(depth_)) * 0.5f;
+
+    return height(
+        int32_t(std::round((x + x_offset) / spec_.spacing)),
+        int32_t(std::round((z + z_offset) / spec_.spacing))
+    );
+}
+
+uint32_t Terrain::level_at(float x, float z) const {
+    float x_offset = (spec_.spacing * float(width_)) * 0.5f;
+    float z_offset = (spec_.spacing * float(depth_)) * 0.5f;
+
+    int32_t node = selected_node_at(
+        int32_t(std::floor((x + x_offset) / spec_.spacing)),
+        int32_t(std::floor((z + z_offset) / spec_.spacing))
+    );
+
+    return (node < 0) ? 0 : nodes_[node].level;
+}
+
+std::vector<ActorID> Terrain::chunk_actors() const {
+    std::vector<ActorID> results;
+    for(auto i: selected_) {
+        results.push_back(nodes_[i].actor_id);
+    }
+    return results;
+}
+
+MaterialID Terrain::material_id() const {
+    return material_->id();
+}
+
+void Terrain::set_material_id(MaterialID material) {
+    material_ = stage_->assets->material(material);
+
+    for(auto& node: nodes_) {
+        if(node.resident) {
+            stage_->assets->mesh(node.mesh_id)->set_material_id(material);
+        }
+    }
+}
+
+void Terrain::update() {
+    auto camera = stage_->window->camera(camera_id_);
+
+    ++frame_;
+
+    std::vector<uint32_t> previous;
+    previous.swap(selected_);
+    for(auto i: previous) {
+        nodes_[i].selected = false;
+    }
+
+    const Mat4& transform = camera->transform();
+    Vec3 eye(transform.mat[12], transform.mat[13], transform.mat[14]);
+
+    // How many pixels a unit of error covers at a distance of one unit
+    float pixels_per_unit = camera->projection_matrix().mat[5] * 0.5f * float(stage_->window->height());
+
+    select(0, eye, pixels_per_unit);
+
+    for(auto i: selected_) {
+        Node& node = nodes_[i];
+        node.last_used = frame_;
+
+        if(!node.resident) {
+            make_resident(node);
+        }
+
+        bool stitch_changed = false;
+        for(uint32_t side = 0; side < 4; ++side) {
+            uint32_t ratio = neighbour_ratio(node, Side(side));
+            if(ratio != node.stitch[side]) {
+                node.stitch[side] = ratio;
+                stitch_changed = true;
+            }
+        }
+
+        if(stitch_changed) {
+            rebuild_indices(node);
+        }
+
+        stage_->actor(node.actor_id)->set_visible(true);
+    }
+
+    for(auto i: previous) {
+        Node& node = nodes_[i];
+        if(!node.selected && node.resident) {
+            stage_->actor(node.actor_id)->set_visible(false);
+        }
+    }
+
+    if(resident_count_ <= lod_.max_resident_chunks) {
+        return;
+    }
+
+    // Over budget, throw away the chunks which haven't been used for longest
+    std::vector<uint32_t> candidates;
+    for(uint32_t i = 0; i < nodes_.size(); ++i) {
+        if(nodes_[i].resident && !nodes_[i].selected) {
+            candidates.push_back(i);
+        }
+    }
+
+    uint32_t excess = std::min<uint32_t>(resident_count_ - lod_.max_resident_chunks, candidates.size());
+
+    std::partial_sort(candidates.begin(), candidates.begin() + excess, candidates.end(), [this](uint32_t lhs, uint32_t rhs) {
+        return nodes_[lhs].last_used < nodes_[rhs].last_used;
+    });
+
+    for(uint32_t i = 0; i < excess; ++i) {
+        evict(nodes_[candidates[i]]);
+    }
+}
+
+void Terrain::select(uint32_t node_index, const Vec3& eye, float pixels_per_unit) {
+    Node& node = nodes_[node_index];
+
+    const int32_t size = node.step * lod_.chunk_size;
+    Vec3 min = position(node.x, node.z);
+    Vec3 max = position(node.x + size, node.z + size);
+
+    // Distance from the eye to the closest point of the chunk's bounds
+    float dx = std::max(0.0f, std::max(min.x - eye.x, eye.x - max.x));
+    float dy = std::max(0.0f, std::max(node.min_height - eye.y, eye.y - node.max_height));
+    float dz = std::max(0.0f, std::max(min.z - eye.z, eye.z - max.z));
+    float distance = std::sqrt((dx * dx) + (dy * dy) + (dz * dz));
+
+    bool has_children = false;
+    for(auto child: node.children) {
+        has_children = has_children || child >= 0;
+    }
+
+    if(has_children && node.error * pixels_per_unit > lod_.max_screen_error * distance) {
+        for(auto child: node.children) {
+            if(child >= 0) {
+                select(child, eye, pixels_per_unit);
+            }
+        }
+    } else {
+        node.selected = true;
+        selected_.push_back(node_index);
+    }
+}
+
+int32_t Terrain::selected_node_at(int32_t x, int32_t z) const {
+    if(nodes_.empty()) {
+        return -1;
+    }
+
+    const int32_t root_size = nodes_[0].step * lod_.chunk_size;
+    if(x < 0 || z < 0 || x >= root_size || z >= root_size) {
+        return -1;
+    }
+
+    int32_t index = 0;
+    while(index >= 0) {
+        const Node& node = nodes_[index];
+        if(node.selected) {
+            return index;
+        }
+
+        const int32_t half = (node.step * lod_.chunk_size) / 2;
+        const int32_t child = ((x - node.x) >= half ? 1 : 0) + ((z - node.z) >= half ? 2 : 0);
+        index = node.children[child];
+    }
+
+    return -1;
+}
+
+uint32_t Terrain::neighbour_ratio(const Node& node, Side side) const {
+    const int32_t size = node.step * lod_.chunk_size;
+    const int32_t middle = size / 2;
+
+    int32_t neighbour = -1;
+    switch(side) {
+        case SIDE_NEG_X: neighbour = selected_node_at(node.x - 1, node.z + middle); break;
+        case SIDE_POS_X: neighbour = selected_node_at(node.x + size, node.z + middle); break;
+        case SIDE_NEG_Z: neighbour = selected_node_at(node.x + middle, node.z - 1); break;
+        case SIDE_POS_Z: neighbour = selected_node_at(node.x + middle, node.z + size); break;
+    }
+
+    if(neighbour < 0 || nodes_[neighbour].step <= node.step) {
+        // Finer neighbours stitch themselves to us
+        return 1;
+    }
+
+    return std::min<uint32_t>(nodes_[neighbour].step / node.step, lod_.chunk_size);
+}
+
+void Terrain::make_resident(Node& node) {
+    node.mesh_id = stage_->assets->new_mesh(VertexSpecification::DEFAULT);
+    auto mesh = stage_->assets->mesh(node.mesh_id);
+
+    const int32_t n = lod_.chunk_size;
+    const float largest = float(std::max(width_, depth_));
+    const int32_t s = node.step;
+
+    for(int32_t j = 0; j <= n; ++j) {
+        for(int32_t i = 0; i <= n; ++i) {
+            int32_t x = std::min(node.x + (i * s), width_ - 1);
+            int32_t z = std::min(node.z + (j * s), depth_ - 1);
+
+            mesh->shared_data->position(position(x, z));
+
+            if(spec_.calculate_normals) {
+                // Central differences over this chunk's own spacing, so coarse chunks shade smoothly
+                float left = height(x - s, z), right = height(x + s, z);
+                float back = height(x, z - s), front = height(x, z + s);
+                mesh->shared_data->normal(Vec3(left - right, 2.0f * float(s) * spec_.spacing, back - front).normalized());
+            } else {
+                mesh->shared_data->normal(Vec3(0, 1, 0));
+            }
+
+            mesh->shared_data->diffuse(kglt::Colour::WHITE);
+
+            mesh->shared_data->tex_coord0(
+                (spec_.texcoord0_repeat / largest) * float(x),
+                (spec_.texcoord0_repeat / largest) * float(z)
+            );
+
+            mesh->shared_data->tex_coord1(
+                float(x) / float(width_),
+                float(z) / float(depth_)
+            );
+
+            mesh->shared_data->move_next();
+        }
+    }
+
+    mesh->shared_data->done();
+    mesh->new_submesh_with_material("chunk", material_->id());
+
+    // The indices are built once we know the neighbours
+    std::fill(node.stitch, node.stitch + 4, 0);
+
+    node.actor_id = stage_->new_actor_with_mesh(node.mesh_id);
+    node.resident = true;
+    ++resident_count_;
+}
+
+void Terrain::evict(Node& node) {
+    if(stage_->has_actor(node.actor_id)) {
+        stage_->delete_actor(node.actor_id);
+    }
+
+    // The mesh is garbage collected now that nothing uses it
+    node.actor_id = ActorID();
+    node.mesh_id = MeshID();
+    node.resident = false;
+    --resident_count_;
+}
+
+void Terrain::rebuild_indices(Node& node) {
+    auto mesh = stage_->assets->mesh(node.mesh_id);
+    auto& indices = mesh->first_submesh()->index_data;
+
+    const int32_t n = lod_.chunk_size;
+
+    /* Along a side which borders a coarser chunk, every vertex is moved back onto the nearest
+     * vertex the neighbour also has. The edge then matches the neighbour's exactly, the
+     * triangles which collapse in the process are skipped */
+    auto vertex = [&](int32_t i, int32_t j) -> Index {
+        if(j == 0 && node.stitch[SIDE_NEG_Z] > 1) {
+            i -= i % node.stitch[SIDE_NEG_Z];
+        } else if(j == n && node.stitch[SIDE_POS_Z] > 1) {
+            i -= i % node.stitch[SIDE_POS_Z];
+        }
+
+        if(i == 0 && node.stitch[SIDE_NEG_X] > 1) {
+            j -= j % node.stitch[SIDE_NEG_X];
+        } else if(i == n && node.stitch[SIDE_POS_X] > 1) {
+            j -= j % node.stitch[SIDE_POS_X];
+        }
+
+        return (j * (n + 1)) + i;
+    };
+
+    auto triangle = [&](Index a, Index b, Index c) {
+        if(a != b && b != c && a != c) {
+            indices->index(a);
+            indices->index(b);
+            indices->index(c);
+        }
+    };
+
+    indices->clear();
+    indices->reserve(n * n * 6);
+
+    for(int32_t j = 0; j < n; ++j) {
+        for(int32_t i = 0; i < n; ++i) {
+            // Same winding as the heightmap loader
+            triangle(vertex(i, j), vertex(i, j + 1), vertex(i + 1, j));
+            triangle(vertex(i + 1, j), vertex(i, j + 1), vertex(i + 1, j + 1));
+        }
+    }
+
+    indices->done();
+}
+
+}
+}
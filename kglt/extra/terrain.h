@@ -0,0 +1,158 @@
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+#include <vector>
+#include <algorithm>
+
+#include "../types.h"
+#include "../generic/managed.h"
+#include "../loaders/heightmap_loader.h"
+#include "../deps/kazsignal/kazsignal.h"
+
+namespace kglt {
+
+namespace extra {
+
+struct TerrainLODSpecification {
+    /* Quads along each side of a chunk, must be a power of two. Every chunk has this many
+     * whatever its level, coarser levels just cover more of the heightmap */
+    uint32_t chunk_size = 32;
+
+    /* A chunk is split into its children while its geometric error would appear larger
+     * than this many pixels from the camera */
+    float max_screen_error = 4.0f;
+
+    /* The number of chunk meshes kept around, the least recently used ones beyond this
+     * are destroyed and rebuilt if they're needed again */
+    uint32_t max_resident_chunks = 256;
+};
+
+/*
+ * Chunked LOD terrain built from a heightmap.
+ *
+ * Rather than one vertex per texel, the heightmap is divided into a quadtree where every node
+ * is a chunk_size x chunk_size grid; the root covers the whole map, and each level down halves
+ * the area and doubles the resolution until the leaves sample every texel. Each frame the
+ * quadtree is walked from the camera and a node is used if its geometric error (how far the
+ * real surface strays from it) projects to less than max_screen_error pixels. This is
+ * independent of the camera direction, so turning around doesn't cause chunks to be rebuilt.
+ *
+ * Chunk meshes are built when first selected and each gets its own actor, so chunks are culled
+ * individually by the stage's partitioner. Where a chunk borders a coarser one, the vertices
+ * along that edge are snapped onto the coarser grid so there are no cracks between levels.
+ *
+ * Selection runs at the start of every frame for the given camera.
+ */
+class Terrain :
+    public Managed<Terrain> {
+
+public:
+    Terrain(StagePtr stage, CameraID camera, const unicode& heightmap_file,
+        const HeightmapSpecification& spec=HeightmapSpecification(),
+        const TerrainLODSpecification& lod=TerrainLODSpecification()
+    );
+
+    /* Builds the terrain from width x depth normalized heights (0.0 - 1.0), row by row */
+    Terrain(StagePtr stage, CameraID camera, const std::vector<float>& heights, uint32_t width, uint32_t depth,
+        const HeightmapSpecification& spec=HeightmapSpecification(),
+        const TerrainLODSpecification& lod=TerrainLODSpecification()
+    );
+
+    ~Terrain();
+
+    /* Reselects the chunks for the camera, this is called automatically at the start of each frame */
+    void update();
+
+    MaterialID material_id() const;
+    void set_material_id(MaterialID material);
+
+    /* The height of the heightmap texel nearest to the given point */
+    float height_at(float x, float z) const;
+
+    uint32_t level_count() const { return level_count_; }
+
+    /* The level of the chunk drawn at the given point, 0 is the coarsest */
+    uint32_t level_at(float x, float z) const;
+
+    /* The actors of the chunks currently selected for drawing */
+    std::vector<ActorID> chunk_actors() const;
+
+    uint32_t selected_chunk_count() const { return selected_.size(); }
+    uint32_t resident_chunk_count() const { return resident_count_; }
+
+private:
+    enum Side {
+        SIDE_NEG_X = 0,
+        SIDE_POS_X,
+        SIDE_NEG_Z,
+        SIDE_POS_Z
+    };
+
+    struct Node {
+        uint32_t level = 0;
+        int32_t x = 0; // Texel coordinates of the corner
+        int32_t z = 0;
+        int32_t step = 1; // Texels between vertices
+
+        float error = 0.0f;
+        float min_height = 0.0f;
+        float max_height = 0.0f;
+
+        int32_t children[4] = {-1, -1, -1, -1};
+
+        bool selected = false;
+
+        bool resident = false;
+        MeshID mesh_id;
+        ActorID actor_id;
+        uint64_t last_used = 0;
+
+        // The ratio between the neighbour's step and ours for each side, greater than 1 where we stitch
+        uint32_t stitch[4] = {0, 0, 0, 0};
+    };
+
+    StagePtr stage_;
+    CameraID camera_id_;
+    HeightmapSpecification spec_;
+    TerrainLODSpecification lod_;
+
+    MaterialPtr material_;
+
+    int32_t width_ = 0;
+    int32_t depth_ = 0;
+    std::vector<float> heights_; // World space heights, one per texel
+
+    uint32_t level_count_ = 0;
+    std::vector<Node> nodes_;
+    std::vector<uint32_t> selected_;
+    uint32_t resident_count_ = 0;
+    uint64_t frame_ = 0;
+
+    sig::Connection update_connection_;
+
+    void build(const std::vector<float>& heights, uint32_t width, uint32_t depth);
+
+    int32_t build_node(uint32_t level, int32_t x, int32_t z, int32_t size);
+    void calculate_error(Node& node) const;
+
+    float height(int32_t x, int32_t z) const {
+        x = std::max(0, std::min(x, width_ - 1));
+        z = std::max(0, std::min(z, depth_ - 1));
+        return heights_[(z * width_) + x];
+    }
+
+    Vec3 position(int32_t x, int32_t z) const;
+
+    void select(uint32_t node_index, const Vec3& eye, float pixels_per_unit);
+    int32_t selected_node_at(int32_t x, int32_t z) const;
+    uint32_t neighbour_ratio(const Node& node, Side side) const;
+
+    void make_resident(Node& node);
+    void evict(Node& node);
+    void rebuild_indices(Node& node);
+};
+
+}
+}
+
+#endif // TERRAIN_H
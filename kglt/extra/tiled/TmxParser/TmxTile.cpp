@@ -54,5 +54,27 @@ namespace Tmx
 		{
 			properties.Parse(propertiesNode);
 		}
+
+		// Parse the animation frames if any.
+		const TiXmlNode *animationNode = tileNode->FirstChild("animation");
+
+		if (animationNode) 
+		{
+			frames.clear();
+
+			const TiXmlElement *frameElem = animationNode->FirstChildElement("frame");
+			while (frameElem) 
+			{
+				int tileId = 0;
+				int duration = 0;
+
+				frameElem->Attribute("tileid", &tileId);
+				frameElem->Attribute("duration", &duration);
+
+				frames.push_back(AnimationFrame(tileId, duration));
+
+				frameElem = frameElem->NextSiblingElement("frame");
+			}
+		}
 	}
 };
@@ -27,10 +27,29 @@
 //-----------------------------------------------------------------------------
 #pragma once
 
+#include <vector>
+
 #include "TmxPropertySet.h"
 
 namespace Tmx 
 {
+	//-------------------------------------------------------------------------
+	// A single frame of an animated tile.
+	//-------------------------------------------------------------------------
+	struct AnimationFrame 
+	{
+		AnimationFrame(int _tileId, int _duration)
+			: tileId(_tileId)
+			, duration(_duration)
+		{}
+
+		// The tile to show, relative to the tileset.
+		int tileId;
+
+		// How long the frame is shown for, in milliseconds.
+		int duration;
+	};
+
 	//-------------------------------------------------------------------------
 	// Class to contain information about every tile in the tileset/tiles 
 	// element.
@@ -54,9 +73,17 @@ namespace Tmx
 		// Get a set of properties regarding the tile.
 		const Tmx::PropertySet &GetProperties() const { return properties; }
 
+		// Get the frames of the tile's animation, empty if it isn't animated.
+		const std::vector< Tmx::AnimationFrame > &GetFrames() const { return frames; }
+
+		// Get whether the tile is animated.
+		bool IsAnimated() const { return !frames.empty(); }
+
 	private:
 		int id;
 
 		Tmx::PropertySet properties;
+
+		std::vector< Tmx::AnimationFrame > frames;
 	};
 };
@@ -0,0 +1,395 @@
+#include <algorithm>
+
+#include "tilemap.h"
+#include "tiled/TmxParser/Tmx.h"
+
+#include "../mesh.h"
+#include "../stage.h"
+#include "../actor.h"
+#include "../window_base.h"
+#include "../resource_locator.h"
+
+namespace kglt {
+namespace extra {
+
+const uint32_t VERTICES_PER_TILE = 4;
+
+/* Tiles don't need normals or a second set of texture coordinates, which saves 80 bytes a cell */
+const VertexSpecification TILE_VERTEX_SPECIFICATION = {
+    VERTEX_ATTRIBUTE_3F,
+    VERTEX_ATTRIBUTE_NONE,
+    VERTEX_ATTRIBUTE_2F,
+    VERTEX_ATTRIBUTE_NONE,
+    VERTEX_ATTRIBUTE_NONE,
+    VERTEX_ATTRIBUTE_NONE,
+    VERTEX_ATTRIBUTE_4F
+};
+
+TileMap::TileMap(StagePtr stage, const unicode& tmx_file, const unicode& layer_name, float tile_render_size, uint32_t chunk_size):
+    stage_(stage),
+    tile_render_size_(tile_render_size),
+    chunk_size_(chunk_size) {
+
+    if(!chunk_size_) {
+        throw std::logic_error("Tile map chunks must be at least one tile across");
+    }
+
+    unicode path = stage->window->resource_locator->locate_file(tmx_file);
+
+    Tmx::Map map;
+    map.ParseFile(path.encode());
+
+    if(map.HasError()) {
+        throw std::runtime_error(_u("Unable to load the tile map {0}: {1}").format(path, map.GetErrorText()).encode());
+    }
+
+    auto layers = map.GetLayers();
+    auto it = std::find_if(layers.begin(), layers.end(), [=](Tmx::Layer* layer) { return layer->GetName() == layer_name.encode(); });
+
+    if(it == layers.end()) {
+        throw std::runtime_error(_u("Unable to find the layer with name: {0}").format(layer_name).encode());
+    }
+
+    Tmx::Layer* layer = (*it);
+
+    width_ = layer->GetWidth();
+    height_ = layer->GetHeight();
+
+    tilesets_ = loaders::load_tiled_tilesets(stage->assets, map, path);
+
+    // Tilesets on the same atlas page share a material, and so a submesh
+    for(auto& tileset: tilesets_) {
+        auto material = std::find(materials_.begin(), materials_.end(), tileset.region.material);
+        tileset_materials_.push_back(material - materials_.begin());
+
+        if(material == materials_.end()) {
+            materials_.push_back(tileset.region.material);
+        }
+    }
+
+    for(uint32_t i = 0; i < tilesets_.size(); ++i) {
+        for(auto& p: tilesets_[i].animations) {
+            Animation& animation = animations_[tilesets_[i].first_gid + p.first];
+            animation.tileset = i;
+            animation.frames = p.second;
+
+            for(auto& frame: animation.frames) {
+                animation.total_duration += frame.second;
+            }
+        }
+    }
+
+    tiles_.resize(width_ * height_, 0);
+    for(uint32_t y = 0; y < height_; ++y) {
+        for(uint32_t x = 0; x < width_; ++x) {
+            int32_t tileset = layer->GetTileTilesetIndex(x, y);
+            if(tileset < 0) {
+                continue;
+            }
+
+            uint32_t gid = tilesets_[tileset].first_gid + layer->GetTileId(x, y);
+            uint32_t cell = (y * width_) + x;
+            tiles_[cell] = gid;
+
+            auto animation = animations_.find(gid);
+            if(animation != animations_.end()) {
+                animation->second.cells.insert(cell);
+            }
+        }
+    }
+
+    chunks_across_ = (width_ + chunk_size_ - 1) / chunk_size_;
+    uint32_t chunks_down = (height_ + chunk_size_ - 1) / chunk_size_;
+
+    chunks_.resize(chunks_across_ * chunks_down);
+    for(uint32_t j = 0; j < chunks_down; ++j) {
+        for(uint32_t i = 0; i < chunks_across_; ++i) {
+            Chunk& chunk = chunks_[(j * chunks_across_) + i];
+            chunk.x = i * chunk_size_;
+            chunk.y = j * chunk_size_;
+            chunk.width = std::min(chunk_size_, width_ - chunk.x);
+            chunk.height = std::min(chunk_size_, height_ - chunk.y);
+
+            build_chunk(chunk);
+        }
+    }
+
+    // Chunks are rewritten here, so this mustn't run on the simulation thread
+    update_connection_ = stage_->signal_update().connect(
+        std::bind(&TileMap::update, this, std::placeholders::_1)
+    );
+}
+
+TileMap::~TileMap() {
+    update_connection_.disconnect();
+
+    for(auto& chunk: chunks_) {
+        if(chunk.actor_id && stage_->has_actor(chunk.actor_id)) {
+            stage_->delete_actor(chunk.actor_id);
+        }
+
+        // The mesh is garbage collected now that nothing uses it
+        chunk.mesh.reset();
+    }
+}
+
+int32_t TileMap::tileset_for(uint32_t gid) const {
+    // Tilesets are in order of their first gid, so it's the last one which starts at or before the tile
+    for(int32_t i = int32_t(tilesets_.size()) - 1; i >= 0; --i) {
+        const loaders::TiledTileset& tileset = tilesets_[i];
+        if(gid >= tileset.first_gid) {
+            uint32_t tile_count = tileset.num_tiles_wide() * tileset.num_tiles_high();
+            return (gid - tileset.first_gid < tile_count) ? i : -1;
+        }
+    }
+
+    return -1;
+}
+
+uint32_t TileMap::material_for(uint32_t gid) const {
+    return tileset_materials_.at(tileset_for(gid));
+}
+
+uint32_t TileMap::tile(uint32_t x, uint32_t y) const {
+    if(x >= width_ || y >= height_) {
+        throw std::out_of_range("Tried to read a tile outside the map");
+    }
+
+    return tiles_[(y * width_) + x];
+}
+
+void TileMap::set_tile(uint32_t x, uint32_t y, uint32_t gid) {
+    if(x >= width_ || y >= height_) {
+        throw std::out_of_range("Tried to set a tile outside the map");
+    }
+
+    if(gid && tileset_for(gid) < 0) {
+        throw std::logic_error(_u("No tileset contains the tile {0}").format(gid).encode());
+    }
+
+    const uint32_t cell = (y * width_) + x;
+    const uint32_t old = tiles_[cell];
+
+    if(old == gid) {
+        return;
+    }
+
+    auto old_animation = animations_.find(old);
+    if(old_animation != animations_.end()) {
+        old_animation->second.cells.erase(cell);
+    }
+
+    tiles_[cell] = gid;
+
+    if(gid) {
+        uint32_t tileset = tileset_for(gid);
+        uint32_t tile_id = gid - tilesets_[tileset].first_gid;
+
+        auto animation = animations_.find(gid);
+        if(animation != animations_.end()) {
+            animation->second.cells.insert(cell);
+            tile_id = animation->second.frames[animation->second.current_frame].first;
+        }
+
+        write_texcoords(x, y, tileset, tile_id);
+    }
+
+    // Only the texture coordinates change unless the cell needs adding to, or removing from, a submesh
+    if(!old || !gid || material_for(old) != material_for(gid)) {
+        chunks_[chunk_index(x, y)].indices_dirty = true;
+    }
+}
+
+Vec2 TileMap::tile_position(uint32_t x, uint32_t y) const {
+    return Vec2(
+        (float(x) + 0.5f) * tile_render_size_,
+        (float(height_ - y) - 0.5f) * tile_render_size_
+    );
+}
+
+std::vector<ActorID> TileMap::chunk_actors() const {
+    std::vector<ActorID> results;
+    for(auto& chunk: chunks_) {
+        if(chunk.actor_id) {
+            results.push_back(chunk.actor_id);
+        }
+    }
+    return results;
+}
+
+ActorID TileMap::chunk_actor(uint32_t x, uint32_t y) const {
+    if(x >= width_ || y >= height_) {
+        throw std::out_of_range("Tried to find the chunk of a tile outside the map");
+    }
+
+    return chunks_[chunk_index(x, y)].actor_id;
+}
+
+void TileMap::update(double dt) {
+    elapsed_ += dt;
+
+    const uint64_t milliseconds = uint64_t(elapsed_ * 1000.0);
+
+    for(auto& p: animations_) {
+        Animation& animation = p.second;
+        if(!animation.total_duration || animation.cells.empty()) {
+            continue;
+        }
+
+        uint32_t time = milliseconds % animation.total_duration;
+        uint32_t frame = 0;
+        while(time >= animation.frames[frame].second) {
+            time -= animation.frames[frame].second;
+            ++frame;
+        }
+
+        if(frame == animation.current_frame) {
+            continue;
+        }
+
+        animation.current_frame = frame;
+
+        uint32_t tile_id = animation.frames[frame].first;
+        for(auto cell: animation.cells) {
+            write_texcoords(cell % width_, cell / width_, animation.tileset, tile_id);
+        }
+    }
+
+    for(auto& chunk: chunks_) {
+        if(chunk.indices_dirty) {
+            rebuild_indices(chunk);
+        }
+    }
+}
+
+void TileMap::build_chunk(Chunk& chunk) {
+    chunk.mesh = stage_->assets->mesh(stage_->assets->new_mesh(TILE_VERTEX_SPECIFICATION));
+
+    VertexData& vertices = chunk.mesh->shared_data;
+    const float half = 0.5f * tile_render_size_;
+
+    for(uint32_t y = chunk.y; y < chunk.y + chunk.height; ++y) {
+        for(uint32_t x = chunk.x; x < chunk.x + chunk.width; ++x) {
+            Vec2 centre = tile_position(x, y);
+
+            const Vec2 corners[] = {
+                Vec2(centre.x - half, centre.y - half),
+                Vec2(centre.x + half, centre.y - half),
+                Vec2(centre.x + half, centre.y + half),
+                Vec2(centre.x - half, centre.y + half)
+            };
+
+            for(uint32_t i = 0; i < VERTICES_PER_TILE; ++i) {
+                vertices.position(corners[i].x, corners[i].y, 0);
+                vertices.diffuse(kglt::Colour::WHITE);
+                vertices.tex_coord0(0, 0);
+                vertices.move_next();
+            }
+        }
+    }
+
+    vertices.done();
+
+    for(uint32_t y = chunk.y; y < chunk.y + chunk.height; ++y) {
+        for(uint32_t x = chunk.x; x < chunk.x + chunk.width; ++x) {
+            uint32_t gid = tiles_[(y * width_) + x];
+            if(!gid) {
+                continue;
+            }
+
+            uint32_t tileset = tileset_for(gid);
+            uint32_t tile_id = gid - tilesets_[tileset].first_gid;
+
+            auto animation = animations_.find(gid);
+            if(animation != animations_.end()) {
+                tile_id = animation->second.frames[animation->second.current_frame].first;
+            }
+
+            write_texcoords(x, y, tileset, tile_id);
+        }
+    }
+
+    rebuild_indices(chunk);
+}
+
+void TileMap::rebuild_indices(Chunk& chunk) {
+    std::map<uint32_t, std::vector<Index>> indices; // By material
+
+    for(uint32_t y = chunk.y; y < chunk.y + chunk.height; ++y) {
+        for(uint32_t x = chunk.x; x < chunk.x + chunk.width; ++x) {
+            uint32_t gid = tiles_[(y * width_) + x];
+            if(!gid) {
+                continue;
+            }
+
+            Index first = first_vertex(chunk, x, y);
+
+            auto& out = indices[material_for(gid)];
+            out.insert(out.end(), {first, first + 1, first + 2, first, first + 2, first + 3});
+        }
+    }
+
+    std::set<uint32_t> materials;
+    for(auto& p: indices) {
+        materials.insert(p.first);
+    }
+
+    /* The render queue only picks up an actor's submeshes when the actor is created, so if
+     * the chunk needs a different set of submeshes the actor is recreated around them. Only
+     * keeping submeshes which have tiles also keeps empty ones out of the chunk's bounds */
+    if(materials != chunk.materials) {
+        if(chunk.actor_id && stage_->has_actor(chunk.actor_id)) {
+            stage_->delete_actor(chunk.actor_id);
+        }
+
+        chunk.actor_id = ActorID();
+
+        for(auto material: chunk.materials) {
+            if(!materials.count(material)) {
+                chunk.mesh->delete_submesh(std::to_string(material));
+            }
+        }
+
+        for(auto material: materials) {
+            if(!chunk.materials.count(material)) {
+                chunk.mesh->new_submesh_with_material(std::to_string(material), materials_[material]);
+            }
+        }
+
+        chunk.materials = materials;
+    }
+
+    for(auto& p: indices) {
+        IndexData& index_data = chunk.mesh->submesh(std::to_string(p.first))->index_data;
+        index_data.clear();
+        index_data.resize(p.second.size());
+        std::copy(p.second.begin(), p.second.end(), index_data._raw_data());
+        index_data.done();
+    }
+
+    if(!chunk.actor_id && !materials.empty()) {
+        chunk.actor_id = stage_->new_actor_with_mesh(chunk.mesh->id());
+    }
+
+    chunk.indices_dirty = false;
+}
+
+void TileMap::write_texcoords(uint32_t x, uint32_t y, uint32_t tileset, uint32_t tile_id) {
+    Chunk& chunk = chunks_[chunk_index(x, y)];
+    VertexData& vertices = chunk.mesh->shared_data;
+
+    auto texcoords = tilesets_[tileset].texcoords(tile_id);
+
+    const uint32_t first = first_vertex(chunk, x, y);
+    uint8_t* data = vertices.data() + (first * vertices.stride()) + vertices.texcoord0_offset();
+
+    for(uint32_t i = 0; i < VERTICES_PER_TILE; ++i) {
+        *((kmVec2*) data) = texcoords[i];
+        data += vertices.stride();
+    }
+
+    chunk.mesh->mark_shared_data_range_dirty(first, VERTICES_PER_TILE);
+}
+
+}
+}
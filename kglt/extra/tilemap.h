@@ -0,0 +1,133 @@
+#ifndef TILEMAP_H
+#define TILEMAP_H
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include "../types.h"
+#include "../generic/managed.h"
+#include "../loaders/tiled_loader.h"
+#include "../deps/kazsignal/kazsignal.h"
+
+namespace kglt {
+
+namespace extra {
+
+/*
+ * A layer of a TMX map which can be changed while the game runs.
+ *
+ * The layer is divided into chunk_size x chunk_size chunks and each chunk gets its own mesh and
+ * actor, so chunks are culled individually by the stage's partitioner. Every cell of a chunk has
+ * its own four vertices whether or not there's a tile there, and these never move. Changing a
+ * tile only rewrites the texture coordinates of its cell and uploads just those vertices, the
+ * chunk's indices are only rebuilt (on the next update) when a cell is emptied or filled, or
+ * switches to a tileset on a different atlas page.
+ *
+ * Tiles are global tile ids as Tiled uses them: 0 is an empty cell and each tileset's tiles
+ * start at its first gid. Tiles with an animation in their tileset animate automatically.
+ *
+ * Tile (0, 0) is the top left of the layer, as in Tiled, and (like TiledLoader) the bottom
+ * left corner of the layer is at the origin with each tile tile_render_size units across.
+ */
+class TileMap :
+    public Managed<TileMap> {
+
+public:
+    static const uint32_t DEFAULT_CHUNK_SIZE = 32;
+
+    TileMap(StagePtr stage, const unicode& tmx_file, const unicode& layer_name,
+        float tile_render_size=1.0f, uint32_t chunk_size=DEFAULT_CHUNK_SIZE
+    );
+
+    ~TileMap();
+
+    /* Advances animated tiles and rebuilds any chunks which need it, called automatically every
+     * frame from the stage's update on the main thread */
+    void update(double dt);
+
+    uint32_t width() const { return width_; }
+    uint32_t height() const { return height_; }
+
+    float tile_render_size() const { return tile_render_size_; }
+
+    uint32_t tile(uint32_t x, uint32_t y) const;
+    void set_tile(uint32_t x, uint32_t y, uint32_t gid);
+
+    /* The centre of the tile in world space */
+    Vec2 tile_position(uint32_t x, uint32_t y) const;
+
+    uint32_t chunk_count() const { return chunks_.size(); }
+    std::vector<ActorID> chunk_actors() const;
+
+    /* The actor of the chunk containing the tile */
+    ActorID chunk_actor(uint32_t x, uint32_t y) const;
+
+    const std::vector<loaders::TiledTileset>& tilesets() const { return tilesets_; }
+
+private:
+    struct Chunk {
+        uint32_t x = 0; // Tile coordinates of the top left corner
+        uint32_t y = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+
+        MeshPtr mesh;
+        ActorID actor_id;
+
+        std::set<uint32_t> materials; // The materials with a submesh, named by their index
+        bool indices_dirty = false;
+    };
+
+    struct Animation {
+        uint32_t tileset = 0;
+        std::vector<std::pair<uint32_t, uint32_t>> frames; // Tile id and duration in milliseconds
+        uint32_t total_duration = 0;
+        uint32_t current_frame = 0;
+
+        std::set<uint32_t> cells; // The cells showing the animated tile
+    };
+
+    StagePtr stage_;
+
+    uint32_t width_ = 0;
+    uint32_t height_ = 0;
+    float tile_render_size_ = 1.0f;
+    uint32_t chunk_size_ = DEFAULT_CHUNK_SIZE;
+    uint32_t chunks_across_ = 0;
+
+    std::vector<loaders::TiledTileset> tilesets_;
+    std::vector<MaterialID> materials_;
+    std::vector<uint32_t> tileset_materials_; // Index into materials_ of each tileset
+
+    std::vector<uint32_t> tiles_; // Row by row from the top
+    std::vector<Chunk> chunks_;
+
+    std::map<uint32_t, Animation> animations_; // By gid
+    double elapsed_ = 0.0;
+
+    sig::Connection update_connection_;
+
+    int32_t tileset_for(uint32_t gid) const;
+    uint32_t material_for(uint32_t gid) const;
+
+    uint32_t chunk_index(uint32_t x, uint32_t y) const {
+        return ((y / chunk_size_) * chunks_across_) + (x / chunk_size_);
+    }
+
+    /* The first of the cell's four vertices in its chunk's mesh */
+    uint32_t first_vertex(const Chunk& chunk, uint32_t x, uint32_t y) const {
+        return (((y - chunk.y) * chunk.width) + (x - chunk.x)) * 4;
+    }
+
+    void build_chunk(Chunk& chunk);
+    void rebuild_indices(Chunk& chunk);
+
+    /* Writes the texture coordinates of the tile into the cell, and marks them for upload */
+    void write_texcoords(uint32_t x, uint32_t y, uint32_t tileset, uint32_t tile_id);
+};
+
+}
+}
+
+#endif // TILEMAP_H
@@ -2,7 +2,9 @@
 #define MANAGER_H
 
 #include <type_traits>
+#include <vector>
 #include "manager_base.h"
+#include "slot_map.h"
 
 #include <functional>
 #include "../deps/kazsignal/kazsignal.h"
@@ -12,7 +14,11 @@ namespace kglt {
 namespace generic {
 
 
-template<typename ObjectType, typename ObjectIDType, typename NewIDGenerator=IncrementalGetNextID<ObjectIDType> >
+/*
+ * Objects are stored in a SlotMap indexed by their ID, so get() and contains() don't lock.
+ * Creating and destroying objects is serialized by the manager lock.
+ */
+template<typename ObjectType, typename ObjectIDType, typename NewIDGenerator=GenerationalIDAllocator<ObjectIDType> >
 class TemplatedManager {
 protected:
     mutable std::recursive_mutex manager_lock_;
@@ -43,50 +49,61 @@ public:
 
     template<typename... Args>
     ObjectIDType make(Args&&... args) {
-        return make(
+        return insert(
             ObjectIDType(
                 generator_(),
                 [this](const ObjectIDType* id) -> typename ObjectIDType::resource_pointer_type {
                     return this->getter(id);
                 }
             ),
+            true,
             std::forward<Args>(args)...
         );
     }
 
     template<typename... Args>
     ObjectIDType make(ObjectIDType id, Args&&... args) {
-        {
-            std::lock_guard<std::recursive_mutex> lock(manager_lock_);
-
-            objects_.insert(std::make_pair(id,
-                ObjectType::create(id, std::forward<Args>(args)...)
-            ));
-        }
-
-        signal_post_create_(*objects_[id], id);
-
-        return id;
+        return insert(id, false, std::forward<Args>(args)...);
     }
 
     void destroy_all() {
-        for(auto p: objects_) {
+        for(auto p: __objects()) {
             signal_pre_delete_(*p.second, p.first);
         }
 
-        objects_.clear();
+        clear();
+    }
+
+    /* Drops every object without firing signal_pre_delete */
+    void clear() {
+        std::vector<std::shared_ptr<ObjectType>> doomed;
+        {
+            std::lock_guard<std::recursive_mutex> lock(manager_lock_);
+
+            std::vector<uint32_t> ids = objects_.ids();
+            for(auto id: ids) {
+                doomed.push_back(erase(id));
+            }
+        }
+        // Objects are destroyed here, outside the lock
     }
 
     void destroy(ObjectIDType id) {
         if(contains(id)) {
-            std::lock_guard<std::recursive_mutex> lock(manager_lock_);
+            std::shared_ptr<ObjectType> doomed;
 
-            ObjectType& obj = *objects_[id];
-            signal_pre_delete_(obj, id);
+            std::lock_guard<std::recursive_mutex> lock(manager_lock_);
 
-            if(contains(id)) {
-                objects_.erase(id);
+            const auto* slot = objects_.find(id.value());
+            if(!slot) {
+                return;
             }
+
+            // Hold a reference in case a signal handler destroys it first
+            doomed = slot->object;
+            signal_pre_delete_(*doomed, id);
+
+            erase(id.value());
         }
     }
 
@@ -95,19 +112,7 @@ public:
     }
 
     std::weak_ptr<ObjectType> get(ObjectIDType id) {
-        std::lock_guard<std::recursive_mutex> lock(manager_lock_);
-
-        auto it = objects_.find(id);
-        if(it == objects_.end()) {
-            L_WARN(_F(
-                "Unable to find object of type: {0} with ID {1}").format(
-                    typeid(ObjectType).name(),
-                    id
-                )
-            );
-            return std::weak_ptr<ObjectType>();
-        }
-        return it->second;
+        return static_cast<const TemplatedManager*>(this)->get(id);
     }
 
     /**
@@ -116,7 +121,8 @@ public:
      * It's not neccessarily random but effectively it is as far as you care.
      */
     std::weak_ptr<ObjectType> first() const {
-        return objects_.begin()->second;
+        std::lock_guard<std::recursive_mutex> lock(manager_lock_);
+        return objects_.find(objects_.ids().front())->object;
     }
 
     /**
@@ -135,10 +141,8 @@ public:
     }
 
     std::weak_ptr<ObjectType> get(ObjectIDType id) const {
-        std::lock_guard<std::recursive_mutex> lock(manager_lock_);
-
-        auto it = objects_.find(id);
-        if(it == objects_.end()) {
+        const auto* slot = objects_.find(id.value());
+        if(!slot) {
             L_WARN(_F(
                 "Unable to find object of type: {0} with ID {1}").format(
                     typeid(ObjectType).name(),
@@ -147,27 +151,33 @@ public:
             );
             return std::weak_ptr<ObjectType>();
         }
-        return it->second;
+        return slot->object;
     }
 
     bool contains(ObjectIDType id) const {
-        return objects_.find(id) != objects_.end();
+        return objects_.contains(id.value());
     }
 
     sig::signal<void (ObjectType&, ObjectIDType)>& signal_post_create() { return signal_post_create_; }
     sig::signal<void (ObjectType&, ObjectIDType)>& signal_pre_delete() { return signal_pre_delete_; }
 
     void each(std::function<void (ObjectType*)> func) const {
-        for(std::pair<ObjectIDType, typename ObjectType::ptr> p: objects_) {
-            auto thing = get(p.first); //Make sure we lock the object
-            auto ptr = thing.lock(); // Keep the shared_ptr around while we use it
-            func(ptr.get());
+        for(auto& p: __objects()) {
+            func(p.second.get());
         }
     }
 
-    //Internal!
-    std::unordered_map<ObjectIDType, std::shared_ptr<ObjectType> >& __objects() {
-        return objects_;
+    //Internal! A snapshot of the objects, so it's safe to create and destroy while iterating it
+    std::vector<std::pair<ObjectIDType, std::shared_ptr<ObjectType>>> __objects() const {
+        std::lock_guard<std::recursive_mutex> lock(manager_lock_);
+
+        std::vector<std::pair<ObjectIDType, std::shared_ptr<ObjectType>>> result;
+        result.reserve(objects_.size());
+        for(auto id: objects_.ids()) {
+            const auto* slot = objects_.find(id);
+            result.push_back(std::make_pair(slot->object->id(), slot->object));
+        }
+        return result;
     }
 
 private:
@@ -176,13 +186,38 @@ private:
 
     static NewIDGenerator generator_;
 
-protected:
-    std::unordered_map<ObjectIDType, std::shared_ptr<ObjectType> > objects_;
+    SlotMap<ObjectType> objects_;
+
+    template<typename... Args>
+    ObjectIDType insert(ObjectIDType id, bool owns_id, Args&&... args) {
+        std::shared_ptr<ObjectType> object;
+        {
+            std::lock_guard<std::recursive_mutex> lock(manager_lock_);
+
+            object = ObjectType::create(id, std::forward<Args>(args)...);
+            objects_.insert(id.value(), object, owns_id);
+        }
+
+        signal_post_create_(*object, id);
+
+        return id;
+    }
+
+    /* Must be called with the lock held */
+    std::shared_ptr<ObjectType> erase(uint32_t id) {
+        bool owns_id = false;
+        auto object = objects_.erase(id, &owns_id);
+        if(object && owns_id) {
+            NewIDGenerator::release(id);
+        }
+        return object;
+    }
 
+protected:
     ObjectIDType _get_object_id_from_ptr(ObjectType* ptr) {
-        for(std::pair<ObjectIDType, std::shared_ptr<ObjectType> > pair: objects_) {
-            if(pair.second.get() == ptr) {
-                return pair.first;
+        for(auto& p: __objects()) {
+            if(p.second.get() == ptr) {
+                return p.first;
             }
         }
 
@@ -2,10 +2,15 @@
 #define REFCOUNT_MANAGER_H
 
 #include <set>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <limits>
 #include "../deps/kazsignal/kazsignal.h"
 #include "../deps/kazlog/kazlog.h"
 
 #include "manager_base.h"
+#include "slot_map.h"
 
 
 namespace kglt {
@@ -15,12 +20,39 @@ enum GarbageCollectMethod {
     GARBAGE_COLLECT_PERIODIC
 };
 
+struct MemoryUsage {
+    std::size_t cpu_bytes = 0;
+    std::size_t gpu_bytes = 0;
+
+    std::size_t total() const { return cpu_bytes + gpu_bytes; }
+
+    MemoryUsage& operator+=(const MemoryUsage& rhs) {
+        cpu_bytes += rhs.cpu_bytes;
+        gpu_bytes += rhs.gpu_bytes;
+        return *this;
+    }
+};
+
 namespace generic {
 
+/*
+ * Objects are stored in a SlotMap indexed by their ID, so lookups don't take the manager lock.
+ * Creating objects and garbage collecting them do.
+ *
+ * Objects report their size with cpu_memory_usage() and gpu_memory_usage(). Rather than
+ * scanning everything at once, collect_step() sweeps a few objects each call, totalling their
+ * sizes and noting which are collectable (garbage collected, referenced by nothing but the
+ * manager, and either looked up since creation or unclaimed for 5 seconds). Once a sweep
+ * completes, collectable objects are evicted least recently used first until the total is
+ * within the memory budget, a few per call. With the default budget of zero there's nothing
+ * to spread out, so every collectable object is evicted as soon as the sweep completes.
+ * Collectable objects which report no size are always evicted. Objects marked as loading are
+ * skipped entirely until they're marked as loaded.
+ */
 template<
     typename ObjectType,
     typename ObjectIDType,
-    typename NewIDGenerator=IncrementalGetNextID<ObjectIDType>
+    typename NewIDGenerator=GenerationalIDAllocator<ObjectIDType>
 >
 class RefCountedTemplatedManager {
 protected:
@@ -40,35 +72,58 @@ private:
 public:
     void mark_as_uncollected(ObjectIDType id) {
         std::lock_guard<std::mutex> lock(manager_lock_);
-        uncollected_.insert(id);
+        auto slot = objects_.find(id.value());
+        if(slot) {
+            slot->last_used = 0;
+        }
+    }
+
+    /*
+     * Objects filled in on another thread (e.g. by an async load) must be marked as loading until
+     * they're finished with, so that collect_step() doesn't size them while they're being written
+     */
+    void mark_as_loading(ObjectIDType id) {
+        std::lock_guard<std::mutex> lock(manager_lock_);
+        loading_.insert(id.value());
+    }
+
+    void mark_as_loaded(ObjectIDType id) {
+        std::lock_guard<std::mutex> lock(manager_lock_);
+        loading_.erase(id.value());
     }
 
+    /* An empty ID is passed on, so that the ID is generated (and later released) by make() */
     ObjectIDType make(GarbageCollectMethod garbage_collect) {
-        return make(generate_new_id(), garbage_collect);
+        return make(ObjectIDType(), garbage_collect);
     }
 
     template<typename ...Args>
     ObjectIDType make(GarbageCollectMethod garbage_collect, Args&&... args) {
-        return make(generate_new_id(), garbage_collect, std::forward<Args>(args)...);
+        return make(ObjectIDType(), garbage_collect, std::forward<Args>(args)...);
     }
 
     template<typename ...Args>
     ObjectIDType make(ObjectIDType id, GarbageCollectMethod garbage_collect, Args&&... args) {
-        std::lock_guard<std::mutex> lock(manager_lock_);
-        if(!id) {
-            id = generate_new_id();
-        }
+        std::shared_ptr<ObjectType> obj;
+        {
+            std::lock_guard<std::mutex> lock(manager_lock_);
 
-        auto obj = ObjectType::create(id, std::forward<Args>(args)...);
-        assert(obj);
+            // IDs we generate are released when the object is collected, IDs we're given aren't
+            bool owns_id = !id;
+            if(owns_id) {
+                id = generate_new_id();
+            }
 
-        obj->enable_gc(garbage_collect == GARBAGE_COLLECT_PERIODIC);
+            obj = ObjectType::create(id, std::forward<Args>(args)...);
+            assert(obj);
 
-        assert(id);
+            obj->enable_gc(garbage_collect == GARBAGE_COLLECT_PERIODIC);
 
-        objects_.insert(std::make_pair(id, obj));
-        creation_times_[id] = std::chrono::system_clock::now();
-        uncollected_.insert(id);
+            assert(id);
+
+            objects_.insert(id.value(), obj, owns_id);
+            creation_times_[id] = std::chrono::system_clock::now();
+        }
 
         signal_post_create_(*obj, id);
 
@@ -80,35 +135,37 @@ public:
     }
 
     std::weak_ptr<ObjectType> manager_unlocked_get(ObjectIDType id) const {
-        auto it = objects_.find(id);
-        if(it == objects_.end()) {
+        auto slot = objects_.find(id.value());
+        if(!slot) {
             L_WARN(_F("Unable to locate object of type {0} with ID {1}").format(typeid(ObjectType).name(), id));
             return std::weak_ptr<ObjectType>();
         }
 
-        uncollected_.erase(id);
+        Objects::touch(slot, clock_);
 
-        return std::weak_ptr<ObjectType>(it->second);
+        return std::weak_ptr<ObjectType>(slot->object);
     }
 
     std::weak_ptr<ObjectType> get(ObjectIDType id) {
-        std::lock_guard<std::mutex> lock(manager_lock_);
         return manager_unlocked_get(id);
     }
 
     ObjectType* get_unsafe(ObjectIDType id) {
-        std::lock_guard<std::mutex> lock(manager_lock_);
+        auto slot = objects_.find(id.value());
+        if(!slot) {
+            return manager_unlocked_get(id).lock().get(); // Logs the failure
+        }
 
-        return manager_unlocked_get(id).lock().get();
+        Objects::touch(slot, clock_);
+        return slot->object.get();
     }
 
     const std::weak_ptr<ObjectType> get(ObjectIDType id) const {
-        std::lock_guard<std::mutex> lock(manager_lock_);
         return manager_unlocked_get(id);
     }
 
     bool contains(ObjectIDType id) const {
-        return objects_.find(id) != objects_.end();
+        return objects_.contains(id.value());
     }
 
     sig::signal<void (ObjectType&, ObjectIDType)>& signal_post_create() { return signal_post_create_; }
@@ -116,80 +173,147 @@ public:
 
     //Internal!
     std::unordered_map<ObjectIDType, std::shared_ptr<ObjectType> > __objects() {
-        return objects_;
+        std::lock_guard<std::mutex> lock(manager_lock_);
+
+        std::unordered_map<ObjectIDType, std::shared_ptr<ObjectType> > result;
+        for(auto id: objects_.ids()) {
+            auto& obj = objects_.find(id)->object;
+            result.insert(std::make_pair(obj->id(), obj));
+        }
+        return result;
     }
 
     void each(std::function<void (ObjectType*)> func) const {
-        std::set<ObjectIDType> object_ids;
+        std::vector<uint32_t> object_ids;
         {
             // We copy the object IDs so we don't keep a handle to
             // any shared_ptrs or anything
             std::lock_guard<std::mutex> lock(manager_lock_);
-            for(auto& p: objects_) {
-                object_ids.insert(p.first);
-            }
+            object_ids = objects_.ids();
         }
 
         for(auto& obj_id: object_ids) {
-            auto thing = get(obj_id).lock();
+            std::shared_ptr<ObjectType> thing;
+            {
+                std::lock_guard<std::mutex> lock(manager_lock_);
+                auto slot = objects_.find(obj_id);
+
+                // If there's no slot it may have been deleted in another thread
+                if(slot) {
+                    Objects::touch(slot, clock_);
+                    thing = slot->object;
+                }
+            }
 
-            // If thing is false-y it may have been deleted in another thread
             if(thing) {
                 func(thing.get());
             }
         }
     }
 
+    /* Collects every collectable object now, whatever the budget */
     void garbage_collect() {
+        // Collected objects are destroyed after the lock is released, as destroying
+        // them can release other resources
+        std::vector<std::shared_ptr<ObjectType>> collected;
+
         std::lock_guard<std::mutex> lock(manager_lock_);
 
-        for(auto obj_it = objects_.begin(); obj_it != objects_.end(); ) {
-            auto& key = obj_it->first;
-            assert(key);
+        // Copied, as erasing reorders the IDs
+        std::vector<uint32_t> ids = objects_.ids();
 
+        for(auto id: ids) {
+            auto slot = objects_.find(id);
+            assert(slot);
 
-            bool pointer_is_unique = obj_it->second.unique();
-            ObjectType* obj = obj_it->second.get();
+            if(is_collectable(slot)) {
+                collected.push_back(collect(id));
+            }
+        }
+    }
 
-            assert(obj);
+    /*
+     * Sweeps up to max_scanned objects and evicts up to max_evicted (or everything collectable,
+     * without a budget), see above. Each call also advances the clock used to order objects by
+     * when they were last used.
+     */
+    void collect_step(uint32_t max_scanned, uint32_t max_evicted) {
+        std::vector<std::shared_ptr<ObjectType>> collected;
 
-            if(pointer_is_unique && obj->uses_gc()) {
-                auto it = uncollected_.find(key);
-                bool ok_to_delete = false;
+        std::lock_guard<std::mutex> lock(manager_lock_);
 
-                if(it == uncollected_.end()) {
-                    //If the object has been accessed, then we can assume
-                    //that it's been used and no longer needed
-                    ok_to_delete = true;
-                } else {
-                    //Otherwise, if the object hasn't been accessed after 10 seconds
-                    //of being alive then delete it.
-                    date_time now = std::chrono::system_clock::now();
+        ++clock_;
 
-                    int lifetime_in_seconds = std::chrono::duration_cast<std::chrono::seconds>(
-                        now-creation_times_[key]
-                    ).count();
+        if(!sweep_position_ && sweep_ids_.empty()) {
+            // Sweep a copy, objects created during the sweep are picked up by the next one
+            sweep_ids_ = objects_.ids();
+        }
 
-                    ok_to_delete = lifetime_in_seconds > 5;
+        for(uint32_t i = 0; i < max_scanned && sweep_position_ < sweep_ids_.size(); ++i) {
+            auto id = sweep_ids_[sweep_position_++];
+            auto slot = objects_.find(id);
+            if(!slot || loading_.count(id)) {
+                // Loading objects are neither counted nor collected, the next sweep will pick them up
+                continue;
+            }
 
-                    if(ok_to_delete) {
-                        L_WARN("Deleting unclaimed resource");
-                    }
-                }
+            MemoryUsage usage = memory_usage_of(slot->object.get());
+            sweep_usage_ += usage;
 
-                if(ok_to_delete) {
-                    obj_it = objects_.erase(obj_it);
-                    creation_times_.erase(key);
-                    L_DEBUG(_F("Garbage collected: {0}").format(key.value()));
-                    continue; // Don't increment the iterator
-                }
+            if(is_collectable(slot)) {
+                sweep_candidates_.push_back(Candidate{id, slot->last_used, usage});
             }
+        }
 
-            ++obj_it;
+        if(sweep_position_ >= sweep_ids_.size()) {
+            finish_sweep();
         }
+
+        // Without a budget, evictions would otherwise pile up if objects are released faster than max_evicted
+        const uint32_t limit = (memory_budget_) ? max_evicted : std::numeric_limits<uint32_t>::max();
+
+        uint32_t evicted = 0;
+        while(evicted < limit && !evictions_.empty()) {
+            auto candidate = evictions_.front();
+            evictions_.pop_front();
+
+            // Things may have changed since the sweep, it may have been used again or be gone
+            auto slot = objects_.find(candidate.id);
+            if(!slot || slot->last_used != candidate.last_used || !is_collectable(slot)) {
+                continue;
+            }
+
+            MemoryUsage usage = memory_usage_of(slot->object.get());
+            memory_usage_.cpu_bytes -= std::min(memory_usage_.cpu_bytes, usage.cpu_bytes);
+            memory_usage_.gpu_bytes -= std::min(memory_usage_.gpu_bytes, usage.gpu_bytes);
+
+            collected.push_back(collect(candidate.id));
+            ++evicted_count_;
+            ++evicted;
+        }
+    }
+
+    void set_memory_budget(std::size_t bytes) {
+        std::lock_guard<std::mutex> lock(manager_lock_);
+        memory_budget_ = bytes;
+    }
+
+    std::size_t memory_budget() const {
+        std::lock_guard<std::mutex> lock(manager_lock_);
+        return memory_budget_;
     }
 
-    typedef std::unordered_map<ObjectIDType, std::shared_ptr<ObjectType>> ObjectMap;
+    /* The total size of the objects as of the last completed sweep, less anything since evicted */
+    MemoryUsage memory_usage() const {
+        std::lock_guard<std::mutex> lock(manager_lock_);
+        return memory_usage_;
+    }
+
+    /* The number of objects evicted by collect_step() so far */
+    uint32_t evicted_count() const {
+        std::lock_guard<std::mutex> lock(manager_lock_);
+        return evicted_count_;
+    }
 
 protected:
     void manager_store_alias(const std::string& alias, ObjectIDType id) {
@@ -223,9 +347,121 @@ protected:
 private:
     typedef std::chrono::time_point<std::chrono::system_clock> date_time;
 
-    ObjectMap objects_;
+    typedef SlotMap<ObjectType> Objects;
+
+    Objects objects_;
     std::unordered_map<ObjectIDType, date_time> creation_times_;
-    mutable std::set<ObjectIDType> uncollected_;
+    std::set<uint32_t> loading_;
+
+    struct Candidate {
+        uint32_t id;
+        uint32_t last_used;
+        MemoryUsage usage;
+    };
+
+    std::atomic<uint32_t> clock_ = {1};
+    std::size_t memory_budget_ = 0;
+    MemoryUsage memory_usage_;
+    uint32_t evicted_count_ = 0;
+
+    std::vector<uint32_t> sweep_ids_;
+    uint32_t sweep_position_ = 0;
+    MemoryUsage sweep_usage_;
+    std::vector<Candidate> sweep_candidates_;
+    std::deque<Candidate> evictions_; // Least recently used first
+
+    static MemoryUsage memory_usage_of(const ObjectType* obj) {
+        MemoryUsage usage;
+        usage.cpu_bytes = obj->cpu_memory_usage();
+        usage.gpu_bytes = obj->gpu_memory_usage();
+        return usage;
+    }
+
+    /* Must be called with the lock held */
+    bool is_collectable(const typename Objects::Slot* slot) {
+        ObjectType* obj = slot->object.get();
+        assert(obj);
+
+        if(!slot->object.unique() || !obj->uses_gc() || loading_.count(slot->id)) {
+            return false;
+        }
+
+        if(slot->last_used) {
+            //If the object has been accessed, then we can assume
+            //that it's been used and no longer needed
+            return true;
+        }
+
+        //Otherwise, if the object hasn't been accessed after 5 seconds
+        //of being alive then delete it.
+        date_time now = std::chrono::system_clock::now();
+
+        int lifetime_in_seconds = std::chrono::duration_cast<std::chrono::seconds>(
+            now-creation_times_[obj->id()]
+        ).count();
+
+        return lifetime_in_seconds > 5;
+    }
+
+    /* Must be called with the lock held, the caller should destroy the object after unlocking */
+    std::shared_ptr<ObjectType> collect(uint32_t id) {
+        auto slot = objects_.find(id);
+        if(!slot->last_used) {
+            L_WARN("Deleting unclaimed resource");
+        }
+
+        creation_times_.erase(slot->object->id());
+        loading_.erase(id);
+
+        bool owns_id = false;
+        auto obj = objects_.erase(id, &owns_id);
+        if(owns_id) {
+            NewIDGenerator::release(id);
+        }
+
+        L_DEBUG(_F("Garbage collected: {0}").format(id));
+        return obj;
+    }
+
+    /* Must be called with the lock held */
+    void finish_sweep() {
+        // Anything evicted after it was swept shouldn't be counted
+        auto gone = std::remove_if(sweep_candidates_.begin(), sweep_candidates_.end(), [this](const Candidate& candidate) {
+            if(objects_.contains(candidate.id)) {
+                return false;
+            }
+
+            sweep_usage_.cpu_bytes -= std::min(sweep_usage_.cpu_bytes, candidate.usage.cpu_bytes);
+            sweep_usage_.gpu_bytes -= std::min(sweep_usage_.gpu_bytes, candidate.usage.gpu_bytes);
+            return true;
+        });
+        sweep_candidates_.erase(gone, sweep_candidates_.end());
+
+        memory_usage_ = sweep_usage_;
+        sweep_usage_ = MemoryUsage();
+        sweep_ids_.clear();
+        sweep_position_ = 0;
+
+        // Least recently used first, objects never used count as the oldest
+        std::sort(sweep_candidates_.begin(), sweep_candidates_.end(), [](const Candidate& lhs, const Candidate& rhs) {
+            return lhs.last_used < rhs.last_used;
+        });
+
+        evictions_.clear();
+
+        std::size_t total = memory_usage_.total();
+        for(auto& candidate: sweep_candidates_) {
+            // Objects which report no size are always collected, there's nothing to budget for
+            if(candidate.usage.total() && total <= memory_budget_) {
+                continue;
+            }
+
+            evictions_.push_back(candidate);
+            total -= std::min(total, candidate.usage.total());
+        }
+
+        sweep_candidates_.clear();
+    }
 
     sig::signal<void (ObjectType&, ObjectIDType)> signal_post_create_;
     sig::signal<void (ObjectType&, ObjectIDType)> signal_pre_delete_;
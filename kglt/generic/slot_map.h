@@ -0,0 +1,232 @@
+#ifndef SLOT_MAP_H
+#define SLOT_MAP_H
+
+#include <cstdint>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <stdexcept>
+
+namespace kglt {
+namespace generic {
+
+/*
+ * IDs handed out to managers pack a slot index (the low INDEX_BITS) and a generation (the
+ * rest) into the 32 bit value. Index 0 is never used so no ID is ever zero.
+ */
+const uint32_t SLOT_INDEX_BITS = 20;
+const uint32_t SLOT_INDEX_MASK = (1u << SLOT_INDEX_BITS) - 1;
+const uint32_t SLOT_GENERATION_MASK = (1u << (32 - SLOT_INDEX_BITS)) - 1;
+
+inline uint32_t slot_index(uint32_t id) { return id & SLOT_INDEX_MASK; }
+inline uint32_t slot_generation(uint32_t id) { return id >> SLOT_INDEX_BITS; }
+
+/*
+ * Allocates IDs for every manager of the ID type, so an ID is unique across managers (a
+ * ResourceManager looks up IDs it doesn't have in its parent, for example).
+ *
+ * When an ID is released its index is reused with the next generation, so stale IDs stop
+ * matching. Freed indexes are only reused once there are plenty of them, which keeps the
+ * same index from cycling through its generations quickly.
+ */
+template<typename IDType>
+class GenerationalIDAllocator {
+public:
+    uint32_t operator()() {
+        return allocate();
+    }
+
+    static uint32_t allocate() {
+        State& state = get_state();
+        std::lock_guard<std::mutex> lock(state.lock);
+
+        uint32_t index = 0;
+        if(state.free.size() > MIN_FREE_INDEXES || (state.next_index > SLOT_INDEX_MASK && !state.free.empty())) {
+            index = state.free.front();
+            state.free.pop_front();
+        } else if(state.next_index <= SLOT_INDEX_MASK) {
+            index = state.next_index++;
+            state.generations.resize(state.next_index, 0);
+        } else {
+            throw std::runtime_error("Ran out of object IDs");
+        }
+
+        return (uint32_t(state.generations[index]) << SLOT_INDEX_BITS) | index;
+    }
+
+    static void release(uint32_t id) {
+        State& state = get_state();
+        std::lock_guard<std::mutex> lock(state.lock);
+
+        uint32_t index = slot_index(id);
+        if(index >= state.next_index || state.generations[index] != slot_generation(id)) {
+            return; // Already released
+        }
+
+        state.generations[index] = (state.generations[index] + 1) & SLOT_GENERATION_MASK;
+        state.free.push_back(index);
+    }
+
+private:
+    static const uint32_t MIN_FREE_INDEXES = 1024;
+
+    struct State {
+        std::mutex lock;
+        uint32_t next_index = 1;
+        std::vector<uint16_t> generations = std::vector<uint16_t>(1, 0);
+        std::deque<uint32_t> free;
+    };
+
+    static State& get_state() {
+        static State state;
+        return state;
+    }
+};
+
+/*
+ * Storage for a manager's objects, addressed directly by the index in their ID.
+ *
+ * Slots live in fixed blocks which are allocated as the indexes in use grow and never move,
+ * so finding an object is a couple of array lookups and a generation check without taking a
+ * lock. Inserting and erasing must be serialized by the owner, and an object mustn't be erased
+ * while another thread is looking *that object* up (lookups of other objects are fine).
+ */
+template<typename T>
+class SlotMap {
+public:
+    struct Slot {
+        std::atomic<uint32_t> id = {0}; // Zero when the slot is empty
+        std::shared_ptr<T> object;
+
+        // The owner's clock when the object was last looked up through touch(), zero if never
+        mutable std::atomic<uint32_t> last_used = {0};
+
+        // Whether the ID came from the allocator (rather than being given to the manager)
+        bool owns_id = false;
+
+        uint32_t dense_index = 0;
+    };
+
+    SlotMap() {
+        for(auto& block: blocks_) {
+            block.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    ~SlotMap() {
+        for(auto& block: blocks_) {
+            delete block.load(std::memory_order_relaxed);
+        }
+    }
+
+    SlotMap(const SlotMap&) = delete;
+    SlotMap& operator=(const SlotMap&) = delete;
+
+    const Slot* find(uint32_t id) const {
+        if(!id) {
+            return nullptr;
+        }
+
+        const uint32_t index = slot_index(id);
+        const Block* block = blocks_[index / BLOCK_SIZE].load(std::memory_order_acquire);
+        if(!block) {
+            return nullptr;
+        }
+
+        const Slot& slot = block->slots[index % BLOCK_SIZE];
+        return (slot.id.load(std::memory_order_acquire) == id) ? &slot : nullptr;
+    }
+
+    Slot* find(uint32_t id) {
+        return const_cast<Slot*>(static_cast<const SlotMap*>(this)->find(id));
+    }
+
+    T* get(uint32_t id) const {
+        const Slot* slot = find(id);
+        return (slot) ? slot->object.get() : nullptr;
+    }
+
+    bool contains(uint32_t id) const {
+        return find(id) != nullptr;
+    }
+
+    void insert(uint32_t id, std::shared_ptr<T> object, bool owns_id) {
+        const uint32_t index = slot_index(id);
+
+        std::atomic<Block*>& block_ref = blocks_[index / BLOCK_SIZE];
+        Block* block = block_ref.load(std::memory_order_relaxed);
+        if(!block) {
+            block = new Block();
+            block_ref.store(block, std::memory_order_release);
+        }
+
+        Slot& slot = block->slots[index % BLOCK_SIZE];
+        if(slot.id.load(std::memory_order_relaxed)) {
+            throw std::logic_error("An object with this ID already exists");
+        }
+
+        slot.object = object;
+        slot.owns_id = owns_id;
+        slot.last_used.store(0, std::memory_order_relaxed);
+        slot.dense_index = ids_.size();
+        ids_.push_back(id);
+
+        // Publish last, so a reader which sees the ID sees the object too
+        slot.id.store(id, std::memory_order_release);
+    }
+
+    /* Empties the slot, returning the object so the caller controls when it's destroyed */
+    std::shared_ptr<T> erase(uint32_t id, bool* owns_id=nullptr) {
+        Slot* slot = find(id);
+        if(!slot) {
+            return std::shared_ptr<T>();
+        }
+
+        slot->id.store(0, std::memory_order_release);
+
+        // Keep the list of IDs dense by moving the last one into the gap
+        uint32_t last = ids_.back();
+        ids_[slot->dense_index] = last;
+        if(last != id) {
+            find(last)->dense_index = slot->dense_index;
+        }
+        ids_.pop_back();
+
+        if(owns_id) {
+            *owns_id = slot->owns_id;
+        }
+
+        std::shared_ptr<T> result;
+        result.swap(slot->object);
+        return result;
+    }
+
+    /* Marks the object as used at the given time, only writing if that's changed to avoid contention */
+    static void touch(const Slot* slot, uint32_t now) {
+        if(slot->last_used.load(std::memory_order_relaxed) != now) {
+            slot->last_used.store(now, std::memory_order_relaxed);
+        }
+    }
+
+    /* The IDs of everything in the map, in no particular order */
+    const std::vector<uint32_t>& ids() const { return ids_; }
+    uint32_t size() const { return ids_.size(); }
+
+private:
+    static const uint32_t BLOCK_SIZE = 1024;
+    static const uint32_t BLOCK_COUNT = (SLOT_INDEX_MASK + 1) / BLOCK_SIZE;
+
+    struct Block {
+        Slot slots[BLOCK_SIZE];
+    };
+
+    std::atomic<Block*> blocks_[BLOCK_COUNT];
+    std::vector<uint32_t> ids_;
+};
+
+}
+}
+
+#endif // SLOT_MAP_H
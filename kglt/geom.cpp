@@ -7,7 +7,9 @@ Geom::Geom(GeomID id, Stage* stage, MeshID mesh, const Vec3 &position, const Qua
     generic::Identifiable<GeomID>(id),
     Object(stage),
     Source(stage),
-    render_priority_(RENDER_PRIORITY_MAIN) {
+    render_priority_(RENDER_PRIORITY_MAIN),
+    position_(position),
+    rotation_(rotation) {
 
     set_parent(stage);
 
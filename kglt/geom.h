@@ -67,12 +67,21 @@ public:
 
     RenderPriority render_priority() const { return render_priority_; }
 
+    // Geoms don't move, so they're always where they were created
+    kglt::Vec3 absolute_position() const override { return position_; }
+    kglt::Quaternion absolute_rotation() const override { return rotation_; }
+    kglt::Vec3 relative_position() const override { return position_; }
+    kglt::Quaternion relative_rotation() const override { return rotation_; }
+
 private:
     VertexData* get_shared_data() const;
 
     std::shared_ptr<Mesh> mesh_;
     RenderPriority render_priority_;
 
+    Vec3 position_;
+    Quaternion rotation_;
+
     void do_update(double dt) {
         update_source(dt);
     }
@@ -3,7 +3,6 @@
 #include "deps/kazlog/kazlog.h"
 #include "idle_task_manager.h"
 #include "window_base.h"
-#include "utils/gl_thread_check.h"
 
 namespace kglt {
 
@@ -32,16 +31,58 @@ ConnectionID IdleTaskManager::add_once(std::function<void ()> callback) {
 
 void IdleTaskManager::run_sync(std::function<void()> callback) {
     /*
-     *  If the current thread is not the main thread, then add the task to idle, and
-     *  don't return until it runs. Otherwise, run the function immediately.
+     *  If the current thread is not the main thread, then queue the task and don't return
+     *  until the main thread has run it. Otherwise, run the function immediately.
      */
 
-    if(GLThreadCheck::is_current()) { //Shouldn't abuse the GL thread check like this really but GL thread == main
+    JobSystem* jobs = window_.jobs.get();
+
+    if(jobs->is_main_thread()) {
         callback();
-    } else {
-        add_once(callback);
-        wait();
+        return;
+    }
+
+    auto done = std::make_shared<std::promise<void>>();
+    auto future = done->get_future();
+
+    {
+        std::lock_guard<std::mutex> lock(sync_mutex_);
+        sync_tasks_.push_back(SyncTask{callback, done});
     }
+
+    // Picked up with the main thread jobs, unless the window gets to it first
+    jobs->schedule_on_main_thread([this]() { execute_sync(); });
+
+    // Rethrows anything the callback threw
+    future.get();
+}
+
+uint32_t IdleTaskManager::execute_sync() {
+    uint32_t count = 0;
+
+    while(true) {
+        SyncTask task;
+        {
+            std::lock_guard<std::mutex> lock(sync_mutex_);
+            if(sync_tasks_.empty()) {
+                break;
+            }
+
+            task = sync_tasks_.front();
+            sync_tasks_.pop_front();
+        }
+
+        try {
+            task.callback();
+            task.done->set_value();
+        } catch(...) {
+            task.done->set_exception(std::current_exception());
+        }
+
+        ++count;
+    }
+
+    return count;
 }
 
 struct TimedTrigger {
@@ -6,6 +6,9 @@
 #include <map>
 #include <mutex>
 #include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
 
 namespace kglt {
 
@@ -20,8 +23,16 @@ public:
     ConnectionID add_once(std::function<void ()> callback);
     ConnectionID add_timeout(float seconds, std::function<void()> callback);
     
+    /*
+     * Runs the callback on the main thread, and doesn't return until it has. From any other
+     * thread the callback is queued and run by execute_sync(), which happens along with the
+     * main thread jobs (or while the window waits for the simulation thread).
+     */
     void run_sync(std::function<void()> callback);
 
+    /* Runs the callbacks of any threads blocked in run_sync(), returns the number run */
+    uint32_t execute_sync();
+
     void remove(ConnectionID connection);
 
     void execute();
@@ -40,6 +51,14 @@ private:
     std::mutex signals_mutex_;
     std::mutex signals_once_mutex_;
 
+    struct SyncTask {
+        std::function<void ()> callback;
+        std::shared_ptr<std::promise<void>> done;
+    };
+
+    std::mutex sync_mutex_;
+    std::deque<SyncTask> sync_tasks_;
+
     std::mutex cv_mutex_;
     std::condition_variable cv_;
 };
@@ -0,0 +1,295 @@
+#include <cassert>
+#include <chrono>
+#include <iterator>
+
+#include "deps/kazlog/kazlog.h"
+#include "job_system.h"
+
+namespace kglt {
+
+namespace {
+    /* Workers record which system they belong to, so that jobs scheduled from inside a
+     * job go onto the scheduling worker's own deque */
+    thread_local const JobSystem* current_system = nullptr;
+    thread_local int32_t current_index = -1;
+}
+
+uint32_t JobSystem::default_worker_count() {
+    uint32_t cores = std::thread::hardware_concurrency();
+
+    // Leave a core for the main thread
+    return (cores > 1) ? cores - 1 : 0;
+}
+
+JobSystem::JobSystem(uint32_t worker_count):
+    main_thread_id_(std::this_thread::get_id()) {
+
+    for(uint32_t i = 0; i < worker_count; ++i) {
+        workers_.push_back(std::unique_ptr<Worker>(new Worker()));
+    }
+
+    // Start the threads after all the workers exist, as they steal from each other
+    for(uint32_t i = 0; i < worker_count; ++i) {
+        workers_[i]->thread = std::thread(std::bind(&JobSystem::worker_loop, this, int32_t(i)));
+    }
+}
+
+JobSystem::~JobSystem() {
+    running_ = false;
+
+    {
+        std::lock_guard<std::mutex> lock(sleep_lock_);
+    }
+    sleep_cond_.notify_all();
+
+    for(auto& worker: workers_) {
+        if(worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+
+    std::deque<ScheduledJob> dropped;
+    for(auto& worker: workers_) {
+        std::lock_guard<std::mutex> lock(worker->lock);
+        std::move(worker->jobs.begin(), worker->jobs.end(), std::back_inserter(dropped));
+        worker->jobs.clear();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(main_thread_lock_);
+        std::move(main_thread_jobs_.begin(), main_thread_jobs_.end(), std::back_inserter(dropped));
+        main_thread_jobs_.clear();
+    }
+
+    if(!dropped.empty()) {
+        L_WARN(_F("Dropping {0} queued jobs on shutdown").format(dropped.size()));
+    }
+
+    for(auto& job: dropped) {
+        complete(job.counter);
+    }
+}
+
+int32_t JobSystem::current_worker_index() const {
+    return (current_system == this) ? current_index : -1;
+}
+
+void JobSystem::schedule(Job job, JobCounterPtr counter) {
+    if(counter) {
+        counter->count_++;
+    }
+
+    enqueue(ScheduledJob{job, counter});
+}
+
+void JobSystem::schedule_after(JobCounterPtr dependency, Job job, JobCounterPtr counter) {
+    if(counter) {
+        counter->count_++;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(dependency->continuations_lock_);
+        if(!dependency->is_complete()) {
+            dependency->continuations_.push_back(std::make_pair(job, counter));
+            return;
+        }
+    }
+
+    enqueue(ScheduledJob{job, counter});
+}
+
+void JobSystem::schedule_on_main_thread(Job job, JobCounterPtr counter) {
+    if(counter) {
+        counter->count_++;
+    }
+
+    std::lock_guard<std::mutex> lock(main_thread_lock_);
+    main_thread_jobs_.push_back(ScheduledJob{job, counter});
+}
+
+void JobSystem::enqueue(ScheduledJob job) {
+    if(workers_.empty()) {
+        // Nothing to hand the job to, so just run it now
+        run(job);
+        return;
+    }
+
+    int32_t index = current_worker_index();
+    if(index < 0) {
+        index = next_worker_++ % workers_.size();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(workers_[index]->lock);
+        workers_[index]->jobs.push_back(std::move(job));
+    }
+
+    queued_++;
+
+    {
+        // Makes sure a worker can't miss the wake up between checking queued_ and sleeping
+        std::lock_guard<std::mutex> lock(sleep_lock_);
+    }
+    sleep_cond_.notify_one();
+}
+
+bool JobSystem::pop(int32_t worker_index, ScheduledJob& out) {
+    Worker* worker = workers_[worker_index].get();
+
+    std::lock_guard<std::mutex> lock(worker->lock);
+    if(worker->jobs.empty()) {
+        return false;
+    }
+
+    // Newest first, it's most likely to still be in the cache
+    out = std::move(worker->jobs.back());
+    worker->jobs.pop_back();
+    queued_--;
+    return true;
+}
+
+bool JobSystem::steal(int32_t thief_index, ScheduledJob& out) {
+    const int32_t count = workers_.size();
+
+    for(int32_t i = 1; i <= count; ++i) {
+        int32_t victim_index = (thief_index + i) % count;
+        if(victim_index < 0) {
+            victim_index += count;
+        }
+
+        if(victim_index == thief_index) {
+            continue;
+        }
+
+        Worker* victim = workers_[victim_index].get();
+
+        std::lock_guard<std::mutex> lock(victim->lock);
+        if(victim->jobs.empty()) {
+            continue;
+        }
+
+        // Oldest first, these are the largest chunks of work
+        out = std::move(victim->jobs.front());
+        victim->jobs.pop_front();
+        queued_--;
+        return true;
+    }
+
+    return false;
+}
+
+bool JobSystem::try_run_one(int32_t worker_index) {
+    if(workers_.empty()) {
+        return false;
+    }
+
+    ScheduledJob job;
+    if((worker_index >= 0 && pop(worker_index, job)) || steal(worker_index, job)) {
+        run(job);
+        return true;
+    }
+
+    return false;
+}
+
+void JobSystem::run(ScheduledJob& job) {
+    try {
+        job.job();
+    } catch(std::exception& e) {
+        L_ERROR(_F("Uncaught exception in job: {0}").format(e.what()));
+    }
+
+    complete(job.counter);
+}
+
+void JobSystem::complete(JobCounterPtr counter) {
+    if(!counter) {
+        return;
+    }
+
+    std::vector<std::pair<Job, JobCounterPtr>> ready;
+    {
+        std::lock_guard<std::mutex> lock(counter->continuations_lock_);
+        if(--counter->count_ > 0) {
+            return;
+        }
+
+        std::swap(ready, counter->continuations_);
+    }
+
+    {
+        // Makes sure a waiter can't miss the wake up between checking the counter and sleeping
+        std::lock_guard<std::mutex> lock(complete_lock_);
+    }
+    complete_cond_.notify_all();
+
+    for(auto& continuation: ready) {
+        if(running_) {
+            enqueue(ScheduledJob{continuation.first, continuation.second});
+        } else {
+            // Shutting down, so the continuation is dropped along with everything else
+            complete(continuation.second);
+        }
+    }
+}
+
+void JobSystem::wait(JobCounterPtr counter) {
+    if(!counter) {
+        return;
+    }
+
+    const int32_t worker_index = current_worker_index();
+    const bool main_thread = is_main_thread();
+
+    while(!counter->is_complete()) {
+        if(main_thread && run_main_thread_jobs()) {
+            continue;
+        }
+
+        if(try_run_one(worker_index)) {
+            continue;
+        }
+
+        if(main_thread || worker_index >= 0) {
+            // Stay responsive to new jobs, we might be the only thread that can run them
+            std::this_thread::yield();
+        } else {
+            std::unique_lock<std::mutex> lock(complete_lock_);
+            complete_cond_.wait(lock, [&counter]() { return counter->is_complete(); });
+        }
+    }
+}
+
+uint32_t JobSystem::run_main_thread_jobs() {
+    assert(is_main_thread());
+
+    std::deque<ScheduledJob> to_run;
+    {
+        std::lock_guard<std::mutex> lock(main_thread_lock_);
+        std::swap(to_run, main_thread_jobs_);
+    }
+
+    for(auto& job: to_run) {
+        run(job);
+    }
+
+    return to_run.size();
+}
+
+void JobSystem::worker_loop(int32_t index) {
+    current_system = this;
+    current_index = index;
+
+    while(running_) {
+        if(try_run_one(index)) {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleep_lock_);
+        sleep_cond_.wait_for(lock, std::chrono::milliseconds(10), [this]() {
+            return queued_.load() > 0 || !running_;
+        });
+    }
+}
+
+}
@@ -0,0 +1,161 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <algorithm>
+
+namespace kglt {
+
+typedef std::function<void ()> Job;
+
+/*
+ * A JobCounter tracks a group of scheduled jobs. It is incremented when a job is
+ * scheduled against it and decremented when the job completes. Jobs can be made to
+ * depend on a counter with JobSystem::schedule_after, they will only be queued once the
+ * counter reaches zero.
+ */
+class JobCounter {
+public:
+    bool is_complete() const { return count_.load() == 0; }
+    int32_t pending() const { return count_.load(); }
+
+private:
+    friend class JobSystem;
+
+    std::atomic<int32_t> count_ = {0};
+
+    std::mutex continuations_lock_;
+    std::vector<std::pair<Job, std::shared_ptr<JobCounter>>> continuations_;
+};
+
+typedef std::shared_ptr<JobCounter> JobCounterPtr;
+
+/*
+ * A work-stealing job system. Each worker thread owns a deque of jobs; a worker pushes
+ * and pops at the back of its own deque and, when that runs dry, steals from the front of
+ * another worker's deque. Jobs scheduled from a non-worker thread are distributed round-robin.
+ *
+ * Jobs which must run on the main (GL) thread are queued separately and are executed by
+ * run_main_thread_jobs() which the window calls once per frame.
+ *
+ * Workers and the main thread never block idly when waiting on a counter: they run other
+ * jobs (and, on the main thread, main thread jobs) until the counter completes, so jobs can
+ * safely wait on jobs they scheduled themselves. Any other thread helps while there are jobs
+ * queued and then sleeps until a counter completes.
+ *
+ * Jobs still queued when the system is destroyed are dropped, but their counters are
+ * completed so that nothing waiting on them hangs.
+ */
+class JobSystem {
+public:
+    JobSystem(uint32_t worker_count=default_worker_count());
+    ~JobSystem();
+
+    static uint32_t default_worker_count();
+
+    uint32_t worker_count() const { return workers_.size(); }
+
+    JobCounterPtr new_counter() const { return std::make_shared<JobCounter>(); }
+
+    void schedule(Job job, JobCounterPtr counter=JobCounterPtr());
+    void schedule_after(JobCounterPtr dependency, Job job, JobCounterPtr counter=JobCounterPtr());
+    void schedule_on_main_thread(Job job, JobCounterPtr counter=JobCounterPtr());
+
+    void wait(JobCounterPtr counter);
+
+    /* Runs any jobs with main thread affinity, returns the number run */
+    uint32_t run_main_thread_jobs();
+    bool is_main_thread() const { return std::this_thread::get_id() == main_thread_id_; }
+
+    /*
+     * Calls func(i) for every i in [begin, end), splitting the range into chunks of grain_size
+     * items. If grain_size is zero, a size is picked so that every worker gets a few chunks.
+     * The calling thread helps with the work and this doesn't return until everything has run.
+     */
+    template<typename Func>
+    void parallel_for(uint32_t begin, uint32_t end, Func func, uint32_t grain_size=0) {
+        if(end <= begin) {
+            return;
+        }
+
+        const uint32_t total = end - begin;
+        if(!grain_size) {
+            grain_size = std::max<uint32_t>(1, total / ((worker_count() + 1) * 4));
+        }
+
+        if(workers_.empty() || total <= grain_size) {
+            for(uint32_t i = begin; i < end; ++i) {
+                func(i);
+            }
+            return;
+        }
+
+        auto counter = new_counter();
+        for(uint32_t chunk = begin; chunk < end; chunk += grain_size) {
+            uint32_t chunk_end = std::min(end, chunk + grain_size);
+            schedule([chunk, chunk_end, &func]() {
+                for(uint32_t i = chunk; i < chunk_end; ++i) {
+                    func(i);
+                }
+            }, counter);
+        }
+
+        wait(counter);
+    }
+
+    template<typename Container, typename Func>
+    void parallel_for_each(Container& container, Func func, uint32_t grain_size=0) {
+        parallel_for(0, container.size(), [&container, &func](uint32_t i) {
+            func(container[i]);
+        }, grain_size);
+    }
+
+private:
+    struct ScheduledJob {
+        Job job;
+        JobCounterPtr counter;
+    };
+
+    struct Worker {
+        std::thread thread;
+        std::mutex lock;
+        std::deque<ScheduledJob> jobs;
+    };
+
+    std::thread::id main_thread_id_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+
+    std::mutex main_thread_lock_;
+    std::deque<ScheduledJob> main_thread_jobs_;
+
+    std::mutex sleep_lock_;
+    std::condition_variable sleep_cond_;
+    std::atomic<uint32_t> queued_ = {0};
+    std::atomic<uint32_t> next_worker_ = {0};
+    std::atomic<bool> running_ = {true};
+
+    // Signalled whenever a counter reaches zero
+    std::mutex complete_lock_;
+    std::condition_variable complete_cond_;
+
+    void enqueue(ScheduledJob job);
+    bool pop(int32_t worker_index, ScheduledJob& out);
+    bool steal(int32_t thief_index, ScheduledJob& out);
+    bool try_run_one(int32_t worker_index);
+    void run(ScheduledJob& job);
+    void complete(JobCounterPtr counter);
+    void worker_loop(int32_t index);
+    int32_t current_worker_index() const;
+};
+
+}
+
+#endif // JOB_SYSTEM_H
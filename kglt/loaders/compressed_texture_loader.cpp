@@ -0,0 +1,334 @@
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+#include "../deps/SOIL/SOIL.h"
+#include "../deps/kazlog/kazlog.h"
+
+#include "compressed_texture_loader.h"
+
+namespace kglt {
+namespace loaders {
+
+namespace {
+
+const uint8_t KTX_IDENTIFIER[12] = {
+    0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A
+};
+
+const uint32_t KTX_ENDIANNESS = 0x04030201;
+const uint32_t KTX_HEADER_SIZE = 64;
+
+const std::string KTX_ORIENTATION_KEY = "KTXorientation";
+const std::string KTX_BOTTOM_UP = "S=r,T=u";
+
+const uint32_t GL_UNSIGNED_BYTE_ = 0x1401;
+const uint32_t GL_RGB_ = 0x1907;
+const uint32_t GL_RGBA_ = 0x1908;
+const uint32_t GL_RGB8_ = 0x8051;
+const uint32_t GL_RGBA8_ = 0x8058;
+
+const uint32_t DDS_HEADER_SIZE = 124;
+const uint32_t DDS_DX10_HEADER_SIZE = 20;
+const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+const uint32_t DDPF_FOURCC = 0x4;
+const uint32_t DDSCAPS2_CUBEMAP = 0x200;
+const uint32_t DDSCAPS2_VOLUME = 0x200000;
+
+uint32_t four_cc(const char* code) {
+    return uint32_t(code[0]) | (uint32_t(code[1]) << 8) | (uint32_t(code[2]) << 16) | (uint32_t(code[3]) << 24);
+}
+
+uint32_t swap_bytes(uint32_t value) {
+    return ((value & 0xFF) << 24) | ((value & 0xFF00) << 8) | ((value >> 8) & 0xFF00) | (value >> 24);
+}
+
+/* Reads little endian words out of the file, checking they're actually there */
+class Reader {
+public:
+    Reader(const std::string& buffer, const unicode& filename):
+        buffer_(buffer),
+        filename_(filename) {}
+
+    void require(std::size_t offset, std::size_t count) const {
+        if(offset + count > buffer_.size() || offset + count < offset) {
+            throw std::runtime_error(_u("Truncated texture file: {0}").format(filename_).encode());
+        }
+    }
+
+    uint32_t u32(std::size_t offset) const {
+        require(offset, 4);
+        uint32_t value = 0;
+        for(uint32_t i = 0; i < 4; ++i) {
+            value |= uint32_t(uint8_t(buffer_[offset + i])) << (i * 8);
+        }
+        return value;
+    }
+
+    const uint8_t* bytes(std::size_t offset, std::size_t count) const {
+        require(offset, count);
+        return (const uint8_t*) buffer_.data() + offset;
+    }
+
+private:
+    const std::string& buffer_;
+    unicode filename_;
+};
+
+void write_u32(std::ostream& out, uint32_t value) {
+    for(uint32_t i = 0; i < 4; ++i) {
+        out.put(char((value >> (i * 8)) & 0xFF));
+    }
+}
+
+void write_padding(std::ostream& out, std::size_t length) {
+    for(std::size_t i = length; i % 4; ++i) {
+        out.put(0);
+    }
+}
+
+}
+
+void CompressedTextureLoader::into(Loadable& resource, const LoaderOptions& options) {
+    Texture* tex = loadable_to<Texture>(resource);
+    assert(tex && "You passed a Resource that is not a texture to the compressed texture loader");
+
+    auto buffer = this->data_->str();
+
+    if(buffer.size() >= sizeof(KTX_IDENTIFIER) && memcmp(buffer.data(), KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER)) == 0) {
+        load_ktx(tex, buffer);
+    } else if(buffer.size() >= 4 && buffer.compare(0, 4, "DDS ") == 0) {
+        load_dds(tex, buffer);
+    } else {
+        L_ERROR(_F("Unrecognised compressed texture: {0}").format(filename_));
+        throw std::runtime_error("Couldn't load the file: " + filename_.encode());
+    }
+}
+
+void CompressedTextureLoader::load_ktx(Texture* tex, const std::string& buffer) {
+    Reader reader(buffer, filename_);
+
+    // Files written on a big endian machine have every word the other way round
+    bool swap = reader.u32(12) != KTX_ENDIANNESS;
+    if(swap && swap_bytes(reader.u32(12)) != KTX_ENDIANNESS) {
+        throw std::runtime_error(_u("Invalid KTX endianness: {0}").format(filename_).encode());
+    }
+
+    auto word = [&](std::size_t offset) -> uint32_t {
+        uint32_t value = reader.u32(offset);
+        return (swap) ? swap_bytes(value) : value;
+    };
+
+    const uint32_t gl_type = word(16);
+    const uint32_t gl_format = word(24);
+    const uint32_t gl_internal_format = word(28);
+    const uint32_t width = word(36);
+    const uint32_t height = std::max(word(40), 1u);
+    const uint32_t depth = word(44);
+    const uint32_t array_elements = word(48);
+    const uint32_t faces = word(52);
+    const uint32_t level_count = std::max(word(56), 1u);
+    const uint32_t key_value_bytes = word(60);
+
+    if(!width || depth || array_elements || faces != 1) {
+        throw std::runtime_error(
+            _u("Only 2D KTX textures are supported, not arrays, cubemaps or volumes: {0}").format(filename_).encode()
+        );
+    }
+
+    bool bottom_up = false;
+
+    std::size_t offset = KTX_HEADER_SIZE;
+    const std::size_t key_value_end = offset + key_value_bytes;
+    while(offset + 4 <= key_value_end) {
+        const uint32_t length = word(offset);
+        const char* pair = (const char*) reader.bytes(offset + 4, length);
+
+        // The key and value are both null terminated
+        std::string key(pair, strnlen(pair, length));
+        if(key == KTX_ORIENTATION_KEY && key.length() < length) {
+            const char* value = pair + key.length() + 1;
+            std::string orientation(value, strnlen(value, length - key.length() - 1));
+            bottom_up = orientation.find(KTX_BOTTOM_UP) == 0;
+        }
+
+        offset += 4 + length;
+        offset += (4 - (offset % 4)) % 4;
+    }
+    offset = key_value_end;
+
+    const TextureFormat format = texture_format_from_gl(gl_internal_format);
+
+    uint32_t channels = 0;
+    if(format == TEXTURE_FORMAT_UNCOMPRESSED) {
+        if(gl_type != GL_UNSIGNED_BYTE_) {
+            throw std::runtime_error(_u("Unsupported KTX data type in: {0}").format(filename_).encode());
+        }
+
+        if(gl_format == GL_RGBA_ && (gl_internal_format == GL_RGBA8_ || gl_internal_format == GL_RGBA_)) {
+            channels = 4;
+        } else if(gl_format == GL_RGB_ && (gl_internal_format == GL_RGB8_ || gl_internal_format == GL_RGB_)) {
+            channels = 3;
+        } else {
+            throw std::runtime_error(_u("Unsupported KTX internal format in: {0}").format(filename_).encode());
+        }
+    }
+
+    std::vector<Texture::Data> levels;
+
+    uint32_t w = width, h = height;
+    for(uint32_t i = 0; i < level_count; ++i) {
+        const uint32_t size = word(offset);
+        const uint8_t* data = reader.bytes(offset + 4, size);
+
+        if(channels) {
+            // Rows of uncompressed data are padded to four bytes, textures are tightly packed
+            const uint32_t row = w * channels;
+            const uint32_t padded_row = row + ((4 - (row % 4)) % 4);
+
+            if(size < padded_row * h) {
+                throw std::runtime_error(_u("Truncated texture file: {0}").format(filename_).encode());
+            }
+
+            Texture::Data level(row * h);
+            for(uint32_t j = 0; j < h; ++j) {
+                std::copy(data + (j * padded_row), data + (j * padded_row) + row, level.begin() + (j * row));
+            }
+            levels.push_back(std::move(level));
+        } else {
+            levels.push_back(Texture::Data(data, data + size));
+        }
+
+        offset += 4 + size;
+        offset += (4 - (offset % 4)) % 4;
+
+        w = std::max(w / 2, 1u);
+        h = std::max(h / 2, 1u);
+    }
+
+    if(channels) {
+        tex->set_bpp(channels * 8);
+        tex->resize(width, height);
+        tex->set_mipmap_data(std::move(levels));
+    } else {
+        tex->set_compressed_data(format, width, height, std::move(levels));
+    }
+
+    if(!bottom_up) {
+        tex->flip_vertically();
+    }
+}
+
+void CompressedTextureLoader::load_dds(Texture* tex, const std::string& buffer) {
+    Reader reader(buffer, filename_);
+
+    const std::size_t header = 4;
+
+    const uint32_t flags = reader.u32(header + 4);
+    const uint32_t height = reader.u32(header + 8);
+    const uint32_t width = reader.u32(header + 12);
+    const uint32_t mipmap_count = (flags & DDSD_MIPMAPCOUNT) ? std::max(reader.u32(header + 24), 1u) : 1;
+    const uint32_t pixel_format_flags = reader.u32(header + 76);
+    const uint32_t fourcc = reader.u32(header + 80);
+    const uint32_t caps2 = reader.u32(header + 108);
+
+    std::size_t offset = header + DDS_HEADER_SIZE;
+
+    TextureFormat format = TEXTURE_FORMAT_UNCOMPRESSED;
+    if((pixel_format_flags & DDPF_FOURCC) && !(caps2 & (DDSCAPS2_CUBEMAP | DDSCAPS2_VOLUME))) {
+        if(fourcc == four_cc("DXT1")) {
+            format = TEXTURE_FORMAT_DXT1;
+        } else if(fourcc == four_cc("DXT3")) {
+            format = TEXTURE_FORMAT_DXT3;
+        } else if(fourcc == four_cc("DXT5")) {
+            format = TEXTURE_FORMAT_DXT5;
+        } else if(fourcc == four_cc("DX10")) {
+            // DXGI_FORMAT_BC1/BC2/BC3, both the UNORM and SRGB variants
+            switch(reader.u32(offset)) {
+                case 71: case 72: format = TEXTURE_FORMAT_DXT1; break;
+                case 74: case 75: format = TEXTURE_FORMAT_DXT3; break;
+                case 77: case 78: format = TEXTURE_FORMAT_DXT5; break;
+                default: break;
+            }
+
+            if(reader.u32(offset + 12) > 1) {
+                // Texture arrays aren't supported
+                format = TEXTURE_FORMAT_UNCOMPRESSED;
+            }
+            offset += DDS_DX10_HEADER_SIZE;
+        }
+    }
+
+    if(format == TEXTURE_FORMAT_UNCOMPRESSED) {
+        // Not something we can upload directly, let SOIL decode it
+        int w, h, channels;
+        unsigned char* data = SOIL_load_image_from_memory(
+            (const unsigned char*) buffer.data(), buffer.size(), &w, &h, &channels, SOIL_LOAD_AUTO
+        );
+
+        if(!data) {
+            L_ERROR(_F("Unable to load texture with name: {0}").format(filename_));
+            throw std::runtime_error("Couldn't load the file: " + filename_.encode());
+        }
+
+        tex->set_bpp(channels * 8);
+        tex->resize(w, h);
+        tex->data().assign(data, data + (w * h * channels));
+        SOIL_free_image_data(data);
+    } else {
+        std::vector<Texture::Data> levels;
+
+        uint32_t w = width, h = height;
+        for(uint32_t i = 0; i < mipmap_count; ++i) {
+            const std::size_t size = compressed_level_size(format, w, h);
+            const uint8_t* data = reader.bytes(offset, size);
+            levels.push_back(Texture::Data(data, data + size));
+
+            offset += size;
+            w = std::max(w / 2, 1u);
+            h = std::max(h / 2, 1u);
+        }
+
+        tex->set_compressed_data(format, width, height, std::move(levels));
+    }
+
+    // DDS rows are always top-down
+    tex->flip_vertically();
+}
+
+void write_ktx(std::ostream& out, TextureFormat format, uint32_t width, uint32_t height, const std::vector<Texture::Data>& levels) {
+    const bool compressed = format != TEXTURE_FORMAT_UNCOMPRESSED;
+
+    std::string key_value = KTX_ORIENTATION_KEY + '\0' + KTX_BOTTOM_UP + '\0';
+    const uint32_t key_value_length = key_value.length();
+    const uint32_t key_value_padding = (4 - (key_value_length % 4)) % 4;
+
+    out.write((const char*) KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER));
+    write_u32(out, KTX_ENDIANNESS);
+    write_u32(out, (compressed) ? 0 : GL_UNSIGNED_BYTE_); // glType
+    write_u32(out, 1); // glTypeSize
+    write_u32(out, (compressed) ? 0 : GL_RGBA_); // glFormat
+    write_u32(out, (compressed) ? texture_format_to_gl(format) : GL_RGBA8_);
+    write_u32(out, (!compressed || texture_format_has_alpha(format)) ? GL_RGBA_ : GL_RGB_); // glBaseInternalFormat
+    write_u32(out, width);
+    write_u32(out, height);
+    write_u32(out, 0); // pixelDepth
+    write_u32(out, 0); // numberOfArrayElements
+    write_u32(out, 1); // numberOfFaces
+    write_u32(out, levels.size());
+    write_u32(out, 4 + key_value_length + key_value_padding);
+
+    write_u32(out, key_value_length);
+    out.write(key_value.data(), key_value.length());
+    write_padding(out, key_value_length);
+
+    // RGBA rows are always a multiple of four bytes, so no row padding is needed
+    for(auto& level: levels) {
+        write_u32(out, level.size());
+        out.write((const char*) &level[0], level.size());
+        write_padding(out, level.size());
+    }
+}
+
+}
+}
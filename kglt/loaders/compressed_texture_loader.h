@@ -0,0 +1,61 @@
+#ifndef KGLT_COMPRESSED_TEXTURE_LOADER_H
+#define KGLT_COMPRESSED_TEXTURE_LOADER_H
+
+#include <ostream>
+
+#include "../loader.h"
+#include "../texture.h"
+
+namespace kglt {
+namespace loaders {
+
+/*
+ * Loads KTX (1.1) and DDS files, keeping S3TC and ETC payloads compressed along with any mipmaps
+ * the file includes. DDS files with other payloads are decoded by SOIL like any other image.
+ *
+ * KTX files written with the KTXorientation "S=r,T=u" are used as they are, anything else (and
+ * every DDS file) is top-down and has to be flipped. S3TC can be flipped without decoding it but
+ * ETC can't, so ETC files should be written bottom-up (as write_ktx does) to stay compressed.
+ */
+class CompressedTextureLoader : public Loader {
+public:
+    CompressedTextureLoader(const unicode& filename, std::shared_ptr<std::stringstream> data):
+        Loader(filename, data) {}
+
+    void into(Loadable& resource, const LoaderOptions& options = LoaderOptions()) override;
+
+private:
+    void load_ktx(Texture* tex, const std::string& buffer);
+    void load_dds(Texture* tex, const std::string& buffer);
+};
+
+class CompressedTextureLoaderType : public LoaderType {
+public:
+    CompressedTextureLoaderType() {
+        // Always add the texture hint
+        add_hint(LOADER_HINT_TEXTURE);
+    }
+
+    ~CompressedTextureLoaderType() {}
+
+    unicode name() { return "compressed_texture"; }
+    bool supports(const unicode& filename) const override {
+        return filename.lower().contains(".ktx") || filename.lower().contains(".dds");
+    }
+
+    Loader::ptr loader_for(const unicode& filename, std::shared_ptr<std::stringstream> data) const {
+        return Loader::ptr(new CompressedTextureLoader(filename, data));
+    }
+};
+
+/*
+ * Writes the levels (the full size image first, then each mipmap) as a KTX file. Rows must be
+ * bottom-up, as they are in a Texture, and the file is marked as such. Uncompressed levels are
+ * written as RGBA.
+ */
+void write_ktx(std::ostream& out, TextureFormat format, uint32_t width, uint32_t height, const std::vector<Texture::Data>& levels);
+
+}
+}
+
+#endif
@@ -1,6 +1,15 @@
+#include <cmath>
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "heightmap_loader.h"
 #include "../mesh.h"
 #include "../resource_manager.h"
+#include "../window_base.h"
+#include "../job_system.h"
 #include "texture_loader.h"
 
 namespace kglt {
@@ -23,187 +32,146 @@ Vec3 get_vertex_at(MeshPtr terrain, int x, int z) {
     return terrain->shared_data->position_at<Vec3>(idx);
 }
 
-static std::vector<Vec3> _get_surrounding_vertices_from_index(Mesh* terrain, uint32_t i) {
-    TerrainData data = terrain->data->get<TerrainData>("terrain_data");
-    uint32_t vertex_count = (data.x_size * data.z_size);
-
-    static std::array<int, 8> surrounding_indexes;
-    static std::vector<Vec3> surrounding_vertices;
-    surrounding_vertices.clear();
-    surrounding_vertices.reserve(8);
-    surrounding_indexes.fill(-1);
-
-    bool can_left = i % data.x_size > 1;
-    bool can_up = i > data.x_size;
-    bool can_right = i % data.x_size < (data.x_size - 1);
-    bool can_down = i < vertex_count - data.x_size;
-
-    if(can_up) {
-        surrounding_indexes[0] = (i - data.x_size);
-        if(can_left) {
-            surrounding_indexes[1] = (i - data.x_size - 1);
-        }
-        if(can_right) {
-            surrounding_indexes[2] = (i - data.x_size + 1);
-        }
-    }
-
-    if(can_left) {
-        surrounding_indexes[3] = (i - 1);
-    }
-
-    if(can_right) {
-        surrounding_indexes[4] = (i + 1);
-    }
+/*
+ * Averages every height with its (up to 8) neighbours. Reads from heights and writes to out, so
+ * rows are independent of each other and are processed in bands across the job system. Each
+ * output is the sum of three contiguous runs from the rows above, at and below, so the interior
+ * of a row is done four heights at a time.
+ */
+static void smooth_heights_iteration(JobSystem& jobs, const std::vector<float>& heights, std::vector<float>& out, int32_t width, int32_t height) {
+    jobs.parallel_for(0, height, [&](uint32_t z) {
+        const float* rows[3];
+        uint32_t row_count = 0;
+
+        if(z > 0) rows[row_count++] = &heights[(z - 1) * width];
+        rows[row_count++] = &heights[z * width];
+        if(int32_t(z) < height - 1) rows[row_count++] = &heights[(z + 1) * width];
+
+        float* target = &out[z * width];
+
+        auto column_sum = [&](int32_t x) -> float {
+            float total = 0.0f;
+            for(uint32_t r = 0; r < row_count; ++r) {
+                total += rows[r][x];
+            }
+            return total;
+        };
 
-    if(can_down) {
-        surrounding_indexes[5] = (i + data.x_size);
-        if(can_left) {
-            surrounding_indexes[6] = (i + data.x_size - 1);
-        }
-        if(can_right) {
-            surrounding_indexes[7] = (i + data.x_size + 1);
+        if(width == 1) {
+            target[0] = column_sum(0) / float(row_count);
+            return;
         }
-    }
-
-    VertexData& shared_data = terrain->shared_data;
-
-    for(auto& idx: surrounding_indexes) {
-        if(idx == -1) continue;
-        surrounding_vertices.push_back(shared_data.position_at<Vec3>(idx));
-    }
-
-    return surrounding_vertices;
-}
-
-std::vector<Vec3> get_surrounding_vertices_from_index(MeshPtr terrain, uint32_t i) {
-    return _get_surrounding_vertices_from_index(terrain.get(), i);
-}
-
-std::vector<Vec3> get_surrounding_vertices(MeshPtr terrain, int x, int z) {
-    TerrainData data = terrain->data->get<TerrainData>("terrain_data");
-    int32_t i = (z * data.x_size) + x;
-
-    return get_surrounding_vertices_from_index(terrain, i);
-}
-
-
-static void _smooth_terrain_iteration(Mesh* mesh, int width, int height) {
-    VertexData& shared_data = mesh->shared_data;
 
-    shared_data.move_to_start();
-
-    for(uint32_t i = 0; i < mesh->shared_data->count(); ++i) {
-        auto this_pos = shared_data.position_at<Vec3>(i);
-        auto vertices = _get_surrounding_vertices_from_index(mesh, i);
-
-        float total_height = this_pos.y;
-        for(auto& vert: vertices) {
-            total_height += vert.y;
+        // The first and last columns only have one horizontal neighbour
+        target[0] = (column_sum(0) + column_sum(1)) / float(row_count * 2);
+        target[width - 1] = (column_sum(width - 2) + column_sum(width - 1)) / float(row_count * 2);
+
+        const float scale = 1.0f / float(row_count * 3);
+        int32_t x = 1;
+
+#ifdef __SSE2__
+        const __m128 scale4 = _mm_set1_ps(scale);
+        for(; x + 4 <= width - 1; x += 4) {
+            __m128 total = _mm_setzero_ps();
+            for(uint32_t r = 0; r < row_count; ++r) {
+                total = _mm_add_ps(total, _mm_loadu_ps(rows[r] + x - 1));
+                total = _mm_add_ps(total, _mm_loadu_ps(rows[r] + x));
+                total = _mm_add_ps(total, _mm_loadu_ps(rows[r] + x + 1));
+            }
+            _mm_storeu_ps(target + x, _mm_mul_ps(total, scale4));
         }
+#endif
 
-        // http://nic-gamedev.blogspot.co.uk/2013/02/simple-terrain-smoothing.html
-
-        float new_height = total_height / float(vertices.size() + 1);
-        shared_data.position(this_pos.x, new_height, this_pos.z);
-        shared_data.move_next();
-    }
-}
-
-void smooth_terrain_iteration(MeshPtr mesh, int width, int height) {
-    _smooth_terrain_iteration(mesh.get(), width, height);
+        for(; x < width - 1; ++x) {
+            target[x] = (column_sum(x - 1) + column_sum(x) + column_sum(x + 1)) * scale;
+        }
+    });
 }
 
-static void _smooth_terrain(Mesh* terrain, uint32_t iterations) {
-    TerrainData data = terrain->data->get<TerrainData>("terrain_data");
+static void smooth_heights(JobSystem& jobs, std::vector<float>& heights, int32_t width, int32_t height, uint32_t iterations) {
+    std::vector<float> scratch(heights.size());
 
     for(uint32_t i = 0; i < iterations; ++i) {
-        _smooth_terrain_iteration(terrain, data.x_size, data.z_size);
+        smooth_heights_iteration(jobs, heights, scratch, width, height);
+        heights.swap(scratch);
     }
 }
 
 void smooth_terrain(MeshPtr terrain, uint32_t iterations) {
-    _smooth_terrain(terrain.get(), iterations);
-}
-
-}
-
-
-namespace loaders {
-
-inline float clamp(float x, float a, float b) {
-    return x < a ? a : (x > b ? b : x);
-}
-
-kglt::Colour colour_for_vertex(const kglt::Vec3& point, const kglt::Vec3& normal, const std::vector<Vec3>& surrounding_points) {
-    // FIXME: Replace with some kind of decent ambient occlusion
-    float sum = 0.0f;
+    TerrainData data = terrain->data->get<TerrainData>("terrain_data");
+    VertexData& shared_data = terrain->shared_data;
 
-    for(auto& neighbour_pos: surrounding_points) {
-        auto neighbour_offset = (neighbour_pos - point).normalized();
-        sum += acos(normal.dot(neighbour_offset));
+    std::vector<float> heights(shared_data.count());
+    for(uint32_t i = 0; i < heights.size(); ++i) {
+        heights[i] = shared_data.position_at<Vec3>(i).y;
     }
 
-    float v = sum / float(surrounding_points.size());
+    smooth_heights(terrain->resource_manager().window->jobs, heights, data.x_size, data.z_size, iterations);
 
-    // If the average angle > 90 degrees, then we are white
-    if(v > 3.142f / 2.0) {
-        return kglt::Colour::WHITE;
-    } else {
-        v /= (3.142 / 2.0);
+    for(uint32_t i = 0; i < heights.size(); ++i) {
+        auto pos = shared_data.position_at<Vec3>(i);
+        shared_data.move_to(i);
+        shared_data.position(pos.x, heights[i], pos.z);
     }
 
-    return kglt::Colour(v, v, v, 1.0);
+    shared_data.done();
 }
 
-std::vector<Vec3> gather_surrounding_points(VertexData* data, int width, int height, uint32_t i) {
-    int32_t vertex_count = (width * height);
-
-    std::vector<uint32_t> surrounding_indexes;
-
-    bool can_left = i % (uint32_t)width > 1;
-    bool can_up = i > (uint32_t)width;
-    bool can_right = i % (uint32_t)width < ((uint32_t)width - 1);
-    bool can_down = i < vertex_count - (uint32_t)width;
-
-    if(can_up) {
-        surrounding_indexes.push_back(i - width);
-        if(can_left) {
-            surrounding_indexes.push_back(i - width - 1);
-        }
-        if(can_right) {
-            surrounding_indexes.push_back(i - width + 1);
-        }
+/*
+ * Writes the normal of every vertex in row z from the central differences of the heights
+ * around it, which is the same as averaging the faces around it on a regular grid. The
+ * gradients for the whole row are worked out first so they can be normalized four at a time.
+ */
+static void calculate_row_normals(const std::vector<float>& heights, int32_t width, int32_t height, int32_t z, float spacing, float* nx, float* ny, float* nz) {
+    const float* row = &heights[z * width];
+    const float* above = &heights[std::max(z - 1, 0) * width];
+    const float* below = &heights[std::min(z + 1, height - 1) * width];
+
+    // At the edges there's only one neighbour, so the difference covers half the distance
+    const float z_distance = float(std::min(z + 1, height - 1) - std::max(z - 1, 0)) * spacing;
+
+    for(int32_t x = 0; x < width; ++x) {
+        int32_t left = std::max(x - 1, 0);
+        int32_t right = std::min(x + 1, width - 1);
+
+        // The normal of the surface y = h(x, z) is (-dh/dx, 1, -dh/dz)
+        nx[x] = (row[left] - row[right]) / (float(right - left) * spacing);
+        ny[x] = 1.0f;
+        nz[x] = (above[x] - below[x]) / z_distance;
     }
 
-    if(can_left) {
-        surrounding_indexes.push_back(i - 1);
-    }
+    int32_t x = 0;
 
-    if(can_right) {
-        surrounding_indexes.push_back(i + 1);
-    }
+#ifdef __SSE2__
+    for(; x + 4 <= width; x += 4) {
+        __m128 vx = _mm_loadu_ps(nx + x);
+        __m128 vz = _mm_loadu_ps(nz + x);
 
-    if(can_down) {
-        surrounding_indexes.push_back(i + width);
-        if(can_left) {
-            surrounding_indexes.push_back(i + width - 1);
-        }
-        if(can_right) {
-            surrounding_indexes.push_back(i + width + 1);
-        }
+        __m128 length_squared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vz, vz)), _mm_set1_ps(1.0f));
+        __m128 inverse_length = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(length_squared));
+
+        _mm_storeu_ps(nx + x, _mm_mul_ps(vx, inverse_length));
+        _mm_storeu_ps(ny + x, inverse_length);
+        _mm_storeu_ps(nz + x, _mm_mul_ps(vz, inverse_length));
     }
+#endif
 
-    std::vector<Vec3> results;
-    for(auto& idx: surrounding_indexes) {
-        results.push_back(data->position_at<Vec3>(idx));
+    for(; x < width; ++x) {
+        float inverse_length = 1.0f / std::sqrt((nx[x] * nx[x]) + (nz[x] * nz[x]) + 1.0f);
+        nx[x] *= inverse_length;
+        ny[x] = inverse_length;
+        nz[x] *= inverse_length;
     }
+}
 
-    return results;
 }
 
 
+namespace loaders {
 
+inline float clamp(float x, float a, float b) {
+    return x < a ? a : (x > b ? b : x);
+}
 
 void HeightmapLoader::into(Loadable &resource, const LoaderOptions &options) {
     Loadable* res_ptr = &resource;
@@ -253,11 +221,13 @@ void HeightmapLoader::into(Loadable &resource, const LoaderOptions &options) {
     int32_t largest = std::max(width, height);
     int32_t total = width * height;
 
+    JobSystem& jobs = mesh->resource_manager().window->jobs;
+
     std::vector<float> heights(total);
     auto& tex_data = tex->data();
     auto stride = tex->bpp() / 8;
     for(int32_t i = 0; i < total; i++) {
-        heights[i] = float(tex_data[i * stride]) / 256.0f;
+        heights[i] = spec.min_height + (range * (float(tex_data[i * stride]) / 256.0f));
     }
 
     // Add some properties for the user to access if they need to
@@ -269,45 +239,79 @@ void HeightmapLoader::into(Loadable &resource, const LoaderOptions &options) {
     data.grid_spacing = spec.spacing;
     mesh->data->stash(data, "terrain_data");
 
-    // Generate the vertices from the heightmap
-    for(int32_t z = 0; z < height; ++z) {
-        for(int32_t x = 0; x < width; ++x) {
-            int32_t idx = (z * width) + x;
+    if(spec.smooth_iterations) {
+        terrain::smooth_heights(jobs, heights, width, height, spec.smooth_iterations);
+    }
+
+    /* The vertices are written straight into the buffer rather than through the cursor, so
+     * that rows can be filled in parallel */
+    if(mesh->shared_data->specification() != VertexSpecification::DEFAULT) {
+        mesh->shared_data->reset(VertexSpecification::DEFAULT);
+    }
+
+    VertexData& vertices = mesh->shared_data;
+    vertices.resize(total);
 
-            float normalized_height = heights[idx];
-            float depth = range * normalized_height;
-            float final_pos = spec.min_height + depth;
+    uint8_t* buffer = vertices.data();
+    const uint32_t vertex_stride = vertices.stride();
+    const uint32_t position_offset = vertices.position_offset();
+    const uint32_t normal_offset = vertices.normal_offset();
+    const uint32_t texcoord0_offset = vertices.texcoord0_offset();
+    const uint32_t texcoord1_offset = vertices.texcoord1_offset();
+    const uint32_t diffuse_offset = vertices.diffuse_offset();
 
-            Vec3 pos = Vec3(
-                (float(x) * spec.spacing) - x_offset,
-                final_pos,
-                (float(z) * spec.spacing) - z_offset
-            );
-            mesh->shared_data->position(pos);
-            mesh->shared_data->normal(Vec3(0, 1, 0));
+    const float texcoord0_scale = spec.texcoord0_repeat / float(largest);
 
-            mesh->shared_data->diffuse(kglt::Colour::WHITE);
+    jobs.parallel_for(0, height, [&](uint32_t z) {
+        std::vector<float> nx(width), ny(width, 1.0f), nz(width);
+
+        if(spec.calculate_normals) {
+            terrain::calculate_row_normals(heights, width, height, z, spec.spacing, &nx[0], &ny[0], &nz[0]);
+        }
+
+        const float pz = (float(z) * spec.spacing) - z_offset;
+
+        for(int32_t x = 0; x < width; ++x) {
+            uint8_t* vertex = buffer + (((z * width) + x) * vertex_stride);
+
+            float* position = (float*) (vertex + position_offset);
+            position[0] = (float(x) * spec.spacing) - x_offset;
+            position[1] = heights[(z * width) + x];
+            position[2] = pz;
+
+            float* normal = (float*) (vertex + normal_offset);
+            normal[0] = nx[x];
+            normal[1] = ny[x];
+            normal[2] = nz[x];
 
             // First texture coordinate takes into account texture_repeat setting
-            mesh->shared_data->tex_coord0(
-                (spec.texcoord0_repeat / float(largest)) * float(x),
-                (spec.texcoord0_repeat / float(largest)) * float(z)
-            );
+            float* texcoord0 = (float*) (vertex + texcoord0_offset);
+            texcoord0[0] = texcoord0_scale * float(x);
+            texcoord0[1] = texcoord0_scale * float(z);
 
             // Second texture coordinate makes the texture span the entire terrain
-            mesh->shared_data->tex_coord1(
-                (1.0 / float(width)) * float(x),
-                (1.0 / float(height)) * float(z)
-            );
+            float* texcoord1 = (float*) (vertex + texcoord1_offset);
+            texcoord1[0] = (1.0 / float(width)) * float(x);
+            texcoord1[1] = (1.0 / float(height)) * float(z);
 
-            mesh->shared_data->move_next();
+            float* diffuse = (float*) (vertex + diffuse_offset);
+            diffuse[0] = diffuse[1] = diffuse[2] = diffuse[3] = 1.0f;
+        }
+    });
+
+    // Each patch only touches its own submesh, so they can be filled in parallel too
+    jobs.parallel_for(0, total_patches, [&](uint32_t patch) {
+        auto sm = submeshes[patch];
+
+        int32_t start_x = (patch % patches_across) * patch_size;
+        int32_t start_z = (patch / patches_across) * patch_size;
+        int32_t end_x = std::min(start_x + patch_size, width - 1);
+        int32_t end_z = std::min(start_z + patch_size, height - 1);
 
-            if(z < (height - 1) && x < (width - 1)) {
-                int patch_x = (x / float(patch_size));
-                int patch_z = (z / float(patch_size));
-                int patch_idx = (patch_z * patches_across) + patch_x;
+        for(int32_t z = start_z; z < end_z; ++z) {
+            for(int32_t x = start_x; x < end_x; ++x) {
+                int32_t idx = (z * width) + x;
 
-                auto sm = submeshes.at(patch_idx);
                 sm->index_data->index(idx);
                 sm->index_data->index(idx + width);
                 sm->index_data->index(idx + 1);
@@ -317,48 +321,12 @@ void HeightmapLoader::into(Loadable &resource, const LoaderOptions &options) {
                 sm->index_data->index(idx + width + 1);
             }
         }
-    }
-
-    if(spec.smooth_iterations) {
-        terrain::_smooth_terrain(mesh, spec.smooth_iterations);
-    }
-
-    if(spec.calculate_normals) {
-        // The mesh don't have any normals, let's generate some!
-        std::unordered_map<int, kglt::Vec3> index_to_normal;
-
-        for(auto sm: submeshes) {
-            // Go through all the triangles, add the face normal to all the vertices
-            for(uint32_t i = 0; i < sm->index_data->count(); i+=3) {
-                Index idx1 = sm->index_data->at(i);
-                Index idx2 = sm->index_data->at(i+1);
-                Index idx3 = sm->index_data->at(i+2);
-
-                kglt::Vec3 v1, v2, v3;
-                v1 = sm->vertex_data->position_at<Vec3>(idx1);
-                v2 = sm->vertex_data->position_at<Vec3>(idx2);
-                v3 = sm->vertex_data->position_at<Vec3>(idx3);
-
-                kglt::Vec3 normal = (v2 - v1).normalized().cross((v3 - v1).normalized()).normalized();
-
-                index_to_normal[idx1] += normal;
-                index_to_normal[idx2] += normal;
-                index_to_normal[idx3] += normal;
-            }
-        }
-
-        // Now set the normal on the vertex data
-        for(auto p: index_to_normal) {
-            mesh->shared_data->move_to(p.first);
-            auto n = p.second.normalized();
-            mesh->shared_data->normal(n);
-        }
-    }
+    }, 1);
 
     for(auto sm: submeshes) {
         sm->index_data->done();
     }
-    mesh->shared_data->done();
+    vertices.done();
 
     mesh->resource_manager().delete_texture(tid); //Finally delete the texture
 
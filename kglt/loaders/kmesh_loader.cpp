@@ -0,0 +1,378 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+
+#include "kmesh_loader.h"
+
+#include "../mesh.h"
+#include "../material.h"
+#include "../resource_manager.h"
+#include "../utils/mapped_file.h"
+#include "../deps/kazlog/kazlog.h"
+
+namespace kglt {
+namespace loaders {
+
+namespace {
+
+const char KMESH_MAGIC[4] = {'K', 'M', 'S', 'H'};
+const uint32_t NO_MATERIAL = 0xFFFFFFFF;
+
+class Writer {
+public:
+    Writer(const std::string& path):
+        file_(path, std::ios::binary | std::ios::trunc) {
+
+        if(!file_) {
+            throw std::runtime_error("Unable to open " + path + " for writing");
+        }
+    }
+
+    void bytes(const void* data, std::size_t count) {
+        if(count) {
+            file_.write((const char*) data, count);
+        }
+    }
+
+    template<typename T>
+    void write(const T& value) {
+        bytes(&value, sizeof(T));
+    }
+
+    void string(const std::string& value) {
+        write<uint32_t>(value.length());
+        bytes(value.c_str(), value.length());
+    }
+
+    void specification(const VertexSpecification& spec) {
+        const uint8_t attributes[8] = {
+            uint8_t(spec.position_attribute), uint8_t(spec.normal_attribute),
+            uint8_t(spec.texcoord0_attribute), uint8_t(spec.texcoord1_attribute),
+            uint8_t(spec.texcoord2_attribute), uint8_t(spec.texcoord3_attribute),
+            uint8_t(spec.diffuse_attribute), uint8_t(spec.specular_attribute)
+        };
+
+        bytes(attributes, sizeof(attributes));
+    }
+
+    void vertices(VertexData& data) {
+        specification(data.specification());
+        write<uint32_t>(data.count());
+        bytes(data.data(), data.data_size());
+    }
+
+    void colour(const Colour& colour) {
+        const float rgba[4] = {colour.r, colour.g, colour.b, colour.a};
+        bytes(rgba, sizeof(rgba));
+    }
+
+    bool good() const { return bool(file_); }
+
+private:
+    std::ofstream file_;
+};
+
+class Reader {
+public:
+    Reader(const uint8_t* data, std::size_t size):
+        data_(data),
+        size_(size) {}
+
+    const uint8_t* bytes(std::size_t count) {
+        if(count > size_ - offset_) {
+            throw std::runtime_error("Truncated kmesh data");
+        }
+
+        const uint8_t* result = data_ + offset_;
+        offset_ += count;
+        return result;
+    }
+
+    template<typename T>
+    T read() {
+        T value;
+        memcpy(&value, bytes(sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    std::string string() {
+        uint32_t length = read<uint32_t>();
+        return std::string((const char*) bytes(length), length);
+    }
+
+    VertexSpecification specification() {
+        const uint8_t* attributes = bytes(8);
+        for(uint32_t i = 0; i < 8; ++i) {
+            if(attributes[i] > VERTEX_ATTRIBUTE_4UB) {
+                throw std::runtime_error("Invalid vertex specification in kmesh data");
+            }
+        }
+
+        return VertexSpecification(
+            VertexAttribute(attributes[0]), VertexAttribute(attributes[1]),
+            VertexAttribute(attributes[2]), VertexAttribute(attributes[3]),
+            VertexAttribute(attributes[4]), VertexAttribute(attributes[5]),
+            VertexAttribute(attributes[6]), VertexAttribute(attributes[7])
+        );
+    }
+
+    /* Fills data (which must already have the right specification) with the next block of vertices */
+    void vertices(VertexData& data) {
+        uint32_t count = read<uint32_t>();
+        const uint8_t* source = bytes(std::size_t(count) * data.stride());
+
+        data.resize(count);
+        if(count) {
+            memcpy(data.data(), source, data.data_size());
+        }
+        data.done();
+    }
+
+    /* Fills data with the next block of indices, which must all be less than vertex_count */
+    void indices(IndexData& data, uint32_t vertex_count) {
+        uint32_t count = read<uint32_t>();
+        const uint8_t* source = bytes(std::size_t(count) * sizeof(Index));
+
+        data.resize(count);
+        if(count) {
+            memcpy(data._raw_data(), source, count * sizeof(Index));
+
+            const Index* indices = data._raw_data();
+            if(std::any_of(indices, indices + count, [vertex_count](Index i) { return i >= vertex_count; })) {
+                throw std::runtime_error("Invalid index in kmesh data");
+            }
+        }
+        data.done();
+    }
+
+    Colour colour() {
+        float rgba[4];
+        memcpy(rgba, bytes(sizeof(rgba)), sizeof(rgba));
+        return Colour(rgba[0], rgba[1], rgba[2], rgba[3]);
+    }
+
+private:
+    const uint8_t* data_;
+    std::size_t size_;
+    std::size_t offset_ = 0;
+};
+
+/* The file a texture was loaded from, stashed by ResourceManager::new_texture_from_file */
+std::string texture_source(ResourceManager& resources, MaterialPass* pass) {
+    if(!pass || !pass->texture_unit_count()) {
+        return std::string();
+    }
+
+    auto texture = resources.texture(pass->texture_unit(0).texture_id());
+    if(!texture || !texture->data->exists("source_path")) {
+        return std::string();
+    }
+
+    return texture->data->get<unicode>("source_path").encode();
+}
+
+/* The material file it was created from, stashed by ResourceManager::new_material_from_file */
+std::string material_source(ResourceManager& resources, MaterialID material_id) {
+    // The default material has its texture set up by the resource manager, so it's cloned instead
+    if(material_id == resources.default_material_id()) {
+        return std::string();
+    }
+
+    auto material = resources.material(material_id);
+    if(!material || !material->data->exists("source_path")) {
+        return std::string();
+    }
+
+    return material->data->get<unicode>("source_path").encode();
+}
+
+}
+
+void write_kmesh(Mesh& mesh, const unicode& path) {
+    if(mesh.is_animated()) {
+        throw std::logic_error("Animated meshes can't be written as kmesh files");
+    }
+
+    auto& resources = mesh.resource_manager();
+
+    std::vector<SubMesh*> submeshes;
+    std::vector<MaterialID> materials;
+    std::unordered_map<MaterialID, uint32_t> material_indexes;
+
+    // Submeshes which shared a material share it again when they're loaded
+    mesh.each([&](const std::string&, SubMesh* submesh) {
+        submeshes.push_back(submesh);
+
+        MaterialID material = submesh->material_id();
+        if(material && !material_indexes.count(material)) {
+            material_indexes[material] = materials.size();
+            materials.push_back(material);
+        }
+    });
+
+    Writer writer(path.encode());
+
+    AABB bounds = mesh.aabb();
+
+    writer.bytes(KMESH_MAGIC, 4);
+    writer.write<uint32_t>(KMESH_VERSION);
+    writer.write<uint32_t>(submeshes.size());
+    writer.write<uint32_t>(materials.size());
+    writer.write<float>(bounds.min.x);
+    writer.write<float>(bounds.min.y);
+    writer.write<float>(bounds.min.z);
+    writer.write<float>(bounds.max.x);
+    writer.write<float>(bounds.max.y);
+    writer.write<float>(bounds.max.z);
+    writer.vertices(*mesh.shared_data.get());
+
+    for(auto& material_id: materials) {
+        auto pass = resources.material(material_id)->first_pass();
+
+        writer.string(material_source(resources, material_id));
+
+        // A material without passes is written with MaterialPass's defaults
+        writer.colour((pass) ? pass->ambient() : Colour::BLACK);
+        writer.colour((pass) ? pass->diffuse() : Colour::WHITE);
+        writer.colour((pass) ? pass->specular() : Colour::BLACK);
+        writer.write<float>((pass) ? pass->shininess() : 0.0f);
+        writer.write<uint8_t>((pass) ? pass->cull_mode() : CULL_MODE_BACK_FACE);
+        writer.string(texture_source(resources, pass.get()));
+    }
+
+    for(auto submesh: submeshes) {
+        MaterialID material = submesh->material_id();
+
+        writer.string(submesh->name());
+        writer.write<uint8_t>(submesh->arrangement());
+        writer.write<uint8_t>(submesh->uses_shared_vertices());
+        writer.write<uint32_t>((material) ? material_indexes.at(material) : NO_MATERIAL);
+
+        if(!submesh->uses_shared_vertices()) {
+            writer.vertices(*submesh->vertex_data.get());
+        }
+
+        auto& indices = submesh->index_data->all();
+        writer.write<uint32_t>(indices.size());
+        writer.bytes(indices.data(), indices.size() * sizeof(Index));
+    }
+
+    if(!writer.good()) {
+        throw std::runtime_error(_F("Error writing kmesh file {0}").format(path));
+    }
+}
+
+void read_kmesh(Mesh& mesh, const uint8_t* data, std::size_t size) {
+    Reader reader(data, size);
+
+    if(memcmp(reader.bytes(4), KMESH_MAGIC, 4) != 0) {
+        throw std::runtime_error("Not a kmesh file");
+    }
+
+    uint32_t version = reader.read<uint32_t>();
+    if(version != KMESH_VERSION) {
+        throw std::runtime_error(_F("Unsupported kmesh version: {0}").format(version));
+    }
+
+    uint32_t submesh_count = reader.read<uint32_t>();
+    uint32_t material_count = reader.read<uint32_t>();
+
+    // The bounds are for tools which want them without loading the mesh, they're recalculated here anyway
+    reader.bytes(sizeof(float) * 6);
+
+    mesh.reset(reader.specification());
+    reader.vertices(*mesh.shared_data.get());
+
+    auto& resources = mesh.resource_manager();
+
+    // Hold on to the materials until a submesh has them, so they can't be garbage collected
+    std::vector<MaterialPtr> materials;
+    std::unordered_map<std::string, TextureID> textures;
+
+    for(uint32_t i = 0; i < material_count; ++i) {
+        // Built the same way as the original, so a cached mesh renders with the same programs
+        std::string material_path = reader.string();
+        auto material = resources.material(
+            (material_path.empty()) ? resources.clone_default_material() : resources.new_material_from_file(material_path)
+        );
+        auto pass = material->first_pass();
+
+        Colour ambient = reader.colour();
+        Colour diffuse = reader.colour();
+        Colour specular = reader.colour();
+        float shininess = reader.read<float>();
+        CullMode cull_mode = CullMode(reader.read<uint8_t>());
+        std::string texture_path = reader.string();
+
+        pass->set_ambient(ambient);
+        pass->set_diffuse(diffuse);
+        pass->set_specular(specular);
+        pass->set_shininess(shininess);
+        pass->set_cull_mode(cull_mode);
+
+        if(!texture_path.empty()) {
+            auto it = textures.find(texture_path);
+            if(it == textures.end()) {
+                try {
+                    it = textures.insert(std::make_pair(texture_path, resources.new_texture_from_file(texture_path))).first;
+                } catch(std::exception& e) {
+                    L_WARN(_F("Unable to load texture {0}: {1}").format(texture_path, e.what()));
+                }
+            }
+
+            if(it != textures.end()) {
+                material->set_texture_unit_on_all_passes(0, it->second);
+            }
+        }
+
+        materials.push_back(material);
+    }
+
+    for(uint32_t i = 0; i < submesh_count; ++i) {
+        std::string name = reader.string();
+        MeshArrangement arrangement = MeshArrangement(reader.read<uint8_t>());
+        bool shared = reader.read<uint8_t>();
+        uint32_t material = reader.read<uint32_t>();
+
+        if(material != NO_MATERIAL && material >= materials.size()) {
+            throw std::runtime_error("Invalid material index in kmesh data");
+        }
+
+        SubMesh* submesh = nullptr;
+        if(shared) {
+            submesh = mesh.new_submesh_with_material(
+                name, (material == NO_MATERIAL) ? MaterialID() : materials[material]->id(), arrangement
+            );
+        } else {
+            submesh = mesh.new_submesh_with_material(
+                name, (material == NO_MATERIAL) ? MaterialID() : materials[material]->id(), arrangement,
+                VERTEX_SHARING_MODE_INDEPENDENT, reader.specification()
+            );
+
+            reader.vertices(*submesh->vertex_data.get());
+        }
+
+        reader.indices(*submesh->index_data.get(), submesh->vertex_data->count());
+    }
+}
+
+void read_kmesh(Mesh& mesh, const unicode& path) {
+    MappedFile file(path.encode());
+    read_kmesh(mesh, file.data(), file.size());
+}
+
+void KMeshLoader::into(Loadable& resource, const LoaderOptions& options) {
+    Mesh* mesh = loadable_to<Mesh>(resource);
+
+    if(kfs::path::exists(filename_.encode())) {
+        read_kmesh(*mesh, filename_);
+    } else {
+        // Not on the filesystem (e.g. an Android asset), use what the locator read for us
+        std::string data = data_->str();
+        read_kmesh(*mesh, (const uint8_t*) data.data(), data.size());
+    }
+}
+
+}
+}
@@ -0,0 +1,65 @@
+#ifndef KMESH_LOADER_H
+#define KMESH_LOADER_H
+
+#include <cstddef>
+#include "../loader.h"
+
+namespace kglt {
+namespace loaders {
+
+/*
+ * A compact binary mesh format, used to cache meshes imported from slower formats.
+ *
+ * The file is a fixed header (magic, version, submesh and material counts, AABB), then the
+ * shared vertex specification, count and data exactly as it's laid out in VertexData, then a
+ * table of the materials the submeshes use, then each submesh (name, arrangement, material,
+ * its own vertices if it doesn't share them, and the raw indices). Loading is a handful of
+ * memcpys straight into the vertex and index buffers, with no per-vertex work.
+ *
+ * Everything is written in the byte order of the machine that wrote it. Materials keep the
+ * material file they were created from (or none, for clones of the default material), the
+ * colours, shininess and cull mode of their first pass and the file the texture in unit 0 was
+ * loaded from, anything more elaborate should be reapplied after loading.
+ */
+
+const uint32_t KMESH_VERSION = 2;
+
+/* Writes the mesh to path, throws std::logic_error for animated meshes */
+void write_kmesh(Mesh& mesh, const unicode& path);
+
+/* Replaces the contents of mesh with the kmesh in data, throws std::runtime_error if it's invalid */
+void read_kmesh(Mesh& mesh, const uint8_t* data, std::size_t size);
+
+/* Memory maps the file at path and reads it with read_kmesh */
+void read_kmesh(Mesh& mesh, const unicode& path);
+
+class KMeshLoader : public Loader {
+public:
+    KMeshLoader(const unicode& filename, std::shared_ptr<std::stringstream> data):
+        Loader(filename, data) {}
+
+    void into(Loadable& resource, const LoaderOptions& options=LoaderOptions());
+};
+
+class KMeshLoaderType : public LoaderType {
+public:
+    KMeshLoaderType() {
+        add_hint(LOADER_HINT_MESH);
+    }
+
+    ~KMeshLoaderType() {}
+
+    unicode name() { return "kmesh"; }
+    bool supports(const unicode& filename) const override {
+        return filename.lower().ends_with(".kmesh");
+    }
+
+    Loader::ptr loader_for(const unicode& filename, std::shared_ptr<std::stringstream> data) const {
+        return Loader::ptr(new KMeshLoader(filename, data));
+    }
+};
+
+}
+}
+
+#endif // KMESH_LOADER_H
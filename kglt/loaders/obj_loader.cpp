@@ -1,8 +1,19 @@
+#include <set>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+#include <unordered_map>
+
 #include "obj_loader.h"
 
 #include "../mesh.h"
+#include "../window_base.h"
 #include "../resource_manager.h"
+#include "../resource_locator.h"
+#include "../job_system.h"
 #include "../shortcuts.h"
+#include "../utils/mapped_file.h"
 
 namespace kglt {
 namespace loaders {
@@ -53,280 +64,596 @@ void parse_face(const unicode& input, int32_t& vertex_index, int32_t& tex_index,
     }
 }
 
-void OBJLoader::into(Loadable &resource, const LoaderOptions &options) {
-    Mesh* mesh = loadable_to<Mesh>(resource);
+namespace {
+
+/* Files are split into chunks of at least this size, smaller ones are parsed in one go */
+const std::size_t MIN_PARALLEL_CHUNK_SIZE = 1024 * 1024;
+
+const double POWERS_OF_TEN[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+}
 
-    //Split on newlines
-    std::vector<unicode> lines = unicode(this->data_->str()).split("\n");
+bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+void skip_space(const char*& cursor, const char* end) {
+    while(cursor < end && is_space(*cursor)) {
+        ++cursor;
+    }
+}
+
+bool parse_int(const char*& cursor, const char* end, int32_t& out) {
+    bool negative = false;
+    if(cursor < end && (*cursor == '-' || *cursor == '+')) {
+        negative = (*cursor == '-');
+        ++cursor;
+    }
+
+    if(cursor == end || !is_digit(*cursor)) {
+        return false;
+    }
+
+    int64_t value = 0;
+    while(cursor < end && is_digit(*cursor)) {
+        value = std::min<int64_t>((value * 10) + (*cursor - '0'), INT32_MAX);
+        ++cursor;
+    }
+
+    out = int32_t((negative) ? -value : value);
+    return true;
+}
+
+/*
+ * An index as written in the file (1-based, or negative to count back from the most recent)
+ * along with the number of elements read so far. Returns -1 if the index was omitted.
+ */
+int32_t resolve_index(int32_t index, uint32_t count, const char* what) {
+    if(index == 0) {
+        return -1;
+    }
+
+    int64_t resolved = (index > 0) ? int64_t(index) - 1 : int64_t(count) + index;
+    if(resolved < 0 || resolved >= count) {
+        throw std::runtime_error(_F("Face refers to {0} {1} but only {2} have been defined").format(what, index, count));
+    }
+
+    return int32_t(resolved);
+}
 
-    std::vector<Vec3> vertices;
+enum StatementType {
+    STATEMENT_FACE,
+    STATEMENT_NEWMTL,
+    STATEMENT_USEMTL,
+    STATEMENT_MTLLIB,
+    STATEMENT_NS,
+    STATEMENT_KA,
+    STATEMENT_KD,
+    STATEMENT_KS,
+    STATEMENT_MAP_KD,
+    STATEMENT_SMOOTHING_GROUP
+};
+
+/* A face corner as it appears in the file, zero where an index was left out */
+struct Corner {
+    int32_t v = 0;
+    int32_t vt = 0;
+    int32_t vn = 0;
+};
+
+/* Anything other than vertex data, which has to be handled in file order */
+struct Statement {
+    StatementType type;
+
+    // The rest of the line after the keyword
+    const char* begin;
+    const char* end;
+
+    // Faces only
+    uint32_t first_corner;
+    uint32_t corner_count;
+
+    // How many of each vertex element the chunk had read before this statement
+    uint32_t positions;
+    uint32_t tex_coords;
+    uint32_t normals;
+};
+
+/* A run of whole lines, parsed independently of the others */
+struct Chunk {
+    const char* begin = nullptr;
+    const char* end = nullptr;
+
+    std::vector<Vec3> positions;
     std::vector<Vec2> tex_coords;
     std::vector<Vec3> normals;
+    std::vector<Corner> corners;
+    std::vector<Statement> statements;
 
-    std::unordered_map<unicode, kglt::MaterialPtr> materials;
-    SubMesh* sm = nullptr;
+    std::string error;
+};
 
-    unicode current_material;
-
-    VertexSpecification spec;
-    spec.position_attribute = VERTEX_ATTRIBUTE_3F;
-    spec.texcoord0_attribute = VERTEX_ATTRIBUTE_2F;
-    spec.normal_attribute = VERTEX_ATTRIBUTE_3F;
-    spec.diffuse_attribute = VERTEX_ATTRIBUTE_4F;
-    mesh->reset(spec);
+bool keyword_is(const char* begin, const char* end, const char* keyword) {
+    std::size_t length = strlen(keyword);
+    return std::size_t(end - begin) == length && memcmp(begin, keyword, length) == 0;
+}
 
-    SubMesh* default_submesh = nullptr;
+void parse_components(const char* cursor, const char* end, float* out, uint32_t required, const char* what) {
+    uint32_t found = 0;
+    while(found < required) {
+        skip_space(cursor, end);
+        if(cursor == end || !parse_float(cursor, end, out[found])) {
+            break;
+        }
+        ++found;
+    }
 
-    bool has_materials = false;
-    for(uint32_t l = 0; l < lines.size(); ++l) {
-        unicode line = lines[l].strip();
+    if(found < required) {
+        throw std::runtime_error(_F("Found {0} components for {1}, expected {2}").format(found, what, required));
+    }
+}
 
-        //Ignore comments
-        if(line.starts_with("#")) {
-            continue;
+void parse_face_corners(const char* cursor, const char* end, std::vector<Corner>& corners) {
+    while(true) {
+        skip_space(cursor, end);
+        if(cursor == end) {
+            break;
         }
 
-        if(line.empty()) {
-            continue;
+        Corner corner;
+        if(!parse_int(cursor, end, corner.v)) {
+            throw std::runtime_error("Invalid face definition");
         }
 
-        std::vector<unicode> parts = line.split("", -1, false); //Split on whitespace
-        if(parts[0] == "v") {
-            if(parts.size() != 4) {
-                throw std::runtime_error(_F("Found {0} components for vertex, expected 3").format(parts.size()));
+        if(cursor < end && *cursor == '/') {
+            ++cursor;
+            parse_int(cursor, end, corner.vt); // Optional, as in 1//2
+
+            if(cursor < end && *cursor == '/') {
+                ++cursor;
+                parse_int(cursor, end, corner.vn);
             }
+        }
 
-            float x = parts[1].to_float();
-            float y = parts[2].to_float();
-            float z = parts[3].to_float();
+        if(cursor < end && !is_space(*cursor)) {
+            throw std::runtime_error("Invalid face definition");
+        }
 
-            vertices.push_back(Vec3(x, y, z));
-        } else if(parts[0] == "vt") {
-            if(parts.size() < 3) {
-                throw std::runtime_error(_F("Found {0} components for texture coordinate, expected 2").format(parts.size() - 1));
-            }
+        corners.push_back(corner);
+    }
+}
 
-            float x = parts[1].to_float();
-            float y = parts[2].to_float();
+void parse_chunk(Chunk& chunk) {
+    const char* line = chunk.begin;
 
-            tex_coords.push_back(Vec2(x, y));
-        } else if(parts[0] == "vn") {
-            if(parts.size() != 4) {
-                throw std::runtime_error(_F("Found {0} components for vertex, expected 3").format(parts.size() - 1));
-            }
+    while(line < chunk.end) {
+        const char* line_end = (const char*) memchr(line, '\n', chunk.end - line);
+        if(!line_end) {
+            line_end = chunk.end;
+        }
 
-            float x = parts[1].to_float();
-            float y = parts[2].to_float();
-            float z = parts[3].to_float();
-
-            Vec3 n(x, y, z);
-            kmVec3Normalize(&n, &n);
-            normals.push_back(n);
-        } else if(parts[0] == "f") {
-            std::string smi;
-            if(current_material.empty()) {
-                if(!default_submesh) {
-                    default_submesh = mesh->new_submesh("default");
-                }
-                smi = "default";
-            } else {
-                if(materials.count(current_material)) {
-                    auto mat_id = materials.at(current_material)->id();
-                    if(mesh->has_submesh(current_material.encode())) {
-                        smi = current_material.encode();
-                    } else {
-                        mesh->new_submesh_with_material(current_material.encode(), mat_id);
-                        smi = current_material.encode();
-                    }
-                } else {
-                    L_WARN(_F("Ignoring non-existant material ({0}) while loading {1}").format(
-                        current_material,
-                        filename_
-                    ));
-                    if(sm) {
-                        smi = sm->name(); // Just stick with the current submesh, don't change it
-                    } else {
-                        if(!default_submesh) {
-                            default_submesh = mesh->new_submesh("default");
-                        }
-                        smi = "default";
-                    }
-                }
-            }
-            sm = mesh->submesh(smi);
+        const char* cursor = line;
+        skip_space(cursor, line_end);
 
-            VertexData* vertex_data = sm->vertex_data.get();
-            IndexData* index_data = sm->index_data.get();
+        const char* keyword = cursor;
+        while(cursor < line_end && !is_space(*cursor)) {
+            ++cursor;
+        }
+        const char* keyword_end = cursor;
 
-            //Faces are a pain in the arse to parse
-            parts = std::vector<unicode>(parts.begin() + 1, parts.end()); //Strip off the first bit
+        skip_space(cursor, line_end);
 
-            int32_t first_v, first_vt, first_vn;
-            parse_face(parts[0], first_v, first_vt, first_vn);
+        // Trailing whitespace isn't part of the arguments (e.g. filenames)
+        const char* arguments_end = line_end;
+        while(arguments_end > cursor && is_space(*(arguments_end - 1))) {
+            --arguments_end;
+        }
 
-            int32_t first_index = vertex_data->count(); //Store the index of this vertex
+        auto statement = [&](StatementType type) {
+            Statement s;
+            s.type = type;
+            s.begin = cursor;
+            s.end = arguments_end;
+            s.first_corner = s.corner_count = 0;
+            s.positions = chunk.positions.size();
+            s.tex_coords = chunk.tex_coords.size();
+            s.normals = chunk.normals.size();
+            chunk.statements.push_back(s);
+        };
 
-            vertex_data->position(vertices[first_v]); //Read the position
-            if(first_vt > -1) {
-                vertex_data->tex_coord0(tex_coords[first_vt]);
-            }
+        if(keyword == keyword_end || *keyword == '#') {
+            // Blank line or comment
+        } else if(keyword_is(keyword, keyword_end, "v")) {
+            Vec3 v;
+            parse_components(cursor, arguments_end, &v.x, 3, "vertex");
+            chunk.positions.push_back(v);
+        } else if(keyword_is(keyword, keyword_end, "vt")) {
+            Vec2 vt;
+            parse_components(cursor, arguments_end, &vt.x, 2, "texture coordinate");
+            chunk.tex_coords.push_back(vt);
+        } else if(keyword_is(keyword, keyword_end, "vn")) {
+            Vec3 vn;
+            parse_components(cursor, arguments_end, &vn.x, 3, "normal");
+            kmVec3Normalize(&vn, &vn);
+            chunk.normals.push_back(vn);
+        } else if(keyword_is(keyword, keyword_end, "f")) {
+            statement(STATEMENT_FACE);
+
+            Statement& face = chunk.statements.back();
+            face.first_corner = chunk.corners.size();
+            parse_face_corners(cursor, arguments_end, chunk.corners);
+            face.corner_count = chunk.corners.size() - face.first_corner;
+        } else if(keyword_is(keyword, keyword_end, "s")) {
+            statement(STATEMENT_SMOOTHING_GROUP);
+        } else if(keyword_is(keyword, keyword_end, "newmtl")) {
+            statement(STATEMENT_NEWMTL);
+        } else if(keyword_is(keyword, keyword_end, "usemtl")) {
+            statement(STATEMENT_USEMTL);
+        } else if(keyword_is(keyword, keyword_end, "mtllib")) {
+            statement(STATEMENT_MTLLIB);
+        } else if(keyword_is(keyword, keyword_end, "Ns")) {
+            statement(STATEMENT_NS);
+        } else if(keyword_is(keyword, keyword_end, "Ka")) {
+            statement(STATEMENT_KA);
+        } else if(keyword_is(keyword, keyword_end, "Kd")) {
+            statement(STATEMENT_KD);
+        } else if(keyword_is(keyword, keyword_end, "Ks")) {
+            statement(STATEMENT_KS);
+        } else if(keyword_is(keyword, keyword_end, "map_Kd")) {
+            statement(STATEMENT_MAP_KD);
+        }
 
-            if(first_vn > -1) {
-                vertex_data->normal(normals[first_vn]);
-            }
-            vertex_data->diffuse(kglt::Colour::WHITE);
-            vertex_data->move_next();
-
-            /*
-             * This loop looks weird because it builds a triangle fan
-             * from the face indexes, as there could be more than 3. It goes
-             * (0, 2, 1), (0, 3, 2) etc.
-             */
-            for(uint32_t i = 1; i < parts.size(); i++) {
-                int32_t v1, vt1, vn1;
-                int32_t v2, vt2, vn2;
-
-                parse_face(parts[i-1], v1, vt1, vn1);
-                parse_face(parts[i], v2, vt2, vn2);
-
-                vertex_data->position(vertices[v1]); //Read the position
-                if(vt1 > -1) {
-                    vertex_data->tex_coord0(tex_coords[vt1]);
-                }
+        line = (line_end < chunk.end) ? line_end + 1 : chunk.end;
+    }
+}
 
-                if(vn1 > -1) {
-                    vertex_data->normal(normals[vn1]);
-                }
+/* Splits the buffer into roughly count pieces, each ending at the end of a line */
+std::vector<Chunk> split_into_chunks(const char* begin, const char* end, uint32_t count) {
+    std::vector<Chunk> chunks(std::max<uint32_t>(1, count));
 
-                vertex_data->move_next();
+    const std::size_t size = end - begin;
+    const char* cursor = begin;
 
-                vertex_data->position(vertices[v2]); //Read the position
-                if(vt2 > -1) {
-                    vertex_data->tex_coord0(tex_coords[vt2]);
-                }
-                if(vn2 > -1) {
-                    vertex_data->normal(normals[vn2]);
-                }
-                vertex_data->diffuse(kglt::Colour::WHITE);
-                vertex_data->move_next();
+    for(uint32_t i = 0; i < chunks.size(); ++i) {
+        chunks[i].begin = cursor;
 
-                //Add the triangle
-                index_data->index(first_index);
-                index_data->index(vertex_data->count() - 2);
-                index_data->index(vertex_data->count() - 1);
-            }
-        } else if(parts[0] == "newmtl") {
-            auto material_name = parts[1];
-
-            // Clone the default material
-            materials[material_name] = mesh->resource_manager().material(mesh->resource_manager().clone_default_material());
-            materials[material_name]->first_pass()->set_cull_mode(CULL_MODE_NONE);
-            current_material = material_name;
-
-            has_materials = true;
-        } else if(parts[0] == "usemtl") {
-            current_material = parts[1];
-        } else if(parts[0] == "mtllib") {
-            /*
-             * If we find a mtllib command, we load the material file and insert its
-             * lines into this position. This makes it so it's like the materials are embedded
-             * in the current file which makes parsing the same as if they were!
-             */
-
-             // We need to re-get the filename because mtllib paths may have spaces and the existing 'parts'
-             // variable would have split it to pieces.
-             auto filename = line.split(" ", 1, false).back();
-             filename = kfs::path::join(kfs::path::dir_name(filename_.encode()), filename.encode());
-
-             try {
-                filename = this->locator->locate_file(filename);
-                auto material_lines = this->locator->read_file_lines(filename);
-                lines.insert(lines.begin() + l + 1, material_lines.begin(), material_lines.end());
-             } catch(ResourceMissingError& e) {
-                 L_DEBUG(_F("mtllib {0} not found. Skipping.").format(filename));
-             }
-        } else if(parts[0] == "Ns") {
-            auto mat = materials.at(current_material);
-            mat->pass(0)->set_shininess(parts[1].to_float());
-        } else if(parts[0] == "Ka") {
-            auto mat = materials.at(current_material);
-
-            float r = parts[1].to_float();
-            float g = parts[2].to_float();
-            float b = parts[3].to_float();
-
-            mat->pass(0)->set_ambient(kglt::Colour(r, g, b, 1.0));
-        } else if(parts[0] == "Kd") {
-            auto mat = materials.at(current_material);
-
-            float r = parts[1].to_float();
-            float g = parts[2].to_float();
-            float b = parts[3].to_float();
-
-            mat->pass(0)->set_diffuse(kglt::Colour(r, g, b, 1.0));
-        } else if(parts[0] == "Ks") {
-            auto mat = materials.at(current_material);
-
-            float r = parts[1].to_float();
-            float g = parts[2].to_float();
-            float b = parts[3].to_float();
-
-            mat->pass(0)->set_specular(kglt::Colour(r, g, b, 1.0));
-        } else if(parts[0] == "Ni") {
-
-        } else if(parts[0] == "d") {
-            // Dissolved == Transparency... apparently
-        } else if(parts[0] == "illum") {
-
-        } else if(parts[0] == "map_Kd") {
-            auto texture_name = parts[1];
-            auto mat = materials.at(current_material);
-            auto texture_file = kfs::path::join(kfs::path::dir_name(filename_.encode()), texture_name.encode());
-            if(kfs::path::exists(texture_file)) {
-                auto tex_id = mesh->resource_manager().new_texture_from_file(texture_file);
-                mat->set_texture_unit_on_all_passes(0, tex_id);
-            } else {
-                L_WARN(_F("Unable to locate texture {0}").format(texture_file));
+        if(i == chunks.size() - 1) {
+            cursor = end;
+        } else {
+            cursor = std::max(cursor, begin + (size * (i + 1)) / chunks.size());
+            const char* newline = (const char*) memchr(cursor, '\n', end - cursor);
+            cursor = (newline) ? newline + 1 : end;
+        }
+
+        chunks[i].end = cursor;
+    }
+
+    return chunks;
+}
+
+struct VertexKey {
+    int32_t v;
+    int32_t vt;
+    int32_t vn;
+
+    /* When normals are generated, corners are only shared within a smoothing group (or within
+     * a face, outside of one) so that the normals come out the same as they're drawn. Zero for
+     * corners with their own normal */
+    uint64_t group = 0;
+
+    bool operator==(const VertexKey& rhs) const {
+        return v == rhs.v && vt == rhs.vt && vn == rhs.vn && group == rhs.group;
+    }
+};
+
+struct VertexKeyHash {
+    std::size_t operator()(const VertexKey& key) const {
+        uint64_t hash = uint32_t(key.v);
+        hash = (hash * 0x9E3779B97F4A7C15ull) ^ uint32_t(key.vt);
+        hash = (hash * 0x9E3779B97F4A7C15ull) ^ uint32_t(key.vn);
+        hash = (hash * 0x9E3779B97F4A7C15ull) ^ key.group;
+        return std::size_t(hash ^ (hash >> 29));
+    }
+};
+
+Colour parse_colour(const Statement& statement) {
+    float rgb[3];
+    parse_components(statement.begin, statement.end, rgb, 3, "colour");
+    return Colour(rgb[0], rgb[1], rgb[2], 1.0);
+}
+
+/* Builds the mesh from the parsed chunks, everything here has to happen in file order */
+class OBJBuilder {
+public:
+    OBJBuilder(Mesh* mesh, const unicode& filename, ResourceLocator* locator):
+        mesh_(mesh),
+        filename_(filename),
+        locator_(locator) {}
+
+    void add_chunks(std::vector<Chunk>& chunks) {
+        for(auto& chunk: chunks) {
+            uint32_t position_offset = positions_.size();
+            uint32_t tex_coord_offset = tex_coords_.size();
+            uint32_t normal_offset = normals_.size();
+
+            positions_.insert(positions_.end(), chunk.positions.begin(), chunk.positions.end());
+            tex_coords_.insert(tex_coords_.end(), chunk.tex_coords.begin(), chunk.tex_coords.end());
+            normals_.insert(normals_.end(), chunk.normals.begin(), chunk.normals.end());
+
+            for(auto& statement: chunk.statements) {
+                handle(chunk, statement, position_offset, tex_coord_offset, normal_offset);
             }
         }
     }
 
+    void finish(JobSystem& jobs);
+
+private:
+    Mesh* mesh_;
+    unicode filename_;
+    ResourceLocator* locator_;
+
+    std::vector<Vec3> positions_;
+    std::vector<Vec2> tex_coords_;
+    std::vector<Vec3> normals_;
+
+    std::unordered_map<VertexKey, Index, VertexKeyHash> vertex_lookup_;
+    std::vector<VertexKey> vertices_;
+
+    uint32_t smoothing_group_ = 0; // 0 is "s off"
+    uint32_t face_count_ = 0;
+
+    std::unordered_map<std::string, MaterialPtr> materials_;
+    std::set<std::string> missing_materials_;
+    std::string current_material_;
+    bool has_materials_ = false;
+
+    SubMesh* submesh_ = nullptr;
+    std::unordered_map<SubMesh*, std::vector<Index>> indices_;
+
+    void handle(Chunk& chunk, const Statement& statement, uint32_t position_offset, uint32_t tex_coord_offset, uint32_t normal_offset);
+    void add_face(const Chunk& chunk, const Statement& statement, uint32_t position_count, uint32_t tex_coord_count, uint32_t normal_count);
+    void select_submesh();
+    void load_material_library(const std::string& name);
+
+    MaterialPtr current_material() {
+        auto it = materials_.find(current_material_);
+        if(it == materials_.end()) {
+            throw std::runtime_error(_F("Material properties given outside of a material in {0}").format(filename_));
+        }
+        return it->second;
+    }
+};
+
+void OBJBuilder::handle(Chunk& chunk, const Statement& statement, uint32_t position_offset, uint32_t tex_coord_offset, uint32_t normal_offset) {
+    std::string arguments(statement.begin, statement.end);
+
+    switch(statement.type) {
+    case STATEMENT_FACE:
+        add_face(
+            chunk, statement,
+            position_offset + statement.positions,
+            tex_coord_offset + statement.tex_coords,
+            normal_offset + statement.normals
+        );
+    break;
+    case STATEMENT_NEWMTL: {
+        // Clone the default material
+        auto& resources = mesh_->resource_manager();
+        auto material = resources.material(resources.clone_default_material());
+        material->first_pass()->set_cull_mode(CULL_MODE_NONE);
+
+        materials_[arguments] = material;
+        current_material_ = arguments;
+        has_materials_ = true;
+    } break;
+    case STATEMENT_USEMTL:
+        current_material_ = arguments;
+    break;
+    case STATEMENT_SMOOTHING_GROUP: {
+        const char* cursor = statement.begin;
+        int32_t group = 0;
+        if(!parse_int(cursor, statement.end, group) || group < 0) {
+            group = 0; // "s off"
+        }
+        smoothing_group_ = uint32_t(group);
+    } break;
+    case STATEMENT_MTLLIB:
+        load_material_library(arguments);
+    break;
+    case STATEMENT_NS: {
+        float shininess = 0.0f;
+        parse_components(statement.begin, statement.end, &shininess, 1, "shininess");
+        current_material()->pass(0)->set_shininess(shininess);
+    } break;
+    case STATEMENT_KA:
+        current_material()->pass(0)->set_ambient(parse_colour(statement));
+    break;
+    case STATEMENT_KD:
+        current_material()->pass(0)->set_diffuse(parse_colour(statement));
+    break;
+    case STATEMENT_KS:
+        current_material()->pass(0)->set_specular(parse_colour(statement));
+    break;
+    case STATEMENT_MAP_KD: {
+        auto material = current_material();
+        auto texture_file = kfs::path::join(kfs::path::dir_name(filename_.encode()), arguments);
+        if(kfs::path::exists(texture_file)) {
+            auto tex_id = mesh_->resource_manager().new_texture_from_file(texture_file);
+            material->set_texture_unit_on_all_passes(0, tex_id);
+        } else {
+            L_WARN(_F("Unable to locate texture {0}").format(texture_file));
+        }
+    } break;
+    }
+}
+
+void OBJBuilder::load_material_library(const std::string& name) {
+    // Material libraries are small, so they're just parsed in one go as if they were part of this file
+    unicode filename = kfs::path::join(kfs::path::dir_name(filename_.encode()), name);
+
+    std::string text;
+    try {
+        filename = locator_->locate_file(filename);
+        text = locator_->read_file(filename)->str();
+    } catch(ResourceMissingError& e) {
+        L_DEBUG(_F("mtllib {0} not found. Skipping.").format(filename));
+        return;
+    }
+
+    Chunk chunk;
+    chunk.begin = text.c_str();
+    chunk.end = text.c_str() + text.length();
+    parse_chunk(chunk);
+
+    for(auto& statement: chunk.statements) {
+        if(statement.type != STATEMENT_FACE) {
+            handle(chunk, statement, 0, 0, 0);
+        }
+    }
+}
+
+void OBJBuilder::select_submesh() {
+    std::string name;
 
-    if(normals.empty()) {
-        mesh->each([&](const std::string& name, SubMesh* submesh) {
-            VertexData* vertex_data = submesh->vertex_data.get();
-            IndexData* index_data = submesh->index_data.get();
+    if(current_material_.empty()) {
+        name = "default";
+        if(!mesh_->has_submesh(name)) {
+            mesh_->new_submesh(name);
+        }
+    } else if(materials_.count(current_material_)) {
+        name = current_material_;
+        if(!mesh_->has_submesh(name)) {
+            mesh_->new_submesh_with_material(name, materials_.at(name)->id());
+        }
+    } else {
+        if(!missing_materials_.count(current_material_)) {
+            L_WARN(_F("Ignoring non-existant material ({0}) while loading {1}").format(current_material_, filename_));
+            missing_materials_.insert(current_material_);
+        }
 
-            // The mesh didn't have any normals, let's generate some!
-            std::unordered_map<int, kglt::Vec3> index_to_normal;
+        if(submesh_) {
+            return; // Just stick with the current submesh, don't change it
+        }
+
+        name = "default";
+        if(!mesh_->has_submesh(name)) {
+            mesh_->new_submesh(name);
+        }
+    }
+
+    submesh_ = mesh_->submesh(name);
+}
+
+void OBJBuilder::add_face(const Chunk& chunk, const Statement& statement, uint32_t position_count, uint32_t tex_coord_count, uint32_t normal_count) {
+    select_submesh();
+
+    if(statement.corner_count < 3) {
+        return;
+    }
 
-            // Go through all the triangles, add the face normal to all the vertices
-            for(uint16_t i = 0; i < index_data->count(); i+=3) {
-                uint16_t idx1 = index_data->at(i);
-                uint16_t idx2 = index_data->at(i+1);
-                uint16_t idx3 = index_data->at(i+2);
+    auto& indices = indices_[submesh_];
 
-                kglt::Vec3 v1, v2, v3;
-                v1 = vertex_data->position_at<Vec3>(idx1);
-                v2 = vertex_data->position_at<Vec3>(idx2);
-                v3 = vertex_data->position_at<Vec3>(idx3);
+    /* Faces are numbered below 2^32 and smoothing groups above it, so the two never collide */
+    const uint64_t face_group = (smoothing_group_) ? (uint64_t(smoothing_group_) << 32) : ++face_count_;
+
+    Index first = 0, previous = 0;
+    for(uint32_t i = 0; i < statement.corner_count; ++i) {
+        const Corner& corner = chunk.corners[statement.first_corner + i];
+
+        VertexKey key;
+        key.v = resolve_index(corner.v, position_count, "vertex");
+        key.vt = resolve_index(corner.vt, tex_coord_count, "texture coordinate");
+        key.vn = resolve_index(corner.vn, normal_count, "normal");
+        key.group = (key.vn < 0) ? face_group : 0;
+
+        if(key.v < 0) {
+            throw std::runtime_error("Face is missing a vertex index");
+        }
+
+        auto it = vertex_lookup_.find(key);
+        if(it == vertex_lookup_.end()) {
+            it = vertex_lookup_.insert(std::make_pair(key, Index(vertices_.size()))).first;
+            vertices_.push_back(key);
+        }
+
+        Index index = it->second;
+
+        // Faces with more than 3 corners are turned into a fan around the first
+        if(i == 0) {
+            first = index;
+        } else if(i >= 2) {
+            indices.push_back(first);
+            indices.push_back(previous);
+            indices.push_back(index);
+        }
+
+        previous = index;
+    }
+}
+
+void OBJBuilder::finish(JobSystem& jobs) {
+    VertexData* vertex_data = mesh_->shared_data.get();
+    vertex_data->resize(vertices_.size());
+
+    uint8_t* data = vertex_data->data();
+    const uint32_t stride = vertex_data->stride();
+    const uint32_t position_offset = vertex_data->position_offset();
+    const uint32_t tex_coord_offset = vertex_data->texcoord0_offset();
+    const uint32_t normal_offset = vertex_data->normal_offset();
+    const uint32_t diffuse_offset = vertex_data->diffuse_offset();
+
+    const Colour white = Colour::WHITE;
+
+    jobs.parallel_for(0, vertices_.size(), [&](uint32_t i) {
+        const VertexKey& key = vertices_[i];
+        uint8_t* vertex = data + (i * stride);
+
+        memcpy(vertex + position_offset, &positions_[key.v], sizeof(Vec3));
+
+        if(key.vt > -1) {
+            memcpy(vertex + tex_coord_offset, &tex_coords_[key.vt], sizeof(Vec2));
+        }
+
+        if(key.vn > -1) {
+            memcpy(vertex + normal_offset, &normals_[key.vn], sizeof(Vec3));
+        }
+
+        memcpy(vertex + diffuse_offset, &white, sizeof(Colour));
+    }, 4096);
+
+    if(normals_.empty()) {
+        /* The mesh didn't have any normals, add the face normal of every triangle to its vertices.
+         * Vertices are only shared within a face or smoothing group, so "s off" comes out flat */
+        std::vector<Vec3> vertex_normals(vertices_.size());
+
+        for(auto& p: indices_) {
+            auto& indices = p.second;
+            for(uint32_t i = 0; i + 2 < indices.size(); i += 3) {
+                const Vec3& v1 = positions_[vertices_[indices[i]].v];
+                const Vec3& v2 = positions_[vertices_[indices[i + 1]].v];
+                const Vec3& v3 = positions_[vertices_[indices[i + 2]].v];
 
                 kglt::Vec3 normal = (v2 - v1).normalized().cross((v3 - v1).normalized()).normalized();
 
-                index_to_normal[idx1] += normal;
-                index_to_normal[idx2] += normal;
-                index_to_normal[idx3] += normal;
+                vertex_normals[indices[i]] += normal;
+                vertex_normals[indices[i + 1]] += normal;
+                vertex_normals[indices[i + 2]] += normal;
             }
+        }
 
-            // Now set the normal on the vertex data
-            for(auto p: index_to_normal) {
-                vertex_data->move_to(p.first);
-                vertex_data->normal(p.second.normalized());
-            }
-        });
+        jobs.parallel_for(0, vertices_.size(), [&](uint32_t i) {
+            Vec3 normal = vertex_normals[i].normalized();
+            memcpy(data + (i * stride) + normal_offset, &normal, sizeof(Vec3));
+        }, 4096);
     }
 
-    if(!has_materials) {
+    if(!has_materials_ && submesh_) {
         //If the OBJ file has no materials, have a look around for textures in the same directory
 
         auto parts = kfs::path::split_ext(filename_.encode());
@@ -346,21 +673,181 @@ void OBJLoader::into(Loadable &resource, const LoaderOptions &options) {
         for(const unicode& p: possible_diffuse_maps) {
             if(kfs::path::exists(p.encode())) {
                 //Create a material from it and apply it to the submesh
-                MaterialID mat = mesh->resource_manager().new_material_from_texture(
-                    mesh->resource_manager().new_texture_from_file(p.encode())
+                MaterialID mat = mesh_->resource_manager().new_material_from_texture(
+                    mesh_->resource_manager().new_texture_from_file(p.encode())
                 );
 
-                sm->set_material_id(mat);
+                submesh_->set_material_id(mat);
                 break;
             }
         }
     }
 
-    mesh->shared_data->done();
-    mesh->each([](const std::string&, SubMesh* submesh) {
+    vertex_data->done();
+
+    for(auto& p: indices_) {
+        IndexData* index_data = p.first->index_data.get();
+        index_data->resize(p.second.size());
+        if(!p.second.empty()) {
+            memcpy(index_data->_raw_data(), &p.second[0], p.second.size() * sizeof(Index));
+        }
+    }
+
+    mesh_->each([](const std::string&, SubMesh* submesh) {
         submesh->index_data->done();
     });
 }
 
+}
+
+bool parse_float(const char*& cursor, const char* end, float& out) {
+    const char* start = cursor;
+
+    bool negative = false;
+    if(cursor < end && (*cursor == '-' || *cursor == '+')) {
+        negative = (*cursor == '-');
+        ++cursor;
+    }
+
+    // Up to 19 significant digits fit in the mantissa, which is far more than a float needs
+    uint64_t mantissa = 0;
+    uint32_t digits = 0;
+    int32_t exponent = 0;
+    bool found_digits = false;
+    bool fraction = false;
+
+    while(cursor < end) {
+        char c = *cursor;
+
+        if(c == '.' && !fraction) {
+            fraction = true;
+        } else if(is_digit(c)) {
+            found_digits = true;
+
+            if(mantissa || c != '0') {
+                if(digits < 19) {
+                    mantissa = (mantissa * 10) + (c - '0');
+                    ++digits;
+                    exponent -= (fraction) ? 1 : 0;
+                } else if(!fraction) {
+                    ++exponent;
+                }
+            } else if(fraction) {
+                --exponent;
+            }
+        } else {
+            break;
+        }
+
+        ++cursor;
+    }
+
+    if(found_digits && cursor < end && (*cursor == 'e' || *cursor == 'E')) {
+        const char* exponent_start = cursor++;
+
+        int32_t value = 0;
+        if(parse_int(cursor, end, value)) {
+            exponent += value;
+        } else {
+            cursor = exponent_start;
+        }
+    }
+
+    if(!found_digits || (cursor < end && !is_space(*cursor))) {
+        // Something unusual like "nan", "inf" or hex, let the standard library have a go
+        cursor = start;
+        while(cursor < end && !is_space(*cursor)) {
+            ++cursor;
+        }
+
+        std::string token(start, cursor);
+        char* parsed_end = nullptr;
+        out = std::strtof(token.c_str(), &parsed_end);
+        return !token.empty() && parsed_end == token.c_str() + token.length();
+    }
+
+    double value = double(mantissa);
+    if(exponent < 0 && exponent >= -22) {
+        value /= POWERS_OF_TEN[-exponent];
+    } else if(exponent > 0 && exponent <= 22) {
+        value *= POWERS_OF_TEN[exponent];
+    } else if(exponent) {
+        value *= std::pow(10.0, double(exponent));
+    }
+
+    out = float((negative) ? -value : value);
+    return true;
+}
+
+void OBJLoader::into(Loadable &resource, const LoaderOptions &options) {
+    Mesh* mesh = loadable_to<Mesh>(resource);
+    JobSystem& jobs = mesh->resource_manager().window->jobs;
+
+    bool parallel = true;
+    if(options.count("parallel")) {
+        parallel = kglt::any_cast<bool>(options.at("parallel"));
+    }
+
+    /*
+     * The text is parsed where it lies. If the file is on disk it's mapped and the copy the
+     * locator made is thrown away, otherwise that copy is used
+     */
+    std::unique_ptr<MappedFile> mapped;
+    std::string text;
+
+    if(kfs::path::exists(filename_.encode())) {
+        mapped.reset(new MappedFile(filename_.encode()));
+    } else {
+        text = data_->str();
+    }
+    data_->str(std::string());
+
+    const char* begin = (mapped) ? (const char*) mapped->data() : text.c_str();
+    const char* end = begin + ((mapped) ? mapped->size() : text.length());
+
+    uint32_t chunk_count = 1;
+    if(parallel) {
+        chunk_count = std::min<std::size_t>(
+            (jobs.worker_count() + 1) * 4,
+            std::max<std::size_t>(1, (end - begin) / MIN_PARALLEL_CHUNK_SIZE)
+        );
+    }
+
+    // Vertex data and face indices are read from each chunk in parallel
+    std::vector<Chunk> chunks = split_into_chunks(begin, end, chunk_count);
+    jobs.parallel_for(0, chunks.size(), [&chunks](uint32_t i) {
+        // Exceptions don't make it out of a job, so pass them back by hand
+        try {
+            parse_chunk(chunks[i]);
+        } catch(std::exception& e) {
+            chunks[i].error = e.what();
+        }
+    }, 1);
+
+    for(auto& chunk: chunks) {
+        if(!chunk.error.empty()) {
+            throw std::runtime_error(_F("Error parsing {0}: {1}").format(filename_, chunk.error));
+        }
+    }
+
+    VertexSpecification spec;
+    spec.position_attribute = VERTEX_ATTRIBUTE_3F;
+    spec.texcoord0_attribute = VERTEX_ATTRIBUTE_2F;
+    spec.normal_attribute = VERTEX_ATTRIBUTE_3F;
+    spec.diffuse_attribute = VERTEX_ATTRIBUTE_4F;
+    mesh->reset(spec);
+
+    // Then materials and faces are applied in file order, sharing identical vertices
+    // Loaders requested by name aren't given a locator
+    ResourceLocator* locator = this->locator.get();
+    if(!locator) {
+        locator = mesh->resource_manager().window->resource_locator.get();
+    }
+
+    OBJBuilder builder(mesh, filename_, locator);
+    builder.add_chunks(chunks);
+    builder.finish(jobs);
+}
+
 }
 }
@@ -6,6 +6,13 @@
 namespace kglt {
 namespace loaders {
 
+/*
+ * Loads Wavefront OBJ meshes. The file is tokenized where it lies (memory mapped where possible)
+ * rather than being copied into strings, and faces share a vertex wherever they use the same
+ * position, texture coordinate and normal. Large files are split into line-aligned chunks
+ * which are parsed in parallel, pass {"parallel", false} as an option to parse on the calling
+ * thread only.
+ */
 class OBJLoader : public Loader {
 public:
     OBJLoader(const unicode& filename, std::shared_ptr<std::stringstream> data):
@@ -16,6 +23,12 @@ public:
 
 void parse_face(const unicode& input, int32_t& vertex_index, int32_t& tex_index, int32_t& normal_index);
 
+/*
+ * Parses a float starting at cursor, which is left after the last character used. Returns
+ * false if the text up to the next whitespace isn't a number.
+ */
+bool parse_float(const char*& cursor, const char* end, float& out);
+
 class OBJLoaderType : public LoaderType {
 public:
     OBJLoaderType() {
@@ -3,61 +3,43 @@
 #include "../types.h"
 #include "../extra/tiled/TmxParser/Tmx.h"
 #include "../resource_manager.h"
+#include "../stage.h"
 
 namespace kglt {
 namespace loaders {
 
-struct TilesetInfo {
-    uint32_t total_width;
-    uint32_t total_height;
+const uint32_t DEFAULT_CHUNK_SIZE = 32;
 
-    uint32_t tile_width;
-    uint32_t tile_height;
+std::array<Vec2, 4> TiledTileset::texcoords(uint32_t tile_id) const {
+    uint32_t x_offset = tile_id % num_tiles_wide();
+    uint32_t y_offset = tile_id / num_tiles_wide();
 
-    uint32_t spacing;
-    uint32_t margin;
+    float x0 = x_offset * (tile_width + spacing) + margin;
+    float y0 = total_height - y_offset * (tile_height + spacing) - margin;
 
-    uint32_t num_tiles_wide() const {
-        return (total_width - (margin * 2) + spacing) / (tile_width + spacing);
-    }
-
-    uint32_t num_tiles_high() const {
-        return (total_height - (margin * 2) + spacing) / (tile_height + spacing);
-    }
-};
-
-void TiledLoader::into(Loadable &resource, const LoaderOptions &options) {
-    Loadable* res_ptr = &resource;
-    Mesh* mesh = dynamic_cast<Mesh*>(res_ptr);
-
-    if(!mesh) {
-        throw std::runtime_error("Tried to load a TMX file into something that wasn't a mesh");
-    }
-
-    Tmx::Map map;
-
-    map.ParseFile(this->filename_.encode());
-
-    unicode layer_name = kglt::any_cast<unicode>(options.at("layer"));
-    float tile_render_size = kglt::any_cast<float>(options.at("render_size"));
-
-    auto layers = map.GetLayers();
-    auto it = std::find_if(layers.begin(), layers.end(), [=](Tmx::Layer* layer) { return layer->GetName() == layer_name.encode(); });
-
-    if(it == layers.end()) {
-        throw std::runtime_error(_u("Unable to find the layer with name: {0}").format(layer_name).encode());
-    }
-
-    Tmx::Layer* layer = (*it);
+    float x1 = x0 + tile_width;
+    float y1 = y0 - tile_height;
 
-    auto parent_dir = kfs::path::abs_path(kfs::path::dir_name(filename_.encode()));
+    // Inset by half a texel so neighbouring tiles don't bleed in
+    float tx0 = x0 / total_width + (0.5 / total_width);
+    float ty0 = y0 / total_height - (0.5 / total_height);
+    float tx1 = x1 / total_width - (0.5 / total_width);
+    float ty1 = y1 / total_height + (0.5 / total_height);
 
-    std::map<int32_t, TilesetInfo> tileset_info;
+    return {{
+        region.map(tx0, ty1),
+        region.map(tx1, ty1),
+        region.map(tx1, ty0),
+        region.map(tx0, ty0)
+    }};
+}
 
-    std::map<int32_t, MaterialID> tileset_materials;
+std::vector<TiledTileset> load_tiled_tilesets(ResourceManager& resources, const Tmx::Map& map, const unicode& map_filename) {
+    auto parent_dir = kfs::path::abs_path(kfs::path::dir_name(map_filename.encode()));
 
+    std::vector<TiledTileset> tilesets(map.GetNumTilesets());
+    std::vector<unicode> paths;
 
-    //Load all of the tilesets from the map
     for(int32_t i = 0; i < map.GetNumTilesets(); ++i) {
         const Tmx::Tileset* tileset = map.GetTileset(i);
         const Tmx::Image* image = tileset->GetImage();
@@ -66,85 +48,192 @@ void TiledLoader::into(Loadable &resource, const LoaderOptions &options) {
         auto final_path = kfs::path::join(parent_dir, rel_path);
         L_DEBUG(_F("Loading tileset from: {0}").format(final_path));
 
-        TextureID tid = mesh->resource_manager().new_texture_from_file(
-            final_path,
-            TextureFlags(MIPMAP_GENERATE_NONE, TEXTURE_WRAP_CLAMP_TO_EDGE, TEXTURE_FILTER_NEAREST)
-        );
-
-        tileset_materials[i] = mesh->resource_manager().new_material_from_texture(tid);
+        paths.push_back(final_path);
 
-        TilesetInfo& info = tileset_info[i];
+        TiledTileset& info = tilesets[i];
+        info.first_gid = tileset->GetFirstGid();
         info.margin = tileset->GetMargin();
         info.spacing = tileset->GetSpacing();
         info.tile_height = tileset->GetTileHeight();
         info.tile_width = tileset->GetTileWidth();
         info.total_height = image->GetHeight();
         info.total_width = image->GetWidth();
+
+        for(auto tile: tileset->GetTiles()) {
+            for(auto& frame: tile->GetFrames()) {
+                info.animations[tile->GetId()].push_back(std::make_pair(frame.tileId, frame.duration));
+            }
+        }
+    }
+
+    /* Pack the tilesets into the atlas so that tiles from different tilesets (and any
+     * sprites packed alongside them) can share a material */
+    auto regions = resources.new_atlas_regions_from_files(paths);
+    for(uint32_t i = 0; i < regions.size(); ++i) {
+        tilesets[i].region = regions[i];
     }
 
-    //Store useful information on the mesh
+    return tilesets;
+}
+
+namespace {
+
+/* Stores the layer's dimensions on the mesh, for code which needs to map between tiles and positions */
+void stash_layer_info(Mesh* mesh, const Tmx::Map& map, const Tmx::Layer* layer, float tile_render_size) {
     mesh->data->stash(layer->GetHeight(), "TILED_LAYER_HEIGHT");
     mesh->data->stash(layer->GetWidth(), "TILED_LAYER_WIDTH");
     mesh->data->stash(map.GetTileWidth(), "TILED_MAP_TILE_WIDTH");
     mesh->data->stash(map.GetTileHeight(), "TILED_MAP_TILE_HEIGHT");
     mesh->data->stash(tile_render_size, "TILED_TILE_RENDER_SIZE");
+}
 
-    /*
-      Now go through the layer and build up a tile submesh for each grid square. Originally I chunked these
-      tiles into groups for nicer culling but this is the wrong place for that. If rendering a lot of submeshes
-      is inefficient then that needs to be tackled in the partitioner.
-    */
+/*
+ * Adds a submesh to the mesh for each tileset used by the chunk whose top left tile is
+ * (chunk_x, chunk_y). Returns false if there weren't any tiles in the chunk.
+ */
+bool build_chunk(Mesh* mesh, const Tmx::Layer* layer, const std::vector<TiledTileset>& tilesets,
+    float tile_render_size, int32_t chunk_x, int32_t chunk_y, int32_t chunk_size) {
+
+    const int32_t width = layer->GetWidth();
+    const int32_t height = layer->GetHeight();
+    const float half = 0.5f * tile_render_size;
+
+    std::map<int32_t, SubMesh*> submeshes;
 
-    for(int32_t y = 0; y < layer->GetHeight(); ++y) {
-        for(int32_t x = 0; x < layer->GetWidth(); ++x) {
+    for(int32_t y = chunk_y; y < std::min<int32_t>(chunk_y + chunk_size, height); ++y) {
+        for(int32_t x = chunk_x; x < std::min<int32_t>(chunk_x + chunk_size, width); ++x) {
             int32_t tileset_index = layer->GetTileTilesetIndex(x, y);
             if(tileset_index < 0) {
                 continue;
             }
 
-            TilesetInfo& tileset = tileset_info[tileset_index];
+            const TiledTileset& tileset = tilesets.at(tileset_index);
+
+            SubMesh*& submesh = submeshes[tileset_index];
+            if(!submesh) {
+                std::string name = layer->GetName() + " (" + std::to_string(chunk_x / chunk_size) + "," +
+                    std::to_string(chunk_y / chunk_size) + ") " + std::to_string(tileset_index);
+
+                submesh = mesh->new_submesh_with_material(
+                    name, tileset.region.material, MESH_ARRANGEMENT_TRIANGLES,
+                    VERTEX_SHARING_MODE_INDEPENDENT, VertexSpecification::DEFAULT
+                );
+            }
+
+            // The centre of the tile, the first row of the layer is at the top
+            Vec3 offset;
+            offset.x = (float(x) * tile_render_size) + half;
+            offset.y = (float(height - y) * tile_render_size) - half;
+
+            const Vec2 corners[] = {
+                Vec2(offset.x - half, offset.y - half),
+                Vec2(offset.x + half, offset.y - half),
+                Vec2(offset.x + half, offset.y + half),
+                Vec2(offset.x - half, offset.y + half)
+            };
+
+            auto texcoords = tileset.texcoords(layer->GetTileId(x, y));
+
+            auto& vertices = submesh->vertex_data;
+            Index first = vertices->count();
+
+            for(uint32_t i = 0; i < 4; ++i) {
+                vertices->position(corners[i].x, corners[i].y, 0);
+                vertices->diffuse(kglt::Colour::WHITE);
+                vertices->tex_coord0(texcoords[i]);
+                vertices->tex_coord1(texcoords[i]);
+                vertices->normal(0, 0, 1);
+                vertices->move_next();
+            }
 
-            int32_t tile_id = layer->GetTileId(x, y);
+            submesh->index_data->index(first);
+            submesh->index_data->index(first + 1);
+            submesh->index_data->index(first + 2);
 
-            int32_t num_tiles_wide = tileset.num_tiles_wide();
+            submesh->index_data->index(first);
+            submesh->index_data->index(first + 2);
+            submesh->index_data->index(first + 3);
+        }
+    }
 
-            int32_t x_offset = tile_id % num_tiles_wide;
-            int32_t y_offset = tile_id / num_tiles_wide;
+    for(auto& p: submeshes) {
+        p.second->vertex_data->done();
+        p.second->index_data->done();
+    }
 
-            float x0 = x_offset * (tileset.tile_width + tileset.spacing) + tileset.margin;
-            float y0 = tileset.total_height - y_offset * (tileset.tile_height + tileset.spacing) - tileset.margin;
+    return !submeshes.empty();
+}
 
-            float x1 = x0 + tileset.tile_width;
-            float y1 = y0 - tileset.tile_height;
+}
 
-            Vec3 offset;
-            offset.x = (float(x) * tile_render_size) + (0.5 * tile_render_size);
-            offset.y = (float(layer->GetHeight() - y) * tile_render_size) - (0.5 * tile_render_size);
+void TiledLoader::into(Loadable &resource, const LoaderOptions &options) {
+    Loadable* res_ptr = &resource;
+    Mesh* mesh = dynamic_cast<Mesh*>(res_ptr);
+    Stage* stage = dynamic_cast<Stage*>(res_ptr);
+
+    if(!mesh && !stage) {
+        throw std::runtime_error("Tried to load a TMX file into something that wasn't a mesh or a stage");
+    }
+
+    Tmx::Map map;
+
+    map.ParseFile(this->filename_.encode());
+
+    unicode layer_name = kglt::any_cast<unicode>(options.at("layer"));
+    float tile_render_size = kglt::any_cast<float>(options.at("render_size"));
+
+    uint32_t chunk_size = DEFAULT_CHUNK_SIZE;
+    if(options.count("chunk_size")) {
+        chunk_size = kglt::any_cast<uint32_t>(options.at("chunk_size"));
+    }
 
-            std::string name = layer->GetName() + " (" + std::to_string(offset.x) + "," + std::to_string(offset.y) + ")";
+    if(!chunk_size) {
+        throw std::logic_error("The chunk size of a tiled layer must be at least one tile");
+    }
 
-            //Create the submesh as a rectangle, the offset determines the location on the map
-            auto submesh = mesh->new_submesh_as_rectangle(name, tileset_materials.at(tileset_index), tile_render_size, tile_render_size, Vec3(offset.x, offset.y, 0));
+    auto layers = map.GetLayers();
+    auto it = std::find_if(layers.begin(), layers.end(), [=](Tmx::Layer* layer) { return layer->GetName() == layer_name.encode(); });
 
-            //Set texture coordinates appropriately for the tileset
-            float tx0 = x0 / tileset.total_width + (0.5 / tileset.total_width);
-            float ty0 = y0 / tileset.total_height - (0.5 / tileset.total_height);
-            float tx1 = x1 / tileset.total_width - (0.5 / tileset.total_width);
-            float ty1 = y1 / tileset.total_height + (0.5 / tileset.total_height);
+    if(it == layers.end()) {
+        throw std::runtime_error(_u("Unable to find the layer with name: {0}").format(layer_name).encode());
+    }
+
+    Tmx::Layer* layer = (*it);
 
-            submesh->vertex_data->move_to(0);
-            submesh->vertex_data->tex_coord0(kglt::Vec2(tx0, ty1));
+    ResourceManager& resources = (mesh) ? mesh->resource_manager() : *stage->assets.get();
+    std::vector<TiledTileset> tilesets = load_tiled_tilesets(resources, map, filename_);
 
-            submesh->vertex_data->move_next();
-            submesh->vertex_data->tex_coord0(kglt::Vec2(tx1, ty1));
+    const int32_t width = layer->GetWidth();
+    const int32_t height = layer->GetHeight();
 
-            submesh->vertex_data->move_next();
-            submesh->vertex_data->tex_coord0(kglt::Vec2(tx1, ty0));
+    if(mesh) {
+        // Everything goes into the one mesh, so the layer is culled as a whole
+        stash_layer_info(mesh, map, layer, tile_render_size);
 
-            submesh->vertex_data->move_next();
-            submesh->vertex_data->tex_coord0(kglt::Vec2(tx0, ty0));
+        for(int32_t chunk_y = 0; chunk_y < height; chunk_y += chunk_size) {
+            for(int32_t chunk_x = 0; chunk_x < width; chunk_x += chunk_size) {
+                build_chunk(mesh, layer, tilesets, tile_render_size, chunk_x, chunk_y, chunk_size);
+            }
+        }
+
+        return;
+    }
+
+    /*
+      Each chunk gets its own mesh and actor, so the partitioner has a bounding box per chunk and
+      can cull most of a large map. Chunks without any tiles don't get an actor at all.
+    */
+
+    for(int32_t chunk_y = 0; chunk_y < height; chunk_y += chunk_size) {
+        for(int32_t chunk_x = 0; chunk_x < width; chunk_x += chunk_size) {
+            MeshPtr chunk = stage->assets->mesh(stage->assets->new_mesh(VertexSpecification::DEFAULT));
+            stash_layer_info(chunk.get(), map, layer, tile_render_size);
+
+            if(build_chunk(chunk.get(), layer, tilesets, tile_render_size, chunk_x, chunk_y, chunk_size)) {
+                stage->new_actor_with_mesh(chunk->id());
+            }
 
-            submesh->vertex_data->done();
+            // The mesh of an empty chunk isn't used by anything, so it's garbage collected
         }
     }
 }
@@ -1,11 +1,69 @@
 #ifndef TILED_LOADER_H
 #define TILED_LOADER_H
 
+#include <array>
+#include <map>
+#include <vector>
+
 #include "../loader.h"
+#include "../texture_atlas.h"
+
+namespace Tmx {
+    class Map;
+}
 
 namespace kglt {
+
+class ResourceManager;
+
 namespace loaders {
 
+/* A tileset of a TMX map, and where its image ended up in the texture atlas */
+struct TiledTileset {
+    uint32_t first_gid = 1;
+
+    uint32_t total_width = 0;
+    uint32_t total_height = 0;
+
+    uint32_t tile_width = 0;
+    uint32_t tile_height = 0;
+
+    uint32_t spacing = 0;
+    uint32_t margin = 0;
+
+    AtlasRegion region;
+
+    /* The frames (tile id and duration in milliseconds) of each animated tile, by tile id */
+    std::map<uint32_t, std::vector<std::pair<uint32_t, uint32_t>>> animations;
+
+    uint32_t num_tiles_wide() const {
+        return (total_width - (margin * 2) + spacing) / (tile_width + spacing);
+    }
+
+    uint32_t num_tiles_high() const {
+        return (total_height - (margin * 2) + spacing) / (tile_height + spacing);
+    }
+
+    /* The atlas texture coordinates of the tile's corners, anti-clockwise from the bottom left */
+    std::array<Vec2, 4> texcoords(uint32_t tile_id) const;
+};
+
+/* Loads every tileset of the map into the texture atlas, relative paths are relative to the map */
+std::vector<TiledTileset> load_tiled_tilesets(ResourceManager& resources, const Tmx::Map& map, const unicode& map_filename);
+
+/*
+ * Loads a layer of a TMX map. The layer is divided into chunks of chunk_size x chunk_size tiles,
+ * and each chunk gets a submesh for each tileset it uses, so a layer is a few draws rather than
+ * one per tile.
+ *
+ * Loaded into a stage, each chunk gets its own mesh and actor so that the partitioner culls
+ * chunks individually. Loaded into a mesh, every chunk is a submesh of that one mesh, and the
+ * layer is only ever culled as a whole. For editing tiles at runtime, or animated tiles, use
+ * extra::TileMap instead.
+ *
+ * Options: "layer" (unicode), "render_size" (float) and optionally "chunk_size" (uint32_t)
+ */
+
 class TiledLoader : public Loader {
 public:
     TiledLoader(const unicode& filename, std::shared_ptr<std::stringstream> data):
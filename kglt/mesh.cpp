@@ -1,4 +1,5 @@
 #include <limits>
+#include <algorithm>
 
 #include "window_base.h"
 #include "resource_manager.h"
@@ -21,6 +22,26 @@ IndexData* SubMesh::get_index_data() const {
     return index_data_;
 }
 
+std::size_t SubMesh::cpu_memory_usage() const {
+    std::size_t bytes = index_data_->count() * sizeof(Index);
+    if(!uses_shared_data_) {
+        bytes += vertex_data_->data_size();
+    }
+    return bytes;
+}
+
+std::size_t SubMesh::gpu_memory_usage() const {
+#ifdef KGLT_GL_VERSION_2X
+    std::size_t bytes = vertex_array_object_->index_buffer_size();
+    if(!uses_shared_data_) {
+        bytes += vertex_array_object_->vertex_buffer_size();
+    }
+    return bytes;
+#else
+    return 0;
+#endif
+}
+
 Mesh::Mesh(
     MeshID id,
     ResourceManager *resource_manager,
@@ -38,6 +59,7 @@ Mesh::Mesh(
 
 void Mesh::reset(VertexSpecification vertex_specification) {
     submeshes_.clear();
+    _update_bounds();
     animation_type_ = MESH_ANIMATION_TYPE_NONE;
     animation_frames_ = 0;
 
@@ -62,10 +84,88 @@ void Mesh::each(std::function<void (const std::string&, SubMesh*)> func) const {
     }
 }
 
+std::size_t Mesh::cpu_memory_usage() const {
+    std::size_t bytes = shared_data_->data_size();
+    for(auto& pair: submeshes_) {
+        bytes += pair.second->cpu_memory_usage();
+    }
+    return bytes;
+}
+
+std::size_t Mesh::gpu_memory_usage() const {
+    std::size_t bytes = 0;
+#ifdef KGLT_GL_VERSION_2X
+    bytes += shared_data_buffer_object_->byte_size();
+#endif
+    for(auto& pair: submeshes_) {
+        bytes += pair.second->gpu_memory_usage();
+    }
+    return bytes;
+}
+
+void Mesh::add_lod(MeshID mesh, float threshold) {
+    auto lod = resource_manager().mesh(mesh);
+
+    if(!lod || lod.get() == this) {
+        throw std::logic_error("Invalid mesh passed as a LOD");
+    }
+
+    if(!lods_.empty()) {
+        float previous = lods_.back().threshold;
+
+        bool in_order = (lod_metric_ == LOD_METRIC_DISTANCE) ? threshold > previous : threshold < previous;
+        if(!in_order) {
+            throw std::logic_error("LOD thresholds must get coarser with each level");
+        }
+    }
+
+    lods_.push_back(MeshLOD{lod, threshold});
+}
+
+void Mesh::clear_lods() {
+    lods_.clear();
+}
+
+MeshPtr Mesh::lod_mesh(uint32_t level) {
+    if(!level) {
+        return shared_from_this();
+    }
+
+    return lods_.at(level - 1).mesh;
+}
+
+uint32_t Mesh::select_lod(float value, uint32_t current_level) const {
+    uint32_t level = 0;
+
+    for(uint32_t i = 1; i <= lods_.size(); ++i) {
+        const float threshold = lods_[i - 1].threshold;
+
+        /* The boundary moves away from whichever side we're currently on, so
+         * small changes around the threshold don't cause a switch */
+        const bool coarser_now = current_level >= i;
+
+        bool past = false;
+        if(lod_metric_ == LOD_METRIC_DISTANCE) {
+            past = value >= threshold * ((coarser_now) ? 1.0f - lod_hysteresis_ : 1.0f + lod_hysteresis_);
+        } else {
+            past = value <= threshold * ((coarser_now) ? 1.0f + lod_hysteresis_ : 1.0f - lod_hysteresis_);
+        }
+
+        if(!past) {
+            break;
+        }
+
+        level = i;
+    }
+
+    return level;
+}
+
 void Mesh::clear() {
     //Delete the submeshes and clear the shared data
     submeshes_.clear();
     shared_data->clear();
+    _update_bounds();
 }
 
 void Mesh::enable_animation(MeshAnimationType animation_type, uint32_t animation_frames) {
@@ -88,30 +188,78 @@ VertexData* Mesh::get_shared_data() const {
 }
 
 const AABB Mesh::aabb() const {
-    //FIXME: This should totally be cached for speed
+    std::lock_guard<std::mutex> lock(bounds_lock_);
+    return bounds_;
+}
+
+void Mesh::_update_bounds() {
     AABB result;
 
-    if(!this->submesh_count()) {
-        return result;
+    if(!submeshes_.empty()) {
+        float max = std::numeric_limits<float>::max();
+        float min = std::numeric_limits<float>::lowest();
+
+        result.min = kglt::Vec3(max, max, max);
+        result.max = kglt::Vec3(min, min, min);
+
+        for(auto& pair: submeshes_) {
+            const AABB& box = pair.second->bounds_;
+
+            if(box.min.x < result.min.x) result.min.x = box.min.x;
+            if(box.min.y < result.min.y) result.min.y = box.min.y;
+            if(box.min.z < result.min.z) result.min.z = box.min.z;
+
+            if(box.max.x > result.max.x) result.max.x = box.max.x;
+            if(box.max.y > result.max.y) result.max.y = box.max.y;
+            if(box.max.z > result.max.z) result.max.z = box.max.z;
+        }
     }
 
-    float max = std::numeric_limits<float>::max();
-    float min = std::numeric_limits<float>::min();
+    {
+        std::lock_guard<std::mutex> lock(bounds_lock_);
+        bounds_ = result;
+    }
 
-    result.min = kglt::Vec3(max, max, max);
-    result.max = kglt::Vec3(min, min, min);
+    signal_bounds_changed_(id());
+}
 
-    each([&result](const std::string& name, SubMesh* mesh) {
-        if(mesh->aabb().min.x < result.min.x) result.min.x = mesh->aabb().min.x;
-        if(mesh->aabb().min.y < result.min.y) result.min.y = mesh->aabb().min.y;
-        if(mesh->aabb().min.z < result.min.z) result.min.z = mesh->aabb().min.z;
+void Mesh::_merge_bounds(const AABB& box) {
+    {
+        std::lock_guard<std::mutex> lock(bounds_lock_);
 
-        if(mesh->aabb().max.x > result.max.x) result.max.x = mesh->aabb().max.x;
-        if(mesh->aabb().max.y > result.max.y) result.max.y = mesh->aabb().max.y;
-        if(mesh->aabb().max.z > result.max.z) result.max.z = mesh->aabb().max.z;
-    });
+        if(submeshes_.size() == 1) {
+            // The first submesh, the (empty) bounds so far mean nothing
+            bounds_ = box;
+        } else {
+            if(box.min.x < bounds_.min.x) bounds_.min.x = box.min.x;
+            if(box.min.y < bounds_.min.y) bounds_.min.y = box.min.y;
+            if(box.min.z < bounds_.min.z) bounds_.min.z = box.min.z;
+
+            if(box.max.x > bounds_.max.x) bounds_.max.x = box.max.x;
+            if(box.max.y > bounds_.max.y) bounds_.max.y = box.max.y;
+            if(box.max.z > bounds_.max.z) bounds_.max.z = box.max.z;
+        }
+    }
 
-    return result;
+    signal_bounds_changed_(id());
+}
+
+void Mesh::_submesh_bounds_changed(const AABB& old_box, const AABB& new_box) {
+    bool inside = false;
+    {
+        std::lock_guard<std::mutex> lock(bounds_lock_);
+
+        // If the old box didn't touch the bounds anywhere, losing it can't shrink them
+        inside = submeshes_.size() > 1 &&
+            old_box.min.x > bounds_.min.x && old_box.min.y > bounds_.min.y && old_box.min.z > bounds_.min.z &&
+            old_box.max.x < bounds_.max.x && old_box.max.y < bounds_.max.y && old_box.max.z < bounds_.max.z;
+    }
+
+    if(inside) {
+        _merge_bounds(new_box);
+    } else {
+        _update_bounds();
+    }
 }
 
 void Mesh::enable_debug(bool value) {
@@ -175,6 +323,8 @@ SubMesh* Mesh::new_submesh_with_material(
 
     auto new_submesh = SubMesh::create(this, name, material, arrangement, vertex_sharing, vertex_specification);
     submeshes_.insert(std::make_pair(name, new_submesh));
+    _merge_bounds(new_submesh->bounds_);
+
     signal_submesh_created_(id(), new_submesh.get());
     return new_submesh.get();
 }
@@ -448,6 +598,8 @@ void Mesh::delete_submesh(const std::string& name) {
     if(it != submeshes_.end()) {
         auto submesh = (*it).second;
         submeshes_.erase(it);
+        _update_bounds();
+
         signal_submesh_destroyed_(id(), submesh.get());
     } else {
 #ifndef NDEBUG
@@ -547,10 +699,41 @@ void Mesh::_update_buffer_object() {
             shared_data_buffer_object_->build(shared_data->data_size(), shared_data->data());
         }
         shared_data_dirty_ = false;
+    } else if(shared_data_dirty_end_ > shared_data_dirty_begin_) {
+        if(!is_animated()) {
+            const uint32_t stride = shared_data->stride();
+            shared_data_buffer_object_->modify(
+                shared_data_dirty_begin_ * stride,
+                (shared_data_dirty_end_ - shared_data_dirty_begin_) * stride,
+                shared_data->data() + (shared_data_dirty_begin_ * stride)
+            );
+        }
     }
+
+    // A full upload covers any range too
+    shared_data_dirty_begin_ = shared_data_dirty_end_ = 0;
 }
 #endif
 
+void Mesh::mark_shared_data_range_dirty(uint32_t first_vertex, uint32_t count) {
+    if(!count) {
+        return;
+    }
+
+    uint32_t end = first_vertex + count;
+    if(end > shared_data->count()) {
+        throw std::out_of_range("Tried to mark vertices beyond the end of the shared data");
+    }
+
+    if(shared_data_dirty_end_ > shared_data_dirty_begin_) {
+        shared_data_dirty_begin_ = std::min(shared_data_dirty_begin_, first_vertex);
+        shared_data_dirty_end_ = std::max(shared_data_dirty_end_, end);
+    } else {
+        shared_data_dirty_begin_ = first_vertex;
+        shared_data_dirty_end_ = end;
+    }
+}
+
 SubMesh* Mesh::submesh(const std::string& name) {
     auto it = submeshes_.find(name);
     if(it != submeshes_.end()) {
@@ -738,20 +921,27 @@ void SubMesh::reverse_winding() {
  *
  * Recalculate the bounds of the submesh. This involves interating over all of the
  * vertices that make up the submesh and so is potentially quite slow. This happens automatically
- * when vertex_data->done() or index_data->done() are called.
+ * when vertex_data->done() or index_data->done() are called, and the mesh's bounds are updated
+ * to match.
  */
 void SubMesh::_recalc_bounds() {
+    AABB old_bounds = bounds_;
+    _calculate_bounds();
+    parent_->_submesh_bounds_changed(old_bounds, bounds_);
+}
+
+void SubMesh::_calculate_bounds() {
     //Set the min bounds to the max
     kmVec3Fill(&bounds_.min, std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
     //Set the max bounds to the min
-    kmVec3Fill(&bounds_.max, -1000000, -1000000, -1000000);
+    kmVec3Fill(&bounds_.max, std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest());
 
     if(!index_data->count()) {
         kmAABB3Initialize(&bounds_, nullptr, 0, 0, 0);
         return;
     }
 
-    for(uint16_t idx: index_data->all()) {
+    for(Index idx: index_data->all()) {
         Vec3 pos = vertex_data->position_at<Vec3>(idx);
         if(pos.x < bounds_.min.x) bounds_.min.x = pos.x;
         if(pos.y < bounds_.min.y) bounds_.min.y = pos.y;
@@ -6,6 +6,7 @@
 #include <unordered_map>
 #include <set>
 #include <memory>
+#include <mutex>
 
 #include "deps/kazmath/kazmath.h"
 
@@ -118,6 +119,10 @@ public:
 
     const std::string& name() const { return name_; }
 
+    /* The size of the submesh's own buffers, shared vertices are counted by the mesh */
+    std::size_t cpu_memory_usage() const;
+    std::size_t gpu_memory_usage() const;
+
 public:
     typedef sig::signal<void (SubMesh*, MaterialID, MaterialID)> MaterialChangedCallback;
 
@@ -148,6 +153,7 @@ private:
     bool index_data_dirty_ = false;
 
     AABB bounds_;
+    void _calculate_bounds();
 
     sig::connection vrecalc_;
     sig::connection irecalc_;
@@ -162,6 +168,22 @@ enum MeshAnimationType {
 };
 
 
+enum LODMetric {
+    LOD_METRIC_SCREEN_SIZE, ///< Thresholds are the fraction of the viewport height covered by the bounds
+    LOD_METRIC_DISTANCE ///< Thresholds are distances from the camera
+};
+
+struct MeshLOD {
+    MeshPtr mesh;
+    float threshold;
+};
+
+/* Describes a LOD for ResourceManager to generate by simplifying a mesh */
+struct LODGenerationLevel {
+    float ratio; ///< The fraction of the original triangles to keep
+    float threshold; ///< Passed to Mesh::add_lod
+};
+
 typedef sig::signal<void (Mesh*, MeshAnimationType, uint32_t)> SignalAnimationEnabled;
 
 class Mesh :
@@ -232,34 +254,93 @@ public:
     void reverse_winding(); ///< Reverse the winding of all submeshes
     void set_texture_on_material(uint8_t unit, TextureID tex, uint8_t pass=0); ///< Replace the texture unit on all submesh materials
 
+    /* The bounds of all the submeshes, kept up to date as they change */
     const AABB aabb() const;
     void normalize(); //Scales the mesh so it has a radius of 1.0
     void transform_vertices(const kglt::Mat4& transform, bool include_submeshes=true);
 
     void each(std::function<void (const std::string&, SubMesh*)> func) const;
 
+    /*
+     * Rewriting the shared vertices in place and calling mark_shared_data_range_dirty(), rather
+     * than shared_data->done(), means only that range is uploaded to GL instead of every vertex.
+     * Ranges marked before the next upload are merged, and bounds aren't recalculated, so
+     * this is for changes like texture coordinates and colours rather than moving vertices.
+     */
+    void mark_shared_data_range_dirty(uint32_t first_vertex, uint32_t count);
+
     void enable_animation(MeshAnimationType animation_type, uint32_t animation_frames);
     bool is_animated() const { return animation_type_ != MESH_ANIMATION_TYPE_NONE; }
     uint32_t animation_frames() const { return animation_frames_; }
     MeshAnimationType animation_type() const { return animation_type_; }
 
+    /*
+     * Levels of detail. Level 0 is always this mesh, add_lod() appends progressively coarser
+     * meshes along with the threshold at which they take over: a distance (which must increase
+     * with each level) or a screen size (which must decrease). Submeshes in a LOD mesh replace
+     * the submesh with the same name in this one, and are drawn with this mesh's materials.
+     *
+     * To stop actors flickering between levels at a boundary, switching to a coarser level needs
+     * the threshold to be passed by the hysteresis fraction, as does switching back.
+     */
+    void add_lod(MeshID mesh, float threshold);
+    void clear_lods();
+
+    uint32_t lod_count() const { return lods_.size() + 1; }
+    MeshPtr lod_mesh(uint32_t level);
+    float lod_threshold(uint32_t level) const { return (level) ? lods_.at(level - 1).threshold : 0.0f; }
+
+    void set_lod_metric(LODMetric metric) { lod_metric_ = metric; }
+    LODMetric lod_metric() const { return lod_metric_; }
+
+    void set_lod_hysteresis(float fraction) { lod_hysteresis_ = fraction; }
+    float lod_hysteresis() const { return lod_hysteresis_; }
+
+    /* Returns the level to use for value (measured with lod_metric()) given the current level */
+    uint32_t select_lod(float value, uint32_t current_level) const;
+
+    /* The vertex and index data of the mesh and its submeshes, LOD meshes aren't included */
+    std::size_t cpu_memory_usage() const override;
+    std::size_t gpu_memory_usage() const override;
+
 public:
     // Signals
 
     typedef sig::signal<void (MeshID, SubMesh*)> SubMeshCreatedCallback;
     typedef sig::signal<void (MeshID, SubMesh*)> SubMeshDestroyedCallback;
     typedef sig::signal<void (MeshID, SubMesh*, MaterialID, MaterialID)> SubMeshMaterialChangedCallback;
+    typedef sig::signal<void (MeshID)> BoundsChangedCallback;
 
     SubMeshCreatedCallback& signal_submesh_created() { return signal_submesh_created_; }
     SubMeshDestroyedCallback& signal_submesh_destroyed() { return signal_submesh_destroyed_; }
     SubMeshMaterialChangedCallback& signal_submesh_material_changed() { return signal_submesh_material_changed_; }
 
+    /* Fired whenever aabb() changes, this may be from whichever thread is filling in the mesh */
+    BoundsChangedCallback& signal_bounds_changed() { return signal_bounds_changed_; }
+
 private:
     friend class SubMesh;
     VertexData* get_shared_data() const;
 
+    mutable std::mutex bounds_lock_;
+    AABB bounds_;
+
+    /* Rescans every submesh's bounds, needed when a submesh is removed or shrinks */
+    void _update_bounds();
+
+    /* Grows the bounds to take in a new submesh */
+    void _merge_bounds(const AABB& box);
+
+    /* Called when a submesh's bounds change from old_box to new_box. The bounds are only
+     * rescanned if the submesh may have been what defined them, otherwise the new box is merged */
+    void _submesh_bounds_changed(const AABB& old_box, const AABB& new_box);
+
     bool shared_data_dirty_ = false;
     VertexData* shared_data_ = nullptr;
+
+    // The range of shared vertices to upload when the whole buffer isn't dirty, empty if begin == end
+    uint32_t shared_data_dirty_begin_ = 0;
+    uint32_t shared_data_dirty_end_ = 0;
     MeshAnimationType animation_type_ = MESH_ANIMATION_TYPE_NONE;
     uint32_t animation_frames_ = 0;
 
@@ -270,11 +351,16 @@ private:
 
     std::unordered_map<std::string, std::shared_ptr<SubMesh>> submeshes_;
 
+    std::vector<MeshLOD> lods_;
+    LODMetric lod_metric_ = LOD_METRIC_SCREEN_SIZE;
+    float lod_hysteresis_ = 0.1f;
+
     SubMesh* normal_debug_mesh_ = nullptr;
 
     SubMeshCreatedCallback signal_submesh_created_;
     SubMeshDestroyedCallback signal_submesh_destroyed_;
     SubMeshMaterialChangedCallback signal_submesh_material_changed_;
+    BoundsChangedCallback signal_bounds_changed_;
 };
 
 }
@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <cmath>
 #include <functional>
 
 #include "types.h"
@@ -17,7 +18,11 @@ MoveableObject::MoveableObject(Stage *stage):
     rotation_locked_(false),
     position_locked_(false) {
 
-    update_from_parent();
+    transforms_ = (stage) ? stage->_transforms_as_shared_ptr() : std::make_shared<TransformStore>();
+    transform_index_ = transforms_->allocate(this);
+
+    signalled_position_ = transforms_->world_position(transform_index_);
+    signalled_rotation_ = transforms_->world_rotation(transform_index_);
 
     //When the parent changes, update the position/orientation
     parent_changed_connection_ = signal_parent_changed().connect(std::bind(&MoveableObject::parent_changed_callback, this, std::placeholders::_1, std::placeholders::_2));
@@ -25,6 +30,7 @@ MoveableObject::MoveableObject(Stage *stage):
 
 MoveableObject::~MoveableObject() {
     parent_changed_connection_.disconnect();
+    transforms_->release(transform_index_);
 }
 
 void MoveableObject::_update_constraint() {
@@ -75,29 +81,32 @@ void MoveableObject::disable_constraint() {
 void MoveableObject::parent_changed_callback(GenericTreeNode *old_parent, GenericTreeNode *new_parent) {
     MoveableObject* new_p = dynamic_cast<MoveableObject*>(new_parent);
 
-    if(!new_p) {
-        return;
+    // Anything else (e.g. the stage) is the origin, so the transform becomes a root
+    if(new_p && new_p->transforms_ == transforms_) {
+        transforms_->set_parent(transform_index_, new_p->transform_index_);
+    } else {
+        transforms_->set_parent(transform_index_, INVALID_TRANSFORM_INDEX);
     }
-
-    update_from_parent();
 }
 
 void MoveableObject::lock_rotation() {
     rotation_locked_ = true;
+    transforms_->set_rotation_locked(transform_index_, true);
 }
 
 void MoveableObject::unlock_rotation() {
     rotation_locked_ = false;
-    update_from_parent();
+    transforms_->set_rotation_locked(transform_index_, false);
 }
 
 void MoveableObject::lock_position() {
     position_locked_ = true;
+    transforms_->set_position_locked(transform_index_, true);
 }
 
 void MoveableObject::unlock_position() {
     position_locked_ = false;
-    update_from_parent();
+    transforms_->set_position_locked(transform_index_, false);
 }
 
 /**
@@ -124,10 +133,9 @@ void MoveableObject::set_absolute_position(float x, float y, float z) {
 }
 
 void MoveableObject::set_relative_position(float x, float y, float z) {
-    //Always store the relative_position_ even for responsive bodies
+    //Always store the relative position even for responsive bodies
     //as they only deal with absolute
-    relative_position_ = Vec3(x, y, z);
-    update_from_parent();
+    transforms_->set_local_position(transform_index_, Vec3(x, y, z));
 }
 
 void MoveableObject::set_absolute_rotation(const Quaternion& quat) {
@@ -150,9 +158,9 @@ void MoveableObject::set_absolute_rotation(const Quaternion& quat) {
 void MoveableObject::set_relative_rotation(const Quaternion &quaternion) {
     //Always store the relative rotation, even for responsive bodies
     //as they only deal with absolute
-    relative_rotation_ = quaternion;
-    relative_rotation_.normalize();
-    update_from_parent();
+    Quaternion rotation = quaternion;
+    rotation.normalize();
+    transforms_->set_local_rotation(transform_index_, rotation);
 }
 
 void MoveableObject::set_absolute_rotation(const Degrees &angle, float x, float y, float z) {
@@ -188,8 +196,6 @@ void MoveableObject::rotate_around(const kglt::Vec3& axis, const kglt::Degrees&
     kmQuaternionRotationAxisAngle(&rot, &axis, kmDegreesToRadians(amount));
 
     set_absolute_rotation(rot * absolute_rotation());
-    absolute_rotation_.normalize();
-    update_from_parent();
 }
 
 Quaternion MoveableObject::calc_look_at_rotation(const Vec3& target) {
@@ -207,48 +213,76 @@ void MoveableObject::look_at(const Vec3& position) {
     set_absolute_rotation(calc_look_at_rotation(position));
 }
 
+Vec3 MoveableObject::absolute_position() const {
+    return transforms_->world_position(transform_index_);
+}
+
+Quaternion MoveableObject::absolute_rotation() const {
+    return transforms_->world_rotation(transform_index_);
+}
+
+Vec3 MoveableObject::relative_position() const {
+    return transforms_->local_position(transform_index_);
+}
+
+Quaternion MoveableObject::relative_rotation() const {
+    return transforms_->local_rotation(transform_index_);
+}
+
 Mat4 MoveableObject::absolute_transformation() const {
-    Mat4 rot_matrix, trans_matrix, final;
+    return transforms_->world_matrix(transform_index_);
+}
 
-    Quaternion abs_rot = absolute_rotation();
+Mat4 MoveableObject::interpolated_transformation() const {
+    Stage* owner = stage.get();
+    if(!owner || !owner->transform_snapshot->is_populated()) {
+        // Not interpolating, so just use the resolved transform
+        return absolute_transformation();
+    }
 
-    kmMat4RotationQuaternion(&rot_matrix, &abs_rot);
-    kmMat4Translation(&trans_matrix, absolute_position().x, absolute_position().y, absolute_position().z);
+    Mat4 result;
+    float alpha = float(owner->window->fixed_step_interp() / owner->window->fixed_step());
+    if(owner->transform_snapshot->interpolated_transformation(this, alpha, result)) {
+        return result;
+    }
 
-    kmMat4Multiply(&final, &trans_matrix, &rot_matrix);
-    return final;
+    return absolute_transformation();
 }
 
-void MoveableObject::update_from_parent() {
-    Vec3 orig_pos = absolute_position();
-    Quaternion orig_rot = absolute_rotation();
+bool MoveableObject::_dispatch_transformation_changed(float distance_epsilon, const Degrees& angle_epsilon) {
+    Vec3 position = absolute_position();
+    Quaternion rotation = absolute_rotation();
 
-    if(!has_parent()) {
-        absolute_position_ = relative_position();
-        absolute_rotation_ = relative_rotation();
+    //Only signal that the transformation changed if it did. Compared against the last
+    //signalled transform, so slow movement still adds up
+    bool moved = false;
+    if(distance_epsilon > 0.0f) {
+        moved = (position - signalled_position_).length_squared() > distance_epsilon * distance_epsilon;
     } else {
-        if(!position_locked_) {
-            absolute_position_ = parent()->as<SceneNode>()->position() + relative_position();
-        }
-        if(!rotation_locked_) {
-            absolute_rotation_ = relative_rotation() * parent()->as<SceneNode>()->rotation();
-            absolute_rotation_.normalize();
-        }
+        moved = position != signalled_position_;
     }
 
-    //Only signal that the transformation changed if it did
-    if(orig_pos != absolute_position() || orig_rot != absolute_rotation()) {
-        transformation_changed();
-        signal_transformation_changed_(absolute_position(), absolute_rotation());
+    bool rotated = false;
+    if(angle_epsilon.value_ > 0.0f) {
+        // The angle between the two rotations, q and -q are the same rotation hence the fabs
+        float dot = std::min(1.0f, float(fabs(kmQuaternionDot(&rotation, &signalled_rotation_))));
+        rotated = to_degrees(Radians(2.0f * std::acos(dot))).value_ > angle_epsilon.value_;
+    } else {
+        rotated = rotation != signalled_rotation_;
+    }
+
+    bool changed = moved || rotated;
+
+    if(!changed) {
+        return false;
     }
 
-    assert(!isnan(absolute_position_.x));
-    assert(!isnan(absolute_position_.y));
-    assert(!isnan(absolute_position_.z));
+    signalled_position_ = position;
+    signalled_rotation_ = rotation;
 
-    apply_recursively([](GenericTreeNode* x) {
-        x->as<MoveableObject>()->update_from_parent();
-    }, false);
+    transformation_changed();
+    signal_transformation_changed_(position, rotation);
+    return true;
 }
 
 void MoveableObject::destroy_children() {
@@ -12,6 +12,8 @@
 #include "generic/data_carrier.h"
 #include "generic/visitor.h"
 #include "types.h"
+#include "transform_store.h"
+#include "transform_snapshot.h"
 
 #include "scene_node.h"
 #include "interfaces.h"
@@ -27,20 +29,6 @@ public:
         stage_(stage),
         uuid_(++object_counter) {
 
-        absolute_position_ = Vec3(0, 0, 0);
-        absolute_rotation_ = Quaternion(0, 0, 0, 1);
-        relative_position_ = Vec3(0, 0, 0);
-        relative_rotation_ = Quaternion(0, 0, 0, 1);
-    }
-
-    Object(Stage* stage, const Vec3& position, const Quaternion& rotation):
-        relative_position_(position),
-        relative_rotation_(rotation),
-        absolute_position_(position),
-        absolute_rotation_(rotation),
-        stage_(stage),
-        uuid_(++object_counter) {
-
     }
 
     virtual ~Object() {}
@@ -59,21 +47,10 @@ public:
     Quaternion rotation() const override { return absolute_rotation(); }
     // End Locateable Interface
 
-    virtual kglt::Vec3 absolute_position() const {
-        return absolute_position_;
-    }
-
-    virtual kglt::Quaternion absolute_rotation() const {
-        return absolute_rotation_;
-    }
-
-    virtual kglt::Quaternion relative_rotation() const {
-        return relative_rotation_;
-    }
-
-    virtual kglt::Vec3 relative_position() const {
-        return relative_position_;
-    }
+    virtual kglt::Vec3 absolute_position() const = 0;
+    virtual kglt::Quaternion absolute_rotation() const = 0;
+    virtual kglt::Quaternion relative_rotation() const = 0;
+    virtual kglt::Vec3 relative_position() const = 0;
 
     void pre_update(double step) override {
         pre_update_controllers(step);
@@ -102,13 +79,6 @@ public:
 
     Property<Object, generic::DataCarrier> data = { this, &Object::data_ };
 
-protected:
-    kglt::Vec3 relative_position_;
-    kglt::Quaternion relative_rotation_;
-
-    kglt::Vec3 absolute_position_;
-    kglt::Quaternion absolute_rotation_;
-
 private:
     Stage* stage_ = nullptr; //Each object is owned by a stage
 
@@ -145,6 +115,11 @@ public:
     virtual void set_absolute_position(float x, float y, float z);
     virtual void set_absolute_position(const kglt::Vec3& pos) { set_absolute_position(pos.x, pos.y, pos.z); }
 
+    kglt::Vec3 absolute_position() const override;
+    kglt::Quaternion absolute_rotation() const override;
+    kglt::Vec3 relative_position() const override;
+    kglt::Quaternion relative_rotation() const override;
+
     std::pair<Vec3, Vec3> constraint() const;
     bool is_constrained() const;
     void constrain_to(const Vec3& min, const Vec3& max);
@@ -242,8 +217,15 @@ public:
 
     void move_forward(float amount);
 
+    /* Returns the cached world matrix from the stage's transform store, it's only rebuilt
+     * after the object (or a parent) has moved */
     kglt::Mat4 absolute_transformation() const;
 
+    /* Returns the transformation to render this object with. This is absolute_transformation()
+     * unless the simulation is threaded, in which case it's interpolated from the stage's
+     * transform snapshot */
+    kglt::Mat4 interpolated_transformation() const;
+
     //Make this object ignore parent rotations or rotate commands until unlocked
     void lock_rotation();
     void unlock_rotation();
@@ -261,8 +243,14 @@ public:
     }
 
     void _update_constraint();
-protected:
-    void update_from_parent();
+
+    /* Fires signal_transformation_changed if the object has moved further than distance_epsilon,
+     * or rotated by more than angle_epsilon, since it was last fired, returning true if it did.
+     * The stage calls this once per frame for each object that changed, so many moves within a
+     * frame only produce a single signal */
+    bool _dispatch_transformation_changed(float distance_epsilon=0.0f, const Degrees& angle_epsilon=Degrees(0));
+
+    TransformIndex _transform_index() const { return transform_index_; }
 
 private:
     sig::connection parent_changed_connection_;
@@ -273,8 +261,25 @@ private:
     bool rotation_locked_;
     bool position_locked_;
 
+    // The transform itself lives in the stage's store, shared so it outlives the stage's members
+    TransformStore::ptr transforms_;
+    TransformIndex transform_index_ = INVALID_TRANSFORM_INDEX;
+
+    kglt::Vec3 signalled_position_;
+    kglt::Quaternion signalled_rotation_;
+
+    // The last two states captured by the stage's transform snapshot
+    friend class TransformSnapshot;
+    friend class TransformStore;
+    TransformState snapshot_previous_;
+    TransformState snapshot_current_;
+
     virtual void transformation_changed() {}
 
+    /* Called by the transform store whenever the world transform is marked dirty (including when
+     * a parent moves), unlike transformation_changed() this isn't held back by any threshold */
+    virtual void world_transform_dirtied() {}
+
     std::unique_ptr<std::pair<Vec3, Vec3>> constraint_;
 };
 
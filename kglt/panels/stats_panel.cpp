@@ -44,6 +44,20 @@ void StatsPanel::initialize() {
     ram_usage.append("<label>").id("ram");
     overlay->find("#ram").text("0");
 
+    auto add_resource_row = [&](const std::string& label, const std::string& id, const std::string& top) {
+        auto row = body.append("<row>");
+        row.css("top", top);
+        row.css("margin-left", "1em");
+        row.css("position", "absolute");
+        row.append("<label>").text(label);
+        row.append("<label>").id(id);
+        overlay->find("#" + id).text("0");
+    };
+
+    add_resource_row("Meshes: ", "meshes", "6em");
+    add_resource_row("Textures: ", "textures", "7.5em");
+    add_resource_row("Sounds: ", "sounds", "9em");
+
     window_->signal_frame_started().connect(std::bind(&StatsPanel::update, this));
 
     initialized_ = true;
@@ -85,6 +99,19 @@ void StatsPanel::update() {
             _u("{0} MB").format(mem_usage)
         );
 
+        auto resource_usage = [this](ResourceCategory category) -> unicode {
+            auto usage = window_->stats->resource_memory_usage(category);
+            return _u("{0} MB RAM, {1} MB GPU, {2} evicted").format(
+                usage.cpu_bytes / (1024 * 1024),
+                usage.gpu_bytes / (1024 * 1024),
+                window_->stats->resources_evicted(category)
+            );
+        };
+
+        overlay->find("#meshes").text(resource_usage(RESOURCE_CATEGORY_MESH));
+        overlay->find("#textures").text(resource_usage(RESOURCE_CATEGORY_TEXTURE));
+        overlay->find("#sounds").text(resource_usage(RESOURCE_CATEGORY_SOUND));
+
         last_update = 0.0f;
         first_update = false;
     }
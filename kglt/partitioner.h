@@ -68,9 +68,30 @@ public:
     StaticChunkChanged& signal_static_chunk_changed() { return signal_static_chunk_changed_; }
 
     virtual MeshID debug_mesh_id() { return MeshID(); }
+
+    /*
+     * Occlusion culling rasterizes occluders into a small software depth buffer and drops anything
+     * hidden behind them. Actors marked as occluders are used if there are any, otherwise the
+     * largest actors on screen are picked automatically. Partitioners which don't support it
+     * ignore these settings.
+     */
+    void set_occlusion_culling_enabled(bool value) { occlusion_culling_enabled_ = value; }
+    bool occlusion_culling_enabled() const { return occlusion_culling_enabled_; }
+
+    void add_occluder(ActorID actor_id) { occluders_.insert(actor_id); }
+    void remove_occluder(ActorID actor_id) { occluders_.erase(actor_id); }
+    bool is_occluder(ActorID actor_id) const { return occluders_.count(actor_id); }
+
+    void set_auto_occluder_count(uint32_t count) { auto_occluder_count_ = count; }
+    uint32_t auto_occluder_count() const { return auto_occluder_count_; }
+
 protected:
     Property<Partitioner, Stage> stage = { this, &Partitioner::stage_ };
 
+    bool occlusion_culling_enabled_ = false;
+    std::set<ActorID> occluders_;
+    uint32_t auto_occluder_count_ = 4;
+
     StaticChunkCreated signal_static_chunk_created_;
     StaticChunkDestroyed signal_static_chunk_destroyed_;
     StaticChunkChanged signal_static_chunk_changed_;
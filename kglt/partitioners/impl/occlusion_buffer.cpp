@@ -0,0 +1,326 @@
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "occlusion_buffer.h"
+#include "../../vertex_data.h"
+
+namespace kglt {
+
+namespace {
+    const float MIN_W = 0.00001f;
+
+    Vec4 transform_point(const Mat4& m, const Vec3& p) {
+        return Vec4(
+            m.mat[0] * p.x + m.mat[4] * p.y + m.mat[8] * p.z + m.mat[12],
+            m.mat[1] * p.x + m.mat[5] * p.y + m.mat[9] * p.z + m.mat[13],
+            m.mat[2] * p.x + m.mat[6] * p.y + m.mat[10] * p.z + m.mat[14],
+            m.mat[3] * p.x + m.mat[7] * p.y + m.mat[11] * p.z + m.mat[15]
+        );
+    }
+
+    bool in_front_of_near_plane(const Vec4& clip) {
+        return clip.w > MIN_W && clip.z >= -clip.w;
+    }
+
+    /* Clamps a pixel coordinate into [0, size) */
+    int32_t clamp_to(float value, uint32_t size) {
+        return (int32_t) std::max(0.0f, std::min(float(size - 1), value));
+    }
+
+    void aabb_corners(const AABB& aabb, Vec3* corners) {
+        for(uint32_t i = 0; i < 8; ++i) {
+            corners[i] = Vec3(
+                (i & 1) ? aabb.max.x : aabb.min.x,
+                (i & 2) ? aabb.max.y : aabb.min.y,
+                (i & 4) ? aabb.max.z : aabb.min.z
+            );
+        }
+    }
+
+    /* The coefficients of an edge function E(x, y) = a * x + b * y + c, which is positive on the
+     * inside of a counter-clockwise triangle */
+    struct Edge {
+        float a, b, c;
+
+        Edge(float x0, float y0, float x1, float y1):
+            a(y0 - y1),
+            b(x1 - x0),
+            c(-(a * x0) - (b * y0)) {}
+    };
+}
+
+OcclusionBuffer::OcclusionBuffer(uint32_t width, uint32_t height):
+    width_((std::max<uint32_t>(width, 4) + 3) & ~3u),
+    height_(std::max<uint32_t>(height, 1)) {
+
+    uint32_t level_width = width_;
+    uint32_t level_height = height_;
+
+    while(true) {
+        Level level;
+        level.width = level_width;
+        level.height = level_height;
+        level.depth.resize(level_width * level_height, 1.0f);
+        levels_.push_back(std::move(level));
+
+        if(level_width == 1 && level_height == 1) {
+            break;
+        }
+
+        level_width = (level_width + 1) / 2;
+        level_height = (level_height + 1) / 2;
+    }
+}
+
+void OcclusionBuffer::begin(const Mat4& view_projection) {
+    view_projection_ = view_projection;
+
+    for(auto& level: levels_) {
+        std::fill(level.depth.begin(), level.depth.end(), 1.0f);
+    }
+}
+
+void OcclusionBuffer::rasterize(const Mat4& model, const VertexData& vertices, const IndexData& indices) {
+    if(vertices.specification().position_attribute != VERTEX_ATTRIBUTE_3F) {
+        return;
+    }
+
+    Mat4 transform;
+    kmMat4Multiply(&transform, &view_projection_, &model);
+
+    std::vector<Vec4> clip(vertices.count());
+    for(uint32_t i = 0; i < vertices.count(); ++i) {
+        clip[i] = transform_point(transform, vertices.position_at<Vec3>(i));
+    }
+
+    auto& all = indices.all();
+    for(uint32_t i = 0; i + 2 < all.size(); i += 3) {
+        rasterize_clip_triangle(clip[all[i]], clip[all[i + 1]], clip[all[i + 2]]);
+    }
+}
+
+void OcclusionBuffer::rasterize_triangle(const Vec3& a, const Vec3& b, const Vec3& c) {
+    rasterize_clip_triangle(
+        transform_point(view_projection_, a),
+        transform_point(view_projection_, b),
+        transform_point(view_projection_, c)
+    );
+}
+
+void OcclusionBuffer::rasterize_clip_triangle(const Vec4& c0, const Vec4& c1, const Vec4& c2) {
+    /* We don't clip, triangles crossing the near plane are just dropped. That only ever means
+     * less gets culled, whereas writing depth in front of the near plane would hide things which
+     * are actually visible */
+    if(!in_front_of_near_plane(c0) || !in_front_of_near_plane(c1) || !in_front_of_near_plane(c2)) {
+        return;
+    }
+
+    float x[3], y[3], z[3];
+    const Vec4* clip[3] = {&c0, &c1, &c2};
+
+    for(uint32_t i = 0; i < 3; ++i) {
+        float inv_w = 1.0f / clip[i]->w;
+        x[i] = ((clip[i]->x * inv_w) * 0.5f + 0.5f) * width_;
+        y[i] = ((clip[i]->y * inv_w) * 0.5f + 0.5f) * height_;
+        z[i] = (clip[i]->z * inv_w) * 0.5f + 0.5f;
+    }
+
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+    if(std::fabs(area) < 0.000001f) {
+        return;
+    }
+
+    // Occluders are rasterized regardless of facing, so flip clockwise triangles
+    if(area < 0) {
+        std::swap(x[1], x[2]);
+        std::swap(y[1], y[2]);
+        std::swap(z[1], z[2]);
+        area = -area;
+    }
+
+    const float left = std::min(x[0], std::min(x[1], x[2]));
+    const float right = std::max(x[0], std::max(x[1], x[2]));
+    const float bottom = std::min(y[0], std::min(y[1], y[2]));
+    const float top = std::max(y[0], std::max(y[1], y[2]));
+
+    if(right < 0 || top < 0 || left >= width_ || bottom >= height_) {
+        return;
+    }
+
+    // Clamp before converting, vertices close to the camera can project a very long way off screen
+    const int32_t min_x = clamp_to(std::floor(left), width_);
+    const int32_t max_x = clamp_to(std::ceil(right), width_);
+    const int32_t min_y = clamp_to(std::floor(bottom), height_);
+    const int32_t max_y = clamp_to(std::ceil(top), height_);
+
+    Edge e01(x[0], y[0], x[1], y[1]);
+    Edge e12(x[1], y[1], x[2], y[2]);
+    Edge e20(x[2], y[2], x[0], y[0]);
+
+    // Depth is interpolated with the barycentric weights, each of which is an edge function over the area
+    const float inv_area = 1.0f / area;
+    const float za = (z[0] * e12.a + z[1] * e20.a + z[2] * e01.a) * inv_area;
+    const float zb = (z[0] * e12.b + z[1] * e20.b + z[2] * e01.b) * inv_area;
+    const float zc = (z[0] * e12.c + z[1] * e20.c + z[2] * e01.c) * inv_area;
+
+    auto& depth = levels_[0].depth;
+
+    // Start on a multiple of 4, the width is always a multiple of 4 so a block never overruns a row
+    const int32_t start_x = min_x & ~3;
+
+#ifdef __SSE2__
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 offsets = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    const __m128 e01a = _mm_set1_ps(e01.a), e12a = _mm_set1_ps(e12.a), e20a = _mm_set1_ps(e20.a);
+    const __m128 zav = _mm_set1_ps(za);
+
+    for(int32_t py = min_y; py <= max_y; ++py) {
+        const float cy = py + 0.5f;
+        const __m128 row01 = _mm_set1_ps(e01.b * cy + e01.c);
+        const __m128 row12 = _mm_set1_ps(e12.b * cy + e12.c);
+        const __m128 row20 = _mm_set1_ps(e20.b * cy + e20.c);
+        const __m128 rowz = _mm_set1_ps(zb * cy + zc);
+
+        float* row = &depth[py * width_];
+
+        for(int32_t px = start_x; px <= max_x; px += 4) {
+            const __m128 cx = _mm_add_ps(_mm_set1_ps(px + 0.5f), offsets);
+
+            __m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(e01a, cx), row01), zero);
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(e12a, cx), row12), zero));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(e20a, cx), row20), zero));
+
+            if(!_mm_movemask_ps(inside)) {
+                continue;
+            }
+
+            const __m128 z = _mm_add_ps(_mm_mul_ps(zav, cx), rowz);
+            const __m128 existing = _mm_loadu_ps(row + px);
+            const __m128 closer = _mm_and_ps(inside, _mm_cmplt_ps(z, existing));
+
+            _mm_storeu_ps(row + px, _mm_or_ps(_mm_and_ps(closer, z), _mm_andnot_ps(closer, existing)));
+        }
+    }
+#else
+    for(int32_t py = min_y; py <= max_y; ++py) {
+        const float cy = py + 0.5f;
+        float* row = &depth[py * width_];
+
+        for(int32_t px = start_x; px <= max_x; ++px) {
+            const float cx = px + 0.5f;
+
+            if(e01.a * cx + e01.b * cy + e01.c < 0 ||
+               e12.a * cx + e12.b * cy + e12.c < 0 ||
+               e20.a * cx + e20.b * cy + e20.c < 0) {
+                continue;
+            }
+
+            const float z = za * cx + zb * cy + zc;
+            if(z < row[px]) {
+                row[px] = z;
+            }
+        }
+    }
+#endif
+}
+
+void OcclusionBuffer::build_pyramid() {
+    for(uint32_t i = 1; i < levels_.size(); ++i) {
+        const Level& source = levels_[i - 1];
+        Level& target = levels_[i];
+
+        for(uint32_t y = 0; y < target.height; ++y) {
+            const uint32_t y0 = y * 2;
+            const uint32_t y1 = std::min(y0 + 1, source.height - 1);
+
+            for(uint32_t x = 0; x < target.width; ++x) {
+                const uint32_t x0 = x * 2;
+                const uint32_t x1 = std::min(x0 + 1, source.width - 1);
+
+                target.depth[(y * target.width) + x] = std::max(
+                    std::max(source.depth[(y0 * source.width) + x0], source.depth[(y0 * source.width) + x1]),
+                    std::max(source.depth[(y1 * source.width) + x0], source.depth[(y1 * source.width) + x1])
+                );
+            }
+        }
+    }
+}
+
+bool OcclusionBuffer::is_occluded(const AABB& aabb) const {
+    Vec3 corners[8];
+    aabb_corners(aabb, corners);
+    return is_occluded(corners, view_projection_);
+}
+
+bool OcclusionBuffer::is_occluded(const AABB& aabb, const Mat4& model) const {
+    Mat4 transform;
+    kmMat4Multiply(&transform, &view_projection_, &model);
+
+    Vec3 corners[8];
+    aabb_corners(aabb, corners);
+    return is_occluded(corners, transform);
+}
+
+bool OcclusionBuffer::is_occluded(const Vec3* corners, const Mat4& transform) const {
+    const float inf = std::numeric_limits<float>::max();
+
+    float min_x = inf, min_y = inf, min_z = inf;
+    float max_x = -inf, max_y = -inf;
+
+    for(uint32_t i = 0; i < 8; ++i) {
+        Vec4 clip = transform_point(transform, corners[i]);
+
+        if(!in_front_of_near_plane(clip)) {
+            // The box reaches the camera, assume it's visible
+            return false;
+        }
+
+        float inv_w = 1.0f / clip.w;
+        float x = ((clip.x * inv_w) * 0.5f + 0.5f) * width_;
+        float y = ((clip.y * inv_w) * 0.5f + 0.5f) * height_;
+        float z = (clip.z * inv_w) * 0.5f + 0.5f;
+
+        min_x = std::min(min_x, x);
+        max_x = std::max(max_x, x);
+        min_y = std::min(min_y, y);
+        max_y = std::max(max_y, y);
+        min_z = std::min(min_z, z);
+    }
+
+    if(max_x < 0 || max_y < 0 || min_x >= width_ || min_y >= height_) {
+        // Off screen, that's for the frustum test to deal with
+        return false;
+    }
+
+    const uint32_t x0 = clamp_to(std::floor(min_x), width_);
+    const uint32_t x1 = clamp_to(std::floor(max_x), width_);
+    const uint32_t y0 = clamp_to(std::floor(min_y), height_);
+    const uint32_t y1 = clamp_to(std::floor(max_y), height_);
+
+    // Pick the level where the box covers no more than a couple of texels in each direction
+    const uint32_t size = std::max(x1 - x0, y1 - y0) + 1;
+
+    uint32_t index = 0;
+    while(index + 1 < levels_.size() && (size >> index) > 2) {
+        ++index;
+    }
+
+    const Level& level = levels_[index];
+
+    for(uint32_t y = (y0 >> index); y <= (y1 >> index); ++y) {
+        for(uint32_t x = (x0 >> index); x <= (x1 >> index); ++x) {
+            if(min_z <= level.depth[(y * level.width) + x]) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+}
@@ -0,0 +1,75 @@
+#ifndef OCCLUSION_BUFFER_H
+#define OCCLUSION_BUFFER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "../../types.h"
+
+namespace kglt {
+
+class VertexData;
+class IndexData;
+
+/*
+ * A low resolution software depth buffer used for occlusion culling on the CPU.
+ *
+ * Occluder triangles are rasterized into the buffer (keeping the nearest depth per pixel), then
+ * build_pyramid() produces a hierarchical-Z pyramid where each texel holds the *farthest* depth of
+ * the four texels beneath it. A bounding box can then be tested against the single pyramid level
+ * where it covers roughly 2x2 texels: if its nearest point is behind everything stored there, it
+ * can't be seen.
+ *
+ * Every test errs on the side of visibility; triangles crossing the near plane aren't rasterized
+ * and boxes crossing it are never reported as occluded. Depth is window depth in [0, 1] where
+ * 1 is the far plane.
+ */
+class OcclusionBuffer {
+public:
+    /* The width is rounded up to a multiple of 4 so rows can be rasterized 4 pixels at a time */
+    OcclusionBuffer(uint32_t width=256, uint32_t height=128);
+
+    /* Clears the buffer ready for a new view */
+    void begin(const Mat4& view_projection);
+
+    /* Rasterizes an indexed triangle list, only 3 component positions are supported */
+    void rasterize(const Mat4& model, const VertexData& vertices, const IndexData& indices);
+    void rasterize_triangle(const Vec3& a, const Vec3& b, const Vec3& c);
+
+    void build_pyramid();
+
+    bool is_occluded(const AABB& aabb) const;
+
+    /* Tests the box aabb after transformation by model, so rotated boxes stay tight */
+    bool is_occluded(const AABB& aabb, const Mat4& model) const;
+
+    uint32_t width() const { return width_; }
+    uint32_t height() const { return height_; }
+    uint32_t level_count() const { return levels_.size(); }
+
+    float depth_at(uint32_t level, uint32_t x, uint32_t y) const {
+        return levels_[level].depth[(y * levels_[level].width) + x];
+    }
+
+private:
+    struct Level {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector<float> depth;
+    };
+
+    uint32_t width_;
+    uint32_t height_;
+
+    Mat4 view_projection_;
+
+    // levels_[0] is the full resolution buffer
+    std::vector<Level> levels_;
+
+    void rasterize_clip_triangle(const Vec4& c0, const Vec4& c1, const Vec4& c2);
+    bool is_occluded(const Vec3* corners, const Mat4& transform) const;
+};
+
+}
+
+#endif // OCCLUSION_BUFFER_H
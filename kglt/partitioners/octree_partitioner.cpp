@@ -6,6 +6,7 @@
 #include "../camera.h"
 #include "../particles.h"
 #include "../geom.h"
+#include "../window_base.h"
 
 namespace kglt {
 
@@ -200,22 +201,13 @@ std::vector<RenderablePtr> OctreePartitioner::geometry_visible_from(CameraID cam
     auto camera = stage->window->camera(camera_id);
     auto& frustum = camera->frustum();
 
+    std::vector<octree_impl::OctreeNode*> visible_nodes;
+
     octree_impl::traverse(
         tree_,
         [&](octree_impl::OctreeNode* node) -> bool {
             if(frustum.intersects_aabb(node->loose_aabb())) {
-                node->data->each_actor([&](ActorID actor_id, AABB aabb) {
-                    auto actor = stage->actor(actor_id);
-                    for(auto subactor: actor->_subactors()) {
-                        results.push_back(subactor);
-                    };
-                });
-
-                node->data->each_particle_system([&](ParticleSystemID ps_id, AABB aabb) {
-                    auto system = stage->particle_system(ps_id);
-                    results.push_back(system->shared_from_this());
-                });
-
+                visible_nodes.push_back(node);
                 return true;
             }
 
@@ -223,9 +215,129 @@ std::vector<RenderablePtr> OctreePartitioner::geometry_visible_from(CameraID cam
         }
     );
 
+    std::unique_ptr<OcclusionBuffer> occlusion;
+    if(occlusion_culling_enabled_) {
+        occlusion = acquire_occlusion_buffer();
+
+        Mat4 view_projection;
+        kmMat4Multiply(&view_projection, &camera->projection_matrix(), &camera->view_matrix());
+
+        occlusion->begin(view_projection);
+        rasterize_occluders(*occlusion, camera, visible_nodes);
+        occlusion->build_pyramid();
+    }
+
+    uint32_t nodes_occluded = 0;
+    uint32_t actors_occluded = 0;
+
+    for(auto node: visible_nodes) {
+        if(occlusion && occlusion->is_occluded(node->loose_aabb())) {
+            ++nodes_occluded;
+            continue;
+        }
+
+        node->data->each_actor([&](ActorID actor_id, AABB aabb) {
+            auto actor = stage->actor(actor_id);
+
+            // Test the actor's own box, the one stored in the node is only updated when it changes node
+            if(occlusion && occlusion->is_occluded(actor->aabb(), actor->absolute_transformation())) {
+                ++actors_occluded;
+                return;
+            }
+
+            for(auto subactor: actor->_subactors()) {
+                results.push_back(subactor);
+            };
+        });
+
+        node->data->each_particle_system([&](ParticleSystemID ps_id, AABB aabb) {
+            auto system = stage->particle_system(ps_id);
+            results.push_back(system->shared_from_this());
+        });
+    }
+
+    if(occlusion) {
+        stage->window->stats->add_occluded(nodes_occluded, actors_occluded);
+        release_occlusion_buffer(std::move(occlusion));
+    }
+
     return results;
 }
 
+std::unique_ptr<OcclusionBuffer> OctreePartitioner::acquire_occlusion_buffer() {
+    std::lock_guard<std::mutex> lock(occlusion_buffers_lock_);
+
+    if(free_occlusion_buffers_.empty()) {
+        return std::unique_ptr<OcclusionBuffer>(new OcclusionBuffer());
+    }
+
+    auto buffer = std::move(free_occlusion_buffers_.back());
+    free_occlusion_buffers_.pop_back();
+    return buffer;
+}
+
+void OctreePartitioner::release_occlusion_buffer(std::unique_ptr<OcclusionBuffer> buffer) {
+    std::lock_guard<std::mutex> lock(occlusion_buffers_lock_);
+    free_occlusion_buffers_.push_back(std::move(buffer));
+}
+
+void OctreePartitioner::rasterize_occluders(OcclusionBuffer& buffer, CameraPtr camera, const std::vector<octree_impl::OctreeNode*>& visible_nodes) {
+    std::vector<ActorID> occluders;
+
+    if(!occluders_.empty()) {
+        for(auto& actor_id: occluders_) {
+            if(stage->has_actor(actor_id)) {
+                occluders.push_back(actor_id);
+            }
+        }
+    } else if(auto_occluder_count_) {
+        /* Nothing was marked as an occluder, so use whatever is biggest on screen. Size over
+         * distance (squared) is a cheap stand-in for projected area */
+        const float MIN_SCORE = 0.01f;
+
+        auto& transform = camera->transform();
+        Vec3 eye(transform.mat[12], transform.mat[13], transform.mat[14]);
+
+        std::vector<std::pair<float, ActorID>> candidates;
+        for(auto node: visible_nodes) {
+            node->data->each_actor([&](ActorID actor_id, AABB aabb) {
+                float size = aabb.max_dimension();
+                float distance = std::max((aabb.centre() - eye).length_squared(), 0.0001f);
+                float score = (size * size) / distance;
+
+                if(score >= MIN_SCORE) {
+                    candidates.push_back(std::make_pair(score, actor_id));
+                }
+            });
+        }
+
+        uint32_t count = std::min<uint32_t>(auto_occluder_count_, candidates.size());
+        std::partial_sort(
+            candidates.begin(), candidates.begin() + count, candidates.end(),
+            [](const std::pair<float, ActorID>& lhs, const std::pair<float, ActorID>& rhs) {
+                return lhs.first > rhs.first;
+            }
+        );
+
+        for(uint32_t i = 0; i < count; ++i) {
+            occluders.push_back(candidates[i].second);
+        }
+    }
+
+    for(auto& actor_id: occluders) {
+        auto actor = stage->actor(actor_id);
+        auto transform = actor->absolute_transformation();
+
+        for(auto subactor: actor->_subactors()) {
+            if(subactor->arrangement() != MESH_ARRANGEMENT_TRIANGLES) {
+                continue;
+            }
+
+            buffer.rasterize(transform, *subactor->vertex_data.get(), *subactor->index_data.get());
+        }
+    }
+}
+
 std::vector<LightID> OctreePartitioner::lights_visible_from(CameraID camera_id) {
     std::vector<LightID> results(lights_always_visible_.begin(), lights_always_visible_.end());
 
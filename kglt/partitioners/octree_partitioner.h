@@ -7,6 +7,7 @@
 #include "../interfaces.h"
 #include "../mesh.h"
 #include "impl/octree.h"
+#include "impl/occlusion_buffer.h"
 
 namespace kglt {
 
@@ -47,6 +48,19 @@ public:
 private:
     octree_impl::Octree tree_;
 
+    /* Cameras can be culled concurrently, so each culling pass borrows its own buffer */
+    std::mutex occlusion_buffers_lock_;
+    std::vector<std::unique_ptr<OcclusionBuffer>> free_occlusion_buffers_;
+
+    std::unique_ptr<OcclusionBuffer> acquire_occlusion_buffer();
+    void release_occlusion_buffer(std::unique_ptr<OcclusionBuffer> buffer);
+
+    void rasterize_occluders(
+        OcclusionBuffer& buffer,
+        CameraPtr camera,
+        const std::vector<octree_impl::OctreeNode*>& visible_nodes
+    );
+
     std::map<ActorID, std::vector<BoundableEntity*> > actor_to_registered_subactors_;
 
     std::map<ActorID, sig::connection> actor_changed_connections_;
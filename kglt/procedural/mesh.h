@@ -7,5 +7,6 @@
 #include "mesh/circle.h"
 #include "mesh/capsule.h"
 #include "mesh/cylinder.h"
+#include "mesh/simplify.h"
 
 #endif // MESH_H_INCLUDED
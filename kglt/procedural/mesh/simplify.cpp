@@ -0,0 +1,455 @@
+#include <array>
+#include <queue>
+#include <cmath>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "simplify.h"
+
+namespace kglt {
+namespace procedural {
+namespace mesh {
+
+namespace {
+
+/* Open edges are weighted so heavily that collapsing across them is a last resort */
+const double BOUNDARY_WEIGHT = 1000.0;
+
+/* Texture seams are kept in shape too, but they can still be simplified along their length */
+const double SEAM_WEIGHT = 100.0;
+
+const Index NO_VERTEX = ~Index(0);
+
+struct Vector {
+    double x, y, z;
+
+    Vector(double x=0, double y=0, double z=0): x(x), y(y), z(z) {}
+    Vector(const Vec3& v): x(v.x), y(v.y), z(v.z) {}
+
+    Vector operator-(const Vector& rhs) const { return Vector(x - rhs.x, y - rhs.y, z - rhs.z); }
+    double dot(const Vector& rhs) const { return x * rhs.x + y * rhs.y + z * rhs.z; }
+
+    Vector cross(const Vector& rhs) const {
+        return Vector(y * rhs.z - z * rhs.y, z * rhs.x - x * rhs.z, x * rhs.y - y * rhs.x);
+    }
+
+    double length() const { return std::sqrt(dot(*this)); }
+};
+
+/* A symmetric 4x4 matrix, stored as its upper triangle */
+struct Quadric {
+    double a2 = 0, ab = 0, ac = 0, ad = 0;
+    double b2 = 0, bc = 0, bd = 0;
+    double c2 = 0, cd = 0;
+    double d2 = 0;
+
+    void add_plane(const Vector& normal, double d, double weight) {
+        const double a = normal.x, b = normal.y, c = normal.z;
+
+        a2 += weight * a * a; ab += weight * a * b; ac += weight * a * c; ad += weight * a * d;
+        b2 += weight * b * b; bc += weight * b * c; bd += weight * b * d;
+        c2 += weight * c * c; cd += weight * c * d;
+        d2 += weight * d * d;
+    }
+
+    Quadric operator+(const Quadric& rhs) const {
+        Quadric result = *this;
+        result += rhs;
+        return result;
+    }
+
+    Quadric& operator+=(const Quadric& rhs) {
+        a2 += rhs.a2; ab += rhs.ab; ac += rhs.ac; ad += rhs.ad;
+        b2 += rhs.b2; bc += rhs.bc; bd += rhs.bd;
+        c2 += rhs.c2; cd += rhs.cd;
+        d2 += rhs.d2;
+        return *this;
+    }
+
+    double error(const Vector& v) const {
+        return a2 * v.x * v.x + 2 * ab * v.x * v.y + 2 * ac * v.x * v.z + 2 * ad * v.x
+             + b2 * v.y * v.y + 2 * bc * v.y * v.z + 2 * bd * v.y
+             + c2 * v.z * v.z + 2 * cd * v.z
+             + d2;
+    }
+};
+
+struct Collapse {
+    double cost;
+    Index from;
+    Index to;
+    uint32_t from_version;
+    uint32_t to_version;
+
+    bool operator<(const Collapse& rhs) const {
+        // std::priority_queue is a max heap, we want the cheapest first
+        return cost > rhs.cost;
+    }
+};
+
+uint64_t edge_key(Index a, Index b) {
+    return (uint64_t(std::min(a, b)) << 32) | uint64_t(std::max(a, b));
+}
+
+void hash_combine(std::size_t& seed, float value) {
+    // Adding zero turns -0 into 0, they compare equal so they must hash the same
+    seed ^= std::hash<float>()(value + 0.0f) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+/* Vertices are welded on their exact position, and split again on their texture coordinates */
+struct WeldKey {
+    Index position;
+    float x, y, z;
+
+    bool operator==(const WeldKey& rhs) const {
+        return position == rhs.position && x == rhs.x && y == rhs.y && z == rhs.z;
+    }
+};
+
+struct WeldKeyHash {
+    std::size_t operator()(const WeldKey& key) const {
+        std::size_t seed = std::hash<Index>()(key.position);
+        hash_combine(seed, key.x);
+        hash_combine(seed, key.y);
+        hash_combine(seed, key.z);
+        return seed;
+    }
+};
+
+/* Gives each distinct key an id, in order of first appearance */
+Index weld(std::unordered_map<WeldKey, Index, WeldKeyHash>& ids, const WeldKey& key) {
+    return ids.insert(std::make_pair(key, Index(ids.size()))).first->second;
+}
+
+}
+
+std::vector<Index> simplify_triangles(const std::vector<Vec3>& positions, const std::vector<Index>& indices,
+    uint32_t target_triangle_count, const std::vector<Vec2>& texcoords) {
+
+    const uint32_t vertex_count = positions.size();
+    const bool has_texcoords = texcoords.size() == vertex_count;
+
+    /* Work on the positions rather than the vertices, so that vertices which were only split
+     * for their normals (or any other attribute) collapse together. Each vertex also gets a
+     * seam class, vertices at the same position with different texture coordinates are on a
+     * texture seam */
+    std::vector<Index> position_of(vertex_count);
+    std::vector<Index> seam_class_of(vertex_count);
+    std::vector<Vector> points;
+    {
+        std::unordered_map<WeldKey, Index, WeldKeyHash> position_ids, seam_ids;
+        for(Index i = 0; i < vertex_count; ++i) {
+            const Vec3& p = positions[i];
+            position_of[i] = weld(position_ids, WeldKey{0, p.x, p.y, p.z});
+
+            if(position_of[i] == points.size()) {
+                points.push_back(Vector(p));
+            }
+
+            Vec2 uv = (has_texcoords) ? texcoords[i] : Vec2();
+            seam_class_of[i] = weld(seam_ids, WeldKey{position_of[i], uv.x, uv.y, 0.0f});
+        }
+    }
+
+    const uint32_t point_count = points.size();
+
+    std::vector<std::array<Index, 3>> triangles;
+    triangles.reserve(indices.size() / 3);
+    for(uint32_t i = 0; i + 2 < indices.size(); i += 3) {
+        triangles.push_back({{indices[i], indices[i + 1], indices[i + 2]}});
+    }
+
+    std::vector<Quadric> quadrics(point_count);
+    std::vector<std::vector<uint32_t>> point_triangles(point_count);
+    std::vector<bool> alive(triangles.size(), true);
+
+    auto normal_of = [&](const std::array<Index, 3>& t) -> Vector {
+        const Vector& a = points[position_of[t[0]]];
+        return (points[position_of[t[1]]] - a).cross(points[position_of[t[2]]] - a);
+    };
+
+    /* The vertex a triangle uses at the position, or NO_VERTEX */
+    auto corner_at = [&](uint32_t triangle, Index point) -> Index {
+        for(auto v: triangles[triangle]) {
+            if(position_of[v] == point) {
+                return v;
+            }
+        }
+        return NO_VERTEX;
+    };
+
+    // Every position accumulates the planes of the triangles around it, weighted by area
+    std::unordered_map<uint64_t, std::vector<uint32_t>> edge_triangles;
+    for(uint32_t i = 0; i < triangles.size(); ++i) {
+        auto& t = triangles[i];
+
+        Vector normal = normal_of(t);
+        double length = normal.length();
+        if(length > 0) {
+            Vector n(normal.x / length, normal.y / length, normal.z / length);
+            double d = -n.dot(points[position_of[t[0]]]);
+
+            for(auto v: t) {
+                quadrics[position_of[v]].add_plane(n, d, length * 0.5);
+            }
+        }
+
+        for(uint32_t j = 0; j < 3; ++j) {
+            Index a = position_of[t[j]];
+            Index b = position_of[t[(j + 1) % 3]];
+
+            if(std::find(point_triangles[a].begin(), point_triangles[a].end(), i) == point_triangles[a].end()) {
+                point_triangles[a].push_back(i);
+            }
+
+            if(a != b) {
+                edge_triangles[edge_key(a, b)].push_back(i);
+            }
+        }
+    }
+
+    /* Open edges and texture seams get a plane perpendicular to each of their triangles, so
+     * moving a vertex off the outline (or off the seam) is expensive */
+    auto add_edge_planes = [&](Index a, Index b, uint32_t triangle, double weight) {
+        Vector edge = points[b] - points[a];
+        Vector perpendicular = edge.cross(normal_of(triangles[triangle]));
+        double length = perpendicular.length();
+        if(length <= 0) {
+            return;
+        }
+
+        Vector n(perpendicular.x / length, perpendicular.y / length, perpendicular.z / length);
+        double d = -n.dot(points[a]);
+
+        quadrics[a].add_plane(n, d, weight * edge.dot(edge));
+        quadrics[b].add_plane(n, d, weight * edge.dot(edge));
+    };
+
+    for(auto& p: edge_triangles) {
+        Index a = Index(p.first >> 32);
+        Index b = Index(p.first & 0xFFFFFFFF);
+
+        if(p.second.size() == 1) {
+            add_edge_planes(a, b, p.second[0], BOUNDARY_WEIGHT);
+            continue;
+        }
+
+        bool seam = false;
+        for(auto t: p.second) {
+            seam = seam ||
+                seam_class_of[corner_at(t, a)] != seam_class_of[corner_at(p.second[0], a)] ||
+                seam_class_of[corner_at(t, b)] != seam_class_of[corner_at(p.second[0], b)];
+        }
+
+        if(seam) {
+            for(auto t: p.second) {
+                add_edge_planes(a, b, t, SEAM_WEIGHT);
+            }
+        }
+    }
+
+    std::vector<bool> removed(point_count, false);
+    std::vector<uint32_t> versions(point_count, 0);
+    std::priority_queue<Collapse> heap;
+
+    // Both directions are queued, as one of them may be ruled out by a seam when it's reached
+    auto push_edge = [&](Index a, Index b) {
+        Quadric q = quadrics[a] + quadrics[b];
+        heap.push(Collapse{q.error(points[b]), a, b, versions[a], versions[b]});
+        heap.push(Collapse{q.error(points[a]), b, a, versions[b], versions[a]});
+    };
+
+    for(auto& p: edge_triangles) {
+        push_edge(Index(p.first >> 32), Index(p.first & 0xFFFFFFFF));
+    }
+
+    uint32_t live_triangles = triangles.size();
+
+    std::unordered_map<Index, Index> replacements;
+
+    while(live_triangles > target_triangle_count && !heap.empty()) {
+        Collapse collapse = heap.top();
+        heap.pop();
+
+        const Index from = collapse.from;
+        const Index to = collapse.to;
+
+        if(removed[from] || removed[to] || versions[from] != collapse.from_version || versions[to] != collapse.to_version) {
+            // Stale, one of the positions has changed since this was queued
+            continue;
+        }
+
+        /* The triangles along the edge say which vertex at to takes the place of each vertex at
+         * from. Vertices at from which aren't on the edge take one in the same seam class, if
+         * there isn't one the collapse would tear the seam open */
+        replacements.clear();
+        for(auto t: point_triangles[from]) {
+            Index target = (alive[t]) ? corner_at(t, to) : NO_VERTEX;
+            if(target != NO_VERTEX) {
+                replacements[corner_at(t, from)] = target;
+            }
+        }
+
+        if(replacements.empty()) {
+            continue;
+        }
+
+        auto replacement_for = [&](Index vertex) -> Index {
+            auto it = replacements.find(vertex);
+            if(it != replacements.end()) {
+                return it->second;
+            }
+
+            for(auto& p: replacements) {
+                if(seam_class_of[p.first] == seam_class_of[vertex]) {
+                    return p.second;
+                }
+            }
+
+            return NO_VERTEX;
+        };
+
+        // Moving from onto to mustn't tear a seam or turn any of the surrounding triangles over
+        bool allowed = true;
+        for(auto t: point_triangles[from]) {
+            if(!alive[t] || corner_at(t, to) != NO_VERTEX) {
+                continue; // This one disappears
+            }
+
+            auto triangle = triangles[t];
+            Vector before = normal_of(triangle);
+
+            for(auto& v: triangle) {
+                if(position_of[v] == from) {
+                    v = replacement_for(v);
+                    if(v == NO_VERTEX) {
+                        allowed = false;
+                        break;
+                    }
+                }
+            }
+
+            if(!allowed || before.dot(normal_of(triangle)) <= 0) {
+                allowed = false;
+                break;
+            }
+        }
+
+        if(!allowed) {
+            continue;
+        }
+
+        for(auto t: point_triangles[from]) {
+            if(!alive[t]) {
+                continue;
+            }
+
+            auto& triangle = triangles[t];
+            if(corner_at(t, to) != NO_VERTEX) {
+                alive[t] = false;
+                --live_triangles;
+            } else {
+                for(auto& v: triangle) {
+                    if(position_of[v] == from) {
+                        v = replacement_for(v);
+                    }
+                }
+                point_triangles[to].push_back(t);
+            }
+        }
+
+        quadrics[to] += quadrics[from];
+        removed[from] = true;
+        point_triangles[from].clear();
+        ++versions[to];
+
+        // Requeue every edge around the surviving position with its new cost
+        std::unordered_set<Index> neighbours;
+        for(auto t: point_triangles[to]) {
+            if(!alive[t]) {
+                continue;
+            }
+
+            for(auto v: triangles[t]) {
+                if(position_of[v] != to) {
+                    neighbours.insert(position_of[v]);
+                }
+            }
+        }
+
+        for(auto v: neighbours) {
+            push_edge(to, v);
+        }
+    }
+
+    std::vector<Index> result;
+    result.reserve(live_triangles * 3);
+    for(uint32_t i = 0; i < triangles.size(); ++i) {
+        if(alive[i]) {
+            result.insert(result.end(), triangles[i].begin(), triangles[i].end());
+        }
+    }
+
+    return result;
+}
+
+void simplify(MeshPtr source, MeshPtr target, float ratio) {
+    target->reset(source->shared_data->specification());
+
+    source->each([&](const std::string& name, SubMesh* submesh) {
+        VertexData* vertices = submesh->vertex_data.get();
+
+        SubMesh* output = target->new_submesh_with_material(
+            name,
+            submesh->material_id(),
+            submesh->arrangement(),
+            (submesh->uses_shared_vertices()) ? VERTEX_SHARING_MODE_SHARED : VERTEX_SHARING_MODE_INDEPENDENT,
+            vertices->specification()
+        );
+
+        std::vector<Index> indices = submesh->index_data->all();
+
+        bool can_simplify = submesh->arrangement() == MESH_ARRANGEMENT_TRIANGLES &&
+            vertices->specification().position_attribute == VERTEX_ATTRIBUTE_3F;
+
+        if(can_simplify) {
+            std::vector<Vec3> positions(vertices->count());
+            for(uint32_t i = 0; i < vertices->count(); ++i) {
+                positions[i] = vertices->position_at<Vec3>(i);
+            }
+
+            // Used to find the texture seams
+            std::vector<Vec2> texcoords;
+            if(vertices->specification().texcoord0_attribute == VERTEX_ATTRIBUTE_2F) {
+                texcoords.resize(vertices->count());
+                for(uint32_t i = 0; i < vertices->count(); ++i) {
+                    texcoords[i] = vertices->texcoord0_at<Vec2>(i);
+                }
+            }
+
+            uint32_t target_count = std::max<uint32_t>(1, uint32_t((indices.size() / 3) * ratio));
+            indices = simplify_triangles(positions, indices, target_count, texcoords);
+        }
+
+        // Only copy the vertices which are still used
+        std::unordered_map<Index, Index> old_to_new;
+        for(auto index: indices) {
+            auto it = old_to_new.find(index);
+            if(it == old_to_new.end()) {
+                it = old_to_new.insert(
+                    std::make_pair(index, vertices->copy_vertex_to_another(*output->vertex_data.get(), index))
+                ).first;
+            }
+
+            output->index_data->index(it->second);
+        }
+
+        output->vertex_data->done();
+        output->index_data->done();
+    });
+}
+
+}
+}
+}
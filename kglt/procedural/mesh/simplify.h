@@ -0,0 +1,43 @@
+#ifndef SIMPLIFY_H
+#define SIMPLIFY_H
+
+#include <vector>
+
+#include "kglt/mesh.h"
+
+namespace kglt {
+namespace procedural {
+namespace mesh {
+
+/*
+ * Reduces a triangle list to (at most) target_triangle_count triangles by repeatedly collapsing
+ * the edge with the lowest quadric error (Garland & Heckbert). Edges collapse onto one of their
+ * endpoints rather than an optimal position, so every vertex in the result is one of the
+ * originals and its other attributes (normals, texture coordinates) carry over untouched.
+ *
+ * Vertices are welded by position, so vertices which were only split for their normals collapse
+ * together. Where texcoords are given (one per vertex) and differ at a position, that's a texture
+ * seam: seams only collapse along their length and are weighted so they keep their shape. Open
+ * edges are weighted more heavily still so that outlines are kept. Collapses which would flip a
+ * triangle are skipped, so the target may not be reached for meshes which can't be simplified
+ * any further. Returns the new index list, which indexes into positions.
+ */
+std::vector<Index> simplify_triangles(
+    const std::vector<Vec3>& positions,
+    const std::vector<Index>& indices,
+    uint32_t target_triangle_count,
+    const std::vector<Vec2>& texcoords=std::vector<Vec2>()
+);
+
+/*
+ * Fills target with a simplified copy of source, keeping around ratio of the triangles of each
+ * triangle submesh. Submeshes keep their names and materials so target can be used as a LOD
+ * of source. Other submeshes are copied as they are.
+ */
+void simplify(MeshPtr source, MeshPtr target, float ratio);
+
+}
+}
+}
+
+#endif // SIMPLIFY_H
@@ -1,4 +1,6 @@
 #include <unordered_map>
+#include <chrono>
+#include <limits>
 
 #include "generic/algorithm.h"
 #include "render_sequence.h"
@@ -12,6 +14,7 @@
 #include "partitioner.h"
 #include "partitioners/octree_partitioner.h"
 #include "loader.h"
+#include "texture_streamer.h"
 
 namespace kglt {
 
@@ -191,14 +194,73 @@ void RenderSequence::set_renderer(Renderer* renderer) {
 }
 
 void RenderSequence::run() {
+    typedef std::chrono::high_resolution_clock Clock;
+
     targets_rendered_this_frame_.clear();
+    window->stats->reset_occluded();
 
     int actors_rendered = 0;
-    for(Pipeline::ptr pipeline: ordered_pipelines_) {
-        run_pipeline(pipeline, actors_rendered);
+    double visibility_ms = 0.0;
+    double draw_ms = 0.0;
+
+    auto elapsed_ms = [](Clock::time_point start) -> double {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    };
+
+    if(parallel_culling_enabled_) {
+        std::vector<Pipeline::ptr> active;
+        for(Pipeline::ptr pipeline: ordered_pipelines_) {
+            if(pipeline->is_active()) {
+                active.push_back(pipeline);
+            }
+        }
+
+        std::vector<PipelineVisibility> visibility(active.size());
+
+        auto start = Clock::now();
+
+        /* Camera constraints write to the cameras, so they must all be resolved before
+         * any culling starts. Frame IDs are handed out here so they stay in pipeline order */
+        for(uint32_t i = 0; i < active.size(); ++i) {
+            update_camera_constraint(active[i]->camera_id());
+            visibility[i].frame_id = generate_frame_id();
+        }
+
+        window->jobs->parallel_for(0, active.size(), [&](uint32_t i) {
+            compute_visibility(active[i], visibility[i]);
+        }, 1);
+
+        visibility_ms = elapsed_ms(start);
+        start = Clock::now();
+
+        for(uint32_t i = 0; i < active.size(); ++i) {
+            run_pipeline(active[i], visibility[i], actors_rendered);
+        }
+
+        draw_ms = elapsed_ms(start);
+    } else {
+        for(Pipeline::ptr pipeline: ordered_pipelines_) {
+            if(!pipeline->is_active()) {
+                continue;
+            }
+
+            PipelineVisibility visibility;
+            visibility.frame_id = generate_frame_id();
+
+            auto start = Clock::now();
+            update_camera_constraint(pipeline->camera_id());
+            compute_visibility(pipeline, visibility);
+            visibility_ms += elapsed_ms(start);
+
+            start = Clock::now();
+            run_pipeline(pipeline, visibility, actors_rendered);
+            draw_ms += elapsed_ms(start);
+        }
     }
 
     window->stats->set_subactors_rendered(actors_rendered);
+    window->stats->set_visibility_time(visibility_ms);
+    window->stats->set_draw_time(draw_ms);
 }
 
 void RenderSequence::update_camera_constraint(CameraID cid) {
@@ -220,14 +282,78 @@ uint64_t generate_frame_id() {
     return ++frame_id;
 }
 
-void RenderSequence::run_pipeline(Pipeline::ptr pipeline_stage, int &actors_rendered) {
-    uint64_t frame_id = generate_frame_id();
+void RenderSequence::compute_visibility(Pipeline::ptr pipeline_stage, PipelineVisibility& visibility) {
+    /* This may run on a worker thread, so it must only read from the stage. Anything that
+     * writes (marking renderables visible, assigning lights, swapping LODs) is left to run_pipeline */
 
-    if(!pipeline_stage->is_active()) {
+    if(pipeline_stage->overlay_id()) {
+        // Overlays aren't culled
         return;
     }
 
-    update_camera_constraint(pipeline_stage->camera_id());
+    CameraID camera_id = pipeline_stage->camera_id();
+    auto camera = window->camera(camera_id);
+    auto stage = window->stage(pipeline_stage->stage_id());
+
+    /* Streamed textures load the detail they need from how large they're drawn, which is the
+     * projected diameter of the renderables using them, in pixels */
+    const bool measure_sizes = window->texture_streamer->streaming_count() > 0;
+    const float pixels_per_unit = camera->projection_matrix().mat[5] * 0.5f * float(window->height());
+
+    Mat4 view_projection;
+    kmMat4Multiply(&view_projection, &camera->projection_matrix(), &camera->view_matrix());
+    const float* m = view_projection.mat;
+
+    auto light_ids = stage->partitioner->lights_visible_from(camera_id);
+    auto lights_visible = map<decltype(light_ids), std::vector<LightPtr>>(
+        light_ids, [&](const LightID& light_id) -> LightPtr { return stage->light(light_id); }
+    );
+
+    for(auto& renderable: stage->partitioner->geometry_visible_from(camera_id)) {
+        if(!renderable->is_visible()) {
+            continue;
+        }
+
+        auto renderable_lights = filter(lights_visible, [=](const LightPtr& light) -> bool {
+            // Filter by whether or not the renderable bounds intersects the light bounds
+            return renderable->aabb().intersects(light->aabb());
+        });
+
+        std::partial_sort(
+            renderable_lights.begin(),
+            renderable_lights.begin() + std::min(MAX_LIGHTS_PER_RENDERABLE, (uint32_t) renderable_lights.size()),
+            renderable_lights.end(),
+            [=](LightPtr lhs, LightPtr rhs) {
+                /* FIXME: Sorting by the centre point is problematic. A renderable is made up
+                 * of many polygons, by choosing the light closest to the center you may find that
+                 * that polygons far away from the center aren't effected by lights when they should be.
+                 * This needs more thought, probably. */
+                float lhs_dist = (renderable->centre() - lhs->position()).length_squared();
+                float rhs_dist = (renderable->centre() - rhs->position()).length_squared();
+                return lhs_dist < rhs_dist;
+            }
+        );
+
+        visibility.renderables.push_back(renderable);
+        visibility.renderable_lights.push_back(std::move(renderable_lights));
+        visibility.renderable_lods.push_back(renderable->_select_lod(camera));
+
+        if(measure_sizes) {
+            AABB box = renderable->transformed_aabb();
+            Vec3 centre = box.centre();
+            float diameter = (Vec3(box.max) - Vec3(box.min)).length();
+            float w = m[3] * centre.x + m[7] * centre.y + m[11] * centre.z + m[15];
+
+            // Anything the camera is inside of could fill the screen
+            visibility.renderable_screen_sizes.push_back(
+                (w > 0.0001f) ? (pixels_per_unit * diameter) / w : std::numeric_limits<float>::max()
+            );
+        }
+    }
+}
+
+void RenderSequence::run_pipeline(Pipeline::ptr pipeline_stage, PipelineVisibility& visibility, int &actors_rendered) {
+    uint64_t frame_id = visibility.frame_id;
 
     RenderTarget& target = *window_; //FIXME: Should be window or texture
 
@@ -268,43 +394,23 @@ void RenderSequence::run_pipeline(Pipeline::ptr pipeline_stage, int &actors_rend
     } else {
         auto stage = window->stage(stage_id);
 
-        auto light_ids = stage->partitioner->lights_visible_from(camera_id);
-        auto lights_visible = map<decltype(light_ids), std::vector<LightPtr>>(
-            light_ids, [&](const LightID& light_id) -> LightPtr { return stage->light(light_id); }
-        );
-
         // Mark the visible objects as visible
-        for(auto& renderable: stage->partitioner->geometry_visible_from(camera_id)) {
-            if(!renderable->is_visible()) {
-                continue;
-
-            }
-
+        for(uint32_t i = 0; i < visibility.renderables.size(); ++i) {
+            auto& renderable = visibility.renderables[i];
             renderable->update_last_visible_frame_id(frame_id);
-
-            auto renderable_lights = filter(lights_visible, [=](const LightPtr& light) -> bool {
-                // Filter by whether or not the renderable bounds intersects the light bounds
-                return renderable->aabb().intersects(light->aabb());
-            });
-
-            std::partial_sort(
-                renderable_lights.begin(),
-                renderable_lights.begin() + std::min(MAX_LIGHTS_PER_RENDERABLE, (uint32_t) renderable_lights.size()),
-                renderable_lights.end(),
-                [=](LightPtr lhs, LightPtr rhs) {
-                    /* FIXME: Sorting by the centre point is problematic. A renderable is made up
-                     * of many polygons, by choosing the light closest to the center you may find that
-                     * that polygons far away from the center aren't effected by lights when they should be.
-                     * This needs more thought, probably. */
-                    float lhs_dist = (renderable->centre() - lhs->position()).length_squared();
-                    float rhs_dist = (renderable->centre() - rhs->position()).length_squared();
-                    return lhs_dist < rhs_dist;
-                }
-            );
-
-            renderable->set_affected_by_lights(renderable_lights);
+            renderable->set_affected_by_lights(visibility.renderable_lights[i]);
+            renderable->_apply_lod(visibility.renderable_lods[i]);
+
+            if(i < visibility.renderable_screen_sizes.size()) {
+                window->texture_streamer->_note_usage(
+                    stage->assets->material(renderable->material_id()),
+                    visibility.renderable_screen_sizes[i]
+                );
+            }
         }
 
+        actors_rendered += visibility.renderables.size();
+
         using namespace std::placeholders;
 
         batcher::RenderQueue::TraverseCallback callback = std::bind(
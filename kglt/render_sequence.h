@@ -117,6 +117,15 @@ public:
 
     void run();
 
+    /*
+     * When enabled, the visibility phase (frustum culling and light assignment) of every active
+     * pipeline runs concurrently on the job system's workers at the start of run(). Draws are
+     * then submitted in priority order on the GL thread as usual. Culling only reads from the
+     * partitioners, so this is safe as long as nothing moves objects while the sequence is running.
+     */
+    void set_parallel_culling_enabled(bool value) { parallel_culling_enabled_ = value; }
+    bool parallel_culling_enabled() const { return parallel_culling_enabled_; }
+
     sig::signal<void (Pipeline&)>& signal_pipeline_started() { return signal_pipeline_started_; }
     sig::signal<void (Pipeline&)>& signal_pipeline_finished() { return signal_pipeline_finished_; }
 
@@ -124,8 +133,18 @@ public:
 
     Property<RenderSequence, WindowBase> window = { this, &RenderSequence::window_ };
 private:    
+    /* The result of the visibility phase for a single pipeline */
+    struct PipelineVisibility {
+        uint64_t frame_id = 0;
+        std::vector<RenderablePtr> renderables;
+        std::vector<std::vector<LightPtr>> renderable_lights;
+        std::vector<uint32_t> renderable_lods;
+        std::vector<float> renderable_screen_sizes; // Only filled in while textures are streaming
+    };
+
     void sort_pipelines(bool acquire_lock=false);
-    void run_pipeline(Pipeline::ptr stage, int& actors_rendered);
+    void compute_visibility(Pipeline::ptr pipeline_stage, PipelineVisibility& visibility);
+    void run_pipeline(Pipeline::ptr stage, PipelineVisibility& visibility, int& actors_rendered);
 
     WindowBase* window_ = nullptr;
     Renderer* renderer_ = nullptr;
@@ -133,6 +152,8 @@ private:
     std::mutex pipeline_lock_;
     std::list<Pipeline::ptr> ordered_pipelines_;
 
+    bool parallel_culling_enabled_ = false;
+
     sig::signal<void (Pipeline&)> signal_pipeline_started_;
     sig::signal<void (Pipeline&)> signal_pipeline_finished_;
 
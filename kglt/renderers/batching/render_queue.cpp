@@ -30,7 +30,8 @@ RenderQueue::RenderQueue(Stage* stage, RenderGroupFactory* render_group_factory)
 
     stage->signal_actor_changed().connect([=](ActorID actor_id, ActorChangeEvent event) {
         auto actor = stage->actor(actor_id);
-        if(event.type == ACTOR_CHANGE_TYPE_SUBACTOR_MATERIAL_CHANGED) {
+        if(event.type == ACTOR_CHANGE_TYPE_SUBACTOR_MATERIAL_CHANGED ||
+           event.type == ACTOR_CHANGE_TYPE_RENDER_PRIORITY_CHANGED) {
             actor->each([=](uint32_t i, SubActor* subactor) {
                 remove_renderable(subactor);
                 insert_renderable(subactor);
@@ -74,8 +74,8 @@ public:
     bool operator<(const RenderGroupImpl& rhs) const {
         // Always sort on priority first
 
-        if(this->priority_ < rhs.priority_) {
-            return true;
+        if(this->priority_ != rhs.priority_) {
+            return this->priority_ < rhs.priority_;
         }
 
         return lt(rhs);
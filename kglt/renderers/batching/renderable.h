@@ -47,6 +47,18 @@ public:
         return lights_affecting_this_frame_;
     }
 
+    /*
+     * Renderables with levels of detail pick one per camera during culling (possibly on a worker
+     * thread), the level is then applied on the GL thread just before that camera draws. Swapping
+     * the level only changes the geometry, so the renderable stays in the same render groups.
+     */
+    virtual uint32_t _select_lod(CameraPtr camera) { return 0; }
+    virtual void _apply_lod(uint32_t level) {}
+
+    /* Renderables which only draw part of their index data at a time narrow the range the
+     * renderer draws here. By default every index is drawn */
+    virtual void _draw_range(uint32_t& first_index, uint32_t& index_count) const {}
+
     Property<Renderable, VertexData> vertex_data = { this, &Renderable::get_vertex_data };
     Property<Renderable, IndexData> index_data = { this, &Renderable::get_index_data };
 
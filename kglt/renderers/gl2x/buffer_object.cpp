@@ -37,6 +37,7 @@ void BufferObject::release() {
     if(buffer_id_) {
         GLCheck(glDeleteBuffers, 1, &buffer_id_);
     }
+    byte_size_ = 0;
 }
 
 void BufferObject::bind() {
@@ -117,6 +118,7 @@ void BufferObject::build(uint32_t byte_size, const void* data) {
 
     GLCheck(glBindBuffer, gl_target_, buffer_id_);
     GLCheck(glBufferData, gl_target_, byte_size, data, usage());
+    byte_size_ = byte_size;
 }
 
 void BufferObject::modify(uint32_t offset, uint32_t byte_size, const void* data) {
@@ -40,12 +40,16 @@ public:
 
     GLenum usage() const;
     GLuint target() const { return gl_target_; }
+
+    /* The size of the data last passed to build() */
+    uint32_t byte_size() const { return byte_size_; }
 private:
 
     BufferObjectUsage usage_;
 
     uint32_t gl_target_;
     uint32_t buffer_id_;
+    uint32_t byte_size_ = 0;
 
     std::vector<uint8_t> offline_data_;
 };
@@ -65,6 +69,9 @@ public:
     void index_buffer_update(uint32_t byte_size, const void* data);
     void index_buffer_update_partial(uint32_t offset, uint32_t byte_size, const void* data);
 
+    uint32_t vertex_buffer_size() const { return vertex_buffer_->byte_size(); }
+    uint32_t index_buffer_size() const { return index_buffer_->byte_size(); }
+
 private:
     void vertex_buffer_bind() { vertex_buffer_->bind(); }
     void index_buffer_bind() { index_buffer_->bind(); }
@@ -9,6 +9,7 @@
 #include "../../partitioner.h"
 #include "../../types.h"
 #include "gpu_program.h"
+#include "program_binary_cache.h"
 
 #include "./glad/glad/glad.h"
 #include "../../utils/gl_error.h"
@@ -230,17 +231,29 @@ void send_attribute(ShaderAvailableAttributes attr,
 
         GLCheck(glEnableVertexAttribArray, loc);
 
-        auto attr_size = vertex_attribute_size(data->attribute_for_type(convert(attr)));
+        auto attr_type = data->attribute_for_type(convert(attr));
+        auto attr_size = vertex_attribute_size(attr_type);
         auto stride = data->stride();
 
-        GLCheck(glVertexAttribPointer,
-            loc,
-            attr_size / sizeof(float),
-            GL_FLOAT,
-            GL_FALSE,
-            stride,
-            BUFFER_OFFSET(offset)
-        );
+        if(attr_type == VERTEX_ATTRIBUTE_4UB) {
+            GLCheck(glVertexAttribPointer,
+                loc,
+                4,
+                GL_UNSIGNED_BYTE,
+                GL_TRUE,
+                stride,
+                BUFFER_OFFSET(offset)
+            );
+        } else {
+            GLCheck(glVertexAttribPointer,
+                loc,
+                attr_size / sizeof(float),
+                GL_FLOAT,
+                GL_FALSE,
+                stride,
+                BUFFER_OFFSET(offset)
+            );
+        }
     } else {
         GLCheck(glDisableVertexAttribArray, loc);
         //L_WARN_ONCE(_u("Couldn't locate attribute on the mesh: {0}").format(attr));
@@ -287,16 +300,43 @@ void GenericRenderer::set_blending_mode(BlendType type) {
     }
 }
 
+bool GenericRenderer::ensure_resident(Renderable* renderable, MaterialPass* material_pass) {
+    /*
+     * Rather than compiling shaders mid-frame, queue the work on the upload queue (which is
+     * processed within a time budget at the start of the next frame) and skip the renderable
+     * until it's ready. Geometry isn't deferred, render() updates the buffers as it draws so
+     * new renderables aren't hidden for a frame.
+     */
+
+    auto program = material_pass->program->_program_as_shared_ptr();
+    if(!program->is_complete()) {
+        uploads->push_unique(program.get(), [program]() {
+            program->build();
+        }, UPLOAD_PRIORITY_HIGH);
+
+        return false;
+    }
+
+    return true;
+}
+
 void GenericRenderer::render(CameraPtr camera, bool render_group_changed, const batcher::RenderGroup* current_group,
     Renderable* renderable, MaterialPass* material_pass, Light* light, const Colour &global_ambient, batcher::Iteration iteration) {
 
+    if(!ensure_resident(renderable, material_pass)) {
+        rebind_required_ = true;
+        return;
+    }
+
     // Casting blindly because I can't see how it's possible that it's anything else!
     GL2RenderGroupImpl* current = (GL2RenderGroupImpl*) current_group->impl();
     ResourceManager& resource_manager = material_pass->material->resource_manager();
 
     static ShaderID last_shader_id;
 
-    if(render_group_changed) {       
+    if(render_group_changed || rebind_required_) {
+        rebind_required_ = false;
+
         if(material_pass->program->program->id() != last_shader_id) {
             material_pass->program->program->build();
             material_pass->program->program->activate();
@@ -308,7 +348,15 @@ void GenericRenderer::render(CameraPtr camera, bool render_group_changed, const
             GLCheck(glActiveTexture, GL_TEXTURE0 + i);
             if(current->texture_id[i]) {
                 auto texture = resource_manager.texture(current->texture_id[i]);
-                GLCheck(glBindTexture, GL_TEXTURE_2D, texture->gl_tex());
+                GLuint gl_tex = (texture) ? texture->gl_tex() : 0;
+
+                if(!gl_tex) {
+                    // Not uploaded yet (e.g. still loading asynchronously) so draw with the default texture
+                    auto placeholder = resource_manager.base_manager()->default_texture_id();
+                    gl_tex = resource_manager.texture(placeholder)->gl_tex();
+                }
+
+                GLCheck(glBindTexture, GL_TEXTURE_2D, gl_tex);
             } else {
                 GLCheck(glBindTexture, GL_TEXTURE_2D, 0);
             }
@@ -413,29 +461,34 @@ void GenericRenderer::render(CameraPtr camera, bool render_group_changed, const
 }
 
 void GenericRenderer::send_geometry(Renderable *renderable) {
-    std::size_t index_count = renderable->index_data->count();
+    uint32_t first_index = 0;
+    uint32_t index_count = renderable->index_data->count();
+    renderable->_draw_range(first_index, index_count);
+
     if(!index_count) {
         return;
     }
 
+    const auto offset = BUFFER_OFFSET(first_index * sizeof(Index));
+
     switch(renderable->arrangement()) {
         case MESH_ARRANGEMENT_POINTS:
-            GLCheck(glDrawElements, GL_POINTS, index_count, GL_UNSIGNED_INT, BUFFER_OFFSET(0));
+            GLCheck(glDrawElements, GL_POINTS, index_count, GL_UNSIGNED_INT, offset);
         break;
         case MESH_ARRANGEMENT_LINES:
-            GLCheck(glDrawElements, GL_LINES, index_count, GL_UNSIGNED_INT, BUFFER_OFFSET(0));
+            GLCheck(glDrawElements, GL_LINES, index_count, GL_UNSIGNED_INT, offset);
         break;
         case MESH_ARRANGEMENT_LINE_STRIP:
-            GLCheck(glDrawElements, GL_LINE_STRIP, index_count, GL_UNSIGNED_INT, BUFFER_OFFSET(0));
+            GLCheck(glDrawElements, GL_LINE_STRIP, index_count, GL_UNSIGNED_INT, offset);
         break;
         case MESH_ARRANGEMENT_TRIANGLES:
-            GLCheck(glDrawElements, GL_TRIANGLES, index_count, GL_UNSIGNED_INT, BUFFER_OFFSET(0));
+            GLCheck(glDrawElements, GL_TRIANGLES, index_count, GL_UNSIGNED_INT, offset);
         break;
         case MESH_ARRANGEMENT_TRIANGLE_STRIP:
-            GLCheck(glDrawElements, GL_TRIANGLE_STRIP, index_count, GL_UNSIGNED_INT, BUFFER_OFFSET(0));
+            GLCheck(glDrawElements, GL_TRIANGLE_STRIP, index_count, GL_UNSIGNED_INT, offset);
         break;
         case MESH_ARRANGEMENT_TRIANGLE_FAN:
-            GLCheck(glDrawElements, GL_TRIANGLE_FAN, index_count, GL_UNSIGNED_INT, BUFFER_OFFSET(0));
+            GLCheck(glDrawElements, GL_TRIANGLE_FAN, index_count, GL_UNSIGNED_INT, offset);
         break;
         default:
             L_DEBUG("Tried to render a mesh with an invalid arrangement");
@@ -450,6 +503,18 @@ void GenericRenderer::init_context() {
     GLCheck(glEnable, GL_DEPTH_TEST);
     GLCheck(glDepthFunc, GL_LEQUAL);
     GLCheck(glEnable, GL_CULL_FACE);
+
+    if(!GPUProgram::binary_cache() && ProgramBinaryCache::is_supported()) {
+        // Cache linked programs on disk so shaders only compile on the first run
+        try {
+            GPUProgram::set_binary_cache(std::make_shared<ProgramBinaryCache>(
+                ProgramBinaryCache::default_directory(),
+                ProgramBinaryCache::current_driver_identity()
+            ));
+        } catch(std::exception& e) {
+            L_WARN(_F("Unable to create the program binary cache: {0}").format(e.what()));
+        }
+    }
 }
 
 
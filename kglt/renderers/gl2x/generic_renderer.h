@@ -26,6 +26,11 @@ public:
 
     void init_context();
 private:
+    /* Set when a renderable is skipped, so the next one drawn rebinds the group state */
+    bool rebind_required_ = false;
+
+    bool ensure_resident(Renderable* renderable, MaterialPass* material_pass);
+
     void set_light_uniforms(GPUProgramInstance* program_instance, Light* light);
     void set_material_uniforms(GPUProgramInstance* program_instance, MaterialPass *pass);
     void set_auto_uniforms_on_shader(GPUProgramInstance *pass, CameraPtr camera, Renderable* subactor, const Colour &global_ambient);
@@ -29,6 +29,7 @@ VertexAttributeType convert(ShaderAvailableAttributes attr) {
 }
 
 uint32_t GPUProgram::shader_id_counter_ = 0;
+ProgramBinaryCache::ptr GPUProgram::binary_cache_;
 
 UniformManager::UniformManager(GPUProgram *program):
     program_(program) {
@@ -202,6 +203,7 @@ void GPUProgram::set_attribute_location(const std::string& attribute, GLint loca
     //Is this always true? Can we just assume that the location was given to that attribute?
     //The docs don't seem to suggest that it can fail...
     attribute_cache_[attribute] = location;
+    bound_attributes_[attribute] = location;
 
     // Once we change the attributes they won't take effect until we relink
     needs_relink_ = true;
@@ -355,6 +357,10 @@ void GPUProgram::build() {
 
     prepare_program();
 
+    if(load_from_binary_cache()) {
+        return;
+    }
+
     for(auto p: shaders_) {
         compile(p.first); //Compile each shader if necessary
     }
@@ -362,6 +368,28 @@ void GPUProgram::build() {
     link(); //Now link the program
 }
 
+bool GPUProgram::load_from_binary_cache() {
+    if(!binary_cache_) {
+        return false;
+    }
+
+    auto key = binary_cache_->key(md5_shader_hash_, bound_attributes_);
+    if(!binary_cache_->load(program_object_, key)) {
+        return false;
+    }
+
+    L_DEBUG(_F("Loaded program {0} from the binary cache").format(program_object_));
+
+    // The binary is already linked, so there's nothing to compile
+    for(auto& p: shaders_) {
+        p.second.is_compiled = true;
+    }
+
+    loaded_from_binary_ = true;
+    finish_link();
+    return true;
+}
+
 const bool GPUProgram::is_complete() const {
     //Vertex and Fragment shader are required
     if(!program_object_ || !shaders_.count(SHADER_TYPE_VERTEX) || !shaders_.count(SHADER_TYPE_FRAGMENT)) {
@@ -397,6 +425,23 @@ void GPUProgram::rebuild_hash() {
 void GPUProgram::link() {
     prepare_program();
 
+    if(loaded_from_binary_) {
+        // A program loaded from a binary has no shaders attached, so they must be compiled before relinking
+        loaded_from_binary_ = false;
+
+        for(auto& p: shaders_) {
+            p.second.is_compiled = false;
+        }
+
+        for(auto p: shaders_) {
+            compile(p.first);
+        }
+    }
+
+    if(binary_cache_) {
+        GLCheck(glProgramParameteri, program_object_, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
     assert(shaders_.at(SHADER_TYPE_VERTEX).is_compiled);
     assert(shaders_.at(SHADER_TYPE_FRAGMENT).is_compiled);
 
@@ -424,6 +469,14 @@ void GPUProgram::link() {
 
     L_DEBUG(_F("Linked program {0}").format(program_object_));
 
+    if(binary_cache_) {
+        binary_cache_->save(program_object_, binary_cache_->key(md5_shader_hash_, bound_attributes_));
+    }
+
+    finish_link();
+}
+
+void GPUProgram::finish_link() {
     // Rebuild the uniform information for debugging
     rebuild_uniform_info();
     uniform_cache_.clear();
@@ -14,6 +14,7 @@
 #include "../../vertex_data.h"
 
 #include "glad/glad/glad.h"
+#include "program_binary_cache.h"
 
 #define BUFFER_OFFSET(bytes) ((GLubyte*) NULL + (bytes))
 
@@ -271,6 +272,13 @@ public:
     GLuint program_object() const { return program_object_; }
     void prepare_program();
 
+    /* True if the program was linked from a cached binary rather than compiled from source */
+    bool is_from_binary_cache() const { return loaded_from_binary_; }
+
+    /* Sets the cache used by every program to skip compilation, pass nullptr to disable it */
+    static void set_binary_cache(ProgramBinaryCache::ptr cache) { binary_cache_ = cache; }
+    static ProgramBinaryCache::ptr binary_cache() { return binary_cache_; }
+
 private:
     friend class ::ShaderTest;
 
@@ -281,6 +289,7 @@ private:
 
     bool is_linked_ = false;
     bool needs_relink_ = false;
+    bool loaded_from_binary_ = false;
 
     uint32_t program_object_ = 0;
     std::unordered_map<ShaderType, ShaderInfo> shaders_;
@@ -296,9 +305,15 @@ private:
     std::unordered_map<std::string, GLint> uniform_cache_;
     std::unordered_map<std::string, int32_t> attribute_cache_;
 
+    // Locations explicitly bound before linking, these are baked into cached binaries
+    AttributeBindings bound_attributes_;
+
     void link();
+    bool load_from_binary_cache();
+    void finish_link();
 
     static uint32_t shader_id_counter_;
+    static ProgramBinaryCache::ptr binary_cache_;
 };
 
 class GPUProgramInstance : public Managed<GPUProgramInstance> {
@@ -0,0 +1,224 @@
+#include <fstream>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+
+#include "../../deps/kfs/kfs.h"
+#include "../../deps/kazlog/kazlog.h"
+#include "../../utils/gl_error.h"
+#include "../../utils/hash/md5.h"
+#include "program_binary_cache.h"
+
+namespace kglt {
+
+namespace {
+    const char BINARY_MAGIC[4] = {'K', 'P', 'B', '1'};
+    const std::string STAMP_FILENAME = "driver.stamp";
+    const std::string BINARY_EXTENSION = ".bin";
+
+    std::string gl_string(GLenum name) {
+        const GLubyte* value = glGetString(name);
+        return (value) ? std::string((const char*) value) : std::string();
+    }
+}
+
+ProgramBinaryCache::ProgramBinaryCache(const std::string& directory, const std::string& driver_identity):
+    directory_(directory),
+    driver_identity_(driver_identity) {
+
+    if(!kfs::path::exists(directory_)) {
+        kfs::make_dirs(directory_);
+    }
+
+    validate_stamp();
+}
+
+std::string ProgramBinaryCache::current_driver_identity() {
+    return gl_string(GL_VENDOR) + "\n" + gl_string(GL_RENDERER) + "\n" + gl_string(GL_VERSION);
+}
+
+bool ProgramBinaryCache::is_supported() {
+    if(!GLAD_GL_ARB_get_program_binary || !glGetProgramBinary || !glProgramBinary) {
+        return false;
+    }
+
+    // Some drivers expose the extension but don't support any formats
+    GLint format_count = 0;
+    GLCheck(glGetIntegerv, GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+    return format_count > 0;
+}
+
+std::string ProgramBinaryCache::default_directory() {
+    auto env = [](const char* name) -> std::string {
+        const char* value = std::getenv(name);
+        return (value) ? std::string(value) : std::string();
+    };
+
+    std::string base;
+#ifdef _WIN32
+    base = env("LOCALAPPDATA");
+#elif defined(__APPLE__)
+    if(!env("HOME").empty()) {
+        base = kfs::path::join(env("HOME"), "Library/Caches");
+    }
+#else
+    base = env("XDG_CACHE_HOME");
+    if(base.empty() && !env("HOME").empty()) {
+        base = kfs::path::join(env("HOME"), ".cache");
+    }
+#endif
+
+    if(base.empty()) {
+        L_WARN("Couldn't find a per-user cache directory, caching program binaries in the temp directory");
+        base = kfs::temp_dir();
+    }
+
+    return kfs::path::join(kfs::path::join(base, "kglt"), "program_cache");
+}
+
+std::string ProgramBinaryCache::key(const std::string& program_hash, const AttributeBindings& attributes) const {
+    hashlib::MD5 hash;
+    hash.update(driver_identity_);
+    hash.update(program_hash);
+
+    // std::map is ordered, so the same bindings always produce the same key
+    for(auto& p: attributes) {
+        hash.update(p.first + "=" + std::to_string(p.second) + ";");
+    }
+
+    return hash.hex_digest();
+}
+
+std::string ProgramBinaryCache::path_for_key(const std::string& key) const {
+    return kfs::path::join(directory_, key + BINARY_EXTENSION);
+}
+
+bool ProgramBinaryCache::has_binary(const std::string& key) const {
+    std::lock_guard<std::mutex> lock(lock_);
+    return kfs::path::exists(path_for_key(key));
+}
+
+void ProgramBinaryCache::validate_stamp() {
+    std::lock_guard<std::mutex> lock(lock_);
+
+    auto stamp_path = kfs::path::join(directory_, STAMP_FILENAME);
+
+    std::string existing;
+    {
+        std::ifstream stamp(stamp_path, std::ios::binary);
+        if(stamp) {
+            existing.assign(std::istreambuf_iterator<char>(stamp), std::istreambuf_iterator<char>());
+        }
+    }
+
+    if(existing == driver_identity_) {
+        return;
+    }
+
+    if(!existing.empty()) {
+        L_INFO("GPU driver has changed, discarding cached program binaries");
+    }
+
+    for(auto& filename: kfs::path::list_dir(directory_)) {
+        if(filename.length() > BINARY_EXTENSION.length() &&
+           filename.compare(filename.length() - BINARY_EXTENSION.length(), BINARY_EXTENSION.length(), BINARY_EXTENSION) == 0) {
+            kfs::remove(kfs::path::join(directory_, filename));
+        }
+    }
+
+    std::ofstream stamp(stamp_path, std::ios::binary | std::ios::trunc);
+    stamp << driver_identity_;
+}
+
+void ProgramBinaryCache::clear() {
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        kfs::remove(kfs::path::join(directory_, STAMP_FILENAME));
+    }
+
+    validate_stamp();
+}
+
+bool ProgramBinaryCache::load(GLuint program, const std::string& key) {
+    std::vector<char> binary;
+    GLenum format = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+
+        std::ifstream file(path_for_key(key), std::ios::binary);
+        if(!file) {
+            return false;
+        }
+
+        char magic[4];
+        uint32_t length = 0;
+
+        file.read(magic, 4);
+        file.read((char*) &format, sizeof(uint32_t));
+        file.read((char*) &length, sizeof(uint32_t));
+
+        if(!file || memcmp(magic, BINARY_MAGIC, 4) != 0 || !length) {
+            L_WARN(_F("Ignoring corrupt program binary: {0}").format(key));
+            return false;
+        }
+
+        binary.resize(length);
+        file.read(&binary[0], length);
+        if(!file) {
+            L_WARN(_F("Ignoring truncated program binary: {0}").format(key));
+            return false;
+        }
+    }
+
+    GLCheck(glProgramBinary, program, format, (const void*) &binary[0], (GLsizei) binary.size());
+
+    GLint linked = 0;
+    GLCheck(glGetProgramiv, program, GL_LINK_STATUS, &linked);
+
+    if(!linked) {
+        // The driver can refuse binaries for any reason, the caller will build from source and replace it
+        L_DEBUG(_F("Driver rejected cached program binary: {0}").format(key));
+        return false;
+    }
+
+    return true;
+}
+
+bool ProgramBinaryCache::save(GLuint program, const std::string& key) {
+    GLint length = 0;
+    GLCheck(glGetProgramiv, program, GL_PROGRAM_BINARY_LENGTH, &length);
+
+    if(length <= 0) {
+        return false;
+    }
+
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    GLsizei written = 0;
+    GLCheck(glGetProgramBinary, program, length, &written, &format, (void*) &binary[0]);
+
+    if(written <= 0) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(lock_);
+
+    std::ofstream file(path_for_key(key), std::ios::binary | std::ios::trunc);
+    if(!file) {
+        L_WARN(_F("Unable to write program binary to {0}").format(directory_));
+        return false;
+    }
+
+    uint32_t format_out = format;
+    uint32_t length_out = written;
+
+    file.write(BINARY_MAGIC, 4);
+    file.write((const char*) &format_out, sizeof(uint32_t));
+    file.write((const char*) &length_out, sizeof(uint32_t));
+    file.write(&binary[0], written);
+
+    return bool(file);
+}
+
+}
@@ -0,0 +1,76 @@
+#ifndef PROGRAM_BINARY_CACHE_H
+#define PROGRAM_BINARY_CACHE_H
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <memory>
+
+#include "glad/glad/glad.h"
+
+namespace kglt {
+
+typedef std::map<std::string, GLint> AttributeBindings;
+
+/*
+ * An on-disk cache of linked GPU program binaries (GL_ARB_get_program_binary) so that shaders
+ * are only compiled from source the first time a program is seen.
+ *
+ * Binaries are only valid for the driver that produced them, so the cache directory is stamped
+ * with the vendor, renderer and version strings of the context. If the stamp doesn't match when
+ * the cache is opened (e.g. after a driver update) every cached binary is thrown away. Drivers
+ * can still reject a binary for their own reasons, in which case load() fails and the caller
+ * falls back to compiling from source.
+ */
+class ProgramBinaryCache {
+public:
+    typedef std::shared_ptr<ProgramBinaryCache> ptr;
+
+    ProgramBinaryCache(const std::string& directory, const std::string& driver_identity);
+
+    /* Returns the identity of the current context's driver, must be called from the GL thread */
+    static std::string current_driver_identity();
+
+    /* True if the context can load and retrieve program binaries at all */
+    static bool is_supported();
+
+    /*
+     * A per-user cache directory which survives reboots: %LOCALAPPDATA% on Windows,
+     * ~/Library/Caches on OSX and $XDG_CACHE_HOME (or ~/.cache) elsewhere. Falls back to the
+     * temp directory if none of those can be found. The renderer uses this unless a cache has
+     * already been set with GPUProgram::set_binary_cache() before the context is created.
+     */
+    static std::string default_directory();
+
+    /*
+     * Attribute locations are baked into a binary at link time, so they form part of the key
+     * along with the hash of the shader sources
+     */
+    std::string key(const std::string& program_hash, const AttributeBindings& attributes) const;
+
+    bool has_binary(const std::string& key) const;
+
+    /* Loads the binary for key into program, returns false if there isn't one or the driver rejected it */
+    bool load(GLuint program, const std::string& key);
+
+    /* Retrieves the binary of the (linked) program and writes it to the cache */
+    bool save(GLuint program, const std::string& key);
+
+    void clear();
+
+    const std::string& directory() const { return directory_; }
+    const std::string& driver_identity() const { return driver_identity_; }
+
+private:
+    std::string directory_;
+    std::string driver_identity_;
+
+    mutable std::mutex lock_;
+
+    std::string path_for_key(const std::string& key) const;
+    void validate_stamp();
+};
+
+}
+
+#endif // PROGRAM_BINARY_CACHE_H
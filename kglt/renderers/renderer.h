@@ -11,6 +11,7 @@
 
 #include "batching/renderable.h"
 #include "batching/render_queue.h"
+#include "upload_queue.h"
 
 namespace kglt {
 
@@ -45,12 +46,14 @@ public:
     ) = 0;
 
     Property<Renderer, WindowBase> window = { this, &Renderer::window_ };
+    Property<Renderer, UploadQueue> uploads = { this, &Renderer::upload_queue_ };
 
     virtual void init_context() = 0;
     // virtual void upload_texture(Texture* texture) = 0;
 
 private:    
     WindowBase* window_ = nullptr;
+    UploadQueue upload_queue_;
 };
 
 }
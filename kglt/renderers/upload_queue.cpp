@@ -0,0 +1,83 @@
+#include <chrono>
+
+#include "upload_queue.h"
+#include "../utils/gl_thread_check.h"
+
+namespace kglt {
+
+void UploadQueue::push(UploadTask task, UploadPriority priority) {
+    std::lock_guard<std::mutex> lock(lock_);
+    tasks_[priority].push_back(QueuedUpload{nullptr, task});
+}
+
+bool UploadQueue::push_unique(const void* key, UploadTask task, UploadPriority priority) {
+    std::lock_guard<std::mutex> lock(lock_);
+
+    if(!pending_keys_.insert(key).second) {
+        return false;
+    }
+
+    tasks_[priority].push_back(QueuedUpload{key, task});
+    return true;
+}
+
+bool UploadQueue::is_pending(const void* key) const {
+    std::lock_guard<std::mutex> lock(lock_);
+    return pending_keys_.count(key);
+}
+
+bool UploadQueue::pop(QueuedUpload& out) {
+    std::lock_guard<std::mutex> lock(lock_);
+
+    for(auto& queue: tasks_) {
+        if(queue.empty()) {
+            continue;
+        }
+
+        out = queue.front();
+        queue.pop_front();
+
+        // Release the key before running, so the task can queue itself again if it needs to
+        if(out.key) {
+            pending_keys_.erase(out.key);
+        }
+        return true;
+    }
+
+    return false;
+}
+
+uint32_t UploadQueue::process(double budget_ms) {
+    GLThreadCheck::check();
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    uint32_t processed = 0;
+    QueuedUpload upload;
+    while(pop(upload)) {
+        upload.task();
+        ++processed;
+
+        auto elapsed = std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - start
+        ).count();
+
+        if(elapsed >= budget_ms) {
+            break;
+        }
+    }
+
+    return processed;
+}
+
+uint32_t UploadQueue::pending_count() const {
+    std::lock_guard<std::mutex> lock(lock_);
+
+    uint32_t total = 0;
+    for(auto& queue: tasks_) {
+        total += queue.size();
+    }
+    return total;
+}
+
+}
@@ -0,0 +1,57 @@
+#ifndef UPLOAD_QUEUE_H
+#define UPLOAD_QUEUE_H
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <unordered_set>
+
+namespace kglt {
+
+typedef std::function<void ()> UploadTask;
+
+enum UploadPriority {
+    UPLOAD_PRIORITY_HIGH, // Shader programs, a missing program holds back a whole render group
+    UPLOAD_PRIORITY_NORMAL, // Textures uploaded from other threads
+    UPLOAD_PRIORITY_LOW, // Anything which can wait, e.g. extra detail
+    UPLOAD_PRIORITY_COUNT
+};
+
+/*
+ * Work that needs the GL context (texture uploads, shader compiles) can be pushed here from
+ * any thread. The window drains the queue on the GL thread at the start of each frame, highest
+ * priority first, but only for as long as the frame's upload budget allows; anything left over
+ * waits for the next frame.
+ */
+class UploadQueue {
+public:
+    void push(UploadTask task, UploadPriority priority=UPLOAD_PRIORITY_NORMAL);
+
+    /* Like push(), but does nothing if a task with the same key is already queued. Returns
+     * true if the task was queued */
+    bool push_unique(const void* key, UploadTask task, UploadPriority priority=UPLOAD_PRIORITY_NORMAL);
+    bool is_pending(const void* key) const;
+
+    /* Runs queued tasks until budget_ms has elapsed. At least one task is always run
+     * so that a single large upload can't stall the queue forever. Returns the number run. */
+    uint32_t process(double budget_ms);
+
+    uint32_t pending_count() const;
+
+private:
+    struct QueuedUpload {
+        const void* key;
+        UploadTask task;
+    };
+
+    mutable std::mutex lock_;
+    std::deque<QueuedUpload> tasks_[UPLOAD_PRIORITY_COUNT];
+    std::unordered_set<const void*> pending_keys_;
+
+    bool pop(QueuedUpload& out);
+};
+
+}
+
+#endif // UPLOAD_QUEUE_H
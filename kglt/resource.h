@@ -2,6 +2,7 @@
 #define RESOURCE_H
 
 #include <cassert>
+#include <cstddef>
 #include <mutex>
 
 #include "generic/property.h"
@@ -29,6 +30,10 @@ public:
                ).count();
     }
 
+    /* Bytes held in system memory and on the GPU, used to budget resource memory */
+    virtual std::size_t cpu_memory_usage() const { return 0; }
+    virtual std::size_t gpu_memory_usage() const { return 0; }
+
     Property<Resource, generic::DataCarrier> data = { this, &Resource::data_ };
 private:
     ResourceManager* manager_;
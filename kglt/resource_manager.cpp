@@ -1,17 +1,30 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <thread>
+
 #include "window_base.h"
 #include "resource_manager.h"
 #include "loader.h"
+#include "loaders/kmesh_loader.h"
 #include "procedural/mesh.h"
+#include "utils/mapped_file.h"
+#include "utils/hash/md5.h"
 #include "utils/gl_thread_check.h"
+#include "renderers/renderer.h"
+#include "texture_streamer.h"
 
 /** FIXME
  *
  * - Write tests to show that all new_X_from_file methods mark resources as uncollected before returning
- * - Think of better GC logic, perhaps collect on every frame?
  */
 
 namespace kglt {
 
+/* How many resources of each category are checked each update, and at most evicted when there's a budget */
+const uint32_t RESOURCES_SCANNED_PER_UPDATE = 64;
+const uint32_t RESOURCES_EVICTED_PER_UPDATE = 8;
+
 ResourceManager::ResourceManager(WindowBase* window, ResourceManager *parent):
     WindowHolder(window),
     parent_(parent) {
@@ -55,19 +68,53 @@ void ResourceManager::update(double dt) {
         mat->update(dt);
     });
 
-    static auto last_collection = std::chrono::system_clock::now();
+    MeshManager::collect_step(RESOURCES_SCANNED_PER_UPDATE, RESOURCES_EVICTED_PER_UPDATE);
+    MaterialManager::collect_step(RESOURCES_SCANNED_PER_UPDATE, RESOURCES_EVICTED_PER_UPDATE);
+    TextureManager::collect_step(RESOURCES_SCANNED_PER_UPDATE, RESOURCES_EVICTED_PER_UPDATE);
+    SoundManager::collect_step(RESOURCES_SCANNED_PER_UPDATE, RESOURCES_EVICTED_PER_UPDATE);
+}
 
-    auto now = std::chrono::system_clock::now();
-    auto diff = now - last_collection;
+void ResourceManager::set_memory_budget(ResourceCategory category, std::size_t bytes) {
+    switch(category) {
+        case RESOURCE_CATEGORY_MESH: MeshManager::set_memory_budget(bytes); break;
+        case RESOURCE_CATEGORY_MATERIAL: MaterialManager::set_memory_budget(bytes); break;
+        case RESOURCE_CATEGORY_TEXTURE: TextureManager::set_memory_budget(bytes); break;
+        case RESOURCE_CATEGORY_SOUND: SoundManager::set_memory_budget(bytes); break;
+        default:
+            throw std::logic_error("Invalid resource category");
+    }
+}
 
-    if(std::chrono::duration_cast<std::chrono::seconds>(diff).count() >= 5) {
-        //Garbage collect all the things
-        MeshManager::garbage_collect();
-        MaterialManager::garbage_collect();
-        TextureManager::garbage_collect();
-        SoundManager::garbage_collect();
+std::size_t ResourceManager::memory_budget(ResourceCategory category) const {
+    switch(category) {
+        case RESOURCE_CATEGORY_MESH: return MeshManager::memory_budget();
+        case RESOURCE_CATEGORY_MATERIAL: return MaterialManager::memory_budget();
+        case RESOURCE_CATEGORY_TEXTURE: return TextureManager::memory_budget();
+        case RESOURCE_CATEGORY_SOUND: return SoundManager::memory_budget();
+        default:
+            throw std::logic_error("Invalid resource category");
+    }
+}
+
+MemoryUsage ResourceManager::memory_usage(ResourceCategory category) const {
+    switch(category) {
+        case RESOURCE_CATEGORY_MESH: return MeshManager::memory_usage();
+        case RESOURCE_CATEGORY_MATERIAL: return MaterialManager::memory_usage();
+        case RESOURCE_CATEGORY_TEXTURE: return TextureManager::memory_usage();
+        case RESOURCE_CATEGORY_SOUND: return SoundManager::memory_usage();
+        default:
+            throw std::logic_error("Invalid resource category");
+    }
+}
 
-        last_collection = std::chrono::system_clock::now();
+uint32_t ResourceManager::evicted_count(ResourceCategory category) const {
+    switch(category) {
+        case RESOURCE_CATEGORY_MESH: return MeshManager::evicted_count();
+        case RESOURCE_CATEGORY_MATERIAL: return MaterialManager::evicted_count();
+        case RESOURCE_CATEGORY_TEXTURE: return TextureManager::evicted_count();
+        case RESOURCE_CATEGORY_SOUND: return SoundManager::evicted_count();
+        default:
+            throw std::logic_error("Invalid resource category");
     }
 }
 
@@ -144,18 +191,237 @@ MeshID ResourceManager::new_mesh_from_submesh(SubMesh* submesh, GarbageCollectMe
     return result;
 }
 
+void ResourceManager::set_mesh_cache_directory(const unicode& directory) {
+    if(base_manager() != this) {
+        base_manager()->set_mesh_cache_directory(directory);
+        return;
+    }
+
+    if(!directory.empty() && !kfs::path::exists(directory.encode())) {
+        kfs::make_dirs(directory.encode());
+    }
+
+    std::lock_guard<std::mutex> lock(mesh_cache_lock_);
+    mesh_cache_directory_ = directory;
+}
+
+unicode ResourceManager::mesh_cache_directory() const {
+    if(base_manager() != this) {
+        return base_manager()->mesh_cache_directory();
+    }
+
+    std::lock_guard<std::mutex> lock(mesh_cache_lock_);
+    return mesh_cache_directory_;
+}
+
+namespace {
+
+/* Calls callback with the arguments of every line in [begin, end) starting with keyword */
+template<typename Callback>
+void each_statement(const char* begin, const char* end, const std::string& keyword, Callback callback) {
+    const char* line = begin;
+    while(line < end) {
+        const char* line_end = std::find(line, end, '\n');
+
+        const char* cursor = line;
+        while(cursor < line_end && (*cursor == ' ' || *cursor == '\t')) ++cursor;
+
+        if(std::size_t(line_end - cursor) > keyword.length() &&
+           std::equal(keyword.begin(), keyword.end(), cursor) &&
+           (cursor[keyword.length()] == ' ' || cursor[keyword.length()] == '\t')) {
+
+            const char* arguments = cursor + keyword.length();
+            const char* arguments_end = line_end;
+            while(arguments < arguments_end && std::isspace((unsigned char) *arguments)) ++arguments;
+            while(arguments_end > arguments && std::isspace((unsigned char) *(arguments_end - 1))) --arguments_end;
+
+            callback(std::string(arguments, arguments_end));
+        }
+
+        line = line_end + 1;
+    }
+}
+
+void hash_data(hashlib::MD5& hash, const char* data, std::size_t size) {
+    // MD5 takes strings, so feed it in blocks rather than copying the whole file at once
+    const std::size_t block_size = 1024 * 1024;
+    for(std::size_t offset = 0; offset < size; offset += block_size) {
+        hash.update(std::string(data + offset, std::min(block_size, size - offset)));
+    }
+}
+
+/*
+ * An OBJ file's materials come from its mtllib files, and those name the textures, so a cached
+ * mesh is stale if any of them change. This hashes the same files the OBJ loader would read: the
+ * material libraries' contents, and the paths of the textures they use along with whether they
+ * exist (missing textures are skipped when loading).
+ */
+void hash_material_libraries(hashlib::MD5& hash, ResourceLocator& locator, const unicode& obj_file, const char* begin, const char* end) {
+    const std::string directory = kfs::path::dir_name(obj_file.encode());
+
+    each_statement(begin, end, "mtllib", [&](const std::string& name) {
+        std::string text;
+        try {
+            unicode filename = locator.locate_file(kfs::path::join(directory, name));
+            text = locator.read_file(filename)->str();
+            hash.update("mtllib " + filename.encode() + ";");
+        } catch(ResourceMissingError& e) {
+            hash.update("mtllib " + name + " missing;");
+            return;
+        }
+
+        hash.update(text);
+
+        each_statement(text.c_str(), text.c_str() + text.length(), "map_Kd", [&](const std::string& texture) {
+            auto texture_file = kfs::path::join(directory, texture);
+            hash.update(texture_file + (kfs::path::exists(texture_file) ? ";" : " missing;"));
+        });
+    });
+}
+
+}
+
+std::string ResourceManager::mesh_cache_file(const unicode& directory, const unicode& path) {
+    hashlib::MD5 hash;
+    hash.update(std::to_string(loaders::KMESH_VERSION) + ";");
+
+    /* Materials and textures are found relative to the file, so identical files in different
+     * places aren't interchangeable */
+    unicode located = window->resource_locator->locate_file(path);
+    hash.update(located.encode() + ";");
+
+    const bool is_obj = path.lower().contains(".obj");
+
+    if(kfs::path::exists(located.encode())) {
+        MappedFile file(located.encode());
+
+        const char* data = (const char*) file.data();
+        hash_data(hash, data, file.size());
+
+        if(is_obj) {
+            hash_material_libraries(hash, *window->resource_locator.get(), located, data, data + file.size());
+        }
+    } else {
+        std::string data = window->resource_locator->read_file(path)->str();
+        hash.update(data);
+
+        if(is_obj) {
+            hash_material_libraries(hash, *window->resource_locator.get(), located, data.c_str(), data.c_str() + data.length());
+        }
+    }
+
+    return kfs::path::join(directory.encode(), hash.hex_digest() + ".kmesh");
+}
+
+void ResourceManager::load_mesh_from_file(MeshPtr mesh, const unicode& path) {
+    unicode cache_directory = mesh_cache_directory();
+
+    std::string cache_file;
+    if(!cache_directory.empty()) {
+        cache_file = mesh_cache_file(cache_directory, path);
+
+        if(kfs::path::exists(cache_file)) {
+            try {
+                loaders::read_kmesh(*mesh, cache_file);
+                return;
+            } catch(std::exception& e) {
+                L_WARN(_F("Ignoring unreadable cached mesh {0}: {1}").format(cache_file, e.what()));
+                mesh->reset(VertexSpecification::POSITION_ONLY);
+            }
+        }
+    }
+
+    auto loader = window->loader_for(path.encode());
+    if(!loader) {
+        throw std::runtime_error(_u("Unable to locate a loader for {0}").format(path).encode());
+    }
+
+    loader->into(mesh);
+
+    if(cache_file.empty() || mesh->is_animated()) {
+        return;
+    }
+
+    // Written under a temporary name and then renamed, so a half written file is never read
+    std::string temp_file = cache_file + "." + std::to_string(
+        std::hash<std::thread::id>()(std::this_thread::get_id())
+    ) + ".tmp";
+
+    try {
+        loaders::write_kmesh(*mesh, temp_file);
+
+        if(std::rename(temp_file.c_str(), cache_file.c_str()) != 0) {
+            throw std::runtime_error("Unable to rename " + temp_file);
+        }
+    } catch(std::exception& e) {
+        L_WARN(_F("Unable to cache mesh {0}: {1}").format(path, e.what()));
+        std::remove(temp_file.c_str());
+    }
+}
+
 MeshID ResourceManager::new_mesh_from_file(const unicode& path, GarbageCollectMethod garbage_collect) {
-    //Load the material
     kglt::MeshID mesh_id = new_mesh(VertexSpecification::POSITION_ONLY, garbage_collect);
-    auto loader = window->loader_for(path.encode());
-    assert(loader && "Unable to locate a loader for the specified mesh file");
 
-    loader->into(mesh(mesh_id));
+    try {
+        load_mesh_from_file(mesh(mesh_id), path);
+    } catch(...) {
+        delete_mesh(mesh_id);
+        throw;
+    }
 
     MeshManager::mark_as_uncollected(mesh_id);
     return mesh_id;
 }
 
+MeshID ResourceManager::new_mesh_from_file(const unicode& path, const std::vector<LODGenerationLevel>& lods, GarbageCollectMethod garbage_collect) {
+    MeshID mesh_id = new_mesh_from_file(path, garbage_collect);
+    generate_mesh_lods(mesh_id, lods);
+    return mesh_id;
+}
+
+void ResourceManager::generate_mesh_lods(MeshID mesh_id, const std::vector<LODGenerationLevel>& lods) {
+    auto source = mesh(mesh_id);
+
+    if(source->is_animated()) {
+        throw std::logic_error("LODs can't be generated for animated meshes");
+    }
+
+    source->clear_lods();
+
+    for(auto& level: lods) {
+        // Each level is simplified from the original, rather than the previous level, to avoid compounding error
+        MeshID lod_id = new_mesh(source->shared_data->specification());
+        procedural::mesh::simplify(source, mesh(lod_id), level.ratio);
+        source->add_lod(lod_id, level.threshold);
+    }
+}
+
+std::shared_future<MeshID> ResourceManager::new_mesh_from_file_async(const unicode& path, GarbageCollectMethod garbage_collect) {
+    auto promise = std::make_shared<std::promise<MeshID>>();
+    std::shared_future<MeshID> result = promise->get_future().share();
+
+    // Keep hold of the mesh while it loads so that it can't be garbage collected
+    MeshPtr target = mesh(new_mesh(VertexSpecification::POSITION_ONLY, garbage_collect));
+    MeshManager::mark_as_loading(target->id());
+
+    window->jobs->schedule([=]() {
+        try {
+            load_mesh_from_file(target, path);
+        } catch(...) {
+            MeshManager::mark_as_loaded(target->id());
+            delete_mesh(target->id());
+            promise->set_exception(std::current_exception());
+            return;
+        }
+
+        MeshManager::mark_as_loaded(target->id());
+        MeshManager::mark_as_uncollected(target->id());
+        promise->set_value(target->id());
+    });
+
+    return result;
+}
+
 MeshID ResourceManager::new_mesh_from_tmx_file(const unicode& tmx_file, const unicode& layer_name, float tile_render_size, GarbageCollectMethod garbage_collect) {
     kglt::MeshID mesh_id = new_mesh(VertexSpecification::DEFAULT, garbage_collect);
     window->loader_for(tmx_file.encode())->into(mesh(mesh_id), {
@@ -389,9 +655,9 @@ MaterialID ResourceManager::get_template_material(const unicode& path) {
     while(materials_loading_.count(template_id)) { // Not really threadsafe...
         if(!load_material && GLThreadCheck::is_current()) {
             /* If we aren't loading the material in this thread, but this is the main thread and the material is loading
-             * in another thread we *must* run the idle tasks while we wait for it to finish. Otherwise it will deadlock
-             * on a run_sync call */
-            window->idle->execute();
+             * in another thread we *must* run the run_sync callbacks while we wait for it to finish. Otherwise it will
+             * deadlock */
+            window->idle->execute_sync();
         } else if(load_material) {
             /* Otherwise, if we're loading the material, we load it, then remove it from the list */
             L_INFO(_F("Loading material {0} into {1}").format(path, template_id));
@@ -416,6 +682,7 @@ MaterialID ResourceManager::new_material_from_file(const unicode& path, GarbageC
     /* Take the template, clone it, and set garbage_collection appropriately */
     auto new_mat = material(template_id)->new_clone(this, garbage_collect).fetch();
     new_mat->enable_gc((garbage_collect == GARBAGE_COLLECT_NEVER) ? false: true);
+    new_mat->data->stash(path, "source_path");
     mark_material_as_uncollected(new_mat->id());
 
     L_DEBUG(_F("Cloned material {0} into {1}").format(template_id, new_mat->id()));
@@ -495,29 +762,136 @@ TextureID ResourceManager::new_texture(GarbageCollectMethod garbage_collect) {
 }
 
 TextureID ResourceManager::new_texture_from_file(const unicode& path, TextureFlags flags, GarbageCollectMethod garbage_collect) {
-    //Load the texture
     auto tex = texture(new_texture(garbage_collect));
-    window->loader_for(path, LOADER_HINT_TEXTURE)->into(tex);
 
-    if(flags.flip_vertically) {
-        tex->flip_vertically();
-    }
+    // Mesh loaders call this for their materials' textures, which happens on a worker for async loads
+    TextureManager::mark_as_loading(tex->id());
 
-    tex->upload(
-        flags.mipmap,
-        flags.wrap,
-        flags.filter,
-        false
-    );
+    try {
+        //Load the texture
+        window->loader_for(path, LOADER_HINT_TEXTURE)->into(tex);
+
+        // Kept so that the texture can be found again, e.g. when a mesh using it is cached
+        tex->data->stash(path, "source_path");
+
+        if(flags.flip_vertically) {
+            tex->flip_vertically();
+        }
 
+        if(!flags.stream || !window->texture_streamer->add(tex, path, flags)) {
+            tex->upload(
+                flags.mipmap,
+                flags.wrap,
+                flags.filter,
+                false
+            );
+        }
+    } catch(...) {
+        TextureManager::mark_as_loaded(tex->id());
+        throw;
+    }
+
+    TextureManager::mark_as_loaded(tex->id());
     mark_texture_as_uncollected(tex->id());
     return tex->id();
 }
 
+std::shared_future<TextureID> ResourceManager::new_texture_from_file_async(const unicode& path, TextureFlags flags, GarbageCollectMethod garbage_collect) {
+    auto promise = std::make_shared<std::promise<TextureID>>();
+    std::shared_future<TextureID> result = promise->get_future().share();
+
+    // Keep hold of the texture while it loads so that it can't be garbage collected
+    TexturePtr tex = texture(new_texture(garbage_collect));
+    TextureManager::mark_as_loading(tex->id());
+
+    window->jobs->schedule([=]() {
+        bool streaming = false;
+        auto resident = std::make_shared<TextureStreamer::ResidentLevels>();
+
+        try {
+            window->loader_for(path, LOADER_HINT_TEXTURE)->into(tex);
+            tex->data->stash(path, "source_path");
+
+            if(flags.flip_vertically) {
+                tex->flip_vertically();
+            }
+
+            // Mipmaps are built here rather than holding up the GL thread, which only uploads them
+            streaming = flags.stream && window->texture_streamer->prepare(tex, path, flags, *resident);
+        } catch(...) {
+            TextureManager::mark_as_loaded(tex->id());
+            delete_texture(tex->id());
+            promise->set_exception(std::current_exception());
+            return;
+        }
+
+        window->renderer->uploads->push([=]() {
+            try {
+                if(streaming) {
+                    window->texture_streamer->__do_add(tex, path, flags, *resident);
+                } else {
+                    tex->__do_upload(flags.mipmap, flags.wrap, flags.filter, false);
+                }
+            } catch(...) {
+                TextureManager::mark_as_loaded(tex->id());
+                delete_texture(tex->id());
+                promise->set_exception(std::current_exception());
+                return;
+            }
+
+            TextureManager::mark_as_loaded(tex->id());
+            mark_texture_as_uncollected(tex->id());
+            promise->set_value(tex->id());
+        });
+    });
+
+    return result;
+}
+
 void ResourceManager::delete_texture(TextureID t) {
     texture(t)->enable_gc();
 }
 
+TextureAtlas* ResourceManager::atlas() {
+    std::lock_guard<std::mutex> lock(atlas_lock_);
+    if(!atlas_) {
+        atlas_.reset(new TextureAtlas(this));
+    }
+
+    return atlas_.get();
+}
+
+std::vector<AtlasRegion> ResourceManager::new_atlas_regions_from_files(const std::vector<unicode>& paths) {
+    std::vector<AtlasRegion> regions;
+
+    for(auto& path: paths) {
+        if(atlas()->has_region(path)) {
+            regions.push_back(atlas()->region(path));
+            continue;
+        }
+
+        // The image is only needed until its pixels have been copied into the atlas
+        auto tex = texture(new_texture());
+        window->loader_for(path, LOADER_HINT_TEXTURE)->into(tex);
+
+        regions.push_back(atlas()->add(tex->id(), path));
+        delete_texture(tex->id());
+    }
+
+    atlas()->upload();
+    return regions;
+}
+
+AtlasRegion ResourceManager::new_atlas_region_from_file(const unicode& path) {
+    return new_atlas_regions_from_files({path}).front();
+}
+
+AtlasRegion ResourceManager::new_atlas_region_from_texture(TextureID texture) {
+    AtlasRegion region = atlas()->add(texture);
+    atlas()->upload();
+    return region;
+}
+
 TextureID ResourceManager::new_texture_with_alias(const std::string& alias, GarbageCollectMethod garbage_collect) {
     TextureID t = new_texture(garbage_collect);
     try {
@@ -3,12 +3,14 @@
 
 #include <string>
 #include <map>
+#include <future>
 
 #include "generic/refcount_manager.h"
 #include "managers/window_holder.h"
 #include "loaders/heightmap_loader.h"
 
 #include "texture.h"
+#include "texture_atlas.h"
 #include "mesh.h"
 #include "material.h"
 #include "sound.h"
@@ -37,6 +39,11 @@ struct TextureFlags {
     TextureWrap wrap = TEXTURE_WRAP_REPEAT;
     TextureFilter filter = TEXTURE_FILTER_NEAREST;
     bool flip_vertically = false;
+
+    /* Hand the texture to the window's TextureStreamer, so that only the mipmaps it's drawn
+     * large enough to need are kept on the GPU. Falls back to a normal upload when the texture
+     * can't be streamed */
+    bool stream = false;
 };
 
 
@@ -63,11 +70,44 @@ public:
 
     MeshID new_mesh_from_file(const unicode& path, GarbageCollectMethod garbage_collect=GARBAGE_COLLECT_PERIODIC);
 
+    /*
+     * Loads the mesh and then generates a simplified mesh for each of the levels, which are
+     * added as its LODs. Levels must be ordered by threshold as in Mesh::add_lod.
+     */
+    MeshID new_mesh_from_file(const unicode& path, const std::vector<LODGenerationLevel>& lods, GarbageCollectMethod garbage_collect=GARBAGE_COLLECT_PERIODIC);
+
+    /*
+     * Reads and parses the file on a worker thread. The returned future becomes ready once
+     * the mesh has loaded, its buffers are built by the renderer when it's first drawn.
+     */
+    std::shared_future<MeshID> new_mesh_from_file_async(const unicode& path, GarbageCollectMethod garbage_collect=GARBAGE_COLLECT_PERIODIC);
+
+    /*
+     * When set, meshes loaded with new_mesh_from_file are also written to this directory in the
+     * binary kmesh format, keyed by a hash of the source file and its location, and later loads
+     * of the same file are read back from there rather than being parsed again. Only the file
+     * itself is hashed, so changes to files it refers to (e.g. an OBJ's .mtl) aren't noticed
+     * until the cache is cleared. Animated meshes aren't cached. Applies to every resource manager of the window,
+     * an empty directory (the default) disables the cache.
+     */
+    void set_mesh_cache_directory(const unicode& directory);
+    unicode mesh_cache_directory() const;
+
     /*
      * Given a submesh, this creates a new mesh with just that single submesh
      */
     MeshID new_mesh_from_submesh(SubMesh* submesh, GarbageCollectMethod garbage_collect=GARBAGE_COLLECT_PERIODIC);
 
+    /*
+     * Replaces the LODs of the mesh with simplified copies of it. Animated meshes can't be
+     * simplified and will throw.
+     */
+    void generate_mesh_lods(MeshID mesh_id, const std::vector<LODGenerationLevel>& lods);
+
+    /*
+     * Loads a layer of a TMX map as a single mesh, which is culled as a whole. To have each chunk
+     * of a large layer culled on its own, load the file into a stage instead (see TiledLoader).
+     */
     MeshID new_mesh_from_tmx_file(const unicode& tmx_file, const unicode& layer_name, float tile_render_size=1.0, GarbageCollectMethod garbage_collect=GARBAGE_COLLECT_PERIODIC);
     MeshID new_mesh_from_heightmap(const unicode& image_file, const HeightmapSpecification &spec=HeightmapSpecification(),
         GarbageCollectMethod garbage_collect=GARBAGE_COLLECT_PERIODIC
@@ -100,6 +140,13 @@ public:
     TextureID new_texture(GarbageCollectMethod garbage_collect=GARBAGE_COLLECT_PERIODIC);
     TextureID new_texture_from_file(const unicode& path, TextureFlags flags=TextureFlags(), GarbageCollectMethod garbage_collect=GARBAGE_COLLECT_PERIODIC);
 
+    /*
+     * Reads and decodes the image on a worker thread, then queues the upload on the renderer
+     * so that it's done within the per-frame upload budget. The returned future becomes ready
+     * once the texture has been uploaded.
+     */
+    std::shared_future<TextureID> new_texture_from_file_async(const unicode& path, TextureFlags flags=TextureFlags(), GarbageCollectMethod garbage_collect=GARBAGE_COLLECT_PERIODIC);
+
     TextureID new_texture_with_alias(const std::string &alias, GarbageCollectMethod garbage_collect=GARBAGE_COLLECT_PERIODIC);
     TextureID new_texture_with_alias_from_file(const std::string& alias, const unicode& path, TextureFlags flags=TextureFlags(), GarbageCollectMethod garbage_collect=GARBAGE_COLLECT_PERIODIC);
     TextureID get_texture_with_alias(const std::string &alias);
@@ -111,6 +158,18 @@ public:
     void mark_texture_as_uncollected(TextureID t);
     void delete_texture(TextureID t);
 
+    /*
+     * Packs images into this resource manager's texture atlas (see TextureAtlas) and uploads
+     * the pages. Images loaded from a file are only added once, loading the same path again
+     * returns the same region. When adding several images, load them together so that the
+     * pages are only uploaded once.
+     */
+    AtlasRegion new_atlas_region_from_file(const unicode& path);
+    std::vector<AtlasRegion> new_atlas_regions_from_files(const std::vector<unicode>& paths);
+    AtlasRegion new_atlas_region_from_texture(TextureID texture);
+
+    TextureAtlas* atlas();
+
     MaterialID new_material(GarbageCollectMethod garbage_collect=GARBAGE_COLLECT_PERIODIC);
     MaterialID new_material_from_file(const unicode& path, GarbageCollectMethod garbage_collect=GARBAGE_COLLECT_PERIODIC);
     MaterialID new_material_with_alias(const std::string &alias, GarbageCollectMethod garbage_collect=GARBAGE_COLLECT_PERIODIC);
@@ -141,6 +200,18 @@ public:
 
     void update(double dt);
 
+    /*
+     * Resources which nothing references any more are kept while their category is within
+     * budget (in bytes of CPU and GPU memory combined), and evicted least recently used first
+     * when it isn't. The default budget is zero, so they're evicted as soon as they're found.
+     * A few resources are checked and evicted each update so there's no hitch, which means
+     * memory_usage() lags slightly behind.
+     */
+    void set_memory_budget(ResourceCategory category, std::size_t bytes);
+    std::size_t memory_budget(ResourceCategory category) const;
+    MemoryUsage memory_usage(ResourceCategory category) const;
+    uint32_t evicted_count(ResourceCategory category) const;
+
     unicode default_material_filename() const;
 
     MaterialID clone_default_material(GarbageCollectMethod garbage_collect=GARBAGE_COLLECT_PERIODIC) {
@@ -170,6 +241,15 @@ private:
     std::set<MaterialID> materials_loading_;
 
     MaterialID get_template_material(const unicode& path);
+
+    std::mutex atlas_lock_;
+    std::unique_ptr<TextureAtlas> atlas_;
+
+    mutable std::mutex mesh_cache_lock_;
+    unicode mesh_cache_directory_;
+
+    std::string mesh_cache_file(const unicode& directory, const unicode& path);
+    void load_mesh_from_file(MeshPtr mesh, const unicode& path);
 };
 
 
@@ -51,6 +51,8 @@ public:
 
     void set_source_init_function(std::function<void (SourceInstance&)> func) { init_source_ = func; }
 
+    std::size_t cpu_memory_usage() const override { return sound_data_.capacity(); }
+
 private:
     std::function<void (SourceInstance&)> init_source_;
 
@@ -25,6 +25,13 @@ Sprite::Sprite(SpriteID id, Stage *stage):
 bool Sprite::init() {
     mesh_id_ = stage->assets->new_mesh_as_rectangle(1.0, 1.0);
 
+    if(stage->sprite_batching_enabled()) {
+        mesh_ = stage->assets->mesh(mesh_id_);
+        batched_ = true;
+        stage->sprite_batcher->add_sprite(id());
+        return true;
+    }
+
     //Annoyingly, we can't use new_actor_with_parent_and_mesh here, because that looks
     //up our ID in the stage, which doesn't exist until this function returns. So instead
     //we make sure we are set as the parent on each update. Not ideal, but still.
@@ -44,13 +51,24 @@ void Sprite::ask_owner_for_destruction() {
 }
 
 void Sprite::update(double dt) {
-    stage->actor(actor_id_)->set_parent(id()); //Make sure every frame that our actor stays attached to us!
+    if(actor_id_) {
+        stage->actor(actor_id_)->set_parent(id()); //Make sure every frame that our actor stays attached to us!
+    }
 
     // Update any keyframe animations
     animation_state_->update(dt);
 }
 
 
+void Sprite::set_layer(RenderPriority layer) {
+    layer_ = layer;
+
+    // Batched sprites move to the layer's batch on the next update
+    if(actor_id_) {
+        stage->actor(actor_id_)->set_render_priority(layer);
+    }
+}
+
 void Sprite::flip_horizontally(bool value) {
     if(value == flipped_horizontally_) return;
 
@@ -88,6 +106,14 @@ void Sprite::update_texture_coordinates() {
     y0 += 0.5 / image_height_;
     y1 -= 0.5 / image_height_;
 
+    Vec2 min = region_.map(x0, y0);
+    Vec2 max = region_.map(x1, y1);
+
+    x0 = min.x;
+    y0 = min.y;
+    x1 = max.x;
+    y1 = max.y;
+
     if(flipped_horizontally_) {
         std::swap(x0, x1);
     }
@@ -115,20 +141,29 @@ void Sprite::update_texture_coordinates() {
     }
 }
 
-void Sprite::set_spritesheet(TextureID texture_id, uint32_t frame_width,
-    uint32_t frame_height, uint32_t margin, uint32_t spacing,
-    std::pair<uint32_t, uint32_t> padding
-) {
+void Sprite::set_frame_layout(uint32_t frame_width, uint32_t frame_height,
+    uint32_t margin, uint32_t spacing, std::pair<uint32_t, uint32_t> padding) {
 
     frame_width_ = frame_width;
     frame_height_ = frame_height;
     sprite_sheet_margin_ = margin;
     sprite_sheet_spacing_ = spacing;
     sprite_sheet_padding_ = padding;
+}
+
+void Sprite::set_spritesheet(TextureID texture_id, uint32_t frame_width,
+    uint32_t frame_height, uint32_t margin, uint32_t spacing,
+    std::pair<uint32_t, uint32_t> padding
+) {
+
+    set_frame_layout(frame_width, frame_height, margin, spacing, padding);
 
     image_width_ = stage->assets->texture(texture_id)->width();
     image_height_ = stage->assets->texture(texture_id)->height();
 
+    // The spritesheet is the whole texture
+    region_ = AtlasRegion();
+
     //Hold a reference to the new material
     material_id_ = stage->assets->new_material_from_texture(texture_id);
     stage->assets->mesh(mesh_id_)->set_material_id(material_id_);
@@ -136,6 +171,23 @@ void Sprite::set_spritesheet(TextureID texture_id, uint32_t frame_width,
     update_texture_coordinates();
 }
 
+void Sprite::set_spritesheet(const AtlasRegion& region, uint32_t frame_width,
+    uint32_t frame_height, uint32_t margin, uint32_t spacing,
+    std::pair<uint32_t, uint32_t> padding
+) {
+
+    set_frame_layout(frame_width, frame_height, margin, spacing, padding);
+
+    image_width_ = region.width;
+    image_height_ = region.height;
+    region_ = region;
+
+    material_id_ = region.material;
+    stage->assets->mesh(mesh_id_)->set_material_id(material_id_);
+
+    update_texture_coordinates();
+}
+
 void Sprite::set_render_dimensions_from_height(float height) {
     set_render_dimensions(-1, height);
 }
@@ -9,6 +9,7 @@
 #include "sound.h"
 #include "object.h"
 #include "animation.h"
+#include "texture_atlas.h"
 
 namespace kglt {
 
@@ -44,6 +45,19 @@ public:
         std::pair<uint32_t, uint32_t> padding=std::make_pair(0, 0)
     );
 
+    /*
+     * Uses a spritesheet which was packed into an atlas (e.g. with
+     * ResourceManager::new_atlas_region_from_file). Sprites drawn from the same atlas page
+     * share its material, so they can be drawn together.
+     */
+    void set_spritesheet(
+        const AtlasRegion& region,
+        uint32_t frame_width,
+        uint32_t frame_height,
+        uint32_t margin=0, uint32_t spacing=0,
+        std::pair<uint32_t, uint32_t> padding=std::make_pair(0, 0)
+    );
+
     void flip_vertically(bool value=true);
     void flip_horizontally(bool value=true);
 
@@ -52,8 +66,21 @@ public:
         return _u("Sprite {0}").format(this->id());
     }
 
+    /* Null when the sprite is batched, see Stage::set_sprite_batching_enabled */
     kglt::ActorID actor_id() const { return actor_id_; }
 
+    MeshID mesh_id() const { return mesh_id_; }
+    MaterialID material_id() const { return material_id_; }
+
+    bool is_batched() const { return batched_; }
+
+    /*
+     * Layers are render priorities, so sprites on a higher layer are drawn over those on a
+     * lower one (and over other geometry with a lower priority).
+     */
+    void set_layer(RenderPriority layer);
+    RenderPriority layer() const { return layer_; }
+
 private:
     float frame_width_ = 0;
     float frame_height_ = 0;
@@ -66,9 +93,24 @@ private:
     MeshID mesh_id_;
     MaterialID material_id_;
 
+    // Batched sprites have no actor holding on to their mesh, so they hold it themselves
+    MeshPtr mesh_;
+
+    bool batched_ = false;
+    RenderPriority layer_ = RENDER_PRIORITY_MAIN;
+
     float image_width_ = 0;
     float image_height_ = 0;
 
+    // Maps texture coordinates within the spritesheet to the texture, only set for atlases
+    AtlasRegion region_;
+
+    void set_frame_layout(
+        uint32_t frame_width, uint32_t frame_height,
+        uint32_t margin, uint32_t spacing,
+        std::pair<uint32_t, uint32_t> padding
+    );
+
     void update_texture_coordinates();
 
     bool flipped_vertically_ = false;
@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <cstring>
+
+#include "sprite_batcher.h"
+#include "stage.h"
+#include "sprite.h"
+#include "actor.h"
+#include "mesh.h"
+
+namespace kglt {
+
+const uint32_t VERTICES_PER_SPRITE = 4;
+const uint32_t INDICES_PER_SPRITE = 6;
+
+SpriteBatcher::SpriteBatcher(Stage* stage):
+    stage_(stage) {
+
+}
+
+SpriteBatcher::~SpriteBatcher() {
+    for(auto& p: batches_) {
+        destroy_batch(p.second);
+    }
+}
+
+void SpriteBatcher::add_sprite(SpriteID sprite_id) {
+    sprites_.push_back(sprite_id);
+}
+
+ActorID SpriteBatcher::batch_actor(RenderPriority layer, MaterialID material) const {
+    auto it = batches_.find(BatchKey(layer, material));
+    return (it == batches_.end()) ? ActorID() : it->second.actor_id;
+}
+
+SpriteBatcher::Batch& SpriteBatcher::batch_for(const BatchKey& key, Sprite* sprite) {
+    auto it = batches_.find(key);
+    if(it != batches_.end()) {
+        return it->second;
+    }
+
+    auto spec = stage_->assets->mesh(sprite->mesh_id())->shared_data->specification();
+    if(spec.position_attribute != VERTEX_ATTRIBUTE_3F) {
+        throw std::logic_error("Batched sprites must have 3D positions");
+    }
+
+    Batch& batch = batches_[key];
+    batch.mesh_id = stage_->assets->new_mesh(spec, GARBAGE_COLLECT_NEVER);
+    stage_->assets->mesh(batch.mesh_id)->new_submesh_with_material("sprites", key.second);
+
+    batch.actor_id = stage_->new_actor_with_mesh(batch.mesh_id, RENDERABLE_CULLING_MODE_NEVER);
+    stage_->actor(batch.actor_id)->set_render_priority(key.first);
+
+    return batch;
+}
+
+void SpriteBatcher::destroy_batch(Batch& batch) {
+    if(stage_->has_actor(batch.actor_id)) {
+        stage_->delete_actor(batch.actor_id);
+    }
+
+    if(stage_->assets->has_mesh(batch.mesh_id)) {
+        stage_->assets->delete_mesh(batch.mesh_id);
+    }
+}
+
+void SpriteBatcher::write_batch(Batch& batch) {
+    auto mesh = stage_->assets->mesh(batch.mesh_id);
+    VertexData& vertices = mesh->shared_data;
+    IndexData& indices = mesh->first_submesh()->index_data;
+
+    const uint32_t stride = vertices.stride();
+    const uint32_t sprite_count = batch.sprites.size();
+
+    vertices.resize(sprite_count * VERTICES_PER_SPRITE);
+    uint8_t* out = vertices.data();
+
+    for(auto sprite: batch.sprites) {
+        auto source_mesh = stage_->assets->mesh(sprite->mesh_id());
+        VertexData& source = source_mesh->shared_data;
+
+        if(source.stride() != stride) {
+            throw std::logic_error("Batched sprites must share a vertex specification");
+        }
+
+        std::memcpy(out, source.data(), stride * VERTICES_PER_SPRITE);
+
+        Mat4 transform = sprite->absolute_transformation();
+        for(uint32_t i = 0; i < VERTICES_PER_SPRITE; ++i) {
+            kmVec3* position = (kmVec3*) (out + (i * stride) + vertices.position_offset());
+            kmVec3Transform(position, position, &transform);
+        }
+
+        out += stride * VERTICES_PER_SPRITE;
+    }
+
+    vertices.done();
+
+    // The quads never change shape, so the indices only need writing when the count does
+    if(sprite_count != batch.sprite_count) {
+        indices.resize(sprite_count * INDICES_PER_SPRITE);
+
+        if(sprite_count) {
+            Index* index = indices._raw_data();
+            for(uint32_t i = 0; i < sprite_count; ++i) {
+                Index first = i * VERTICES_PER_SPRITE;
+
+                *index++ = first;
+                *index++ = first + 1;
+                *index++ = first + 2;
+
+                *index++ = first;
+                *index++ = first + 2;
+                *index++ = first + 3;
+            }
+        }
+
+        indices.done();
+        batch.sprite_count = sprite_count;
+    }
+}
+
+void SpriteBatcher::update() {
+    // Forget any sprites which have been deleted
+    sprites_.erase(
+        std::remove_if(sprites_.begin(), sprites_.end(), [this](SpriteID id) { return !stage_->has_sprite(id); }),
+        sprites_.end()
+    );
+
+    for(auto& p: batches_) {
+        p.second.sprites.clear();
+    }
+
+    for(auto sprite_id: sprites_) {
+        Sprite* sprite = stage_->sprite(sprite_id);
+
+        // Sprites without a spritesheet have nothing to draw
+        if(!sprite->is_visible() || !sprite->material_id()) {
+            continue;
+        }
+
+        batch_for(BatchKey(sprite->layer(), sprite->material_id()), sprite).sprites.push_back(sprite);
+    }
+
+    for(auto it = batches_.begin(); it != batches_.end();) {
+        Batch& batch = it->second;
+
+        if(batch.sprites.empty() && ++batch.idle_updates > MAX_IDLE_UPDATES) {
+            destroy_batch(batch);
+            it = batches_.erase(it);
+            continue;
+        }
+
+        if(!batch.sprites.empty()) {
+            batch.idle_updates = 0;
+        }
+
+        // Batches which just emptied are written once more, so their last sprites disappear
+        if(!batch.sprites.empty() || batch.sprite_count) {
+            write_batch(batch);
+        }
+
+        ++it;
+    }
+}
+
+}
@@ -0,0 +1,70 @@
+#ifndef SPRITE_BATCHER_H
+#define SPRITE_BATCHER_H
+
+#include <map>
+#include <vector>
+
+#include "types.h"
+
+namespace kglt {
+
+class Stage;
+class Sprite;
+
+/*
+ * Draws the stage's batched sprites (see Stage::set_sprite_batching_enabled). Each frame the
+ * visible sprites are grouped by layer and material, and every group is written into the
+ * vertex data of a single actor, so it's one draw however many sprites it has. The actors use
+ * the layer as their render priority, so higher layers are drawn over lower ones; within a
+ * group sprites are drawn in the order they were created.
+ *
+ * The vertices are copied from each sprite's own (four vertex) mesh and transformed to world
+ * space, so anything which changes that mesh (frames, flipping, render dimensions) carries
+ * over. The batch actors cover the whole stage and aren't culled.
+ */
+class SpriteBatcher {
+public:
+    SpriteBatcher(Stage* stage);
+    ~SpriteBatcher();
+
+    SpriteBatcher(const SpriteBatcher&) = delete;
+    SpriteBatcher& operator=(const SpriteBatcher&) = delete;
+
+    void add_sprite(SpriteID sprite_id);
+
+    /* Rewrites every batch from the current state of its sprites */
+    void update();
+
+    uint32_t batch_count() const { return batches_.size(); }
+    uint32_t sprite_count() const { return sprites_.size(); }
+
+    /* The actor drawing the layer's sprites which use the material, null if there isn't one */
+    ActorID batch_actor(RenderPriority layer, MaterialID material) const;
+
+private:
+    /* Batches with no sprites are kept around for this many updates, in case sprites come back */
+    static const uint32_t MAX_IDLE_UPDATES = 120;
+
+    struct Batch {
+        MeshID mesh_id;
+        ActorID actor_id;
+        uint32_t idle_updates = 0;
+        uint32_t sprite_count = 0;
+
+        std::vector<Sprite*> sprites; // Scratch, refilled every update
+    };
+
+    typedef std::pair<RenderPriority, MaterialID> BatchKey;
+
+    Stage* stage_;
+    std::vector<SpriteID> sprites_;
+    std::map<BatchKey, Batch> batches_;
+
+    Batch& batch_for(const BatchKey& key, Sprite* sprite);
+    void write_batch(Batch& batch);
+    void destroy_batch(Batch& batch);
+};
+
+}
+
+#endif // SPRITE_BATCHER_H
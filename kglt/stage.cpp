@@ -23,7 +23,10 @@ Stage::Stage(StageID id, WindowBase *parent, AvailablePartitioner partitioner):
     SkyboxManager(parent, this),
     resource_manager_(ResourceManager::create(parent, parent->shared_assets.get())),
     ambient_light_(kglt::Colour::WHITE),
-    geom_manager_(new GeomManager()) {
+    geom_manager_(new GeomManager()),
+    transform_snapshot_(new TransformSnapshot()),
+    transform_store_(std::make_shared<TransformStore>()),
+    sprite_batcher_(new SpriteBatcher(this)) {
 
     set_partitioner(partitioner);
     render_queue_.reset(new batcher::RenderQueue(this, parent->renderer.get()));
@@ -42,10 +45,10 @@ bool Stage::init() {
 }
 
 void Stage::cleanup() {
-    SpriteManager::objects_.clear();
-    LightManager::objects_.clear();
-    ActorManager::objects_.clear();
-    CameraProxyManager::objects_.clear();
+    SpriteManager::clear();
+    LightManager::clear();
+    ActorManager::clear();
+    CameraProxyManager::clear();
 }
 
 void Stage::ask_owner_for_destruction() {
@@ -62,6 +65,13 @@ void Stage::on_subactor_material_changed(
     signal_actor_changed_(actor_id, evt);
 }
 
+void Stage::on_actor_render_priority_changed(ActorID actor_id, RenderPriority old, RenderPriority new_priority) {
+    ActorChangeEvent evt;
+    evt.type = ACTOR_CHANGE_TYPE_RENDER_PRIORITY_CHANGED;
+
+    signal_actor_changed_(actor_id, evt);
+}
+
 ActorID Stage::new_actor(RenderableCullingMode mode) {
     using namespace std::placeholders;
 
@@ -71,6 +81,9 @@ ActorID Stage::new_actor(RenderableCullingMode mode) {
     actor(result)->signal_subactor_material_changed().connect(
         std::bind(&Stage::on_subactor_material_changed, this, _1, _2, _3, _4)
     );
+    actor(result)->signal_render_priority_changed().connect(
+        std::bind(&Stage::on_actor_render_priority_changed, this, _1, _2, _3)
+    );
 
     //Tell everyone about the new actor
     signal_actor_created_(result);
@@ -86,6 +99,9 @@ ActorID Stage::new_actor_with_mesh(MeshID mid, RenderableCullingMode mode) {
     actor(result)->signal_subactor_material_changed().connect(
         std::bind(&Stage::on_subactor_material_changed, this, _1, _2, _3, _4)
     );
+    actor(result)->signal_render_priority_changed().connect(
+        std::bind(&Stage::on_actor_render_priority_changed, this, _1, _2, _3)
+    );
 
     //If a mesh was specified, set it
     if(mid) {
@@ -365,6 +381,29 @@ void Stage::set_partitioner(AvailablePartitioner partitioner) {
 
 void Stage::update(double dt) {
     resource_manager_->update(dt);
+    signal_update_(dt);
+}
+
+void Stage::update_transforms() {
+    // Resolve every world transform in one linear sweep, then notify anyone listening
+    transform_store_->update();
+
+    std::vector<MoveableObject*> moved;
+
+    // Only the objects which were touched this frame, each exactly once
+    for(auto index: transform_store_->take_changed()) {
+        /* Looked up each time, as a listener could destroy an object we haven't reached yet */
+        MoveableObject* object = transform_store_->owner(index);
+        if(object && object->_dispatch_transformation_changed(transform_notification_epsilon_, transform_notification_angle_)) {
+            moved.push_back(object);
+        }
+    }
+
+    if(!moved.empty()) {
+        signal_objects_moved_(moved);
+    }
+
+    sprite_batcher_->update();
 }
 
 void Stage::on_actor_created(ActorID actor_id) {
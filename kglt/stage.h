@@ -15,12 +15,16 @@
 #include "types.h"
 #include "resource_manager.h"
 #include "window_base.h"
+#include "transform_snapshot.h"
+#include "transform_store.h"
+#include "sprite_batcher.h"
 
 namespace kglt {
 
 class SubActor;
 enum ActorChangeType {
-    ACTOR_CHANGE_TYPE_SUBACTOR_MATERIAL_CHANGED
+    ACTOR_CHANGE_TYPE_SUBACTOR_MATERIAL_CHANGED,
+    ACTOR_CHANGE_TYPE_RENDER_PRIORITY_CHANGED
 };
 
 struct SubActorMaterialChangeData {
@@ -59,6 +63,9 @@ typedef sig::signal<void (GeomID)> GeomDestroyedSignal;
 typedef sig::signal<void (ParticleSystemID)> ParticleSystemCreatedSignal;
 typedef sig::signal<void (ParticleSystemID)> ParticleSystemDestroyedSignal;
 
+typedef sig::signal<void (const std::vector<MoveableObject*>&)> ObjectsMovedSignal;
+typedef sig::signal<void (double)> StageUpdatedSignal;
+
 class Stage:
     public Managed<Stage>,
     public generic::Identifiable<StageID>,
@@ -120,6 +127,16 @@ public:
     void delete_sprite(SpriteID s);
     uint32_t sprite_count() const;
 
+    /*
+     * When enabled, sprites created from then on don't get an actor each. Instead they're drawn
+     * by the sprite batcher, which writes all the sprites sharing a layer and material into one
+     * vertex stream every frame so that they're a single draw. Batched sprites have no actor
+     * (actor_id() is null) and aren't culled individually. Sprites which already exist keep
+     * being drawn the way they were.
+     */
+    void set_sprite_batching_enabled(bool value=true) { sprite_batching_enabled_ = value; }
+    bool sprite_batching_enabled() const { return sprite_batching_enabled_; }
+
     LightID new_light(LightType type=LIGHT_TYPE_POINT);
     LightID new_light(MoveableObject& parent, LightType type=LIGHT_TYPE_POINT);
     LightPtr light(LightID light);
@@ -151,6 +168,12 @@ public:
     Property<Stage, Partitioner> partitioner = { this, &Stage::partitioner_ };
     Property<Stage, ResourceManager> assets = { this, &Stage::resource_manager_ };
     Property<Stage, generic::DataCarrier> data = { this, &Stage::data_ };
+    Property<Stage, TransformSnapshot> transform_snapshot = { this, &Stage::transform_snapshot_ };
+    Property<Stage, TransformStore> transforms = { this, &Stage::transform_store_ };
+    Property<Stage, SpriteBatcher> sprite_batcher = { this, &Stage::sprite_batcher_ };
+
+    // Internal, objects keep the store alive as they may be destroyed after the stage's members
+    TransformStore::ptr _transforms_as_shared_ptr() const { return transform_store_; }
 
     bool init() override;
     void cleanup() override;
@@ -159,6 +182,23 @@ public:
 
     void update(double dt) override;
 
+    /* Sends the (coalesced) transformation changed signals of everything that moved since the
+     * last call, then signal_objects_moved with the whole batch. The window calls this once per
+     * frame before rendering, so the partitioner sees each moved object exactly once. Batched
+     * sprites are written out afterwards, from their final transforms */
+    void update_transforms();
+
+    /* Objects which moved less than distance (in world units) and rotated by less than angle
+     * since they were last signalled aren't signalled. Zero (the default for both) signals any
+     * change at all */
+    void set_transform_notification_epsilon(float distance, const Degrees& angle=Degrees(0)) {
+        transform_notification_epsilon_ = distance;
+        transform_notification_angle_ = angle;
+    }
+
+    float transform_notification_epsilon() const { return transform_notification_epsilon_; }
+    Degrees transform_notification_angle() const { return transform_notification_angle_; }
+
     // Locateable interface
 
     Vec3 position() const override { return Vec3(); }
@@ -196,6 +236,12 @@ public:
     sig::signal<void (SpriteID)>& signal_sprite_created() { return signal_sprite_created_; }
     sig::signal<void (SpriteID)>& signal_sprite_destroyed() { return signal_sprite_destroyed_; }
 
+    ObjectsMovedSignal& signal_objects_moved() { return signal_objects_moved_; }
+
+    /* Fired by update() once a frame, always on the main thread (unlike the window's step signal,
+     * which runs on the simulation thread when that's threaded) */
+    StageUpdatedSignal& signal_update() { return signal_update_; }
+
 private:
     ActorCreatedSignal signal_actor_created_;
     ActorDestroyedSignal signal_actor_destroyed_;
@@ -210,6 +256,11 @@ private:
     sig::signal<void (SpriteID)> signal_sprite_created_;
     sig::signal<void (SpriteID)> signal_sprite_destroyed_;
 
+    ObjectsMovedSignal signal_objects_moved_;
+    StageUpdatedSignal signal_update_;
+    float transform_notification_epsilon_ = 0.0f;
+    Degrees transform_notification_angle_ = Degrees(0);
+
     std::shared_ptr<Partitioner> partitioner_;
 
     void set_partitioner(AvailablePartitioner partitioner);
@@ -227,6 +278,11 @@ private:
     std::shared_ptr<ResourceManager> resource_manager_;
     kglt::Colour ambient_light_;
     std::unique_ptr<GeomManager> geom_manager_;
+    std::unique_ptr<TransformSnapshot> transform_snapshot_;
+    TransformStore::ptr transform_store_;
+
+    bool sprite_batching_enabled_ = false;
+    std::unique_ptr<SpriteBatcher> sprite_batcher_;
 
     generic::DataCarrier data_;
 
@@ -234,6 +290,7 @@ private:
     void on_actor_created(ActorID actor_id);
     void on_actor_destroyed(ActorID actor_id);
     void on_subactor_material_changed(ActorID actor_id, SubActor* subactor, MaterialID old, MaterialID newM);
+    void on_actor_render_priority_changed(ActorID actor_id, RenderPriority old, RenderPriority new_priority);
 };
 
 
@@ -1,5 +1,9 @@
 #include <cassert>
+#include <algorithm>
+#include <cstring>
 #include <stdexcept>
+#include <future>
+#include <set>
 
 #include "utils/gl_thread_check.h"
 #include "utils/gl_error.h"
@@ -9,6 +13,7 @@
 #include "window_base.h"
 #include "texture.h"
 #include "resource_manager.h"
+#include "renderers/renderer.h"
 
 #ifdef KGLT_GL_VERSION_2X
 #include "./renderers/gl2x/glad/glad/glad.h"
@@ -21,6 +26,90 @@ namespace kglt {
 const std::string Texture::BuiltIns::CHECKERBOARD = "kglt/materials/textures/checkerboard.png";
 const std::string Texture::BuiltIns::BUTTON = "kglt/materials/textures/button.png";
 
+namespace {
+
+/* The GL format to upload a compressed texture as, or 0 if the driver doesn't support it and it must be
+ * decompressed. Only call this from the GL thread */
+uint32_t supported_gl_format(TextureFormat format) {
+#ifdef KGLT_GL_VERSION_2X
+    static const std::set<uint32_t> supported = []() {
+        GLint count = 0;
+        GLCheck(glGetIntegerv, GL_NUM_COMPRESSED_TEXTURE_FORMATS, &count);
+
+        std::vector<GLint> formats(std::max(count, 1));
+        if(count) {
+            GLCheck(glGetIntegerv, GL_COMPRESSED_TEXTURE_FORMATS, &formats[0]);
+        }
+
+        return std::set<uint32_t>(formats.begin(), formats.begin() + count);
+    }();
+
+    uint32_t gl_format = texture_format_to_gl(format);
+    if(supported.count(gl_format)) {
+        return gl_format;
+    }
+
+    // ETC2 decoders handle ETC1 data, and some drivers only list the ETC2 formats
+    if(format == TEXTURE_FORMAT_ETC1 && supported.count(texture_format_to_gl(TEXTURE_FORMAT_ETC2_RGB))) {
+        return texture_format_to_gl(TEXTURE_FORMAT_ETC2_RGB);
+    }
+#endif
+    return 0;
+}
+
+bool rects_touch(const Texture::DirtyRect& a, const Texture::DirtyRect& b) {
+    return a.x <= b.x + b.width && b.x <= a.x + a.width &&
+           a.y <= b.y + b.height && b.y <= a.y + a.height;
+}
+
+Texture::DirtyRect rect_union(const Texture::DirtyRect& a, const Texture::DirtyRect& b) {
+    Texture::DirtyRect result;
+    result.x = std::min(a.x, b.x);
+    result.y = std::min(a.y, b.y);
+    result.width = std::max(a.x + a.width, b.x + b.width) - result.x;
+    result.height = std::max(a.y + a.height, b.y + b.height) - result.y;
+    return result;
+}
+
+/* Halves the level in each direction (down to 1), averaging each 2x2 block of pixels */
+Texture::Data downsample(const Texture::Data& source, uint32_t width, uint32_t height, uint32_t channels) {
+    const uint32_t new_width = std::max(width / 2, 1u);
+    const uint32_t new_height = std::max(height / 2, 1u);
+
+    Texture::Data result(new_width * new_height * channels);
+
+    for(uint32_t y = 0; y < new_height; ++y) {
+        const uint32_t y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+
+        for(uint32_t x = 0; x < new_width; ++x) {
+            const uint32_t x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+
+            for(uint32_t c = 0; c < channels; ++c) {
+                uint32_t total = source[((y0 * width) + x0) * channels + c] +
+                    source[((y0 * width) + x1) * channels + c] +
+                    source[((y1 * width) + x0) * channels + c] +
+                    source[((y1 * width) + x1) * channels + c];
+
+                result[((y * new_width) + x) * channels + c] = (total + 2) / 4;
+            }
+        }
+    }
+
+    return result;
+}
+
+void flip_rows(Texture::Data& data, uint32_t width, uint32_t height, uint32_t channels) {
+    const uint32_t row = width * channels;
+
+    for(uint32_t j = 0; j * 2 < height; ++j) {
+        auto top = data.begin() + (j * row);
+        auto bottom = data.begin() + ((height - 1 - j) * row);
+        std::swap_ranges(top, top + row, bottom);
+    }
+}
+
+}
+
 Texture::~Texture() {
     if(gl_tex_) {
         GLCheck(glDeleteTextures, 1, &gl_tex_);
@@ -36,11 +125,212 @@ void Texture::resize(uint32_t width, uint32_t height) {
     width_ = width;
     height_ = height;
 
+    format_ = TEXTURE_FORMAT_UNCOMPRESSED;
+    mipmaps_.clear();
+    dirty_rects_.clear();
+
     data_.clear();
     data_.resize(width * height * (bpp_ / 8));
 }
 
-void Texture::sub_texture(TextureID src, uint16_t offset_x, uint16_t offset_y) {
+void Texture::set_compressed_data(TextureFormat format, uint32_t width, uint32_t height, std::vector<Data> levels) {
+    if(format == TEXTURE_FORMAT_UNCOMPRESSED) {
+        throw std::logic_error("Tried to set compressed data without a compressed format");
+    }
+
+    if(levels.empty()) {
+        throw std::logic_error("Compressed textures need at least one level");
+    }
+
+    uint32_t w = width, h = height;
+    for(auto& level: levels) {
+        if(level.size() < compressed_level_size(format, w, h)) {
+            throw std::logic_error("Not enough data for a level of the compressed texture");
+        }
+
+        w = std::max(w / 2, 1u);
+        h = std::max(h / 2, 1u);
+    }
+
+    // Compressed formats decode to RGBA
+    bpp_ = 32;
+    width_ = width;
+    height_ = height;
+    format_ = format;
+
+    data_.swap(levels[0]);
+    mipmaps_.assign(
+        std::make_move_iterator(levels.begin() + 1),
+        std::make_move_iterator(levels.end())
+    );
+}
+
+void Texture::set_mipmap_data(std::vector<Data> levels) {
+    if(levels.empty() || is_compressed()) {
+        throw std::logic_error("Mipmap data must be uncompressed and include the full size level");
+    }
+
+    uint32_t w = width_, h = height_;
+    for(auto& level: levels) {
+        if(level.size() != w * h * channels()) {
+            throw std::logic_error("Mipmap levels must halve in size, and match the bpp of the texture");
+        }
+
+        w = std::max(w / 2, 1u);
+        h = std::max(h / 2, 1u);
+    }
+
+    data_.swap(levels[0]);
+    mipmaps_.assign(
+        std::make_move_iterator(levels.begin() + 1),
+        std::make_move_iterator(levels.end())
+    );
+}
+
+void Texture::decompress() {
+    if(!is_compressed()) {
+        return;
+    }
+
+    std::vector<Data> levels;
+
+    uint32_t w = width_, h = height_;
+    for(uint32_t i = 0; i < mipmap_count(); ++i) {
+        Data rgba(w * h * 4);
+        decompress_level(format_, w, h, &mipmap_data(i)[0], &rgba[0]);
+        levels.push_back(std::move(rgba));
+
+        w = std::max(w / 2, 1u);
+        h = std::max(h / 2, 1u);
+    }
+
+    format_ = TEXTURE_FORMAT_UNCOMPRESSED;
+    bpp_ = 32;
+
+    data_.swap(levels[0]);
+    mipmaps_.assign(
+        std::make_move_iterator(levels.begin() + 1),
+        std::make_move_iterator(levels.end())
+    );
+}
+
+std::size_t Texture::cpu_memory_usage() const {
+    std::size_t total = data_.capacity();
+    for(auto& level: mipmaps_) {
+        total += level.capacity();
+    }
+    return total;
+}
+
+uint32_t Texture::full_mipmap_count() const {
+    uint32_t count = 1;
+    uint32_t size = std::max(width_, height_);
+    while(size > 1) {
+        size /= 2;
+        ++count;
+    }
+    return count;
+}
+
+std::size_t Texture::level_size(uint32_t level) const {
+    if(is_compressed()) {
+        return compressed_level_size(format_, level_width(level), level_height(level));
+    }
+
+    return level_width(level) * level_height(level) * channels();
+}
+
+void Texture::generate_mipmap_data() {
+    if(is_compressed()) {
+        throw std::logic_error("Mipmaps can't be generated from compressed data");
+    }
+
+    while(mipmap_count() < full_mipmap_count()) {
+        uint32_t level = mipmap_count() - 1;
+        mipmaps_.push_back(downsample(mipmap_data(level), level_width(level), level_height(level), channels()));
+    }
+}
+
+void Texture::__do_upload_levels(uint32_t first_level, std::vector<Texture::Data>& levels, TextureWrap wrap, TextureFilter filter) {
+#ifdef KGLT_GL_VERSION_2X
+    const uint32_t end = first_level + levels.size();
+    const uint32_t expected_end = (streaming_.streaming) ? streaming_.resident_mip : full_mipmap_count();
+
+    if(levels.empty() || end != expected_end) {
+        throw std::logic_error("Streamed levels must join on to the resident levels");
+    }
+
+    if(!gl_tex_) {
+        GLCheck(glGenTextures, 1, &gl_tex_);
+    }
+
+    GLCheck(glBindTexture, GL_TEXTURE_2D, gl_tex_);
+    GLCheck(glPixelStorei, GL_UNPACK_ALIGNMENT, 1);
+
+    // Falls back to decoding each level if the driver can't take the format
+    const uint32_t gl_format = (is_compressed()) ? supported_gl_format(format_) : 0;
+
+    level_bytes_.resize(full_mipmap_count(), 0);
+    for(uint32_t i = 0; i < levels.size(); ++i) {
+        level_bytes_[first_level + i] = upload_level(gl_format, first_level + i, levels[i]);
+    }
+
+    if(!streaming_.streaming) {
+        streaming_.streaming = true;
+        streaming_.always_resident_mip = first_level;
+        streaming_.requested_mip = first_level;
+
+        GLCheck(glTexParameteri, GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, GLint(full_mipmap_count() - 1));
+        apply_sampler_parameters(MIPMAP_GENERATE_COMPLETE, wrap, filter);
+    }
+
+    // Levels below the base level are ignored, so the texture is complete from the resident levels alone
+    streaming_.resident_mip = first_level;
+    GLCheck(glTexParameteri, GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, GLint(first_level));
+
+    streaming_.resident_bytes = 0;
+    for(auto bytes: level_bytes_) {
+        streaming_.resident_bytes += bytes;
+    }
+    gpu_memory_usage_ = streaming_.resident_bytes;
+#else
+    throw std::logic_error("Texture streaming needs GL 2.x");
+#endif
+}
+
+void Texture::upload_levels(uint32_t first_level, std::vector<Texture::Data> levels, TextureWrap wrap, TextureFilter filter) {
+    // Shared so the levels aren't copied if this has to be queued for the GL thread
+    auto shared_levels = std::make_shared<std::vector<Texture::Data>>(std::move(levels));
+
+    run_on_gl_thread([=]() {
+        this->__do_upload_levels(first_level, *shared_levels, wrap, filter);
+    });
+}
+
+void Texture::__do_release_levels(uint32_t resident_mip) {
+#ifdef KGLT_GL_VERSION_2X
+    resident_mip = std::min(resident_mip, streaming_.always_resident_mip);
+
+    if(!streaming_.streaming || resident_mip <= streaming_.resident_mip) {
+        return;
+    }
+
+    GLCheck(glBindTexture, GL_TEXTURE_2D, gl_tex_);
+    GLCheck(glTexParameteri, GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, GLint(resident_mip));
+
+    // Respecifying a level as empty is the only way GL 2 has to give its memory back
+    for(uint32_t level = streaming_.resident_mip; level < resident_mip; ++level) {
+        GLCheck(glTexImage2D, GL_TEXTURE_2D, level, GL_RGBA, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        streaming_.resident_bytes -= level_bytes_[level];
+        level_bytes_[level] = 0;
+    }
+
+    streaming_.resident_mip = resident_mip;
+    gpu_memory_usage_ = streaming_.resident_bytes;
+#endif
+}
+
+void Texture::sub_texture(TextureID src, uint32_t offset_x, uint32_t offset_y) {
     auto source_ptr = resource_manager().texture(src); //Lock
 
     //Bad things...
@@ -55,22 +345,119 @@ void Texture::sub_texture(TextureID src, uint16_t offset_x, uint16_t offset_y) {
         throw std::logic_error("Tried to blit texture of a different colour depth");
     }
 
-    for(uint16_t j = 0; j < source.height(); ++j) {
-        for(uint16_t i = 0; i < source.width(); ++i) {
-            uint16_t idx = ((width() * (offset_y + j)) + (offset_x + i)) * (bpp() / 8);
-            uint16_t source_idx = ((source.width() * j) + i) * (bpp() / 8);
+    if(is_compressed() || source.is_compressed()) {
+        throw std::logic_error("Compressed textures must be decompressed before blitting");
+    }
+
+    const std::size_t row = std::size_t(source.width()) * channels();
+
+    if(data_.size() < std::size_t(width_) * height_ * channels() || source.data_.size() < row * source.height()) {
+        throw std::logic_error("Tried to blit a texture after its data was freed");
+    }
+
+    for(uint32_t j = 0; j < source.height(); ++j) {
+        std::size_t idx = ((std::size_t(width_) * (offset_y + j)) + offset_x) * channels();
+        std::memcpy(&data_[idx], &source.data_[row * j], row);
+    }
+
+    mark_dirty(offset_x, offset_y, source.width(), source.height());
 
-            data()[idx] = source.data()[source_idx];
-            data()[idx+1] = source.data()[source_idx+1];
-            data()[idx+2] = source.data()[source_idx+2];
-            if(bpp() == 32) {
-                data()[idx+3] = source.data()[source_idx+3];
+    if(gl_tex_) {
+        upload_dirty();
+    } else {
+        upload(MIPMAP_GENERATE_COMPLETE, TEXTURE_WRAP_REPEAT, TEXTURE_FILTER_NEAREST, false);
+    }
+}
+
+void Texture::mark_dirty(uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+    if(is_compressed()) {
+        throw std::logic_error("Compressed textures can't be partially updated");
+    }
+
+    if(x + width > width_ || y + height > height_) {
+        throw std::out_of_range("Dirty rectangle is outside the texture");
+    }
+
+    if(!width || !height) {
+        return;
+    }
+
+    DirtyRect rect;
+    rect.x = x;
+    rect.y = y;
+    rect.width = width;
+    rect.height = height;
+
+    // Absorb any rectangles this one touches, checking again each time it grows
+    bool merged = true;
+    while(merged) {
+        merged = false;
+        for(auto it = dirty_rects_.begin(); it != dirty_rects_.end(); ++it) {
+            if(rects_touch(*it, rect)) {
+                rect = rect_union(*it, rect);
+                dirty_rects_.erase(it);
+                merged = true;
+                break;
             }
         }
     }
 
-    //FIXME: SHould use glTexSubImage
-    upload();
+    dirty_rects_.push_back(rect);
+
+    if(dirty_rects_.size() > MAX_DIRTY_RECTS) {
+        for(auto& other: dirty_rects_) {
+            rect = rect_union(rect, other);
+        }
+
+        dirty_rects_.assign(1, rect);
+    }
+}
+
+void Texture::upload_dirty() {
+    run_on_gl_thread([this]() {
+        this->__do_upload_dirty();
+    });
+}
+
+void Texture::__do_upload_dirty() {
+    if(dirty_rects_.empty()) {
+        return;
+    }
+
+    if(!gl_tex_) {
+        throw std::logic_error("Tried to update part of a texture which hasn't been uploaded");
+    }
+
+    if(data_.size() < std::size_t(width_) * height_ * channels()) {
+        throw std::logic_error("Tried to update a texture after its data was freed");
+    }
+
+    GLCheck(glBindTexture, GL_TEXTURE_2D, gl_tex_);
+    GLCheck(glPixelStorei, GL_UNPACK_ALIGNMENT, 1);
+
+    // Rows of each rectangle are read straight out of data_, so GL needs the full row length
+    GLCheck(glPixelStorei, GL_UNPACK_ROW_LENGTH, width_);
+
+    for(auto& rect: dirty_rects_) {
+        std::size_t idx = ((std::size_t(width_) * rect.y) + rect.x) * channels();
+
+        GLCheck(glTexSubImage2D,
+            GL_TEXTURE_2D, 0,
+            rect.x, rect.y, rect.width, rect.height,
+            (bpp_ == 32) ? GL_RGBA : GL_RGB,
+            GL_UNSIGNED_BYTE, &data_[idx]
+        );
+    }
+
+    GLCheck(glPixelStorei, GL_UNPACK_ROW_LENGTH, 0);
+
+    if(uploaded_mipmap_ == MIPMAP_GENERATE_COMPLETE) {
+#ifdef KGLT_GL_VERSION_2X
+        GLCheck(glGenerateMipmap, GL_TEXTURE_2D);
+#endif
+    }
+
+    dirty_rects_.clear();
 }
 
 void Texture::__do_upload(MipmapGenerate mipmap, TextureWrap wrap, TextureFilter filter, bool free_after) {
@@ -78,25 +465,71 @@ void Texture::__do_upload(MipmapGenerate mipmap, TextureWrap wrap, TextureFilter
         GLCheck(glGenTextures, 1, &gl_tex_);
     }
 
+    uint32_t gl_format = 0;
+    if(is_compressed()) {
+        gl_format = supported_gl_format(format_);
+        if(!gl_format) {
+            L_DEBUG("Compressed texture format isn't supported by the driver, decompressing");
+            decompress();
+        }
+    }
+
     GLCheck(glBindTexture, GL_TEXTURE_2D, gl_tex_);
     GLCheck(glPixelStorei, GL_PACK_ALIGNMENT,1);
     GLCheck(glPixelStorei, GL_UNPACK_ALIGNMENT,1);
-    GLCheck(glTexImage2D,
-        GL_TEXTURE_2D,
-        0, (bpp_ == 32)? GL_RGBA: GL_RGB,
-        width_, height_, 0,
-        (bpp_ == 32) ? GL_RGBA : GL_RGB,
-        GL_UNSIGNED_BYTE, &data_[0]
-    );
+
+    gpu_memory_usage_ = upload_level(gl_format, 0, data_);
+
+    bool prebuilt_mipmaps = false;
+
     if(mipmap == MIPMAP_GENERATE_COMPLETE) {
+        if(!mipmaps_.empty()) {
+            // The file came with its mipmaps, so use those rather than generating them
+            for(uint32_t i = 0; i < mipmaps_.size(); ++i) {
+                gpu_memory_usage_ += upload_level(gl_format, i + 1, mipmaps_[i]);
+            }
+
+            prebuilt_mipmaps = true;
+        } else if(gl_format) {
+            // GL can't generate mipmaps from compressed data
+            L_WARN("Compressed texture has no mipmaps, mipmapping is disabled for it");
+            mipmap = MIPMAP_GENERATE_NONE;
+        } else {
 #ifdef KGLT_GL_VERSION_1X
-        // FIXME: OpenGL >= 1.4 - may need to look for GL_SGIS_generate_mipmap extension
-        //GLCheck(glTexParameteri, GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_TRUE);
+            // FIXME: OpenGL >= 1.4 - may need to look for GL_SGIS_generate_mipmap extension
+            //GLCheck(glTexParameteri, GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_TRUE);
 #else
-        GLCheck(glGenerateMipmap, GL_TEXTURE_2D);
+            GLCheck(glGenerateMipmap, GL_TEXTURE_2D);
+
+            uint32_t w = width_, h = height_;
+            while(w > 1 || h > 1) {
+                w = std::max(w / 2, 1u);
+                h = std::max(h / 2, 1u);
+                gpu_memory_usage_ += w * h * (bpp_ / 8);
+            }
 #endif
+        }
     }
 
+#ifdef KGLT_GL_VERSION_2X
+    // Files don't always include every level down to 1x1, without this the texture would be incomplete
+    GLCheck(glTexParameteri, GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (prebuilt_mipmaps) ? GLint(mipmaps_.size()) : 1000);
+#else
+    (void) prebuilt_mipmaps;
+#endif
+
+    apply_sampler_parameters(mipmap, wrap, filter);
+
+    // The whole texture has just been sent, so nothing is outstanding
+    dirty_rects_.clear();
+    uploaded_mipmap_ = mipmap;
+
+    if(free_after) {
+        free();
+    }
+}
+
+void Texture::apply_sampler_parameters(MipmapGenerate mipmap, TextureWrap wrap, TextureFilter filter) {
     switch(wrap) {
         case TEXTURE_WRAP_REPEAT: {
             GLCheck(glTexParameteri, GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -131,51 +564,128 @@ void Texture::__do_upload(MipmapGenerate mipmap, TextureWrap wrap, TextureFilter
         }
         GLCheck(glTexParameteri, GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     }
+}
 
-    if(free_after) {
-        free();
+std::size_t Texture::upload_level(uint32_t gl_format, uint32_t level, const Texture::Data& data) {
+    const uint32_t width = level_width(level);
+    const uint32_t height = level_height(level);
+
+#ifdef KGLT_GL_VERSION_2X
+    if(gl_format) {
+        const std::size_t size = compressed_level_size(format_, width, height);
+        GLCheck(glCompressedTexImage2D,
+            GL_TEXTURE_2D,
+            level, gl_format,
+            width, height, 0,
+            size, &data[0]
+        );
+        return size;
+    }
+#endif
+
+    if(is_compressed()) {
+        // The driver can't take this format, so decode the level (only streamed levels arrive here)
+        Texture::Data rgba(width * height * 4);
+        decompress_level(format_, width, height, &data[0], &rgba[0]);
+
+        GLCheck(glTexImage2D,
+            GL_TEXTURE_2D,
+            level, GL_RGBA,
+            width, height, 0,
+            GL_RGBA, GL_UNSIGNED_BYTE, &rgba[0]
+        );
+        return rgba.size();
     }
+
+    GLCheck(glTexImage2D,
+        GL_TEXTURE_2D,
+        level, (bpp_ == 32)? GL_RGBA: GL_RGB,
+        width, height, 0,
+        (bpp_ == 32) ? GL_RGBA : GL_RGB,
+        GL_UNSIGNED_BYTE, &data[0]
+    );
+    return width * height * (bpp_ / 8);
 }
 
 void Texture::upload(MipmapGenerate mipmap, TextureWrap wrap, TextureFilter filter, bool free_after) {
+    run_on_gl_thread([=]() {
+        this->__do_upload(mipmap, wrap, filter, free_after);
+    });
+}
+
+void Texture::run_on_gl_thread(std::function<void ()> func) {
     if(GLThreadCheck::is_current()) {
-        __do_upload(mipmap, wrap, filter, free_after);
+        func();
     } else {
 
         //FIXME: This might get hairy if more than one thread is messing with the texture
         //as we do an unlocked access here (which is fine when it's only this thread and the
         //main thread, but if there's another one then, that could be bad news)
-        resource_manager().window->idle->add_once([=] {
-            this->__do_upload(mipmap, wrap, filter, free_after);
+        auto done = std::make_shared<std::promise<void>>();
+        auto future = done->get_future();
+
+        resource_manager().window->renderer->uploads->push([=]() {
+            try {
+                func();
+                done->set_value();
+            } catch(...) {
+                done->set_exception(std::current_exception());
+            }
         });
 
-        //Wait for the main thread to process the upload
-        resource_manager().window->idle->wait();
+        //Wait for the main thread to process the upload, rethrows any upload errors
+        future.get();
     }
 }
 
 void Texture::flip_vertically() {
     /**
-     *  Flips the texture data vertically
+     *  Flips the texture data vertically, including any mipmaps
      */
 
-    for(uint32_t j = 0; j * 2 < (uint32_t) height(); ++j)
-    {
-        int index1 = j * width() * channels();
-        int index2 = (height() - 1 - j) * width() * channels();
-        for(uint32_t i = width() * channels(); i > 0; --i )
-        {
-            uint8_t temp = data_[index1];
-            data_[index1] = data_[index2];
-            data_[index2] = temp;
-            ++index1;
-            ++index2;
+    if(is_compressed()) {
+        uint32_t flipped = 0;
+
+        uint32_t w = width_, h = height_;
+        for(uint32_t i = 0; i < mipmap_count(); ++i) {
+            if(!flip_compressed_level(format_, w, h, mipmap_data(i))) {
+                break;
+            }
+
+            ++flipped;
+            w = std::max(w / 2, 1u);
+            h = std::max(h / 2, 1u);
+        }
+
+        if(flipped == mipmap_count()) {
+            return;
         }
+
+        // Flipping is its own inverse, so put back the levels that were done and decode instead
+        w = width_;
+        h = height_;
+        for(uint32_t i = 0; i < flipped; ++i) {
+            flip_compressed_level(format_, w, h, mipmap_data(i));
+            w = std::max(w / 2, 1u);
+            h = std::max(h / 2, 1u);
+        }
+
+        L_WARN("Decompressing a texture which can't be flipped while compressed");
+        decompress();
+    }
+
+    uint32_t w = width_, h = height_;
+    for(uint32_t i = 0; i < mipmap_count(); ++i) {
+        flip_rows(mipmap_data(i), w, h, channels());
+        w = std::max(w / 2, 1u);
+        h = std::max(h / 2, 1u);
     }
 }
 
 void Texture::free() {
-    data_.clear();
+    // Swap rather than clear so the memory is actually released
+    Texture::Data().swap(data_);
+    std::vector<Texture::Data>().swap(mipmaps_);
 }
 
 }
@@ -1,8 +1,10 @@
 #ifndef TEXTURE_H_INCLUDED
 #define TEXTURE_H_INCLUDED
 
+#include <algorithm>
 #include <cstdint>
 #include <memory>
+#include <functional>
 #include <vector>
 #include "generic/identifiable.h"
 #include "generic/managed.h"
@@ -10,6 +12,7 @@
 #include "types.h"
 #include "resource.h"
 #include "interfaces.h"
+#include "texture_compression.h"
 
 namespace kglt {
 
@@ -79,7 +82,108 @@ public:
 
     Texture::Data& data() { return data_; }
 
-    void sub_texture(TextureID src, uint16_t offset_x, uint16_t offset_y);
+    /*
+     * Replaces the texture with block compressed data (e.g. from a KTX or DDS file), the first
+     * level is the full size image and any others are its mipmaps, each half the size of the last.
+     * When the texture is uploaded the levels are passed to GL as they are if the driver supports
+     * the format, otherwise they're decompressed first. With mipmaps included, uploading with
+     * MIPMAP_GENERATE_COMPLETE uses them rather than generating them.
+     */
+    void set_compressed_data(TextureFormat format, uint32_t width, uint32_t height, std::vector<Data> levels);
+
+    /* Replaces the texture with uncompressed levels, for files which include their own mipmaps */
+    void set_mipmap_data(std::vector<Data> levels);
+
+    /* Decodes compressed data to RGBA, including any mipmaps */
+    void decompress();
+
+    TextureFormat format() const { return format_; }
+    bool is_compressed() const { return format_ != TEXTURE_FORMAT_UNCOMPRESSED; }
+
+    /* The number of levels held, including the full size image */
+    uint32_t mipmap_count() const { return mipmaps_.size() + 1; }
+    Texture::Data& mipmap_data(uint32_t level) { return (level) ? mipmaps_.at(level - 1) : data_; }
+
+    /* The number of levels in a complete mipmap chain, down to 1x1 */
+    uint32_t full_mipmap_count() const;
+
+    uint32_t level_width(uint32_t level) const { return std::max(width_ >> level, 1u); }
+    uint32_t level_height(uint32_t level) const { return std::max(height_ >> level, 1u); }
+
+    /* The size in bytes of a level in the texture's format */
+    std::size_t level_size(uint32_t level) const;
+
+    /* Builds the rest of the mipmap chain on the CPU by averaging each 2x2 block of the level
+     * above, for uncompressed textures which don't have all their mipmaps already */
+    void generate_mipmap_data();
+
+    /*
+     * Streamed textures (see TextureStreamer) keep only their smallest mipmaps on the GPU all
+     * the time. More detailed levels are loaded when the texture is drawn large enough to need
+     * them, and released again when it isn't. Levels are numbered from the full size image, so
+     * a resident_mip of 2 means the texture is currently a quarter of its full width.
+     */
+    struct StreamingStatus {
+        bool streaming = false;
+        uint32_t resident_mip = 0; ///< The most detailed level on the GPU
+        uint32_t requested_mip = 0; ///< The most detailed level the streamer wants on the GPU
+        uint32_t always_resident_mip = 0; ///< This level and smaller are never released
+        std::size_t resident_bytes = 0;
+    };
+
+    /* Updated on the GL thread as levels are uploaded and released */
+    StreamingStatus streaming_status() const { return streaming_; }
+    void _set_requested_mip(uint32_t level) { streaming_.requested_mip = level; }
+
+    /*
+     * Uploads levels first_level onwards (levels[0] is first_level) for streaming. The first
+     * call sets the texture up for streaming and must include every level down to 1x1, the
+     * levels it uploads are the ones which are always resident. Later calls must end where the
+     * resident levels begin. The wrap and filter are only applied by the first call.
+     */
+    void __do_upload_levels(uint32_t first_level, std::vector<Data>& levels, TextureWrap wrap, TextureFilter filter);
+    void upload_levels(uint32_t first_level, std::vector<Data> levels, TextureWrap wrap, TextureFilter filter);
+
+    /* Releases the GPU memory of every level more detailed than resident_mip */
+    void __do_release_levels(uint32_t resident_mip);
+
+    /*
+     * Copies the source texture into this one at the offset. If this texture has already been
+     * uploaded only the changed area is sent to GL, otherwise the whole texture is uploaded
+     * (keeping its data, so it can be blitted into again).
+     */
+    void sub_texture(TextureID src, uint32_t offset_x, uint32_t offset_y);
+
+    /* A region of the texture which has changed since it was last uploaded */
+    struct DirtyRect {
+        uint32_t x = 0;
+        uint32_t y = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+    };
+
+    static const uint32_t MAX_DIRTY_RECTS = 16;
+
+    /*
+     * Records that part of data() has been changed, for upload_dirty(). Overlapping or touching
+     * rectangles are merged and if there are more than MAX_DIRTY_RECTS they're all merged into
+     * one, so the number of glTexSubImage2D calls stays small.
+     */
+    void mark_dirty(uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+
+    const std::vector<DirtyRect>& dirty_rects() const { return dirty_rects_; }
+
+    /*
+     * Sends only the dirty rectangles to GL with glTexSubImage2D, rather than respecifying the
+     * whole texture. The texture must have been uploaded (without freeing its data) first.
+     * Mipmaps are regenerated if the last upload generated them.
+     */
+    void upload_dirty();
+
+    std::size_t cpu_memory_usage() const override;
+
+    /* The size of the uploaded texture, including its mipmaps */
+    std::size_t gpu_memory_usage() const override { return gpu_memory_usage_; }
 
 private:
     uint32_t width_;
@@ -88,7 +192,27 @@ private:
 
     Texture::Data data_;
 
+    TextureFormat format_ = TEXTURE_FORMAT_UNCOMPRESSED;
+    std::vector<Texture::Data> mipmaps_; // Levels after the first, if the texture came with them
+
     uint32_t gl_tex_;
+    std::size_t gpu_memory_usage_ = 0;
+
+    std::vector<DirtyRect> dirty_rects_;
+    MipmapGenerate uploaded_mipmap_ = MIPMAP_GENERATE_NONE;
+
+    StreamingStatus streaming_;
+    std::vector<std::size_t> level_bytes_; // GPU size of each streamed level, 0 when not resident
+
+    void apply_sampler_parameters(MipmapGenerate mipmap, TextureWrap wrap, TextureFilter filter);
+
+    /* Uploads a level in the texture's format, returns its size on the GPU */
+    std::size_t upload_level(uint32_t gl_format, uint32_t level, const Texture::Data& data);
+
+    void __do_upload_dirty();
+
+    /* Runs the function on the GL thread, waiting for it to finish */
+    void run_on_gl_thread(std::function<void ()> func);
 };
 
 }
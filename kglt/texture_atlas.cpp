@@ -0,0 +1,286 @@
+#include <algorithm>
+#include <limits>
+
+#include "texture_atlas.h"
+#include "resource_manager.h"
+
+namespace kglt {
+
+const uint32_t TextureAtlas::PADDING;
+
+SkylinePacker::SkylinePacker(uint32_t width, uint32_t height):
+    width_(width),
+    height_(height) {
+
+    skyline_.push_back(Segment{0, 0, width});
+}
+
+bool SkylinePacker::fits(std::size_t index, uint32_t width, uint32_t height, uint32_t& y) const {
+    if(skyline_[index].x + width > width_) {
+        return false;
+    }
+
+    // The rectangle rests on the highest of the segments it spans
+    y = 0;
+    uint32_t remaining = width;
+    for(std::size_t i = index; remaining > 0; ++i) {
+        if(i == skyline_.size()) {
+            return false;
+        }
+
+        y = std::max(y, skyline_[i].y);
+        if(y + height > height_) {
+            return false;
+        }
+
+        remaining -= std::min(remaining, skyline_[i].width);
+    }
+
+    return true;
+}
+
+bool SkylinePacker::pack(uint32_t width, uint32_t height, uint32_t& x, uint32_t& y) {
+    if(!width || !height) {
+        return false;
+    }
+
+    std::size_t best_index = skyline_.size();
+    uint32_t best_top = std::numeric_limits<uint32_t>::max();
+    uint32_t best_width = std::numeric_limits<uint32_t>::max();
+    uint32_t best_y = 0;
+
+    for(std::size_t i = 0; i < skyline_.size(); ++i) {
+        uint32_t rest_y;
+        if(!fits(i, width, height, rest_y)) {
+            continue;
+        }
+
+        uint32_t top = rest_y + height;
+        if(top < best_top || (top == best_top && skyline_[i].width < best_width)) {
+            best_index = i;
+            best_top = top;
+            best_width = skyline_[i].width;
+            best_y = rest_y;
+        }
+    }
+
+    if(best_index == skyline_.size()) {
+        return false;
+    }
+
+    x = skyline_[best_index].x;
+    y = best_y;
+
+    skyline_.insert(skyline_.begin() + best_index, Segment{x, y + height, width});
+
+    // Trim the segments which are now underneath the new one
+    for(std::size_t i = best_index + 1; i < skyline_.size();) {
+        const Segment& previous = skyline_[i - 1];
+        uint32_t previous_end = previous.x + previous.width;
+
+        if(skyline_[i].x >= previous_end) {
+            break;
+        }
+
+        uint32_t shrink = previous_end - skyline_[i].x;
+        if(skyline_[i].width <= shrink) {
+            skyline_.erase(skyline_.begin() + i);
+        } else {
+            skyline_[i].x += shrink;
+            skyline_[i].width -= shrink;
+            break;
+        }
+    }
+
+    // Merge neighbours at the same height
+    for(std::size_t i = 0; i + 1 < skyline_.size();) {
+        if(skyline_[i].y == skyline_[i + 1].y) {
+            skyline_[i].width += skyline_[i + 1].width;
+            skyline_.erase(skyline_.begin() + i + 1);
+        } else {
+            ++i;
+        }
+    }
+
+    used_area_ += uint64_t(width) * uint64_t(height);
+    return true;
+}
+
+TextureAtlas::TextureAtlas(ResourceManager* resource_manager, uint32_t page_size):
+    resource_manager_(resource_manager),
+    page_size_(page_size) {
+
+}
+
+TextureAtlas::Page& TextureAtlas::new_page(uint32_t width, uint32_t height) {
+    TextureID texture_id = resource_manager_->new_texture(GARBAGE_COLLECT_NEVER);
+    auto texture = resource_manager_->texture(texture_id);
+    texture->set_bpp(32);
+    texture->resize(width, height);
+
+    MaterialID material_id = resource_manager_->new_material_from_texture(texture_id, GARBAGE_COLLECT_NEVER);
+
+    pages_.push_back(Page(texture_id, material_id, width, height));
+    return pages_.back();
+}
+
+AtlasRegion TextureAtlas::add(TextureID texture_id, const unicode& name) {
+    std::lock_guard<std::mutex> lock(lock_);
+
+    if(!name.empty()) {
+        auto it = regions_.find(name);
+        if(it != regions_.end()) {
+            return it->second;
+        }
+    }
+
+    auto source = resource_manager_->texture(texture_id);
+
+    // Pages are uncompressed RGBA, so block compressed sources have to be decoded to be copied in
+    source->decompress();
+
+    const uint32_t width = source->width();
+    const uint32_t height = source->height();
+    const uint32_t channels = source->channels();
+
+    if(!width || !height) {
+        throw std::logic_error("Tried to add an empty texture to an atlas");
+    }
+
+    if(source->data().size() < width * height * channels) {
+        throw std::logic_error("Tried to add a texture to an atlas after its data was freed");
+    }
+
+    const uint32_t padded_width = width + (PADDING * 2);
+    const uint32_t padded_height = height + (PADDING * 2);
+
+    Page* page = nullptr;
+    uint32_t x = 0, y = 0;
+    for(auto& candidate: pages_) {
+        if(candidate.packer.pack(padded_width, padded_height, x, y)) {
+            page = &candidate;
+            break;
+        }
+    }
+
+    if(!page) {
+        if(padded_width > page_size_ || padded_height > page_size_) {
+            page = &new_page(padded_width, padded_height);
+        } else {
+            page = &new_page(page_size_, page_size_);
+        }
+
+        page->packer.pack(padded_width, padded_height, x, y);
+    }
+
+    auto target = resource_manager_->texture(page->texture);
+    const uint32_t page_width = target->width();
+    const uint32_t page_height = target->height();
+
+    const uint8_t* src = &source->data()[0];
+    uint8_t* dest = &target->data()[0];
+
+    /* Copy the image, repeating its outermost pixels into the padding. Greyscale images are
+     * expanded to RGB and anything without alpha is made opaque. */
+    for(uint32_t j = 0; j < padded_height; ++j) {
+        uint32_t source_y = std::min(std::max(j, PADDING) - PADDING, height - 1);
+
+        for(uint32_t i = 0; i < padded_width; ++i) {
+            uint32_t source_x = std::min(std::max(i, PADDING) - PADDING, width - 1);
+
+            const uint8_t* in = src + ((source_y * width) + source_x) * channels;
+            uint8_t* out = dest + (((y + j) * page_width) + (x + i)) * 4;
+
+            switch(channels) {
+                case 1:
+                    out[0] = out[1] = out[2] = in[0];
+                    out[3] = 255;
+                break;
+                case 2:
+                    out[0] = out[1] = out[2] = in[0];
+                    out[3] = in[1];
+                break;
+                case 3:
+                    out[0] = in[0];
+                    out[1] = in[1];
+                    out[2] = in[2];
+                    out[3] = 255;
+                break;
+                default:
+                    std::copy(in, in + 4, out);
+            }
+        }
+    }
+
+    target->mark_dirty(x, y, padded_width, padded_height);
+    page->dirty = true;
+
+    AtlasRegion region;
+    region.texture = page->texture;
+    region.material = page->material;
+    region.x = x + PADDING;
+    region.y = y + PADDING;
+    region.width = width;
+    region.height = height;
+    region.uv_offset = Vec2(float(region.x) / float(page_width), float(region.y) / float(page_height));
+    region.uv_scale = Vec2(float(width) / float(page_width), float(height) / float(page_height));
+
+    if(!name.empty()) {
+        regions_[name] = region;
+    }
+
+    return region;
+}
+
+bool TextureAtlas::has_region(const unicode& name) const {
+    std::lock_guard<std::mutex> lock(lock_);
+    return regions_.count(name);
+}
+
+AtlasRegion TextureAtlas::region(const unicode& name) const {
+    std::lock_guard<std::mutex> lock(lock_);
+
+    auto it = regions_.find(name);
+    if(it == regions_.end()) {
+        throw std::logic_error(_u("No atlas region named {0}").format(name).encode());
+    }
+
+    return it->second;
+}
+
+void TextureAtlas::upload() {
+    std::vector<TextureID> dirty;
+
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        for(auto& page: pages_) {
+            if(page.dirty) {
+                dirty.push_back(page.texture);
+                page.dirty = false;
+            }
+        }
+    }
+
+    for(auto texture_id: dirty) {
+        auto texture = resource_manager_->texture(texture_id);
+
+        if(texture->gl_tex()) {
+            // Only send the regions packed since the last upload
+            texture->upload_dirty();
+        } else {
+            texture->upload(
+                MIPMAP_GENERATE_NONE,
+                TEXTURE_WRAP_CLAMP_TO_EDGE,
+                TEXTURE_FILTER_NEAREST,
+                false
+            );
+        }
+    }
+}
+
+uint32_t TextureAtlas::page_count() const {
+    std::lock_guard<std::mutex> lock(lock_);
+    return pages_.size();
+}
+
+}
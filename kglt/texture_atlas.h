@@ -0,0 +1,135 @@
+#ifndef TEXTURE_ATLAS_H
+#define TEXTURE_ATLAS_H
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "types.h"
+
+namespace kglt {
+
+class ResourceManager;
+
+/*
+ * Packs rectangles into a fixed size area using the skyline bottom-left heuristic. The top
+ * edge of everything placed so far is kept as a list of horizontal segments, and each new
+ * rectangle goes wherever its top would be lowest, preferring the narrowest segment on a tie.
+ */
+class SkylinePacker {
+public:
+    SkylinePacker(uint32_t width, uint32_t height);
+
+    /* Finds room for a rectangle and returns its position, or false if there isn't any */
+    bool pack(uint32_t width, uint32_t height, uint32_t& x, uint32_t& y);
+
+    uint32_t width() const { return width_; }
+    uint32_t height() const { return height_; }
+
+    /* The fraction of the area covered by packed rectangles */
+    float occupancy() const { return float(used_area_) / (float(width_) * float(height_)); }
+
+private:
+    struct Segment {
+        uint32_t x;
+        uint32_t y;
+        uint32_t width;
+    };
+
+    uint32_t width_;
+    uint32_t height_;
+    uint64_t used_area_ = 0;
+
+    std::vector<Segment> skyline_;
+
+    bool fits(std::size_t index, uint32_t width, uint32_t height, uint32_t& y) const;
+};
+
+/*
+ * Where an image ended up in an atlas. The UV offset and scale map texture coordinates of
+ * the original image onto the page, so meshes written for the image keep working.
+ */
+struct AtlasRegion {
+    TextureID texture;
+    MaterialID material;
+
+    // The image's pixels within the page (excluding the padding around them)
+    uint32_t x = 0;
+    uint32_t y = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+
+    Vec2 uv_offset = Vec2(0, 0);
+    Vec2 uv_scale = Vec2(1, 1);
+
+    Vec2 map(float u, float v) const {
+        return Vec2(uv_offset.x + (u * uv_scale.x), uv_offset.y + (v * uv_scale.y));
+    }
+
+    Vec2 map(const Vec2& uv) const {
+        return map(uv.x, uv.y);
+    }
+};
+
+/*
+ * Copies small images into shared 32 bit pages, each with a single material, so that the
+ * sprites, tiles and UI drawn from them can share a render group rather than each image
+ * breaking the batch.
+ *
+ * Every image is surrounded by a pixel of its own edge so filtering doesn't bleed in the
+ * neighbouring image. Pages aren't mipmapped (mipmaps would bleed regardless) and clamp to
+ * edge, and they keep their pixels in memory so they can be added to. Images too big for a
+ * page get a page of their own. Regions are never removed, the pages last as long as the
+ * resource manager.
+ */
+class TextureAtlas {
+public:
+    TextureAtlas(ResourceManager* resource_manager, uint32_t page_size=DEFAULT_PAGE_SIZE);
+
+    /*
+     * Copies the pixels of the texture (which must still have its data) into a page. The
+     * page isn't uploaded until upload() is called. If a name is given and an image was
+     * already added under it, the existing region is returned instead.
+     */
+    AtlasRegion add(TextureID texture, const unicode& name="");
+
+    bool has_region(const unicode& name) const;
+    AtlasRegion region(const unicode& name) const;
+
+    /* Uploads any pages which have changed since the last upload, pages which were already
+     * uploaded only send the regions added since */
+    void upload();
+
+    uint32_t page_count() const;
+    uint32_t page_size() const { return page_size_; }
+
+    static const uint32_t DEFAULT_PAGE_SIZE = 1024;
+    static const uint32_t PADDING = 1;
+
+private:
+    struct Page {
+        Page(TextureID texture, MaterialID material, uint32_t width, uint32_t height):
+            texture(texture),
+            material(material),
+            packer(width, height) {}
+
+        TextureID texture;
+        MaterialID material;
+        SkylinePacker packer;
+        bool dirty = false;
+    };
+
+    ResourceManager* resource_manager_;
+    uint32_t page_size_;
+
+    mutable std::mutex lock_;
+    std::vector<Page> pages_;
+    std::unordered_map<unicode, AtlasRegion> regions_;
+
+    Page& new_page(uint32_t width, uint32_t height);
+};
+
+}
+
+#endif // TEXTURE_ATLAS_H
@@ -0,0 +1,718 @@
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#include "texture_compression.h"
+
+namespace kglt {
+
+namespace {
+
+const uint32_t GL_COMPRESSED_RGBA_S3TC_DXT1 = 0x83F1;
+const uint32_t GL_COMPRESSED_RGBA_S3TC_DXT3 = 0x83F2;
+const uint32_t GL_COMPRESSED_RGBA_S3TC_DXT5 = 0x83F3;
+const uint32_t GL_ETC1_RGB8 = 0x8D64;
+const uint32_t GL_COMPRESSED_RGB8_ETC2 = 0x9274;
+const uint32_t GL_COMPRESSED_RGBA8_ETC2_EAC = 0x9278;
+
+const int ETC1_MODIFIERS[8][2] = {
+    {2, 8}, {5, 17}, {9, 29}, {13, 42}, {18, 60}, {24, 80}, {33, 106}, {47, 183}
+};
+
+const int ETC2_DISTANCES[8] = {3, 6, 11, 16, 23, 32, 41, 64};
+
+const int EAC_MODIFIERS[16][8] = {
+    {-3, -6, -9, -15, 2, 5, 8, 14},
+    {-3, -7, -10, -13, 2, 6, 9, 12},
+    {-2, -5, -8, -13, 1, 4, 7, 12},
+    {-2, -4, -6, -13, 1, 3, 5, 12},
+    {-3, -6, -8, -12, 2, 5, 7, 11},
+    {-3, -7, -9, -11, 2, 6, 8, 10},
+    {-4, -7, -8, -11, 3, 6, 7, 10},
+    {-3, -5, -8, -11, 2, 4, 7, 10},
+    {-2, -6, -8, -10, 1, 5, 7, 9},
+    {-2, -5, -8, -10, 1, 4, 7, 9},
+    {-2, -4, -8, -10, 1, 3, 7, 9},
+    {-2, -5, -7, -10, 1, 4, 6, 9},
+    {-3, -4, -7, -10, 2, 3, 6, 9},
+    {-1, -2, -3, -10, 0, 1, 2, 9},
+    {-4, -6, -8, -9, 3, 5, 7, 8},
+    {-3, -5, -7, -9, 2, 4, 6, 8}
+};
+
+uint8_t clamp_byte(int value) {
+    return uint8_t(std::max(0, std::min(255, value)));
+}
+
+/* A decoded 4x4 block, row by row */
+struct Block {
+    uint8_t rgba[16][4];
+};
+
+// S3TC
+
+void decode_dxt_colour(const uint8_t* in, bool allow_transparent, Block& out) {
+    uint16_t c0 = in[0] | (in[1] << 8);
+    uint16_t c1 = in[2] | (in[3] << 8);
+
+    int colours[4][4];
+    auto expand = [](uint16_t c, int* rgb) {
+        int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+        rgb[0] = (r << 3) | (r >> 2);
+        rgb[1] = (g << 2) | (g >> 4);
+        rgb[2] = (b << 3) | (b >> 2);
+        rgb[3] = 255;
+    };
+
+    expand(c0, colours[0]);
+    expand(c1, colours[1]);
+
+    for(int i = 0; i < 3; ++i) {
+        if(c0 > c1 || !allow_transparent) {
+            colours[2][i] = (2 * colours[0][i] + colours[1][i]) / 3;
+            colours[3][i] = (colours[0][i] + 2 * colours[1][i]) / 3;
+        } else {
+            colours[2][i] = (colours[0][i] + colours[1][i]) / 2;
+            colours[3][i] = 0;
+        }
+    }
+
+    colours[2][3] = 255;
+    colours[3][3] = (c0 > c1 || !allow_transparent) ? 255 : 0;
+
+    for(int y = 0; y < 4; ++y) {
+        for(int x = 0; x < 4; ++x) {
+            int index = (in[4 + y] >> (x * 2)) & 3;
+            for(int i = 0; i < 4; ++i) {
+                out.rgba[(y * 4) + x][i] = colours[index][i];
+            }
+        }
+    }
+}
+
+void decode_dxt3_alpha(const uint8_t* in, Block& out) {
+    for(int i = 0; i < 16; ++i) {
+        out.rgba[i][3] = ((in[i / 2] >> ((i % 2) * 4)) & 0xF) * 17;
+    }
+}
+
+void decode_dxt5_alpha(const uint8_t* in, Block& out) {
+    int alphas[8];
+    alphas[0] = in[0];
+    alphas[1] = in[1];
+
+    if(alphas[0] > alphas[1]) {
+        for(int i = 1; i < 7; ++i) {
+            alphas[i + 1] = ((7 - i) * alphas[0] + i * alphas[1]) / 7;
+        }
+    } else {
+        for(int i = 1; i < 5; ++i) {
+            alphas[i + 1] = ((5 - i) * alphas[0] + i * alphas[1]) / 5;
+        }
+        alphas[6] = 0;
+        alphas[7] = 255;
+    }
+
+    uint64_t bits = 0;
+    for(int i = 0; i < 6; ++i) {
+        bits |= uint64_t(in[2 + i]) << (8 * i);
+    }
+
+    for(int i = 0; i < 16; ++i) {
+        out.rgba[i][3] = alphas[(bits >> (3 * i)) & 7];
+    }
+}
+
+// ETC
+
+int extend4(int value) { return (value << 4) | value; }
+int extend5(int value) { return (value << 3) | (value >> 2); }
+int extend6(int value) { return (value << 2) | (value >> 4); }
+int extend7(int value) { return (value << 1) | (value >> 6); }
+
+int signed3(int value) { return (value & 4) ? value - 8 : value; }
+
+/* The 2-bit index of a pixel, pixels are numbered down the columns */
+int etc_pixel_index(const uint8_t* in, int x, int y) {
+    int bit = (x * 4) + y;
+    int msb = (((in[4] << 8) | in[5]) >> bit) & 1;
+    int lsb = (((in[6] << 8) | in[7]) >> bit) & 1;
+    return (msb << 1) | lsb;
+}
+
+void decode_etc_subblocks(const uint8_t* in, const int base[2][3], Block& out) {
+    const bool flip = in[3] & 1;
+    const int tables[2] = {(in[3] >> 5) & 7, (in[3] >> 2) & 7};
+
+    for(int y = 0; y < 4; ++y) {
+        for(int x = 0; x < 4; ++x) {
+            int subblock = (flip) ? (y >= 2) : (x >= 2);
+            int index = etc_pixel_index(in, x, y);
+
+            int modifier = ETC1_MODIFIERS[tables[subblock]][index & 1];
+            if(index & 2) {
+                modifier = -modifier;
+            }
+
+            uint8_t* pixel = out.rgba[(y * 4) + x];
+            for(int i = 0; i < 3; ++i) {
+                pixel[i] = clamp_byte(base[subblock][i] + modifier);
+            }
+            pixel[3] = 255;
+        }
+    }
+}
+
+void decode_etc_paint(const uint8_t* in, const int paint[4][3], Block& out) {
+    for(int y = 0; y < 4; ++y) {
+        for(int x = 0; x < 4; ++x) {
+            int index = etc_pixel_index(in, x, y);
+            uint8_t* pixel = out.rgba[(y * 4) + x];
+            for(int i = 0; i < 3; ++i) {
+                pixel[i] = clamp_byte(paint[index][i]);
+            }
+            pixel[3] = 255;
+        }
+    }
+}
+
+void decode_etc_colour(const uint8_t* in, bool etc2, Block& out) {
+    int base[2][3];
+
+    if(!(in[3] & 2)) {
+        // Individual mode
+        for(int i = 0; i < 3; ++i) {
+            base[0][i] = extend4(in[i] >> 4);
+            base[1][i] = extend4(in[i] & 0xF);
+        }
+
+        decode_etc_subblocks(in, base, out);
+        return;
+    }
+
+    int first[3], second[3];
+    for(int i = 0; i < 3; ++i) {
+        first[i] = in[i] >> 3;
+        second[i] = first[i] + signed3(in[i] & 7);
+    }
+
+    /* ETC2 uses the combinations which would overflow in differential mode for its new modes,
+     * which channel overflows picks the mode */
+    if(etc2 && (second[0] < 0 || second[0] > 31)) {
+        // T mode
+        int c0[3] = {
+            extend4((((in[0] >> 3) & 3) << 2) | (in[0] & 3)),
+            extend4(in[1] >> 4),
+            extend4(in[1] & 0xF)
+        };
+        int c1[3] = {extend4(in[2] >> 4), extend4(in[2] & 0xF), extend4(in[3] >> 4)};
+        int d = ETC2_DISTANCES[((in[3] >> 1) & 6) | (in[3] & 1)];
+
+        int paint[4][3];
+        for(int i = 0; i < 3; ++i) {
+            paint[0][i] = c0[i];
+            paint[1][i] = c1[i] + d;
+            paint[2][i] = c1[i];
+            paint[3][i] = c1[i] - d;
+        }
+
+        decode_etc_paint(in, paint, out);
+    } else if(etc2 && (second[1] < 0 || second[1] > 31)) {
+        // H mode
+        int r0 = (in[0] >> 3) & 0xF;
+        int g0 = ((in[0] & 7) << 1) | ((in[1] >> 4) & 1);
+        int b0 = (in[1] & 8) | ((in[1] & 3) << 1) | (in[2] >> 7);
+        int r1 = (in[2] >> 3) & 0xF;
+        int g1 = ((in[2] & 7) << 1) | (in[3] >> 7);
+        int b1 = (in[3] >> 3) & 0xF;
+
+        int ordering = (((r0 << 8) | (g0 << 4) | b0) >= ((r1 << 8) | (g1 << 4) | b1)) ? 1 : 0;
+        int d = ETC2_DISTANCES[(in[3] & 4) | ((in[3] & 1) << 1) | ordering];
+
+        int c0[3] = {extend4(r0), extend4(g0), extend4(b0)};
+        int c1[3] = {extend4(r1), extend4(g1), extend4(b1)};
+
+        int paint[4][3];
+        for(int i = 0; i < 3; ++i) {
+            paint[0][i] = c0[i] + d;
+            paint[1][i] = c0[i] - d;
+            paint[2][i] = c1[i] + d;
+            paint[3][i] = c1[i] - d;
+        }
+
+        decode_etc_paint(in, paint, out);
+    } else if(etc2 && (second[2] < 0 || second[2] > 31)) {
+        // Planar mode, three colours interpolated across the block
+        int ro = extend6((in[0] >> 1) & 0x3F);
+        int go = extend7(((in[0] & 1) << 6) | ((in[1] >> 1) & 0x3F));
+        int bo = extend6(((in[1] & 1) << 5) | (in[2] & 0x18) | ((in[2] & 3) << 1) | ((in[3] >> 7) & 1));
+        int rh = extend6(((in[3] >> 1) & 0x3E) | (in[3] & 1));
+        int gh = extend7((in[4] >> 1) & 0x7F);
+        int bh = extend6(((in[4] & 1) << 5) | ((in[5] >> 3) & 0x1F));
+        int rv = extend6(((in[5] & 7) << 3) | ((in[6] >> 5) & 7));
+        int gv = extend7(((in[6] & 0x1F) << 2) | ((in[7] >> 6) & 3));
+        int bv = extend6(in[7] & 0x3F);
+
+        for(int y = 0; y < 4; ++y) {
+            for(int x = 0; x < 4; ++x) {
+                uint8_t* pixel = out.rgba[(y * 4) + x];
+                pixel[0] = clamp_byte((x * (rh - ro) + y * (rv - ro) + 4 * ro + 2) >> 2);
+                pixel[1] = clamp_byte((x * (gh - go) + y * (gv - go) + 4 * go + 2) >> 2);
+                pixel[2] = clamp_byte((x * (bh - bo) + y * (bv - bo) + 4 * bo + 2) >> 2);
+                pixel[3] = 255;
+            }
+        }
+    } else {
+        // Differential mode
+        for(int i = 0; i < 3; ++i) {
+            base[0][i] = extend5(first[i]);
+            base[1][i] = extend5(second[i] & 31);
+        }
+
+        decode_etc_subblocks(in, base, out);
+    }
+}
+
+void decode_eac_alpha(const uint8_t* in, Block& out) {
+    int base = in[0];
+    int multiplier = in[1] >> 4;
+    const int* table = EAC_MODIFIERS[in[1] & 0xF];
+
+    uint64_t bits = 0;
+    for(int i = 2; i < 8; ++i) {
+        bits = (bits << 8) | in[i];
+    }
+
+    for(int x = 0; x < 4; ++x) {
+        for(int y = 0; y < 4; ++y) {
+            int index = (bits >> (45 - 3 * ((x * 4) + y))) & 7;
+            out.rgba[(y * 4) + x][3] = clamp_byte(base + table[index] * multiplier);
+        }
+    }
+}
+
+uint32_t block_bytes(TextureFormat format) {
+    switch(format) {
+        case TEXTURE_FORMAT_DXT1:
+        case TEXTURE_FORMAT_ETC1:
+        case TEXTURE_FORMAT_ETC2_RGB:
+            return 8;
+        case TEXTURE_FORMAT_DXT3:
+        case TEXTURE_FORMAT_DXT5:
+        case TEXTURE_FORMAT_ETC2_RGBA:
+            return 16;
+        default:
+            throw std::logic_error("Not a block compressed texture format");
+    }
+}
+
+// Encoding
+
+int colour_error(const int* a, const uint8_t* b) {
+    int dr = a[0] - b[0], dg = a[1] - b[1], db = a[2] - b[2];
+    return (dr * dr) + (dg * dg) + (db * db);
+}
+
+/* The pixels of a 4x4 block, edge pixels are repeated where the block hangs over the image */
+void read_block(const uint8_t* in, uint32_t width, uint32_t height, uint32_t bx, uint32_t by, Block& block) {
+    for(uint32_t y = 0; y < 4; ++y) {
+        for(uint32_t x = 0; x < 4; ++x) {
+            uint32_t sx = std::min(bx + x, width - 1);
+            uint32_t sy = std::min(by + y, height - 1);
+            std::copy(in + ((sy * width) + sx) * 4, in + ((sy * width) + sx) * 4 + 4, block.rgba[(y * 4) + x]);
+        }
+    }
+}
+
+struct SubblockChoice {
+    int table = 0;
+    int error = 0;
+    int indices[16] = {0};
+};
+
+/* Picks the best modifier table for the pixels of a subblock around the base colour */
+SubblockChoice choose_etc_table(const Block& block, bool flip, int subblock, const int* base) {
+    SubblockChoice best;
+    best.error = std::numeric_limits<int>::max();
+
+    for(int table = 0; table < 8; ++table) {
+        SubblockChoice choice;
+        choice.table = table;
+
+        for(int y = 0; y < 4; ++y) {
+            for(int x = 0; x < 4; ++x) {
+                if(((flip) ? (y >= 2) : (x >= 2)) != bool(subblock)) {
+                    continue;
+                }
+
+                int best_pixel = std::numeric_limits<int>::max();
+                for(int index = 0; index < 4; ++index) {
+                    int modifier = ETC1_MODIFIERS[table][index & 1] * ((index & 2) ? -1 : 1);
+                    int colour[3];
+                    for(int i = 0; i < 3; ++i) {
+                        colour[i] = clamp_byte(base[i] + modifier);
+                    }
+
+                    int error = colour_error(colour, block.rgba[(y * 4) + x]);
+                    if(error < best_pixel) {
+                        best_pixel = error;
+                        choice.indices[(x * 4) + y] = index;
+                    }
+                }
+
+                choice.error += best_pixel;
+            }
+        }
+
+        if(choice.error < best.error) {
+            best = choice;
+        }
+    }
+
+    return best;
+}
+
+void encode_etc1_block(const Block& block, uint8_t* out) {
+    int best_error = std::numeric_limits<int>::max();
+
+    for(int flip = 0; flip < 2; ++flip) {
+        float average[2][3] = {{0}};
+        for(int y = 0; y < 4; ++y) {
+            for(int x = 0; x < 4; ++x) {
+                int subblock = (flip) ? (y >= 2) : (x >= 2);
+                for(int i = 0; i < 3; ++i) {
+                    average[subblock][i] += block.rgba[(y * 4) + x][i] / 8.0f;
+                }
+            }
+        }
+
+        for(int differential = 0; differential < 2; ++differential) {
+            int quantized[2][3];
+            int base[2][3];
+            bool valid = true;
+
+            for(int s = 0; s < 2; ++s) {
+                for(int i = 0; i < 3; ++i) {
+                    if(differential) {
+                        quantized[s][i] = int(average[s][i] * 31.0f / 255.0f + 0.5f);
+                        base[s][i] = extend5(quantized[s][i]);
+                    } else {
+                        quantized[s][i] = int(average[s][i] * 15.0f / 255.0f + 0.5f);
+                        base[s][i] = extend4(quantized[s][i]);
+                    }
+                }
+            }
+
+            if(differential) {
+                for(int i = 0; i < 3; ++i) {
+                    int delta = quantized[1][i] - quantized[0][i];
+                    valid = valid && delta >= -4 && delta <= 3;
+                }
+            }
+
+            if(!valid) {
+                continue;
+            }
+
+            SubblockChoice choices[2] = {
+                choose_etc_table(block, flip, 0, base[0]),
+                choose_etc_table(block, flip, 1, base[1])
+            };
+
+            int error = choices[0].error + choices[1].error;
+            if(error >= best_error) {
+                continue;
+            }
+
+            best_error = error;
+
+            for(int i = 0; i < 3; ++i) {
+                if(differential) {
+                    out[i] = (quantized[0][i] << 3) | ((quantized[1][i] - quantized[0][i]) & 7);
+                } else {
+                    out[i] = (quantized[0][i] << 4) | quantized[1][i];
+                }
+            }
+
+            out[3] = (choices[0].table << 5) | (choices[1].table << 2) | (differential << 1) | flip;
+
+            uint16_t msbs = 0, lsbs = 0;
+            for(int x = 0; x < 4; ++x) {
+                for(int y = 0; y < 4; ++y) {
+                    int subblock = (flip) ? (y >= 2) : (x >= 2);
+                    int bit = (x * 4) + y;
+                    int index = choices[subblock].indices[bit];
+                    msbs |= ((index >> 1) & 1) << bit;
+                    lsbs |= (index & 1) << bit;
+                }
+            }
+
+            out[4] = msbs >> 8;
+            out[5] = msbs & 0xFF;
+            out[6] = lsbs >> 8;
+            out[7] = lsbs & 0xFF;
+        }
+    }
+}
+
+void encode_eac_block(const Block& block, uint8_t* out) {
+    int lowest = 255, highest = 0;
+    for(int i = 0; i < 16; ++i) {
+        lowest = std::min<int>(lowest, block.rgba[i][3]);
+        highest = std::max<int>(highest, block.rgba[i][3]);
+    }
+
+    int best_error = std::numeric_limits<int>::max();
+    uint64_t best_bits = 0;
+
+    const int base = (lowest + highest + 1) / 2;
+
+    for(int table = 0; table < 16; ++table) {
+        const int* modifiers = EAC_MODIFIERS[table];
+        int span = modifiers[7] - modifiers[3];
+        int ideal = std::max(1, (highest - lowest + span / 2) / span);
+
+        for(int multiplier = std::max(1, ideal - 1); multiplier <= std::min(15, ideal + 1); ++multiplier) {
+            int error = 0;
+            uint64_t bits = 0;
+
+            for(int x = 0; x < 4; ++x) {
+                for(int y = 0; y < 4; ++y) {
+                    int alpha = block.rgba[(y * 4) + x][3];
+                    int best_pixel = std::numeric_limits<int>::max(), best_index = 0;
+
+                    for(int index = 0; index < 8; ++index) {
+                        int difference = clamp_byte(base + modifiers[index] * multiplier) - alpha;
+                        if(difference * difference < best_pixel) {
+                            best_pixel = difference * difference;
+                            best_index = index;
+                        }
+                    }
+
+                    error += best_pixel;
+                    bits |= uint64_t(best_index) << (45 - 3 * ((x * 4) + y));
+                }
+            }
+
+            if(error < best_error) {
+                best_error = error;
+                best_bits = bits;
+                out[0] = base;
+                out[1] = (multiplier << 4) | table;
+            }
+        }
+    }
+
+    for(int i = 0; i < 6; ++i) {
+        out[2 + i] = (best_bits >> (8 * (5 - i))) & 0xFF;
+    }
+}
+
+}
+
+bool texture_format_has_alpha(TextureFormat format) {
+    switch(format) {
+        case TEXTURE_FORMAT_DXT1:
+        case TEXTURE_FORMAT_DXT3:
+        case TEXTURE_FORMAT_DXT5:
+        case TEXTURE_FORMAT_ETC2_RGBA:
+            return true;
+        default:
+            return false;
+    }
+}
+
+std::size_t compressed_level_size(TextureFormat format, uint32_t width, uint32_t height) {
+    return std::size_t((width + 3) / 4) * ((height + 3) / 4) * block_bytes(format);
+}
+
+uint32_t texture_format_to_gl(TextureFormat format) {
+    switch(format) {
+        case TEXTURE_FORMAT_DXT1: return GL_COMPRESSED_RGBA_S3TC_DXT1;
+        case TEXTURE_FORMAT_DXT3: return GL_COMPRESSED_RGBA_S3TC_DXT3;
+        case TEXTURE_FORMAT_DXT5: return GL_COMPRESSED_RGBA_S3TC_DXT5;
+        case TEXTURE_FORMAT_ETC1: return GL_ETC1_RGB8;
+        case TEXTURE_FORMAT_ETC2_RGB: return GL_COMPRESSED_RGB8_ETC2;
+        case TEXTURE_FORMAT_ETC2_RGBA: return GL_COMPRESSED_RGBA8_ETC2_EAC;
+        default:
+            throw std::logic_error("Not a compressed texture format");
+    }
+}
+
+TextureFormat texture_format_from_gl(uint32_t gl_format) {
+    switch(gl_format) {
+        case 0x83F0: // The RGB variant of DXT1 decodes the same, just without the transparent colour
+        case GL_COMPRESSED_RGBA_S3TC_DXT1: return TEXTURE_FORMAT_DXT1;
+        case GL_COMPRESSED_RGBA_S3TC_DXT3: return TEXTURE_FORMAT_DXT3;
+        case GL_COMPRESSED_RGBA_S3TC_DXT5: return TEXTURE_FORMAT_DXT5;
+        case GL_ETC1_RGB8: return TEXTURE_FORMAT_ETC1;
+        case GL_COMPRESSED_RGB8_ETC2: return TEXTURE_FORMAT_ETC2_RGB;
+        case GL_COMPRESSED_RGBA8_ETC2_EAC: return TEXTURE_FORMAT_ETC2_RGBA;
+        default:
+            return TEXTURE_FORMAT_UNCOMPRESSED;
+    }
+}
+
+void decompress_level(TextureFormat format, uint32_t width, uint32_t height, const uint8_t* in, uint8_t* out) {
+    const uint32_t stride = block_bytes(format);
+
+    for(uint32_t by = 0; by < height; by += 4) {
+        for(uint32_t bx = 0; bx < width; bx += 4) {
+            Block block;
+
+            switch(format) {
+                case TEXTURE_FORMAT_DXT1:
+                    decode_dxt_colour(in, true, block);
+                break;
+                case TEXTURE_FORMAT_DXT3:
+                    decode_dxt_colour(in + 8, false, block);
+                    decode_dxt3_alpha(in, block);
+                break;
+                case TEXTURE_FORMAT_DXT5:
+                    decode_dxt_colour(in + 8, false, block);
+                    decode_dxt5_alpha(in, block);
+                break;
+                case TEXTURE_FORMAT_ETC1:
+                    decode_etc_colour(in, false, block);
+                break;
+                case TEXTURE_FORMAT_ETC2_RGB:
+                    decode_etc_colour(in, true, block);
+                break;
+                case TEXTURE_FORMAT_ETC2_RGBA:
+                    decode_etc_colour(in + 8, true, block);
+                    decode_eac_alpha(in, block);
+                break;
+                default:
+                    throw std::logic_error("Not a compressed texture format");
+            }
+
+            // Blocks hanging over the edge of the image only have some of their pixels written
+            for(uint32_t y = 0; y < 4 && by + y < height; ++y) {
+                for(uint32_t x = 0; x < 4 && bx + x < width; ++x) {
+                    std::copy(block.rgba[(y * 4) + x], block.rgba[(y * 4) + x] + 4, out + (((by + y) * width) + bx + x) * 4);
+                }
+            }
+
+            in += stride;
+        }
+    }
+}
+
+bool flip_compressed_level(TextureFormat format, uint32_t width, uint32_t height, std::vector<uint8_t>& data) {
+    if(format != TEXTURE_FORMAT_DXT1 && format != TEXTURE_FORMAT_DXT3 && format != TEXTURE_FORMAT_DXT5) {
+        return false;
+    }
+
+    if(height > 4 && height % 4) {
+        return false;
+    }
+
+    const uint32_t rows = std::min(height, 4u); // Pixel rows used in each block
+    const uint32_t stride = block_bytes(format);
+    const uint32_t blocks_across = (width + 3) / 4;
+    const uint32_t blocks_down = (height + 3) / 4;
+
+    if(data.size() < blocks_across * blocks_down * stride) {
+        throw std::logic_error("Not enough data for the compressed texture level");
+    }
+
+    auto flip_colour = [rows](uint8_t* block) {
+        std::reverse(block + 4, block + 4 + rows);
+    };
+
+    auto flip_block = [&](uint8_t* block) {
+        switch(format) {
+            case TEXTURE_FORMAT_DXT1:
+                flip_colour(block);
+            break;
+            case TEXTURE_FORMAT_DXT3: {
+                // Two bytes of alpha per row
+                for(uint32_t i = 0; i < rows / 2; ++i) {
+                    std::swap(block[i * 2], block[(rows - 1 - i) * 2]);
+                    std::swap(block[i * 2 + 1], block[(rows - 1 - i) * 2 + 1]);
+                }
+                flip_colour(block + 8);
+            } break;
+            case TEXTURE_FORMAT_DXT5: {
+                // Twelve bits of alpha indices per row
+                uint64_t bits = 0;
+                for(int i = 0; i < 6; ++i) {
+                    bits |= uint64_t(block[2 + i]) << (8 * i);
+                }
+
+                uint64_t row_bits[4];
+                for(int i = 0; i < 4; ++i) {
+                    row_bits[i] = (bits >> (12 * i)) & 0xFFF;
+                }
+
+                std::reverse(row_bits, row_bits + rows);
+
+                bits = 0;
+                for(int i = 0; i < 4; ++i) {
+                    bits |= row_bits[i] << (12 * i);
+                }
+
+                for(int i = 0; i < 6; ++i) {
+                    block[2 + i] = (bits >> (8 * i)) & 0xFF;
+                }
+
+                flip_colour(block + 8);
+            } break;
+            default:
+                break;
+        }
+    };
+
+    std::vector<uint8_t> row(blocks_across * stride);
+    for(uint32_t j = 0; j * 2 < blocks_down; ++j) {
+        uint8_t* top = &data[j * blocks_across * stride];
+        uint8_t* bottom = &data[(blocks_down - 1 - j) * blocks_across * stride];
+
+        if(top != bottom) {
+            std::copy(top, top + row.size(), row.begin());
+            std::copy(bottom, bottom + row.size(), top);
+            std::copy(row.begin(), row.end(), bottom);
+        }
+    }
+
+    for(uint32_t i = 0; i < blocks_across * blocks_down; ++i) {
+        flip_block(&data[i * stride]);
+    }
+
+    return true;
+}
+
+std::vector<uint8_t> compress_etc1(const uint8_t* in, uint32_t width, uint32_t height) {
+    std::vector<uint8_t> result(compressed_level_size(TEXTURE_FORMAT_ETC1, width, height));
+    uint8_t* out = &result[0];
+
+    for(uint32_t by = 0; by < height; by += 4) {
+        for(uint32_t bx = 0; bx < width; bx += 4) {
+            Block block;
+            read_block(in, width, height, bx, by, block);
+            encode_etc1_block(block, out);
+            out += 8;
+        }
+    }
+
+    return result;
+}
+
+std::vector<uint8_t> compress_etc2_rgba(const uint8_t* in, uint32_t width, uint32_t height) {
+    std::vector<uint8_t> result(compressed_level_size(TEXTURE_FORMAT_ETC2_RGBA, width, height));
+    uint8_t* out = &result[0];
+
+    for(uint32_t by = 0; by < height; by += 4) {
+        for(uint32_t bx = 0; bx < width; bx += 4) {
+            Block block;
+            read_block(in, width, height, bx, by, block);
+            encode_eac_block(block, out);
+            encode_etc1_block(block, out + 8);
+            out += 16;
+        }
+    }
+
+    return result;
+}
+
+}
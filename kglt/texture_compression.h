@@ -0,0 +1,48 @@
+#ifndef TEXTURE_COMPRESSION_H
+#define TEXTURE_COMPRESSION_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace kglt {
+
+enum TextureFormat {
+    TEXTURE_FORMAT_UNCOMPRESSED, ///< RGB or RGBA bytes, depending on the bpp of the texture
+    TEXTURE_FORMAT_DXT1, ///< S3TC, 1-bit alpha
+    TEXTURE_FORMAT_DXT3, ///< S3TC, explicit 4-bit alpha
+    TEXTURE_FORMAT_DXT5, ///< S3TC, interpolated alpha
+    TEXTURE_FORMAT_ETC1,
+    TEXTURE_FORMAT_ETC2_RGB,
+    TEXTURE_FORMAT_ETC2_RGBA ///< ETC2 colour with EAC alpha
+};
+
+bool texture_format_has_alpha(TextureFormat format);
+
+/* The size in bytes of a level of a block compressed texture, each block covers 4x4 pixels */
+std::size_t compressed_level_size(TextureFormat format, uint32_t width, uint32_t height);
+
+/* The GL internal format to upload the compressed format with, and the format for a GL internal format
+ * (TEXTURE_FORMAT_UNCOMPRESSED if it isn't one we know) */
+uint32_t texture_format_to_gl(TextureFormat format);
+TextureFormat texture_format_from_gl(uint32_t gl_format);
+
+/* Decodes a compressed level to tightly packed RGBA, for when the GL implementation can't use it directly */
+void decompress_level(TextureFormat format, uint32_t width, uint32_t height, const uint8_t* in, uint8_t* out);
+
+/*
+ * Flips a compressed level vertically without decoding it, by reversing the rows of blocks and the
+ * rows of pixels within each block. This can only be done where rows don't straddle blocks
+ * differently once flipped (heights which are a multiple of four, or under four) and only for S3TC,
+ * ETC blocks can't be flipped bitwise; returns false if the level wasn't flipped.
+ */
+bool flip_compressed_level(TextureFormat format, uint32_t width, uint32_t height, std::vector<uint8_t>& data);
+
+/* Encoders used by the texture converter, in is tightly packed RGBA. ETC1 blocks are valid ETC2 blocks,
+ * and ETC2 RGBA is encoded as ETC1 colour with EAC alpha */
+std::vector<uint8_t> compress_etc1(const uint8_t* in, uint32_t width, uint32_t height);
+std::vector<uint8_t> compress_etc2_rgba(const uint8_t* in, uint32_t width, uint32_t height);
+
+}
+
+#endif // TEXTURE_COMPRESSION_H
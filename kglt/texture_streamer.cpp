@@ -0,0 +1,378 @@
+#include <algorithm>
+#include <cmath>
+
+#include "deps/kazlog/kazlog.h"
+
+#include "texture_streamer.h"
+#include "window_base.h"
+#include "resource_manager.h"
+#include "material.h"
+#include "job_system.h"
+#include "renderers/renderer.h"
+
+namespace kglt {
+
+const uint32_t TextureStreamer::DEFAULT_RESIDENT_SIZE;
+const std::size_t TextureStreamer::DEFAULT_MEMORY_BUDGET;
+const uint32_t TextureStreamer::MAX_CONCURRENT_LOADS;
+
+namespace {
+
+/* The most detailed level which is no larger than resident_size in either direction */
+uint32_t first_resident_level(const Texture& texture, uint32_t resident_size) {
+    uint32_t level = 0;
+    while(level + 1 < texture.full_mipmap_count() &&
+          std::max(texture.level_width(level), texture.level_height(level)) > resident_size) {
+        ++level;
+    }
+    return level;
+}
+
+/* The level which gives roughly one texel per pixel when drawn at the size */
+uint32_t needed_level(const Texture& texture, float pixels, uint32_t always_resident_mip) {
+    if(pixels <= 0.0f) {
+        return always_resident_mip;
+    }
+
+    float texels = std::max(texture.width(), texture.height());
+    float level = std::floor(std::log2(texels / pixels));
+
+    if(level <= 0.0f) {
+        return 0;
+    }
+
+    return std::min(uint32_t(level), always_resident_mip);
+}
+
+/* The GPU memory the texture uses with the level and everything smaller resident */
+std::size_t bytes_from_level(const Texture& texture, uint32_t level) {
+    std::size_t total = 0;
+    for(uint32_t i = level; i < texture.full_mipmap_count(); ++i) {
+        total += texture.level_size(i);
+    }
+    return total;
+}
+
+}
+
+TextureStreamer::TextureStreamer(WindowBase* window):
+    window_(window) {
+
+}
+
+bool TextureStreamer::add(TexturePtr texture, const unicode& path, const TextureFlags& flags) {
+    ResidentLevels resident;
+    if(!prepare(texture, path, flags, resident)) {
+        return false;
+    }
+
+    texture->upload_levels(resident.first_level, std::move(resident.levels), flags.wrap, flags.filter);
+    track(texture, path, flags, resident.first_level);
+    return true;
+}
+
+bool TextureStreamer::prepare(TexturePtr texture, const unicode& path, const TextureFlags& flags, ResidentLevels& resident) {
+#ifdef KGLT_GL_VERSION_1X
+    // Streaming relies on GL_TEXTURE_BASE_LEVEL
+    return false;
+#else
+    if(flags.mipmap != MIPMAP_GENERATE_COMPLETE) {
+        return false;
+    }
+
+    if(!texture->is_compressed()) {
+        texture->generate_mipmap_data();
+    }
+
+    if(texture->mipmap_count() < texture->full_mipmap_count()) {
+        L_WARN(_F("Unable to stream {0}, compressed textures need a full set of mipmaps").format(path));
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        resident.first_level = first_resident_level(*texture, resident_size_);
+    }
+
+    resident.levels.clear();
+    for(uint32_t i = resident.first_level; i < texture->mipmap_count(); ++i) {
+        resident.levels.push_back(std::move(texture->mipmap_data(i)));
+    }
+
+    // The more detailed levels are read from the file again when they're needed
+    texture->free();
+    return true;
+#endif
+}
+
+void TextureStreamer::__do_add(TexturePtr texture, const unicode& path, const TextureFlags& flags, ResidentLevels& resident) {
+    texture->__do_upload_levels(resident.first_level, resident.levels, flags.wrap, flags.filter);
+    track(texture, path, flags, resident.first_level);
+}
+
+void TextureStreamer::track(TexturePtr texture, const unicode& path, const TextureFlags& flags, uint32_t first_level) {
+    std::lock_guard<std::mutex> lock(lock_);
+
+    Entry& entry = entries_[texture->id()];
+    entry.texture = texture;
+    entry.path = path;
+    entry.flip_vertically = flags.flip_vertically;
+    entry.wanted_mip = first_level;
+}
+
+void TextureStreamer::_note_usage(MaterialPtr material, float pixels) {
+    if(!material) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(lock_);
+
+    for(uint32_t i = 0; i < material->pass_count(); ++i) {
+        auto pass = material->pass(i);
+
+        for(uint32_t j = 0; j < pass->texture_unit_count(); ++j) {
+            auto it = entries_.find(pass->texture_unit(j).texture_id());
+            if(it != entries_.end()) {
+                it->second.pixels = std::max(it->second.pixels, pixels);
+            }
+        }
+    }
+}
+
+void TextureStreamer::update(double dt) {
+    std::lock_guard<std::mutex> lock(lock_);
+
+    struct Candidate {
+        TextureID id;
+        Entry* entry;
+        TexturePtr texture;
+        uint32_t always_resident_mip;
+        uint32_t requested_mip;
+    };
+
+    std::vector<Candidate> candidates;
+    std::size_t total = 0;
+
+    for(auto it = entries_.begin(); it != entries_.end();) {
+        Entry& entry = it->second;
+
+        auto texture = entry.texture.lock();
+        if(!texture) {
+            it = entries_.erase(it);
+            continue;
+        }
+
+        auto status = texture->streaming_status();
+        uint32_t needed = needed_level(*texture, entry.pixels, status.always_resident_mip);
+
+        entry.last_pixels = entry.pixels;
+        entry.pixels = 0.0f;
+
+        // More detail is wanted straight away, but it's only given up once it hasn't been needed for a while
+        if(needed <= entry.wanted_mip) {
+            entry.wanted_mip = needed;
+            entry.time_wanting_less = 0.0;
+        } else {
+            entry.time_wanting_less += dt;
+            if(entry.time_wanting_less >= eviction_delay_) {
+                entry.wanted_mip = needed;
+                entry.time_wanting_less = 0.0;
+            }
+        }
+
+        uint32_t requested = (entry.failed) ? status.resident_mip : entry.wanted_mip;
+
+        candidates.push_back({it->first, &entry, texture, status.always_resident_mip, requested});
+        total += bytes_from_level(*texture, requested);
+
+        ++it;
+    }
+
+    if(total > memory_budget_) {
+        // Take detail away from the textures drawn smallest first, a level at a time
+        std::sort(candidates.begin(), candidates.end(), [](const Candidate& lhs, const Candidate& rhs) {
+            return lhs.entry->last_pixels < rhs.entry->last_pixels;
+        });
+
+        bool reduced = true;
+        while(total > memory_budget_ && reduced) {
+            reduced = false;
+
+            for(auto& candidate: candidates) {
+                if(total <= memory_budget_) {
+                    break;
+                }
+
+                if(candidate.requested_mip < candidate.always_resident_mip) {
+                    total -= candidate.texture->level_size(candidate.requested_mip);
+                    ++candidate.requested_mip;
+                    reduced = true;
+                }
+            }
+        }
+    }
+
+    for(auto& candidate: candidates) {
+        candidate.texture->_set_requested_mip(candidate.requested_mip);
+
+        if(candidate.requested_mip > candidate.texture->streaming_status().resident_mip) {
+            candidate.texture->__do_release_levels(candidate.requested_mip);
+        }
+    }
+
+    // Load the detail for the textures drawn largest first
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& lhs, const Candidate& rhs) {
+        return lhs.entry->last_pixels > rhs.entry->last_pixels;
+    });
+
+    for(auto& candidate: candidates) {
+        if(loading_count_ >= MAX_CONCURRENT_LOADS) {
+            break;
+        }
+
+        uint32_t resident = candidate.texture->streaming_status().resident_mip;
+        if(candidate.requested_mip < resident && !candidate.entry->loading) {
+            start_load(candidate.id, *candidate.entry, candidate.texture, candidate.requested_mip, resident);
+        }
+    }
+}
+
+void TextureStreamer::start_load(TextureID id, Entry& entry, TexturePtr texture, uint32_t first_level, uint32_t end_level) {
+    entry.loading = true;
+    ++loading_count_;
+
+    auto window = window_;
+    auto path = entry.path;
+    auto flip = entry.flip_vertically;
+
+    window_->jobs->schedule([=]() {
+        auto levels = std::make_shared<std::vector<Texture::Data>>();
+
+        try {
+            auto scratch = Texture::create(TextureID(), &texture->resource_manager());
+            window->loader_for(path, LOADER_HINT_TEXTURE)->into(scratch);
+
+            if(flip) {
+                scratch->flip_vertically();
+            }
+
+            if(!scratch->is_compressed()) {
+                scratch->generate_mipmap_data();
+            }
+
+            if(scratch->format() != texture->format() || scratch->bpp() != texture->bpp() ||
+               scratch->width() != texture->width() || scratch->height() != texture->height() ||
+               scratch->mipmap_count() < end_level) {
+                throw std::runtime_error("The file no longer matches the texture");
+            }
+
+            for(uint32_t i = first_level; i < end_level; ++i) {
+                levels->push_back(std::move(scratch->mipmap_data(i)));
+            }
+        } catch(std::exception& e) {
+            L_WARN(_F("Unable to stream {0}: {1}").format(path, e.what()));
+            levels->clear();
+        }
+
+        window->renderer->uploads->push([=]() {
+            this->finish_load(id, first_level, end_level, *levels);
+        }, UPLOAD_PRIORITY_LOW);
+    });
+}
+
+void TextureStreamer::finish_load(TextureID id, uint32_t first_level, uint32_t end_level, std::vector<Texture::Data>& levels) {
+    std::lock_guard<std::mutex> lock(lock_);
+
+    --loading_count_;
+
+    auto it = entries_.find(id);
+    if(it == entries_.end()) {
+        return;
+    }
+
+    Entry& entry = it->second;
+    entry.loading = false;
+
+    auto texture = entry.texture.lock();
+    if(!texture) {
+        return;
+    }
+
+    if(levels.empty()) {
+        entry.failed = true;
+        return;
+    }
+
+    // Levels may have been released while this was loading, in which case the next update tries again
+    auto status = texture->streaming_status();
+    if(status.resident_mip != end_level) {
+        return;
+    }
+
+    // Only upload what's still wanted
+    uint32_t start = std::max(first_level, status.requested_mip);
+    if(start >= end_level) {
+        return;
+    }
+
+    std::vector<Texture::Data> wanted(
+        std::make_move_iterator(levels.begin() + (start - first_level)),
+        std::make_move_iterator(levels.end())
+    );
+
+    texture->__do_upload_levels(start, wanted, TEXTURE_WRAP_REPEAT, TEXTURE_FILTER_NEAREST);
+}
+
+void TextureStreamer::set_memory_budget(std::size_t bytes) {
+    std::lock_guard<std::mutex> lock(lock_);
+    memory_budget_ = bytes;
+}
+
+std::size_t TextureStreamer::memory_budget() const {
+    std::lock_guard<std::mutex> lock(lock_);
+    return memory_budget_;
+}
+
+void TextureStreamer::set_resident_size(uint32_t pixels) {
+    std::lock_guard<std::mutex> lock(lock_);
+    resident_size_ = pixels;
+}
+
+uint32_t TextureStreamer::resident_size() const {
+    std::lock_guard<std::mutex> lock(lock_);
+    return resident_size_;
+}
+
+void TextureStreamer::set_eviction_delay(double seconds) {
+    std::lock_guard<std::mutex> lock(lock_);
+    eviction_delay_ = seconds;
+}
+
+double TextureStreamer::eviction_delay() const {
+    std::lock_guard<std::mutex> lock(lock_);
+    return eviction_delay_;
+}
+
+uint32_t TextureStreamer::streaming_count() const {
+    std::lock_guard<std::mutex> lock(lock_);
+    return entries_.size();
+}
+
+uint32_t TextureStreamer::loading_count() const {
+    std::lock_guard<std::mutex> lock(lock_);
+    return loading_count_;
+}
+
+std::size_t TextureStreamer::resident_bytes() const {
+    std::lock_guard<std::mutex> lock(lock_);
+
+    std::size_t total = 0;
+    for(auto& pair: entries_) {
+        if(auto texture = pair.second.texture.lock()) {
+            total += texture->streaming_status().resident_bytes;
+        }
+    }
+    return total;
+}
+
+}
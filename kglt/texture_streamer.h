@@ -0,0 +1,115 @@
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "types.h"
+#include "texture.h"
+
+namespace kglt {
+
+class WindowBase;
+struct TextureFlags;
+
+/*
+ * Streams the detailed mipmaps of textures loaded with TextureFlags::stream in and out of GPU
+ * memory, so that big scenes only pay for the detail that can actually be seen.
+ *
+ * While culling, the render sequence works out how large each visible renderable is on screen
+ * and credits the textures of its material with that size (in pixels). Once a frame update()
+ * turns that into the level each texture needs, assuming the texture is stretched once across
+ * the renderable so one texel per pixel is enough. More detailed levels are read from the
+ * texture's file again on a worker thread and uploaded through the renderer's upload queue.
+ * Levels which haven't been needed for eviction_delay seconds are released. If the levels
+ * wanted add up to more than the memory budget, the textures drawn smallest lose detail first.
+ *
+ * Levels no larger than resident_size in either direction are uploaded when the texture loads
+ * and never released, so there's always something to draw. Streaming needs the GL 2.x renderer,
+ * elsewhere textures with the stream flag are uploaded in full as usual.
+ */
+class TextureStreamer {
+public:
+    static const uint32_t DEFAULT_RESIDENT_SIZE = 64;
+    static const std::size_t DEFAULT_MEMORY_BUDGET = 256 * 1024 * 1024;
+    static const uint32_t MAX_CONCURRENT_LOADS = 2;
+
+    TextureStreamer(WindowBase* window);
+
+    /*
+     * Takes over a texture which has just been loaded from path (with all its data) and uploads
+     * the levels which are always resident, freeing the texture's data. Returns false if the
+     * texture can't be streamed (it has no mipmaps, or is compressed without a full mipmap
+     * chain) in which case it should be uploaded as normal. This waits for the GL thread to do
+     * the upload, so loads on a worker call prepare() there and queue __do_add() instead.
+     */
+    bool add(TexturePtr texture, const unicode& path, const TextureFlags& flags);
+
+    /* The levels which stay resident, taken out of a texture by prepare() */
+    struct ResidentLevels {
+        uint32_t first_level = 0;
+        std::vector<Texture::Data> levels;
+    };
+
+    /* The first half of add(), safe on any thread: builds the mipmaps and moves the always resident
+     * levels into resident. Returns false if the texture can't be streamed */
+    bool prepare(TexturePtr texture, const unicode& path, const TextureFlags& flags, ResidentLevels& resident);
+
+    /* The second half of add(), uploads the prepared levels and starts streaming the texture. Must
+     * be called on the GL thread */
+    void __do_add(TexturePtr texture, const unicode& path, const TextureFlags& flags, ResidentLevels& resident);
+
+    /* Called by the render sequence with the size a material has been drawn at this frame */
+    void _note_usage(MaterialPtr material, float pixels);
+
+    /* Picks the level each texture needs, and releases or starts loading levels to match. Runs on the GL thread */
+    void update(double dt);
+
+    /* The GPU memory (in bytes) streamed textures may use, including their always resident levels */
+    void set_memory_budget(std::size_t bytes);
+    std::size_t memory_budget() const;
+
+    void set_resident_size(uint32_t pixels);
+    uint32_t resident_size() const;
+
+    void set_eviction_delay(double seconds);
+    double eviction_delay() const;
+
+    uint32_t streaming_count() const;
+    uint32_t loading_count() const;
+    std::size_t resident_bytes() const;
+
+private:
+    struct Entry {
+        std::weak_ptr<Texture> texture;
+        unicode path;
+        bool flip_vertically = false;
+
+        float pixels = 0.0f; // The largest the texture has been drawn since the last update
+        float last_pixels = 0.0f;
+        uint32_t wanted_mip = 0; // The level needed, regardless of the budget
+        double time_wanting_less = 0.0;
+
+        bool loading = false;
+        bool failed = false; // Reading the file again failed, so the texture stays as it is
+    };
+
+    WindowBase* window_;
+
+    mutable std::mutex lock_;
+    std::unordered_map<TextureID, Entry> entries_;
+    uint32_t loading_count_ = 0;
+
+    std::size_t memory_budget_ = DEFAULT_MEMORY_BUDGET;
+    uint32_t resident_size_ = DEFAULT_RESIDENT_SIZE;
+    double eviction_delay_ = 2.0;
+
+    void track(TexturePtr texture, const unicode& path, const TextureFlags& flags, uint32_t first_level);
+    void start_load(TextureID id, Entry& entry, TexturePtr texture, uint32_t first_level, uint32_t end_level);
+    void finish_load(TextureID id, uint32_t first_level, uint32_t end_level, std::vector<Texture::Data>& levels);
+};
+
+}
+
+#endif // TEXTURE_STREAMER_H
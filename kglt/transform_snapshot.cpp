@@ -0,0 +1,67 @@
+#include <algorithm>
+
+#include "transform_snapshot.h"
+#include "object.h"
+#include "generic/generic_tree.h"
+
+namespace kglt {
+
+void TransformSnapshot::capture(GenericTreeNode* root) {
+    const uint64_t generation = ++generation_;
+
+    root->apply_recursively([generation](GenericTreeNode* node) {
+        MoveableObject* object = dynamic_cast<MoveableObject*>(node);
+        if(!object) {
+            return;
+        }
+
+        object->snapshot_previous_ = object->snapshot_current_;
+        object->snapshot_current_.generation = generation;
+        object->snapshot_current_.position = object->absolute_position();
+        object->snapshot_current_.rotation = object->absolute_rotation();
+    }, false);
+}
+
+void TransformSnapshot::publish() {
+    published_ = generation_;
+}
+
+void TransformSnapshot::clear() {
+    // Skipping a generation leaves every object's captured state stale
+    ++generation_;
+    published_ = 0;
+}
+
+bool TransformSnapshot::interpolated_transformation(const MoveableObject* object, float alpha, Mat4& out) const {
+    const TransformState& current = object->snapshot_current_;
+    const TransformState& previous = object->snapshot_previous_;
+
+    if(!published_ || current.generation != published_) {
+        return false;
+    }
+
+    /* If the object was moved outside of the fixed step (e.g. from update()) since the snapshot
+     * was taken then the snapshot is stale, so let the caller use the live transform */
+    if(object->absolute_position() != current.position || object->absolute_rotation() != current.rotation) {
+        return false;
+    }
+
+    Vec3 position = current.position;
+    Quaternion rotation = current.rotation;
+
+    if(previous.generation == published_ - 1) {
+        alpha = std::min(std::max(alpha, 0.0f), 1.0f);
+
+        kmVec3Lerp(&position, &previous.position, &current.position, alpha);
+        kmQuaternionSlerp(&rotation, &previous.rotation, &current.rotation, alpha);
+    }
+
+    Mat4 rot_matrix, trans_matrix;
+    kmMat4RotationQuaternion(&rot_matrix, &rotation);
+    kmMat4Translation(&trans_matrix, position.x, position.y, position.z);
+    kmMat4Multiply(&out, &trans_matrix, &rot_matrix);
+
+    return true;
+}
+
+}
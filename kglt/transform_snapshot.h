@@ -0,0 +1,50 @@
+#ifndef TRANSFORM_SNAPSHOT_H
+#define TRANSFORM_SNAPSHOT_H
+
+#include "types.h"
+
+class GenericTreeNode;
+
+namespace kglt {
+
+class MoveableObject;
+
+struct TransformState {
+    uint64_t generation = 0;
+    Vec3 position;
+    Quaternion rotation;
+};
+
+/*
+ * Captures the absolute transforms of every MoveableObject in a stage, for interpolation.
+ *
+ * When the window runs the simulation on its own thread, the simulation thread captures
+ * the stage after each batch of fixed steps and then publishes it. Each object keeps its last
+ * two captured states, and the renderer interpolates between them so that objects move
+ * smoothly between fixed steps, rather than snapping at the fixed step rate.
+ *
+ * The simulation only runs while the main thread waits on it, so nothing here is locked.
+ */
+class TransformSnapshot {
+public:
+    void capture(GenericTreeNode* root);
+    void publish();
+    void clear();
+
+    bool is_populated() const { return published_ != 0; }
+
+    /*
+     * Interpolates the transform of object between the previous and current snapshots. Returns
+     * false if the object isn't in the snapshot (e.g. it was created since the last publish) or
+     * if it has been moved since the snapshot was taken
+     */
+    bool interpolated_transformation(const MoveableObject* object, float alpha, Mat4& out) const;
+
+private:
+    uint64_t generation_ = 0; // The last capture
+    uint64_t published_ = 0; // The last capture the renderer may use, 0 if none
+};
+
+}
+
+#endif // TRANSFORM_SNAPSHOT_H
@@ -0,0 +1,352 @@
+#include <algorithm>
+#include <cassert>
+
+#include "transform_store.h"
+#include "object.h"
+
+namespace kglt {
+
+TransformIndex TransformStore::allocate(MoveableObject* owner) {
+    TransformIndex slot;
+
+    if(!free_slots_.empty()) {
+        slot = free_slots_.back();
+        free_slots_.pop_back();
+    } else {
+        slot = slot_to_dense_.size();
+        slot_to_dense_.push_back(0);
+        parent_slot_.push_back(INVALID_TRANSFORM_INDEX);
+        children_.push_back(std::vector<TransformIndex>());
+        owners_.push_back(nullptr);
+    }
+
+    // New transforms have no parent, so appending them keeps the arrays in hierarchy order
+    uint32_t dense = dense_size_++;
+
+    dense_to_slot_.push_back(slot);
+    parent_dense_.push_back(INVALID_TRANSFORM_INDEX);
+    flags_.push_back(TRANSFORM_FLAG_DIRTY | TRANSFORM_FLAG_MATRIX_DIRTY);
+    local_position_.push_back(Vec3(0, 0, 0));
+    local_rotation_.push_back(Quaternion(0, 0, 0, 1));
+    world_position_.push_back(Vec3(0, 0, 0));
+    world_rotation_.push_back(Quaternion(0, 0, 0, 1));
+    world_matrix_.push_back(Mat4());
+
+    slot_to_dense_[slot] = dense;
+    parent_slot_[slot] = INVALID_TRANSFORM_INDEX;
+    children_[slot].clear();
+    owners_[slot] = owner;
+
+    // New transforms start dirty, so they must be in the changed set for later moves to be seen
+    mark_changed(dense, slot);
+
+    return slot;
+}
+
+void TransformStore::release(TransformIndex index) {
+    uint32_t dense = slot_to_dense_[index];
+    assert(!(flags_[dense] & TRANSFORM_FLAG_FREE));
+
+    // Any children are orphaned and become roots
+    for(auto child: children_[index]) {
+        parent_slot_[child] = INVALID_TRANSFORM_INDEX;
+        parent_dense_[slot_to_dense_[child]] = INVALID_TRANSFORM_INDEX;
+        mark_dirty(child);
+    }
+    children_[index].clear();
+
+    set_parent(index, INVALID_TRANSFORM_INDEX);
+
+    // Leave a hole, it's compacted away the next time the order is rebuilt
+    flags_[dense] = TRANSFORM_FLAG_FREE;
+    dense_to_slot_[dense] = INVALID_TRANSFORM_INDEX;
+    slot_to_dense_[index] = INVALID_TRANSFORM_INDEX;
+    owners_[index] = nullptr;
+    free_slots_.push_back(index);
+
+    ++free_dense_count_;
+    order_dirty_ = true;
+}
+
+void TransformStore::set_parent(TransformIndex index, TransformIndex parent) {
+    assert(index != parent);
+
+    TransformIndex old_parent = parent_slot_[index];
+    uint32_t dense = slot_to_dense_[index];
+
+    if(old_parent != INVALID_TRANSFORM_INDEX) {
+        auto& siblings = children_[old_parent];
+        siblings.erase(std::remove(siblings.begin(), siblings.end(), index), siblings.end());
+    }
+
+    parent_slot_[index] = parent;
+
+    if(parent == INVALID_TRANSFORM_INDEX) {
+        parent_dense_[dense] = INVALID_TRANSFORM_INDEX;
+    } else {
+        children_[parent].push_back(index);
+
+        uint32_t parent_dense = slot_to_dense_[parent];
+        parent_dense_[dense] = parent_dense;
+
+        // Descendants always come after their parent, so only this pair can be out of order
+        if(parent_dense > dense) {
+            order_dirty_ = true;
+        }
+    }
+
+    mark_dirty(index);
+}
+
+void TransformStore::set_local_position(TransformIndex index, const Vec3& position) {
+    local_position_[slot_to_dense_[index]] = position;
+    mark_dirty(index);
+}
+
+void TransformStore::set_local_rotation(TransformIndex index, const Quaternion& rotation) {
+    local_rotation_[slot_to_dense_[index]] = rotation;
+    mark_dirty(index);
+}
+
+void TransformStore::set_position_locked(TransformIndex index, bool value) {
+    uint8_t& flags = flags_[slot_to_dense_[index]];
+    if(value) {
+        flags |= TRANSFORM_FLAG_POSITION_LOCKED;
+    } else {
+        flags &= ~TRANSFORM_FLAG_POSITION_LOCKED;
+        mark_dirty(index);
+    }
+}
+
+void TransformStore::set_rotation_locked(TransformIndex index, bool value) {
+    uint8_t& flags = flags_[slot_to_dense_[index]];
+    if(value) {
+        flags |= TRANSFORM_FLAG_ROTATION_LOCKED;
+    } else {
+        flags &= ~TRANSFORM_FLAG_ROTATION_LOCKED;
+        mark_dirty(index);
+    }
+}
+
+bool TransformStore::is_dirty(TransformIndex index) const {
+    return flags_[slot_to_dense_[index]] & TRANSFORM_FLAG_DIRTY;
+}
+
+void TransformStore::mark_dirty(TransformIndex index) {
+    uint8_t& flags = flags_[slot_to_dense_[index]];
+
+    if(flags & TRANSFORM_FLAG_DIRTY) {
+        // Descendants are always dirty when their parent is, so there's nothing more to do
+        return;
+    }
+
+    flags |= TRANSFORM_FLAG_DIRTY | TRANSFORM_FLAG_MATRIX_DIRTY;
+    mark_changed(slot_to_dense_[index], index);
+
+    if(owners_[index]) {
+        owners_[index]->world_transform_dirtied();
+    }
+
+    for(auto child: children_[index]) {
+        mark_dirty(child);
+    }
+}
+
+void TransformStore::mark_changed(uint32_t dense, TransformIndex index) {
+    if(flags_[dense] & TRANSFORM_FLAG_CHANGED) {
+        return;
+    }
+
+    flags_[dense] |= TRANSFORM_FLAG_CHANGED;
+    changed_.push_back(index);
+}
+
+std::vector<TransformIndex> TransformStore::take_changed() {
+    std::vector<TransformIndex> result;
+    result.reserve(changed_.size());
+
+    for(auto index: changed_) {
+        uint32_t dense = slot_to_dense_[index];
+        if(dense == INVALID_TRANSFORM_INDEX || !(flags_[dense] & TRANSFORM_FLAG_CHANGED)) {
+            // Released (and possibly reused) since it changed
+            continue;
+        }
+
+        flags_[dense] &= ~TRANSFORM_FLAG_CHANGED;
+        result.push_back(index);
+    }
+
+    changed_.clear();
+    return result;
+}
+
+const Vec3& TransformStore::world_position(TransformIndex index) {
+    uint32_t dense = slot_to_dense_[index];
+    resolve(dense);
+    return world_position_[dense];
+}
+
+const Quaternion& TransformStore::world_rotation(TransformIndex index) {
+    uint32_t dense = slot_to_dense_[index];
+    resolve(dense);
+    return world_rotation_[dense];
+}
+
+const Mat4& TransformStore::world_matrix(TransformIndex index) {
+    uint32_t dense = slot_to_dense_[index];
+    resolve(dense);
+
+    if(flags_[dense] & TRANSFORM_FLAG_MATRIX_DIRTY) {
+        compute_matrix(dense);
+    }
+
+    return world_matrix_[dense];
+}
+
+void TransformStore::resolve(uint32_t dense) {
+    if(!(flags_[dense] & TRANSFORM_FLAG_DIRTY)) {
+        return;
+    }
+
+    uint32_t parent = parent_dense_[dense];
+    if(parent != INVALID_TRANSFORM_INDEX) {
+        resolve(parent);
+    }
+
+    compute_world(dense);
+}
+
+void TransformStore::compute_world(uint32_t dense) {
+    const uint8_t flags = flags_[dense];
+    const uint32_t parent = parent_dense_[dense];
+
+    if(!(flags & TRANSFORM_FLAG_POSITION_LOCKED)) {
+        world_position_[dense] = (parent == INVALID_TRANSFORM_INDEX) ?
+            local_position_[dense] : world_position_[parent] + local_position_[dense];
+    }
+
+    if(!(flags & TRANSFORM_FLAG_ROTATION_LOCKED)) {
+        if(parent == INVALID_TRANSFORM_INDEX) {
+            world_rotation_[dense] = local_rotation_[dense];
+        } else {
+            world_rotation_[dense] = local_rotation_[dense] * world_rotation_[parent];
+            world_rotation_[dense].normalize();
+        }
+    }
+
+    flags_[dense] = (flags & ~TRANSFORM_FLAG_DIRTY) | TRANSFORM_FLAG_MATRIX_DIRTY;
+}
+
+void TransformStore::compute_matrix(uint32_t dense) {
+    Mat4 rot_matrix, trans_matrix;
+
+    const Vec3& position = world_position_[dense];
+
+    kmMat4RotationQuaternion(&rot_matrix, &world_rotation_[dense]);
+    kmMat4Translation(&trans_matrix, position.x, position.y, position.z);
+    kmMat4Multiply(&world_matrix_[dense], &trans_matrix, &rot_matrix);
+
+    flags_[dense] &= ~TRANSFORM_FLAG_MATRIX_DIRTY;
+}
+
+void TransformStore::update() {
+    if(order_dirty_) {
+        rebuild_order();
+    }
+
+    /* Parents always precede their children, so by the time a dirty child is reached its
+     * parent's world transform is already up to date */
+    for(uint32_t i = 0; i < dense_size_; ++i) {
+        const uint8_t flags = flags_[i];
+
+        if(flags & TRANSFORM_FLAG_FREE) {
+            continue;
+        }
+
+        if(flags & TRANSFORM_FLAG_DIRTY) {
+            compute_world(i);
+        }
+
+        if(flags_[i] & TRANSFORM_FLAG_MATRIX_DIRTY) {
+            compute_matrix(i);
+        }
+    }
+}
+
+void TransformStore::rebuild_order() {
+    const uint32_t live_count = size();
+
+    std::vector<TransformIndex> order;
+    order.reserve(live_count);
+
+    // Depth-first from each root, so every subtree ends up contiguous
+    std::vector<TransformIndex> stack;
+    for(uint32_t i = 0; i < dense_size_; ++i) {
+        if(flags_[i] & TRANSFORM_FLAG_FREE) {
+            continue;
+        }
+
+        TransformIndex slot = dense_to_slot_[i];
+        if(parent_slot_[slot] != INVALID_TRANSFORM_INDEX) {
+            continue;
+        }
+
+        stack.push_back(slot);
+        while(!stack.empty()) {
+            TransformIndex next = stack.back();
+            stack.pop_back();
+
+            order.push_back(next);
+
+            auto& children = children_[next];
+            for(auto it = children.rbegin(); it != children.rend(); ++it) {
+                stack.push_back(*it);
+            }
+        }
+    }
+
+    assert(order.size() == live_count);
+
+    std::vector<TransformIndex> new_dense_to_slot(live_count);
+    std::vector<uint32_t> new_parent_dense(live_count);
+    std::vector<uint8_t> new_flags(live_count);
+    std::vector<Vec3> new_local_position(live_count);
+    std::vector<Quaternion> new_local_rotation(live_count);
+    std::vector<Vec3> new_world_position(live_count);
+    std::vector<Quaternion> new_world_rotation(live_count);
+    std::vector<Mat4> new_world_matrix(live_count);
+
+    for(uint32_t i = 0; i < live_count; ++i) {
+        TransformIndex slot = order[i];
+        uint32_t old = slot_to_dense_[slot];
+
+        new_dense_to_slot[i] = slot;
+        new_flags[i] = flags_[old];
+        new_local_position[i] = local_position_[old];
+        new_local_rotation[i] = local_rotation_[old];
+        new_world_position[i] = world_position_[old];
+        new_world_rotation[i] = world_rotation_[old];
+        new_world_matrix[i] = world_matrix_[old];
+
+        // Parents are visited first, so their new position is already known
+        TransformIndex parent = parent_slot_[slot];
+        new_parent_dense[i] = (parent == INVALID_TRANSFORM_INDEX) ? INVALID_TRANSFORM_INDEX : slot_to_dense_[parent];
+
+        slot_to_dense_[slot] = i;
+    }
+
+    std::swap(dense_to_slot_, new_dense_to_slot);
+    std::swap(parent_dense_, new_parent_dense);
+    std::swap(flags_, new_flags);
+    std::swap(local_position_, new_local_position);
+    std::swap(local_rotation_, new_local_rotation);
+    std::swap(world_position_, new_world_position);
+    std::swap(world_rotation_, new_world_rotation);
+    std::swap(world_matrix_, new_world_matrix);
+
+    dense_size_ = live_count;
+    free_dense_count_ = 0;
+    order_dirty_ = false;
+}
+
+}
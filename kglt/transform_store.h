@@ -0,0 +1,118 @@
+#ifndef TRANSFORM_STORE_H
+#define TRANSFORM_STORE_H
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+
+#include "types.h"
+
+namespace kglt {
+
+class MoveableObject;
+
+typedef uint32_t TransformIndex;
+
+const TransformIndex INVALID_TRANSFORM_INDEX = ~TransformIndex(0);
+
+/*
+ * Contiguous storage for the transforms of every MoveableObject in a stage.
+ *
+ * Objects hold a TransformIndex, which is a stable handle into the store. The transforms
+ * themselves (local and world position/rotation, world matrix and flags) live in parallel arrays
+ * which are kept in hierarchy order: every parent comes before all of its children. That means
+ * update() can resolve every dirty world transform in a single linear sweep, as each parent has
+ * always been resolved by the time its children are reached.
+ *
+ * Setting a local transform marks that transform and its descendants dirty; world transforms
+ * are then resolved either by the next update() or on demand when they're read. Everything
+ * marked dirty is also recorded (once) in a changed set, which the stage drains each frame to
+ * notify listeners about what moved. Owners are told straight away when their world transform
+ * is marked dirty, for anything cached from it.
+ */
+class TransformStore {
+public:
+    typedef std::shared_ptr<TransformStore> ptr;
+
+    TransformIndex allocate(MoveableObject* owner=nullptr);
+    void release(TransformIndex index);
+
+    MoveableObject* owner(TransformIndex index) const { return owners_[index]; }
+
+    /* Pass INVALID_TRANSFORM_INDEX to make the transform a root */
+    void set_parent(TransformIndex index, TransformIndex parent);
+    TransformIndex parent(TransformIndex index) const { return parent_slot_[index]; }
+
+    void set_local_position(TransformIndex index, const Vec3& position);
+    void set_local_rotation(TransformIndex index, const Quaternion& rotation);
+
+    const Vec3& local_position(TransformIndex index) const { return local_position_[slot_to_dense_[index]]; }
+    const Quaternion& local_rotation(TransformIndex index) const { return local_rotation_[slot_to_dense_[index]]; }
+
+    /* A locked component keeps its current world value regardless of what the parent does */
+    void set_position_locked(TransformIndex index, bool value);
+    void set_rotation_locked(TransformIndex index, bool value);
+
+    const Vec3& world_position(TransformIndex index);
+    const Quaternion& world_rotation(TransformIndex index);
+    const Mat4& world_matrix(TransformIndex index);
+
+    bool is_dirty(TransformIndex index) const;
+
+    /* Resolves every dirty world transform (and matrix), restoring hierarchy order first if needed */
+    void update();
+
+    /* Returns every transform marked dirty since the last call (each only once) and starts
+     * a new set. Transforms released in the meantime are left out */
+    std::vector<TransformIndex> take_changed();
+
+    /* Number of live transforms */
+    uint32_t size() const { return dense_size_ - free_dense_count_; }
+
+    /* The dense position of a transform, exposed so that ordering can be tested */
+    uint32_t _dense_index(TransformIndex index) const { return slot_to_dense_[index]; }
+
+private:
+    enum TransformFlags {
+        TRANSFORM_FLAG_DIRTY = 1,
+        TRANSFORM_FLAG_MATRIX_DIRTY = 2,
+        TRANSFORM_FLAG_POSITION_LOCKED = 4,
+        TRANSFORM_FLAG_ROTATION_LOCKED = 8,
+        TRANSFORM_FLAG_FREE = 16,
+        TRANSFORM_FLAG_CHANGED = 32
+    };
+
+    // Indexed by slot (TransformIndex)
+    std::vector<uint32_t> slot_to_dense_;
+    std::vector<TransformIndex> parent_slot_;
+    std::vector<std::vector<TransformIndex>> children_;
+    std::vector<TransformIndex> free_slots_;
+    std::vector<MoveableObject*> owners_;
+
+    std::vector<TransformIndex> changed_;
+
+    // Indexed by dense position, in hierarchy order
+    std::vector<TransformIndex> dense_to_slot_;
+    std::vector<uint32_t> parent_dense_;
+    std::vector<uint8_t> flags_;
+    std::vector<Vec3> local_position_;
+    std::vector<Quaternion> local_rotation_;
+    std::vector<Vec3> world_position_;
+    std::vector<Quaternion> world_rotation_;
+    std::vector<Mat4> world_matrix_;
+
+    uint32_t dense_size_ = 0;
+    uint32_t free_dense_count_ = 0;
+    bool order_dirty_ = false;
+
+    void mark_dirty(TransformIndex index);
+    void mark_changed(uint32_t dense, TransformIndex index);
+    void resolve(uint32_t dense);
+    void compute_world(uint32_t dense);
+    void compute_matrix(uint32_t dense);
+    void rebuild_order();
+};
+
+}
+
+#endif // TRANSFORM_STORE_H
@@ -40,6 +40,28 @@ kglt::Vec3 operator/(float lhs, const kglt::Vec3& rhs) {
     return result;
 }
 
+AABB AABB::transformed(const Mat4& transform) const {
+    /* Transform the centre, then each axis of the result extends by the absolute
+     * contribution of every local axis (Arvo's method) */
+    Vec3 local_centre = centre();
+    Vec3 extents = (Vec3(max) - Vec3(min)) * 0.5f;
+
+    Vec3 world_centre;
+    kmVec3Transform(&world_centre, &local_centre, &transform);
+
+    const float* m = transform.mat;
+    Vec3 world_extents(
+        fabs(m[0]) * extents.x + fabs(m[4]) * extents.y + fabs(m[8]) * extents.z,
+        fabs(m[1]) * extents.x + fabs(m[5]) * extents.y + fabs(m[9]) * extents.z,
+        fabs(m[2]) * extents.x + fabs(m[6]) * extents.y + fabs(m[10]) * extents.z
+    );
+
+    AABB result;
+    result.min = world_centre - world_extents;
+    result.max = world_centre + world_extents;
+    return result;
+}
+
 Vec3 Vec3::random_deviant(const Degrees& angle, const Vec3 up) const {
     //Lovingly adapted from ogre
     Vec3 new_up = (up == Vec3()) ? perpendicular() : up;
@@ -512,6 +512,9 @@ struct AABB : public kmAABB3 {
         return Vec3(min) + ((Vec3(max) - Vec3(min)) * 0.5f);
     }
 
+    /* The box enclosing this one once transformed, rotations make it larger */
+    AABB transformed(const Mat4& transform) const;
+
     const bool has_zero_area() const {
         /*
          * Returns True if the AABB has two or more zero dimensions
@@ -682,6 +685,14 @@ enum VirtualDPadDirections {
     VIRTUAL_DPAD_DIRECTIONS_ANALOG
 };
 
+enum ResourceCategory {
+    RESOURCE_CATEGORY_MESH,
+    RESOURCE_CATEGORY_MATERIAL,
+    RESOURCE_CATEGORY_TEXTURE,
+    RESOURCE_CATEGORY_SOUND,
+    RESOURCE_CATEGORY_MAX
+};
+
 const std::string DEFAULT_MATERIAL_SCHEME = "default";
 
 class Mesh;
@@ -5,6 +5,8 @@
 #endif
 
 #include <thread>
+#include <cstring>
+#include <algorithm>
 
 #include "../loader.h"
 #include "../overlay.h"
@@ -20,6 +22,33 @@
 namespace kglt {
 namespace ui {
 
+namespace {
+
+/* Matches nk_draw_vertex: position, uv and an RGBA colour packed into four bytes */
+const VertexSpecification NK_VERTEX_SPECIFICATION(
+    VERTEX_ATTRIBUTE_2F,
+    VERTEX_ATTRIBUTE_NONE,
+    VERTEX_ATTRIBUTE_2F,
+    VERTEX_ATTRIBUTE_NONE,
+    VERTEX_ATTRIBUTE_NONE,
+    VERTEX_ATTRIBUTE_NONE,
+    VERTEX_ATTRIBUTE_4UB
+);
+
+static_assert(sizeof(struct nk_draw_vertex) == sizeof(float) * 4 + 4, "nk_draw_vertex doesn't match the vertex specification");
+
+/* FNV-1a */
+uint64_t hash_bytes(uint64_t hash, const void* data, std::size_t size) {
+    const uint8_t* bytes = (const uint8_t*) data;
+    for(std::size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+}
+
 Interface::Interface(WindowBase &window, Overlay *owner):
     window_(window),
     stage_(owner) {
@@ -73,23 +102,6 @@ std::vector<unicode> Interface::find_fonts() {
 }
 
 bool Interface::init() {
-    auto null_material_id = stage_->assets->new_material_from_texture(
-        stage_->assets->default_texture_id(),
-        GARBAGE_COLLECT_NEVER
-    );
-
-    auto null_material = stage_->assets->material(null_material_id);
-    null_material->first_pass()->set_cull_mode(CULL_MODE_NONE);
-    null_material->first_pass()->set_blending(BLEND_ALPHA);
-    null_material->first_pass()->set_depth_test_enabled(false);
-
-    // Load a material which renders a single white pixel texture
-    nk_device_.null_tex = null_material_id;
-
-    // Set the null texture to use this material
-    nk_device_.null.texture = nk_handle_id((int) nk_device_.null_tex.value());
-    nk_device_.null.uv.x = nk_device_.null.uv.y = 0;
-
     nk_font_atlas_init_default(&nk_font_);
     nk_font_atlas_begin(&nk_font_);
     struct nk_font* font = nk_font_atlas_add_default(&nk_font_, 13, 0);
@@ -115,9 +127,16 @@ bool Interface::init() {
     font_material->first_pass()->set_depth_test_enabled(false);
 
     nk_device_.font_tex = font_material_id;
-    nk_font_atlas_end(&nk_font_, nk_handle_id((int)nk_device_.font_tex.value()), nullptr);
+
+    /* Nuklear bakes a white pixel into the font atlas for untextured shapes, so the whole
+     * interface draws with the font material rather than switching between two */
+    nk_font_atlas_end(&nk_font_, nk_handle_id((int)nk_device_.font_tex.value()), &nk_device_.null);
     nk_init_default(&nk_ctx_, &font->handle);
     nk_buffer_init_default(&nk_device_.cmds);
+    nk_buffer_init_default(&nk_device_.vertices);
+    nk_buffer_init_default(&nk_device_.elements);
+
+    renderable_ = std::make_shared<UIRenderable>(NK_VERTEX_SPECIFICATION);
     return true;
 }
 
@@ -224,12 +243,25 @@ void Interface::render(CameraPtr camera, Viewport viewport) {
 
 }
 
-void Interface::send_to_renderer(CameraPtr camera, Viewport viewport) {
-    // Now to actually render everything
-    const struct nk_draw_command *cmd;
-    struct nk_buffer vbuf, ebuf;
+uint64_t Interface::hash_commands() {
+    /* Everything drawn this frame is in the windows' command buffers, which nk_convert walks
+     * in window order. Hidden and empty windows are skipped, just as nk_convert does */
+    const nk_byte* memory = (const nk_byte*) nk_buffer_memory_const(&nk_ctx_.memory);
+
+    uint64_t hash = 14695981039346656037ull;
+    for(struct nk_window* iter = nk_ctx_.begin; iter; iter = iter->next) {
+        if(iter->buffer.begin == iter->buffer.end || (iter->flags & NK_WINDOW_HIDDEN)) {
+            continue;
+        }
+
+        hash = hash_bytes(hash, &iter, sizeof(iter));
+        hash = hash_bytes(hash, memory + iter->buffer.begin, iter->buffer.end - iter->buffer.begin);
+    }
+
+    return hash;
+}
 
-    /* fill converting configuration */
+void Interface::convert_commands() {
     struct nk_convert_config config;
     memset(&config, 0, sizeof(config));
     config.global_alpha = 1.0f;
@@ -240,86 +272,77 @@ void Interface::send_to_renderer(CameraPtr camera, Viewport viewport) {
     config.arc_segment_count = 22;
     config.null = nk_device_.null;
 
-    /* convert shapes into vertexes */
-    nk_buffer_init_default(&vbuf);
-    nk_buffer_init_default(&ebuf);
-    nk_convert(&nk_ctx_, &nk_device_.cmds, &vbuf, &ebuf, &config);
-
-    VertexSpecification spec;
-    spec.position_attribute = VERTEX_ATTRIBUTE_2F;
-    spec.texcoord0_attribute = VERTEX_ATTRIBUTE_2F;
-    spec.diffuse_attribute = VERTEX_ATTRIBUTE_4F;
-
-    const nk_byte* vertices = (const nk_byte*) nk_buffer_memory_const(&vbuf);
-    const nk_draw_index *offset = (const nk_draw_index*) nk_buffer_memory_const(&ebuf);
-
-    VertexData vertex_data(spec);
-
-    auto vertex_size = (sizeof(float) * 4 + sizeof(uint32_t));
-
-    const nk_byte* current = vertices;
-    for(uint32_t i = 0; i < vbuf.size / vertex_size; ++i) {
-        float x = ((float*)current)[0];
-        float y = ((float*)current)[1];
-        float u = ((float*)current)[2];
-        float v = ((float*)current)[3];
-
-        current += sizeof(float) * 4;
-        uint32_t colour = ((uint32_t*)current)[0];
-        current += sizeof(uint32_t);
-
-        vertex_data.position(x, y);
-        vertex_data.tex_coord0(u, v);
-        vertex_data.diffuse(kglt::Colour(
-            float((colour & 0xFF000000) >> 6) / 256.0f,
-            float((colour & 0xFF0000) >> 4) / 256.0f,
-            float((colour & 0xFF00) >> 2) / 256.0f,
-            float((colour & 0xFF)) / 256.0f
-        ));
-        vertex_data.move_next();
+    nk_buffer_clear(&nk_device_.cmds);
+    nk_buffer_clear(&nk_device_.vertices);
+    nk_buffer_clear(&nk_device_.elements);
+    nk_convert(&nk_ctx_, &nk_device_.cmds, &nk_device_.vertices, &nk_device_.elements, &config);
+
+    // The vertex layout matches, so the vertices can be copied straight in
+    VertexData& vertex_data = renderable_->vertex_data;
+    const uint32_t vertex_count = nk_device_.vertices.allocated / sizeof(struct nk_draw_vertex);
+
+    vertex_data.resize(vertex_count);
+    if(vertex_count) {
+        memcpy(vertex_data.data(), nk_buffer_memory_const(&nk_device_.vertices), vertex_count * sizeof(struct nk_draw_vertex));
     }
     vertex_data.done();
 
-    std::vector<std::shared_ptr<UIRenderable>> renderables;
+    // Nuklear's indices are 16 bit, ours are 32
+    IndexData& index_data = renderable_->index_data;
+    const uint32_t index_count = nk_device_.elements.allocated / sizeof(nk_draw_index);
+    const nk_draw_index* indices = (const nk_draw_index*) nk_buffer_memory_const(&nk_device_.elements);
 
-    auto& renderer = this->window_.renderer;
+    index_data.resize(index_count);
+    if(index_count) {
+        std::copy(indices, indices + index_count, index_data._raw_data());
+    }
+    index_data.done();
 
+    draw_commands_.clear();
+
+    const struct nk_draw_command* cmd;
+    uint32_t first_index = 0;
     nk_draw_foreach(cmd, &nk_ctx_, &nk_device_.cmds) {
         if(!cmd->elem_count) continue;
 
-        renderables.push_back(std::make_shared<UIRenderable>(vertex_data, MaterialID(cmd->texture.id)));
+        // FIXME: clipping?
+        draw_commands_.push_back(DrawCommand{MaterialID(cmd->texture.id), first_index, cmd->elem_count});
+        first_index += cmd->elem_count;
+    }
 
-        auto renderable = renderables.back();
+    renderable_->_mark_dirty();
+}
 
-        // FIXME: clipping?
-        for(uint32_t i = 0; i < cmd->elem_count; ++i) {
-            renderable->index_data->index(offset[i]);
-        }
-        renderable->index_data->done();
-        offset += cmd->elem_count;
+void Interface::send_to_renderer(CameraPtr camera, Viewport viewport) {
+    /* Most interfaces don't change from one frame to the next, in which case the geometry from
+     * last time is drawn again without converting or uploading anything */
+    uint64_t hash = hash_commands();
+    if(hash != command_hash_) {
+        convert_commands();
+        command_hash_ = hash;
     }
 
     nk_clear(&nk_ctx_);
-    nk_buffer_free(&vbuf);
-    nk_buffer_free(&ebuf);
 
-    for(auto& renderable: renderables) {
-        auto material = stage_->assets->material(renderable->material_id());
+    auto& renderer = this->window_.renderer;
+
+    for(auto& command: draw_commands_) {
+        renderable_->_set_draw_range(command.material, command.first_index, command.index_count);
+
+        auto material = stage_->assets->material(command.material);
         MaterialPass* pass = material->first_pass().get();
-        auto render_group = renderer->new_render_group(renderable.get(), pass);
+        auto render_group = renderer->new_render_group(renderable_.get(), pass);
         renderer->render(
             camera,
             true, // Render group changed
             &render_group,
-            renderable.get(),
+            renderable_.get(),
             pass,
             nullptr,
             kglt::Colour::WHITE,
             kglt::batcher::Iteration(0)
         );
     }
-
-
 }
 
 void Interface::set_dimensions(uint16_t width, uint16_t height) {
@@ -365,6 +388,11 @@ void Interface::set_styles(const std::string& stylesheet_content) {
 }
 
 Interface::~Interface() {
+    if(renderable_) {
+        // Only set up by init()
+        nk_buffer_free(&nk_device_.vertices);
+        nk_buffer_free(&nk_device_.elements);
+    }
 }
 
 }
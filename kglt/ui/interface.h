@@ -152,25 +152,24 @@ private:
     std::vector<Element> elements_;
 };
 
+/*
+ * All of an interface's geometry, kept from frame to frame. Each nuklear draw command is a
+ * range of the indices drawn with its own material, the range is picked with _set_draw_range()
+ * before the renderable is handed to the renderer. The buffers are only uploaded again after
+ * _mark_dirty(), so an interface which hasn't changed costs nothing but the draw calls.
+ */
 class UIRenderable:
     public Renderable {
 
 public:
-    UIRenderable(VertexData& vertices, MaterialID material):
-        vertices_(vertices),
-        material_id_(material) {
+    UIRenderable(VertexSpecification spec):
+        vertices_(spec) {
 
 #ifdef KGLT_GL_VERSION_2X
         vertex_array_object_ = VertexArrayObject::create();
 #endif
     }
 
-    UIRenderable(const UIRenderable& rhs):
-        vertices_(rhs.vertices_),
-        material_id_(rhs.material_id_) {
-
-    }
-
     const MeshArrangement arrangement() const override { return MESH_ARRANGEMENT_TRIANGLES; }
     kglt::RenderPriority render_priority() const override { return RENDER_PRIORITY_MAIN; }
     kglt::Mat4 final_transformation() const override { return Mat4(); }
@@ -179,26 +178,47 @@ public:
     const AABB transformed_aabb() const { return AABB(); } // Not used
     const AABB aabb() const { return AABB(); } // Not used
 
+    void _set_draw_range(MaterialID material, uint32_t first_index, uint32_t index_count) {
+        material_id_ = material;
+        first_index_ = first_index;
+        index_count_ = index_count;
+    }
+
+    void _draw_range(uint32_t& first_index, uint32_t& index_count) const override {
+        first_index = first_index_;
+        index_count = index_count_;
+    }
+
+    void _mark_dirty() { dirty_ = true; }
+
 #ifdef KGLT_GL_VERSION_2X
     void _bind_vertex_array_object() {
         vertex_array_object_->bind();
     }
 
     void _update_vertex_array_object() {
+        if(!dirty_) {
+            return;
+        }
+
         vertex_array_object_->vertex_buffer_update(vertex_data->data_size(), vertex_data->data());
         vertex_array_object_->index_buffer_update(index_data->count() * sizeof(Index), index_data->_raw_data());
+        dirty_ = false;
     }
 private:
     VertexArrayObject::ptr vertex_array_object_;
 #endif
 
 private:
-    VertexData* get_vertex_data() const { return &vertices_; }
+    VertexData* get_vertex_data() const { return const_cast<VertexData*>(&vertices_); }
     IndexData* get_index_data() const { return const_cast<IndexData*>(&indices_); }
 
-    VertexData& vertices_;
+    VertexData vertices_;
     IndexData indices_;
     MaterialID material_id_;
+    uint32_t first_index_ = 0;
+    uint32_t index_count_ = 0;
+    bool dirty_ = true;
 };
 
 
@@ -246,11 +266,25 @@ private:
     nk_font_atlas nk_font_;
     struct nk_kglt_device {
         struct nk_buffer cmds;
+        struct nk_buffer vertices; // nk_convert output, kept so it isn't reallocated every change
+        struct nk_buffer elements;
         struct nk_draw_null_texture null;
         MaterialID font_tex;
-        MaterialID null_tex;
     } nk_device_;
 
+    /* A nuklear draw command, as a range of the renderable's indices */
+    struct DrawCommand {
+        MaterialID material;
+        uint32_t first_index;
+        uint32_t index_count;
+    };
+
+    std::shared_ptr<UIRenderable> renderable_;
+    std::vector<DrawCommand> draw_commands_;
+    uint64_t command_hash_ = 0;
+
+    uint64_t hash_commands();
+    void convert_commands();
     void send_to_renderer(CameraPtr camera, Viewport viewport);
 };
 
@@ -0,0 +1,73 @@
+#include <stdexcept>
+#include <fstream>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "mapped_file.h"
+
+namespace kglt {
+
+MappedFile::MappedFile(const std::string& path):
+    path_(path) {
+
+#if !defined(_WIN32)
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+        throw std::runtime_error("Unable to open file: " + path);
+    }
+
+    struct stat info;
+    if(fstat(fd, &info) != 0) {
+        close(fd);
+        throw std::runtime_error("Unable to read file: " + path);
+    }
+
+    size_ = info.st_size;
+
+    if(size_) {
+        void* address = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(address != MAP_FAILED) {
+            data_ = (const uint8_t*) address;
+            mapped_ = true;
+        }
+    }
+
+    // The mapping holds its own reference to the file
+    close(fd);
+
+    if(mapped_ || !size_) {
+        return;
+    }
+#endif
+
+    // No mmap, or the mapping failed (e.g. on some virtual filesystems), read the file instead
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if(!file) {
+        throw std::runtime_error("Unable to open file: " + path);
+    }
+
+    size_ = file.tellg();
+    file.seekg(0);
+
+    buffer_.resize(size_);
+    if(size_ && !file.read((char*) &buffer_[0], size_)) {
+        throw std::runtime_error("Unable to read file: " + path);
+    }
+
+    data_ = (size_) ? &buffer_[0] : nullptr;
+}
+
+MappedFile::~MappedFile() {
+#if !defined(_WIN32)
+    if(mapped_) {
+        munmap((void*) data_, size_);
+    }
+#endif
+}
+
+}
@@ -0,0 +1,42 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace kglt {
+
+/*
+ * A read-only view of a whole file. Where the platform has mmap the file is mapped rather than
+ * read, so pages are only touched when they're used and large files aren't copied into the
+ * heap; elsewhere the file is read into memory. Throws std::runtime_error if the file can't be
+ * opened.
+ */
+class MappedFile {
+public:
+    MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile& rhs) = delete;
+    MappedFile& operator=(const MappedFile& rhs) = delete;
+
+    const uint8_t* data() const { return data_; }
+    std::size_t size() const { return size_; }
+
+    const std::string& path() const { return path_; }
+
+private:
+    std::string path_;
+
+    const uint8_t* data_ = nullptr;
+    std::size_t size_ = 0;
+
+    bool mapped_ = false;
+    std::vector<uint8_t> buffer_;
+};
+
+}
+
+#endif // MAPPED_FILE_H
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <stdexcept>
 #include "vertex_data.h"
 #include "window_base.h"
@@ -36,6 +37,7 @@ uint32_t vertex_attribute_size(VertexAttribute attr) {
         case VERTEX_ATTRIBUTE_2F: return sizeof(float) * 2;
         case VERTEX_ATTRIBUTE_3F:  return sizeof(float) * 3;
         case VERTEX_ATTRIBUTE_4F: return sizeof(float) * 4;
+        case VERTEX_ATTRIBUTE_4UB: return sizeof(uint8_t) * 4;
         default:
             assert(0 && "Invalid attribute specified");
     }
@@ -49,7 +51,8 @@ VertexData::VertexData(VertexSpecification vertex_specification):
 
 void VertexData::clear() {
     data_.clear();
-    cursor_position_ = 0;    
+    vertex_count_ = 0;
+    cursor_position_ = 0;
 }
 
 void VertexData::position_checks() {
@@ -246,6 +249,19 @@ void VertexData::tex_coord3(float u, float v, float w, float x) {
 }
 
 void VertexData::diffuse(float r, float g, float b, float a) {
+    if(vertex_specification_.diffuse_attribute == VERTEX_ATTRIBUTE_4UB) {
+        auto to_byte = [](float v) -> uint8_t {
+            return uint8_t(std::min(std::max(v, 0.0f), 1.0f) * 255.0f + 0.5f);
+        };
+
+        uint8_t* out = &data_[cursor_position_ + diffuse_offset()];
+        out[0] = to_byte(r);
+        out[1] = to_byte(g);
+        out[2] = to_byte(b);
+        out[3] = to_byte(a);
+        return;
+    }
+
     assert(vertex_specification_.diffuse_attribute == VERTEX_ATTRIBUTE_4F);
     Vec4* out = (Vec4*) &data_[cursor_position_ + diffuse_offset()];
     *out = Vec4(r, g, b, a);
@@ -16,7 +16,8 @@ enum VertexAttribute {
     VERTEX_ATTRIBUTE_NONE,
     VERTEX_ATTRIBUTE_2F,
     VERTEX_ATTRIBUTE_3F,
-    VERTEX_ATTRIBUTE_4F
+    VERTEX_ATTRIBUTE_4F,
+    VERTEX_ATTRIBUTE_4UB // Four bytes, normalized to 0-1 (e.g. packed RGBA colours)
 };
 
 uint32_t vertex_attribute_size(VertexAttribute attr);
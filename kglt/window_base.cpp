@@ -17,12 +17,16 @@
 #include "loaders/wal_loader.h"
 #include "loaders/md2_loader.h"
 #include "loaders/pcx_loader.h"
+#include "loaders/kmesh_loader.h"
+#include "loaders/compressed_texture_loader.h"
 
 #include "sound.h"
 #include "camera.h"
 #include "watcher.h"
 #include "message_bar.h"
 #include "render_sequence.h"
+#include "renderers/renderer.h"
+#include "texture_streamer.h"
 #include "stage.h"
 #include "overlay.h"
 #include "virtual_gamepad.h"
@@ -46,6 +50,8 @@ WindowBase::WindowBase():
     height_(-1),
     is_running_(true),
     idle_(*this),
+    texture_streamer_(new TextureStreamer(this)),
+    jobs_(new JobSystem()),
     resource_locator_(ResourceLocator::create()),
     frame_counter_time_(0),
     frame_counter_frames_(0),
@@ -66,6 +72,8 @@ WindowBase::WindowBase():
 }
 
 WindowBase::~WindowBase() {
+    set_threaded_simulation(false);
+
     //FIXME: Make WindowBase Managed<> and put this in cleanup()
     virtual_gamepad_.reset();
     loading_.reset();
@@ -180,6 +188,8 @@ bool WindowBase::_init(int width, int height, int bpp, bool fullscreen) {
         register_loader(std::make_shared<kglt::loaders::WALLoaderType>());
         register_loader(std::make_shared<kglt::loaders::MD2LoaderType>());
         register_loader(std::make_shared<kglt::loaders::PCXLoaderType>());
+        register_loader(std::make_shared<kglt::loaders::KMeshLoaderType>());
+        register_loader(std::make_shared<kglt::loaders::CompressedTextureLoaderType>());
 
         L_INFO("Initializing OpenAL");
         Sound::init_openal();
@@ -283,28 +293,54 @@ bool WindowBase::run_frame() {
 
     check_events();
 
+    // The timer isn't thread-safe, so work out how many steps to run here
+    uint32_t steps = 0;
     while(ktiTimerCanUpdate()) {
-        pre_fixed_update(fixed_step);
-        signal_step_(fixed_step); //Trigger any steps
-        fixed_update(fixed_step); // Run the fixed updates on controllers
-        post_fixed_update(fixed_step);
+        ++steps;
     }
 
     fixed_step_interp_ = ktiGetAccumulatorValue();
-    signal_post_step_(fixed_step_interp_);
+
+    const bool threaded = is_simulation_threaded();
+
+    if(!threaded) {
+        run_fixed_steps(steps, fixed_step);
+        signal_post_step_(fixed_step_interp_);
+    }
 
     shared_assets->update(delta_time_);
+    update_resource_stats();
+
     idle_.execute(); //Execute idle tasks before render
+    jobs_->run_main_thread_jobs();
+
+    // Let the partitioners (and anything else listening) know what moved this frame
+    for(auto stage_pair: StageManager::__objects()) {
+        stage_pair.second->update_transforms();
+    }
 
     /* Don't run the render sequence if we don't have a context, and don't update the resource
      * manager either because that probably needs a context too! */
     {
         std::lock_guard<std::mutex> rendering_lock(context_lock_);
         if(has_context()) {
+            renderer_->uploads->process(upload_budget_);
+
             render_sequence()->run();
 
+            // Uses the sizes textures were drawn at this frame
+            texture_streamer_->update(delta_time_);
+
             signal_pre_swap_();
+        }
+
+        /* Once the scene has been submitted, the simulation can run alongside the
+         * buffer swap (which is where we'd otherwise be blocked on the GPU) */
+        if(threaded) {
+            start_simulation(steps, fixed_step);
+        }
 
+        if(has_context()) {
             swap_buffers();
             GLChecker::end_of_frame_check();
 
@@ -312,6 +348,11 @@ bool WindowBase::run_frame() {
         }
     }
 
+    if(threaded) {
+        wait_for_simulation();
+        signal_post_step_(fixed_step_interp_);
+    }
+
     signal_frame_finished_();
 
     if(!is_running_) {
@@ -348,6 +389,129 @@ uint8_t WindowBase::joypad_count() const {
     return input_controller_->joypad_count();
 }
 
+void WindowBase::update_resource_stats() {
+    auto stages = StageManager::__objects();
+
+    for(uint32_t i = 0; i < RESOURCE_CATEGORY_MAX; ++i) {
+        auto category = (ResourceCategory) i;
+
+        MemoryUsage usage = shared_assets->memory_usage(category);
+        uint32_t evicted = shared_assets->evicted_count(category);
+
+        for(auto& stage_pair: stages) {
+            usage += stage_pair.second->assets->memory_usage(category);
+            evicted += stage_pair.second->assets->evicted_count(category);
+        }
+
+        stats->set_resource_memory_usage(category, usage, evicted);
+    }
+}
+
+void WindowBase::run_fixed_steps(uint32_t count, double step) {
+    for(uint32_t i = 0; i < count; ++i) {
+        pre_fixed_update(step);
+        signal_step_(step); //Trigger any steps
+        fixed_update(step); // Run the fixed updates on controllers
+        post_fixed_update(step);
+    }
+}
+
+void WindowBase::set_threaded_simulation(bool value) {
+    if(value == is_simulation_threaded()) return;
+
+    if(value) {
+        L_INFO("Starting the simulation thread");
+
+        simulation_stopping_ = false;
+        simulation_busy_ = false;
+        simulation_thread_ = std::thread(std::bind(&WindowBase::run_simulation, this));
+    } else {
+        L_INFO("Stopping the simulation thread");
+
+        wait_for_simulation();
+        {
+            std::lock_guard<std::mutex> lock(simulation_lock_);
+            simulation_stopping_ = true;
+        }
+        simulation_cond_.notify_all();
+        simulation_thread_.join();
+
+        // Go back to rendering the live transforms
+        for(auto stage_pair: StageManager::__objects()) {
+            stage_pair.second->transform_snapshot->clear();
+        }
+    }
+}
+
+void WindowBase::start_simulation(uint32_t count, double step) {
+    {
+        std::lock_guard<std::mutex> lock(simulation_lock_);
+        simulation_steps_pending_ = count;
+        simulation_step_ = step;
+        simulation_busy_ = true;
+    }
+    simulation_cond_.notify_all();
+}
+
+void WindowBase::wait_for_simulation() {
+    std::unique_lock<std::mutex> lock(simulation_lock_);
+    while(simulation_busy_) {
+        /* The simulation thread may be blocked in idle->run_sync, or on an upload (a texture upload
+         * from a fixed step, or from a job it picked up while waiting), so keep running those until
+         * it finishes. Nothing else runs here: idle tasks and main thread jobs expect to run
+         * between frames, not while the simulation is changing the scene */
+        if(!simulation_cond_.wait_for(lock, std::chrono::milliseconds(1), [this]() { return !simulation_busy_; })) {
+            lock.unlock();
+            idle_.execute_sync();
+
+            {
+                std::unique_lock<std::mutex> rendering_lock(context_lock_, std::try_to_lock);
+                if(rendering_lock.owns_lock() && has_context()) {
+                    renderer_->uploads->process(upload_budget_);
+                }
+            }
+
+            lock.lock();
+        }
+    }
+}
+
+void WindowBase::run_simulation() {
+    while(true) {
+        uint32_t steps = 0;
+        double step = 0.0;
+
+        {
+            std::unique_lock<std::mutex> lock(simulation_lock_);
+            simulation_cond_.wait(lock, [this]() { return simulation_busy_ || simulation_stopping_; });
+
+            if(simulation_stopping_) {
+                return;
+            }
+
+            steps = simulation_steps_pending_;
+            step = simulation_step_;
+        }
+
+        run_fixed_steps(steps, step);
+
+        if(steps) {
+            for(auto stage_pair: StageManager::__objects()) {
+                auto snapshot = stage_pair.second->transform_snapshot.get();
+                snapshot->capture(stage_pair.second.get());
+                snapshot->publish();
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(simulation_lock_);
+            simulation_steps_pending_ = 0;
+            simulation_busy_ = false;
+        }
+        simulation_cond_.notify_all();
+    }
+}
+
 double WindowBase::fixed_step_interp() const {
     return fixed_step_interp_;
 }
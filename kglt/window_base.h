@@ -4,16 +4,22 @@
 #include <SDL.h>
 
 #include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 
 #include "deps/kazlog/kazlog.h"
 #include "deps/kaztimer/kaztimer.h"
 
 #include "generic/property.h"
 #include "generic/manager.h"
+#include "generic/refcount_manager.h"
 #include "generic/data_carrier.h"
 
 #include "resource_locator.h"
 #include "idle_task_manager.h"
+#include "job_system.h"
 #include "input_controller.h"
 #include "generic/auto_weakptr.h"
 #include "types.h"
@@ -50,6 +56,7 @@ class Watcher;
 class VirtualGamepad;
 class Renderer;
 class Panel;
+class TextureStreamer;
 
 typedef std::function<void (double)> WindowUpdateCallback;
 typedef std::shared_ptr<Loader> LoaderPtr;
@@ -66,9 +73,52 @@ public:
     void set_frames_per_second(uint32_t value) {
         frames_per_second_ = value;
     }
+
+    /* Milliseconds spent culling and assigning lights across all pipelines last frame */
+    double visibility_time() const { return visibility_time_; }
+    void set_visibility_time(double value) {
+        visibility_time_ = value;
+    }
+
+    /* Milliseconds spent submitting draws across all pipelines last frame */
+    double draw_time() const { return draw_time_; }
+    void set_draw_time(double value) {
+        draw_time_ = value;
+    }
+
+    /* Octree nodes and actors which passed the frustum test but were hidden by occluders last
+     * frame. Partitioners may cull on worker threads, so these are accumulated atomically */
+    uint32_t nodes_occluded() const { return nodes_occluded_; }
+    uint32_t actors_occluded() const { return actors_occluded_; }
+
+    void add_occluded(uint32_t nodes, uint32_t actors) {
+        nodes_occluded_ += nodes;
+        actors_occluded_ += actors;
+    }
+
+    void reset_occluded() {
+        nodes_occluded_ = 0;
+        actors_occluded_ = 0;
+    }
+
+    /* Resource memory and evictions summed over the window's and every stage's resource managers */
+    MemoryUsage resource_memory_usage(ResourceCategory category) const { return resource_memory_usage_[category]; }
+    uint32_t resources_evicted(ResourceCategory category) const { return resources_evicted_[category]; }
+
+    void set_resource_memory_usage(ResourceCategory category, const MemoryUsage& usage, uint32_t evicted) {
+        resource_memory_usage_[category] = usage;
+        resources_evicted_[category] = evicted;
+    }
 private:
     uint32_t subactors_renderered_;
     uint32_t frames_per_second_;
+    double visibility_time_ = 0.0;
+    double draw_time_ = 0.0;
+    std::atomic<uint32_t> nodes_occluded_ = {0};
+    std::atomic<uint32_t> actors_occluded_ = {0};
+
+    MemoryUsage resource_memory_usage_[RESOURCE_CATEGORY_MAX];
+    uint32_t resources_evicted_[RESOURCE_CATEGORY_MAX] = {0};
 };
 
 typedef sig::signal<void ()> FrameStartedSignal;
@@ -141,8 +191,22 @@ public:
     
     bool run_frame();
     void fixed_update(double dt);
+
+    /*
+     * When enabled, the fixed steps (controllers, physics) run on a separate simulation thread
+     * while the render thread swaps buffers. Stages publish a transform snapshot after each batch
+     * of steps and renderables are drawn interpolated between the last two snapshots.
+     *
+     * Fixed step callbacks must not make GL calls directly in this mode; use idle->run_sync.
+     */
+    void set_threaded_simulation(bool value=true);
+    bool is_simulation_threaded() const { return simulation_thread_.joinable(); }
     void update(double dt) override;
 
+    /* The maximum time (in milliseconds) spent each frame draining the renderer's upload queue */
+    void set_upload_budget(double milliseconds) { upload_budget_ = milliseconds; }
+    double upload_budget() const { return upload_budget_; }
+
     Mouse& mouse();
     Joypad& joypad(uint8_t idx);
     uint8_t joypad_count() const;
@@ -253,11 +317,14 @@ private:
     bool is_running_;
         
     IdleTaskManager idle_;
+    std::unique_ptr<TextureStreamer> texture_streamer_; // Outlives the jobs, which may still be loading for it
+    std::unique_ptr<JobSystem> jobs_;
 
     KTIuint fixed_timer_;
     KTIuint variable_timer_;
     double delta_time_;
     double fixed_step_interp_ = 0.0;
+    double upload_budget_ = 2.0;
     bool is_paused_ = false;
     bool has_context_ = false;
 
@@ -298,6 +365,21 @@ private:
 
     Stats stats_;
 
+    std::thread simulation_thread_;
+    std::mutex simulation_lock_;
+    std::condition_variable simulation_cond_;
+    uint32_t simulation_steps_pending_ = 0;
+    double simulation_step_ = 0.0;
+    bool simulation_busy_ = false;
+    bool simulation_stopping_ = false;
+
+    void run_fixed_steps(uint32_t count, double step);
+    void run_simulation();
+    void start_simulation(uint32_t count, double step);
+    void wait_for_simulation();
+
+    void update_resource_stats();
+
 public:
 
     //Read only properties
@@ -319,6 +401,8 @@ public:
     };
 
     Property<WindowBase, IdleTaskManager> idle = { this, &WindowBase::idle_ };
+    Property<WindowBase, JobSystem> jobs = { this, &WindowBase::jobs_ };
+    Property<WindowBase, TextureStreamer> texture_streamer = { this, &WindowBase::texture_streamer_ };
     Property<WindowBase, generic::DataCarrier> data = { this, &WindowBase::data_carrier_ };
     Property<WindowBase, ResourceLocator> resource_locator = { this, &WindowBase::resource_locator_ };
 
@@ -0,0 +1,119 @@
+#ifndef TEST_HEIGHTMAP_H
+#define TEST_HEIGHTMAP_H
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+
+#include "kaztest/kaztest.h"
+
+#include "kglt/kglt.h"
+#include "global.h"
+
+class HeightmapTest : public KGLTTestCase {
+public:
+    void set_up() {
+        KGLTTestCase::set_up();
+        stage_id_ = window->new_stage();
+    }
+
+    void tear_down() {
+        KGLTTestCase::tear_down();
+        window->delete_stage(stage_id_);
+        std::remove(path_.c_str());
+    }
+
+    /* Writes an uncompressed 8 bit greyscale TGA */
+    void write_heightmap(uint16_t width, uint16_t height, std::function<uint8_t (uint16_t, uint16_t)> value) {
+        uint8_t header[18] = {0};
+        header[2] = 3;
+        header[12] = width & 0xFF;
+        header[13] = width >> 8;
+        header[14] = height & 0xFF;
+        header[15] = height >> 8;
+        header[16] = 8;
+
+        std::ofstream file(path_, std::ios::binary);
+        file.write((char*) header, sizeof(header));
+        for(uint16_t z = 0; z < height; ++z) {
+            for(uint16_t x = 0; x < width; ++x) {
+                char v = value(x, z);
+                file.write(&v, 1);
+            }
+        }
+    }
+
+    void test_slope_positions_and_normals() {
+        // Rises by 2 units every texel along x
+        write_heightmap(64, 48, [](uint16_t x, uint16_t z) -> uint8_t { return x * 2; });
+
+        kglt::HeightmapSpecification spec;
+        spec.min_height = 0.0f;
+        spec.max_height = 256.0f;
+        spec.spacing = 1.0f;
+
+        auto stage = window->stage(stage_id_);
+        auto mesh = stage->assets->mesh(stage->assets->new_mesh_from_heightmap(path_, spec));
+
+        assert_equal(64 * 48, mesh->shared_data->count());
+        assert_equal(63 * 47 * 6, mesh->first_submesh()->index_data->count());
+
+        kglt::Vec3 expected_normal = kglt::Vec3(-2, 1, 0).normalized();
+
+        for(uint32_t z = 0; z < 48; ++z) {
+            for(uint32_t x = 1; x < 63; ++x) {
+                uint32_t i = (z * 64) + x;
+                auto pos = mesh->shared_data->position_at<kglt::Vec3>(i);
+
+                assert_close(float(x) - 32.0f, pos.x, 0.0001);
+                assert_close(float(x * 2), pos.y, 0.0001);
+                assert_close(float(z) - 24.0f, pos.z, 0.0001);
+
+                kglt::Vec3 normal;
+                mesh->shared_data->normal_at(i, normal);
+                assert_close(expected_normal.x, normal.x, 0.0001);
+                assert_close(expected_normal.y, normal.y, 0.0001);
+                assert_close(expected_normal.z, normal.z, 0.0001);
+            }
+        }
+    }
+
+    void test_smoothing_keeps_flat_maps_flat() {
+        write_heightmap(50, 50, [](uint16_t, uint16_t) -> uint8_t { return 128; });
+
+        kglt::HeightmapSpecification spec;
+        spec.smooth_iterations = 5;
+
+        auto stage = window->stage(stage_id_);
+        auto mesh = stage->assets->mesh(stage->assets->new_mesh_from_heightmap(path_, spec));
+
+        float expected = spec.min_height + (spec.max_height - spec.min_height) * (128.0f / 256.0f);
+        for(uint32_t i = 0; i < mesh->shared_data->count(); ++i) {
+            assert_close(expected, mesh->shared_data->position_at<kglt::Vec3>(i).y, 0.0001);
+        }
+    }
+
+    void test_load_large_heightmap() {
+        // tools/heightmap_benchmark times loading one of these
+        const uint16_t size = 1024;
+        write_heightmap(size, size, [](uint16_t x, uint16_t z) -> uint8_t {
+            return uint8_t(128 + 100 * std::sin(x * 0.05f) * std::cos(z * 0.03f));
+        });
+
+        kglt::HeightmapSpecification spec;
+        spec.smooth_iterations = 4;
+
+        auto stage = window->stage(stage_id_);
+
+        auto mesh_id = stage->assets->new_mesh_from_heightmap(path_, spec);
+
+        assert_equal(size * size, stage->assets->mesh(mesh_id)->shared_data->count());
+    }
+
+private:
+    kglt::StageID stage_id_;
+    std::string path_ = "heightmap_test.tga";
+};
+
+#endif // TEST_HEIGHTMAP_H
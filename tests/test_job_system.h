@@ -0,0 +1,154 @@
+#ifndef TEST_JOB_SYSTEM_H
+#define TEST_JOB_SYSTEM_H
+
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#include "kaztest/kaztest.h"
+#include "kglt/job_system.h"
+
+namespace {
+
+using namespace kglt;
+
+class JobSystemTest : public TestCase {
+public:
+    void test_counters_complete() {
+        JobSystem jobs(2);
+
+        std::atomic<int> value(0);
+        auto counter = jobs.new_counter();
+
+        for(int i = 0; i < 100; ++i) {
+            jobs.schedule([&value]() { value++; }, counter);
+        }
+
+        jobs.wait(counter);
+
+        assert_true(counter->is_complete());
+        assert_equal(100, value.load());
+    }
+
+    void test_dependencies() {
+        JobSystem jobs(2);
+
+        std::atomic<int> value(0);
+        int seen = -1;
+
+        auto first = jobs.new_counter();
+        auto second = jobs.new_counter();
+
+        for(int i = 0; i < 50; ++i) {
+            jobs.schedule([&value]() { value++; }, first);
+        }
+
+        jobs.schedule_after(first, [&]() { seen = value.load(); }, second);
+        jobs.wait(second);
+
+        assert_equal(50, seen);
+    }
+
+    void test_main_thread_jobs() {
+        JobSystem jobs(1);
+
+        bool ran_on_main = false;
+        auto counter = jobs.new_counter();
+
+        jobs.schedule([&]() {
+            jobs.schedule_on_main_thread([&]() { ran_on_main = jobs.is_main_thread(); }, counter);
+        }, counter);
+
+        // Waiting on the main thread runs main thread jobs
+        jobs.wait(counter);
+        assert_true(ran_on_main);
+    }
+
+    void test_parallel_for() {
+        JobSystem jobs(3);
+
+        std::vector<uint32_t> values(10000, 0);
+        jobs.parallel_for(0, values.size(), [&values](uint32_t i) {
+            values[i] = i * 2;
+        });
+
+        for(uint32_t i = 0; i < values.size(); ++i) {
+            assert_equal(i * 2, values[i]);
+        }
+    }
+
+    void test_parallel_for_at_each_thread_count() {
+        // Timings for the same workload are reported by tools/job_system_benchmark
+        const uint32_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+
+        std::vector<float> values(200000);
+
+        for(uint32_t threads = 1; threads <= max_threads; ++threads) {
+            // The calling thread works too, so N threads is N - 1 workers
+            JobSystem jobs(threads - 1);
+
+            std::fill(values.begin(), values.end(), -1.0f);
+            jobs.parallel_for(0, values.size(), [&values](uint32_t i) {
+                float v = float(i);
+                for(int j = 0; j < 32; ++j) {
+                    v = std::sqrt(v + float(j));
+                }
+                values[i] = v;
+            });
+
+            for(float v: values) {
+                assert_true(v >= 0.0f);
+            }
+        }
+    }
+
+    void test_wait_from_another_thread() {
+        JobSystem jobs(2);
+
+        auto counter = jobs.new_counter();
+        std::atomic<bool> release(false);
+        std::atomic<uint32_t> total(0);
+
+        for(uint32_t i = 0; i < 4; ++i) {
+            jobs.schedule([&release, &total]() {
+                while(!release) {
+                    std::this_thread::yield();
+                }
+                total++;
+            }, counter);
+        }
+
+        // Neither a worker nor the main thread, so this sleeps until the counter completes
+        std::atomic<bool> waited(false);
+        std::thread waiter([&jobs, &counter, &waited]() {
+            jobs.wait(counter);
+            waited = true;
+        });
+
+        release = true;
+        waiter.join();
+
+        assert_true(waited);
+        assert_equal(4u, total.load());
+    }
+
+    void test_destruction_completes_counters() {
+        auto counter = std::make_shared<JobCounter>();
+        auto after = std::make_shared<JobCounter>();
+
+        {
+            JobSystem jobs(1);
+            jobs.schedule_on_main_thread([]() {}, counter);
+            jobs.schedule_after(counter, []() {}, after);
+        }
+
+        // The queued jobs were dropped, but nothing waiting on them would hang
+        assert_true(counter->is_complete());
+        assert_true(after->is_complete());
+    }
+};
+
+}
+
+#endif // TEST_JOB_SYSTEM_H
@@ -0,0 +1,230 @@
+#ifndef TEST_KMESH_H
+#define TEST_KMESH_H
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include "kaztest/kaztest.h"
+
+#include "kglt/kglt.h"
+#include "kglt/deps/kfs/kfs.h"
+#include "kglt/loaders/kmesh_loader.h"
+#include "global.h"
+
+class KMeshTest : public KGLTTestCase {
+public:
+    void set_up() {
+        KGLTTestCase::set_up();
+        stage_id_ = window->new_stage();
+        path_ = kfs::path::join(kfs::temp_dir(), "kglt_test.kmesh");
+        cache_directory_ = kfs::path::join(kfs::temp_dir(), "kglt_test_mesh_cache");
+        copy_path_ = kfs::path::join(kfs::temp_dir(), "kglt_test_cube.obj");
+        mtl_path_ = kfs::path::join(kfs::temp_dir(), "cube.mtl");
+    }
+
+    void tear_down() {
+        KGLTTestCase::tear_down();
+        window->delete_stage(stage_id_);
+        window->shared_assets->set_mesh_cache_directory("");
+
+        std::remove(path_.c_str());
+        std::remove(copy_path_.c_str());
+        std::remove(mtl_path_.c_str());
+        if(kfs::path::exists(cache_directory_)) {
+            for(auto& filename: kfs::path::list_dir(cache_directory_)) {
+                kfs::remove(kfs::path::join(cache_directory_, filename));
+            }
+        }
+    }
+
+    void assert_same_mesh(kglt::MeshPtr expected, kglt::MeshPtr actual) {
+        assert_equal(expected->submesh_count(), actual->submesh_count());
+        assert_true(expected->shared_data->specification() == actual->shared_data->specification());
+        assert_equal(expected->shared_data->data_size(), actual->shared_data->data_size());
+        assert_equal(0, memcmp(expected->shared_data->data(), actual->shared_data->data(), expected->shared_data->data_size()));
+
+        expected->each([&](const std::string& name, kglt::SubMesh* submesh) {
+            assert_true(actual->has_submesh(name));
+
+            auto other = actual->submesh(name);
+            assert_equal(submesh->arrangement(), other->arrangement());
+            assert_equal(submesh->uses_shared_vertices(), other->uses_shared_vertices());
+            assert_true(submesh->index_data->all() == other->index_data->all());
+
+            if(!submesh->uses_shared_vertices()) {
+                assert_equal(submesh->vertex_data->data_size(), other->vertex_data->data_size());
+                assert_equal(0, memcmp(submesh->vertex_data->data(), other->vertex_data->data(), submesh->vertex_data->data_size()));
+            }
+
+            auto expected_pass = expected->resource_manager().material(submesh->material_id())->first_pass();
+            auto actual_pass = actual->resource_manager().material(other->material_id())->first_pass();
+            assert_close(expected_pass->diffuse().r, actual_pass->diffuse().r, 0.0001);
+            assert_close(expected_pass->diffuse().g, actual_pass->diffuse().g, 0.0001);
+            assert_equal(expected_pass->cull_mode(), actual_pass->cull_mode());
+        });
+    }
+
+    void test_round_trip() {
+        auto stage = window->stage(stage_id_);
+        auto source = stage->assets->mesh(stage->assets->new_mesh_as_box(2.0, 3.0, 4.0));
+
+        auto material = stage->assets->material(source->first_submesh()->material_id());
+        material->first_pass()->set_diffuse(kglt::Colour(0.25, 0.5, 0.75, 1.0));
+        material->first_pass()->set_cull_mode(kglt::CULL_MODE_NONE);
+
+        // One with its own vertices, as well as the shared ones
+        auto independent = source->new_submesh("independent", kglt::MESH_ARRANGEMENT_LINES,
+            kglt::VERTEX_SHARING_MODE_INDEPENDENT, kglt::VertexSpecification::POSITION_AND_DIFFUSE
+        );
+        independent->vertex_data->position(0, 0, 0);
+        independent->vertex_data->diffuse(kglt::Colour::RED);
+        independent->vertex_data->move_next();
+        independent->vertex_data->position(1, 2, 3);
+        independent->vertex_data->diffuse(kglt::Colour::BLUE);
+        independent->vertex_data->move_next();
+        independent->vertex_data->done();
+        independent->index_data->index(0);
+        independent->index_data->index(1);
+        independent->index_data->done();
+
+        kglt::loaders::write_kmesh(*source, path_);
+
+        auto loaded = stage->assets->mesh(stage->assets->new_mesh(kglt::VertexSpecification::POSITION_ONLY));
+        kglt::loaders::read_kmesh(*loaded, path_);
+
+        assert_same_mesh(source, loaded);
+
+        // And through the loader, like any other mesh file
+        auto from_file = stage->assets->mesh(stage->assets->new_mesh_from_file(path_));
+        assert_same_mesh(source, from_file);
+    }
+
+    void test_corrupt_data_throws() {
+        auto stage = window->stage(stage_id_);
+        auto source = stage->assets->mesh(stage->assets->new_mesh_as_cube(1.0));
+
+        kglt::loaders::write_kmesh(*source, path_);
+
+        std::vector<uint8_t> data;
+        {
+            std::ifstream file(path_, std::ios::binary);
+            data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        }
+
+        auto target = stage->assets->mesh(stage->assets->new_mesh(kglt::VertexSpecification::POSITION_ONLY));
+
+        // Truncated
+        assert_raises(std::runtime_error, std::bind(
+            static_cast<void (*)(kglt::Mesh&, const uint8_t*, std::size_t)>(&kglt::loaders::read_kmesh),
+            std::ref(*target), &data[0], data.size() / 2
+        ));
+
+        // Wrong magic
+        data[0] = 'X';
+        assert_raises(std::runtime_error, std::bind(
+            static_cast<void (*)(kglt::Mesh&, const uint8_t*, std::size_t)>(&kglt::loaders::read_kmesh),
+            std::ref(*target), &data[0], data.size()
+        ));
+    }
+
+    void test_out_of_range_indices_throw() {
+        auto stage = window->stage(stage_id_);
+        auto source = stage->assets->mesh(stage->assets->new_mesh_as_cube(1.0));
+
+        source->first_submesh()->index_data->index(source->shared_data->count());
+        source->first_submesh()->index_data->done();
+
+        kglt::loaders::write_kmesh(*source, path_);
+
+        auto target = stage->assets->mesh(stage->assets->new_mesh(kglt::VertexSpecification::POSITION_ONLY));
+        assert_raises(std::runtime_error, std::bind(
+            static_cast<void (*)(kglt::Mesh&, const unicode&)>(&kglt::loaders::read_kmesh),
+            std::ref(*target), unicode(path_)
+        ));
+    }
+
+    void test_imported_meshes_are_cached() {
+        kfs::Path data_path = kfs::path::join(kfs::path::dir_name(__FILE__), "test-data");
+        window->resource_locator->add_search_path(data_path);
+        window->shared_assets->set_mesh_cache_directory(cache_directory_);
+
+        auto stage = window->stage(stage_id_);
+
+        auto parsed = stage->assets->mesh(stage->assets->new_mesh_from_file("cube.obj"));
+        assert_equal(1, kfs::path::list_dir(cache_directory_).size());
+
+        // The second load comes from the cache and must match the parsed one
+        auto cached = stage->assets->mesh(stage->assets->new_mesh_from_file("cube.obj"));
+        assert_equal(1, kfs::path::list_dir(cache_directory_).size());
+        assert_same_mesh(parsed, cached);
+
+        // Swap a different mesh into the cache, if the next load reads the cache it gets that instead
+        auto cache_file = kfs::path::join(cache_directory_, kfs::path::list_dir(cache_directory_).front());
+        auto box = stage->assets->mesh(stage->assets->new_mesh_as_box(1.0, 2.0, 3.0));
+        kglt::loaders::write_kmesh(*box, cache_file);
+
+        auto from_cache = stage->assets->mesh(stage->assets->new_mesh_from_file("cube.obj"));
+        assert_same_mesh(box, from_cache);
+    }
+
+    void test_mesh_cache_is_keyed_by_location() {
+        kfs::Path data_path = kfs::path::join(kfs::path::dir_name(__FILE__), "test-data");
+        window->shared_assets->set_mesh_cache_directory(cache_directory_);
+
+        // The same file somewhere else might refer to different materials and textures
+        {
+            std::ifstream source(kfs::path::join(data_path, "cube.obj"), std::ios::binary);
+            std::ofstream copy(copy_path_, std::ios::binary);
+            copy << source.rdbuf();
+        }
+
+        auto stage = window->stage(stage_id_);
+        stage->assets->new_mesh_from_file(kfs::path::join(data_path, "cube.obj"));
+        stage->assets->new_mesh_from_file(copy_path_);
+
+        assert_equal(2, kfs::path::list_dir(cache_directory_).size());
+    }
+
+    void test_mesh_cache_is_keyed_by_materials() {
+        kfs::Path data_path = kfs::path::join(kfs::path::dir_name(__FILE__), "test-data");
+        window->shared_assets->set_mesh_cache_directory(cache_directory_);
+
+        {
+            std::ifstream source(kfs::path::join(data_path, "cube.obj"), std::ios::binary);
+            std::ofstream copy(copy_path_, std::ios::binary);
+            copy << source.rdbuf();
+        }
+
+        auto write_material = [this](const std::string& diffuse) {
+            std::ofstream mtl(mtl_path_);
+            mtl << "newmtl None" << std::endl << "Kd " << diffuse << std::endl;
+        };
+
+        auto diffuse_of = [](kglt::MeshPtr mesh) {
+            return mesh->resource_manager().material(mesh->first_submesh()->material_id())->first_pass()->diffuse();
+        };
+
+        auto stage = window->stage(stage_id_);
+
+        write_material("1.0 0.0 0.0");
+        auto red = stage->assets->mesh(stage->assets->new_mesh_from_file(copy_path_));
+        assert_close(1.0f, diffuse_of(red).r, 0.0001);
+
+        // Editing only the material library mustn't give back the mesh cached with the old material
+        write_material("0.0 1.0 0.0");
+        auto green = stage->assets->mesh(stage->assets->new_mesh_from_file(copy_path_));
+        assert_close(1.0f, diffuse_of(green).g, 0.0001);
+
+        assert_equal(2, kfs::path::list_dir(cache_directory_).size());
+    }
+
+private:
+    kglt::StageID stage_id_;
+    std::string path_;
+    std::string cache_directory_;
+    std::string copy_path_;
+    std::string mtl_path_;
+};
+
+#endif // TEST_KMESH_H
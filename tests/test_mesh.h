@@ -1,6 +1,7 @@
 #ifndef TEST_MESH_H
 #define TEST_MESH_H
 
+#include <set>
 #include "kaztest/kaztest.h"
 
 #include "kglt/kglt.h"
@@ -184,6 +185,68 @@ public:
         assert_equal(kglt::MaterialID(1), actor->subactor(0).material_id());
     }
 
+    void test_mesh_bounds_follow_changes() {
+        auto stage = window->stage(stage_id_);
+        auto mesh = stage->assets->mesh(generate_test_mesh(stage));
+
+        auto box = mesh->aabb();
+        assert_close(-1.0f, box.min.x, 0.0001f);
+        assert_close(1.0f, box.max.y, 0.0001f);
+
+        // Moving a vertex updates the cached bounds
+        mesh->shared_data->move_to(2);
+        mesh->shared_data->position(5.0, 1.0, 0.0);
+        mesh->shared_data->done();
+
+        assert_close(5.0f, mesh->aabb().max.x, 0.0001f);
+
+        // New submeshes grow the bounds, and they shrink back when one is removed
+        mesh->new_submesh_as_box("far", kglt::MaterialID(), 2.0, 2.0, 2.0, kglt::Vec3(20, 0, 0));
+        assert_close(21.0f, mesh->aabb().max.x, 0.0001f);
+
+        mesh->delete_submesh("far");
+        assert_close(5.0f, mesh->aabb().max.x, 0.0001f);
+
+        // As does removing the submesh which used it
+        mesh->delete_submesh("test");
+        assert_close(1.0f, mesh->aabb().max.x, 0.0001f);
+        assert_close(-1.0f, mesh->aabb().max.y, 0.0001f);
+    }
+
+    void test_actor_world_bounds() {
+        auto stage = window->stage(stage_id_);
+        auto mesh = stage->assets->mesh(generate_test_mesh(stage));
+        auto actor = stage->actor(stage->new_actor_with_mesh(mesh->id()));
+
+        actor->set_absolute_position(10, 0, 0);
+        auto box = actor->transformed_aabb();
+        assert_close(9.0f, box.min.x, 0.0001f);
+        assert_close(11.0f, box.max.x, 0.0001f);
+
+        // A quarter turn about y swaps the x and z extents
+        actor->set_absolute_rotation(kglt::Degrees(90), 0, 1, 0);
+        box = actor->transformed_aabb();
+        assert_close(10.0f, box.min.x, 0.0001f);
+        assert_close(10.0f, box.max.x, 0.0001f);
+        assert_close(-1.0f, box.min.z, 0.0001f);
+        assert_close(1.0f, box.max.z, 0.0001f);
+
+        // Changing the mesh is picked up too
+        mesh->shared_data->move_to(2);
+        mesh->shared_data->position(1.0, 3.0, 0.0);
+        mesh->shared_data->done();
+
+        assert_close(3.0f, actor->transformed_aabb().max.y, 0.0001f);
+
+        // Moving a parent moves its children's bounds
+        auto parent = stage->actor(stage->new_actor());
+        actor->set_parent(parent->id());
+
+        box = actor->transformed_aabb();
+        parent->set_absolute_position(parent->absolute_position() + kglt::Vec3(0, 10, 0));
+        assert_close(box.min.y + 10.0f, actor->transformed_aabb().min.y, 0.0001f);
+    }
+
     void test_scene_methods() {
         auto stage = window->stage(stage_id_);
 
@@ -256,6 +319,176 @@ public:
         assert_equal(kglt::Vec2(1.0 / 3.0, 4.0 / 4.0), vd.texcoord0_at<kglt::Vec2>(23));
     }
 
+    void test_lod_selection_uses_hysteresis() {
+        auto stage = window->stage(stage_id_);
+        auto mesh = stage->assets->mesh(generate_test_mesh(stage));
+
+        mesh->set_lod_metric(kglt::LOD_METRIC_DISTANCE);
+        mesh->set_lod_hysteresis(0.1);
+        mesh->add_lod(generate_test_mesh(stage), 10.0);
+        mesh->add_lod(generate_test_mesh(stage), 20.0);
+
+        assert_equal(3, mesh->lod_count());
+        assert_raises(std::logic_error, std::bind(&kglt::Mesh::add_lod, mesh.get(), generate_test_mesh(stage), 15.0));
+
+        assert_equal(0, mesh->select_lod(5.0, 0));
+        assert_equal(1, mesh->select_lod(12.0, 0));
+        assert_equal(2, mesh->select_lod(25.0, 0));
+
+        // Just past the threshold isn't far enough to switch, in either direction
+        assert_equal(0, mesh->select_lod(10.5, 0));
+        assert_equal(1, mesh->select_lod(9.5, 1));
+        assert_equal(0, mesh->select_lod(8.0, 1));
+    }
+
+    void test_simplify_triangles_reduces_grid() {
+        // A flat 8x8 grid, 128 triangles
+        const int size = 8;
+
+        std::vector<kglt::Vec3> positions;
+        for(int y = 0; y <= size; ++y) {
+            for(int x = 0; x <= size; ++x) {
+                positions.push_back(kglt::Vec3(x, y, 0));
+            }
+        }
+
+        std::vector<kglt::Index> indices;
+        for(int y = 0; y < size; ++y) {
+            for(int x = 0; x < size; ++x) {
+                kglt::Index i = (y * (size + 1)) + x;
+                kglt::Index above = i + size + 1;
+                indices.insert(indices.end(), {i, i + 1, above + 1, i, above + 1, above});
+            }
+        }
+
+        auto result = kglt::procedural::mesh::simplify_triangles(positions, indices, 32);
+
+        assert_true(result.size() / 3 <= 32);
+        assert_true(result.size() / 3 > 0);
+
+        // The corners define the outline so they must survive, and nothing should be flipped
+        float area = 0;
+        std::set<kglt::Index> used(result.begin(), result.end());
+        for(kglt::Index corner: {0, size, size * (size + 1), (size + 1) * (size + 1) - 1}) {
+            assert_true(used.count(corner));
+        }
+
+        for(uint32_t i = 0; i < result.size(); i += 3) {
+            auto& a = positions[result[i]];
+            auto& b = positions[result[i + 1]];
+            auto& c = positions[result[i + 2]];
+
+            float z = ((b.x - a.x) * (c.y - a.y)) - ((b.y - a.y) * (c.x - a.x));
+            assert_true(z > 0);
+            area += z * 0.5;
+        }
+
+        assert_close(float(size * size), area, 0.0001);
+    }
+
+    void test_simplify_triangles_welds_split_vertices() {
+        // The same grid, flat shaded, so every triangle has vertices of its own
+        const int size = 8;
+
+        std::vector<kglt::Vec3> positions;
+        std::vector<kglt::Vec2> texcoords;
+        auto add = [&](int x, int y) -> kglt::Index {
+            positions.push_back(kglt::Vec3(x, y, 0));
+            texcoords.push_back(kglt::Vec2(x / float(size), y / float(size)));
+            return positions.size() - 1;
+        };
+
+        std::vector<kglt::Index> indices;
+        for(int y = 0; y < size; ++y) {
+            for(int x = 0; x < size; ++x) {
+                indices.insert(indices.end(), {add(x, y), add(x + 1, y), add(x + 1, y + 1)});
+                indices.insert(indices.end(), {add(x, y), add(x + 1, y + 1), add(x, y + 1)});
+            }
+        }
+
+        auto result = kglt::procedural::mesh::simplify_triangles(positions, indices, 32, texcoords);
+        assert_true(result.size() / 3 <= 32);
+
+        float area = 0;
+        for(uint32_t i = 0; i < result.size(); i += 3) {
+            auto& a = positions[result[i]];
+            auto& b = positions[result[i + 1]];
+            auto& c = positions[result[i + 2]];
+
+            float z = ((b.x - a.x) * (c.y - a.y)) - ((b.y - a.y) * (c.x - a.x));
+            assert_true(z > 0);
+            area += z * 0.5;
+        }
+
+        assert_close(float(size * size), area, 0.0001);
+    }
+
+    void test_simplify_triangles_keeps_texture_seams() {
+        // A grid with a texture seam down x = 4, the right hand side has its own vertices there
+        const int size = 8;
+        const int seam = 4;
+
+        std::vector<kglt::Vec3> positions;
+        std::vector<kglt::Vec2> texcoords;
+        std::vector<std::vector<kglt::Index>> left(size + 1), right(size + 1);
+
+        for(int y = 0; y <= size; ++y) {
+            for(int x = 0; x <= size; ++x) {
+                positions.push_back(kglt::Vec3(x, y, 0));
+                texcoords.push_back(kglt::Vec2((x <= seam) ? 0.0f : 1.0f, y));
+                left[y].push_back(positions.size() - 1);
+                right[y].push_back(positions.size() - 1);
+
+                if(x == seam) {
+                    positions.push_back(kglt::Vec3(x, y, 0));
+                    texcoords.push_back(kglt::Vec2(1.0f, y));
+                    right[y].back() = positions.size() - 1;
+                }
+            }
+        }
+
+        std::vector<kglt::Index> indices;
+        for(int y = 0; y < size; ++y) {
+            for(int x = 0; x < size; ++x) {
+                auto& side = (x < seam) ? left : right;
+                indices.insert(indices.end(), {
+                    side[y][x], side[y][x + 1], side[y + 1][x + 1],
+                    side[y][x], side[y + 1][x + 1], side[y + 1][x]
+                });
+            }
+        }
+
+        auto result = kglt::procedural::mesh::simplify_triangles(positions, indices, 16, texcoords);
+        assert_true(result.size() / 3 <= 16);
+
+        // Every triangle still uses the vertices from its own side of the seam
+        for(uint32_t i = 0; i < result.size(); i += 3) {
+            float centre = (positions[result[i]].x + positions[result[i + 1]].x + positions[result[i + 2]].x) / 3.0f;
+            float expected = (centre < seam) ? 0.0f : 1.0f;
+
+            for(uint32_t j = 0; j < 3; ++j) {
+                assert_close(expected, texcoords[result[i + j]].x, 0.0001);
+            }
+        }
+    }
+
+    void test_generated_lods_keep_submeshes() {
+        auto stage = window->stage(stage_id_);
+        auto mesh_id = stage->assets->new_mesh_as_sphere(2.0);
+        auto mesh = stage->assets->mesh(mesh_id);
+
+        stage->assets->generate_mesh_lods(mesh_id, {{0.5, 0.5}, {0.25, 0.2}});
+        assert_equal(3, mesh->lod_count());
+
+        auto lod = mesh->lod_mesh(2);
+        mesh->each([&](const std::string& name, kglt::SubMesh* submesh) {
+            auto simplified = lod->submesh(name);
+            assert_true(simplified);
+            assert_equal(submesh->material_id(), simplified->material_id());
+            assert_true(simplified->index_data->count() < submesh->index_data->count());
+        });
+    }
+
 private:
     kglt::CameraID camera_id_;
     kglt::StageID stage_id_;
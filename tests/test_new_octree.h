@@ -63,6 +63,7 @@ public:
         /* Moving the actor should cause a remove + insert. The remove should remove the
          * root node and the insert should generate a new one in the new location */
         actor->move_to(10, 10, 10);
+        stage_->update_transforms();
 
         assert_equal(1, octree_->node_count());
         assert_equal(actor->absolute_position(), octree_->get_root()->centre());
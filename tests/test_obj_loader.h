@@ -1,11 +1,109 @@
 #ifndef TEST_OBJ_LOADER_H
 #define TEST_OBJ_LOADER_H
 
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
 #include "kglt/deps/kfs/kfs.h"
 #include "kglt/loaders/obj_loader.h"
 
 class OBJLoaderTest : public KGLTTestCase {
 public:
+    void tear_down() {
+        KGLTTestCase::tear_down();
+        std::remove(grid_path_.c_str());
+    }
+
+    /* Writes a size x size grid of quads, using negative indices for every other row */
+    void write_grid(uint32_t size) {
+        std::ofstream file(grid_path_);
+        file << "# Generated grid" << std::endl;
+
+        for(uint32_t z = 0; z <= size; ++z) {
+            for(uint32_t x = 0; x <= size; ++x) {
+                file << "v " << x << " " << (x * z) * 0.001f << " " << z << "\n";
+                file << "vt " << float(x) / size << " " << float(z) / size << "\n";
+            }
+        }
+
+        file << "vn 0 1 0" << std::endl;
+
+        const int32_t count = (size + 1) * (size + 1);
+        for(uint32_t z = 0; z < size; ++z) {
+            for(uint32_t x = 0; x < size; ++x) {
+                int32_t corners[4] = {
+                    int32_t((z * (size + 1)) + x + 1),
+                    int32_t((z * (size + 1)) + x + 2),
+                    int32_t(((z + 1) * (size + 1)) + x + 2),
+                    int32_t(((z + 1) * (size + 1)) + x + 1)
+                };
+
+                file << "f";
+                for(auto c: corners) {
+                    if(z % 2) {
+                        file << " " << (c - count - 1) << "/" << (c - count - 1) << "/-1";
+                    } else {
+                        file << " " << c << "/" << c << "/1";
+                    }
+                }
+                file << "\n";
+            }
+        }
+    }
+
+    void test_float_parsing() {
+        const char* inputs[] = {"0", "-1.5", "1e-3", "0.000001234", "+42.125", "3.4028234e38", "-7.25E+2"};
+
+        for(auto input: inputs) {
+            const char* cursor = input;
+            float value = 0;
+
+            assert_true(kglt::loaders::parse_float(cursor, input + strlen(input), value));
+            assert_equal(std::strtof(input, nullptr), value);
+            assert_true(cursor == input + strlen(input));
+        }
+
+        const char* invalid = "1.2.3";
+        const char* cursor = invalid;
+        float value = 0;
+        assert_false(kglt::loaders::parse_float(cursor, invalid + strlen(invalid), value));
+    }
+
+    void test_vertices_are_shared() {
+        write_grid(10);
+
+        auto mesh = window->shared_assets->mesh(window->shared_assets->new_mesh_from_file(grid_path_));
+
+        assert_equal(11 * 11, mesh->shared_data->count());
+        assert_equal(1, mesh->submesh_count());
+        assert_equal(10 * 10 * 6, mesh->first_submesh()->index_data->count());
+
+        // The fan for the first quad
+        auto& indices = mesh->first_submesh()->index_data->all();
+        assert_equal(mesh->shared_data->position_at<kglt::Vec3>(indices[0]).x, 0);
+        assert_equal(mesh->shared_data->position_at<kglt::Vec3>(indices[1]).x, 1);
+        assert_equal(mesh->shared_data->position_at<kglt::Vec3>(indices[2]).z, 1);
+    }
+
+    void test_parallel_parsing_matches() {
+        // Big enough to be split into several chunks
+        write_grid(300);
+
+        auto sequential = window->shared_assets->mesh(window->shared_assets->new_mesh(kglt::VertexSpecification::POSITION_ONLY));
+        auto parallel = window->shared_assets->mesh(window->shared_assets->new_mesh(kglt::VertexSpecification::POSITION_ONLY));
+
+        window->loader_for(grid_path_)->into(sequential, {{"parallel", false}});
+        window->loader_for(grid_path_)->into(parallel);
+
+        assert_equal(301 * 301, parallel->shared_data->count());
+        assert_equal(sequential->shared_data->data_size(), parallel->shared_data->data_size());
+        assert_equal(0, memcmp(sequential->shared_data->data(), parallel->shared_data->data(), parallel->shared_data->data_size()));
+        assert_true(sequential->first_submesh()->index_data->all() == parallel->first_submesh()->index_data->all());
+    }
+
     void test_face_parsing() {
         unicode line = "1//2";
 
@@ -57,6 +155,43 @@ public:
         //Shouldn't throw
         kglt::MeshID mid = window->shared_assets->new_mesh_from_file("cube.obj");
     }
+
+    void test_generated_normals_are_flat() {
+        kfs::Path path = kfs::path::join(kfs::path::dir_name(__FILE__), "test-data");
+        window->resource_locator->add_search_path(path);
+
+        // cube.obj has no normals and "s off", so each face gets its own vertices with the face normal
+        auto mesh = window->shared_assets->mesh(window->shared_assets->new_mesh_from_file("cube.obj"));
+        assert_equal(6 * 4, mesh->shared_data->count());
+
+        for(uint32_t i = 0; i < mesh->shared_data->count(); ++i) {
+            kglt::Vec3 normal;
+            mesh->shared_data->normal_at(i, normal);
+
+            // Exactly one axis, the rest zero
+            float largest = std::max(std::fabs(normal.x), std::max(std::fabs(normal.y), std::fabs(normal.z)));
+            assert_close(1.0f, largest, 0.0001f);
+            assert_close(1.0f, std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z), 0.0001f);
+        }
+    }
+
+    void test_async_loading() {
+        kfs::Path path = kfs::path::join(kfs::path::dir_name(__FILE__), "test-data");
+        window->resource_locator->add_search_path(path);
+
+        auto future = window->shared_assets->new_mesh_from_file_async("cube.obj");
+
+        while(future.wait_for(std::chrono::milliseconds(0)) != std::future_status::ready) {
+            window->run_frame();
+        }
+
+        kglt::MeshID mid = future.get();
+        assert_true(window->shared_assets->has_mesh(mid));
+        assert_true(window->shared_assets->mesh(mid)->submesh_count() > 0);
+    }
+
+private:
+    std::string grid_path_ = kfs::path::join(kfs::temp_dir(), "kglt_test_grid.obj");
 };
 
 #endif // TEST_OBJ_LOADER_H
@@ -92,6 +92,96 @@ public:
         assert_equal(kglt::Vec3(10, 0, 0), actor2->relative_position());
     }
 
+    void test_hierarchy_transforms_follow_parent() {
+        auto stage = window->stage(stage_id_);
+        auto parent = stage->actor(stage->new_actor());
+        auto child = stage->actor(stage->new_actor());
+        auto grandchild = stage->actor(stage->new_actor());
+
+        child->set_parent(parent->id());
+        grandchild->set_parent(child->id());
+
+        child->set_relative_position(1, 0, 0);
+        grandchild->set_relative_position(1, 0, 0);
+
+        // Force the transforms to be resolved, then move the root
+        assert_equal(kglt::Vec3(2, 0, 0), grandchild->absolute_position());
+
+        parent->set_absolute_position(0, 5, 0);
+
+        assert_equal(kglt::Vec3(2, 5, 0), grandchild->absolute_position());
+        assert_close(5.0, grandchild->absolute_transformation().mat[13], 0.0001);
+    }
+
+    void test_transformation_changed_is_coalesced() {
+        auto stage = window->stage(stage_id_);
+        auto actor = stage->actor(stage->new_actor());
+
+        int count = 0;
+        kglt::Vec3 last;
+        actor->signal_transformation_changed().connect([&](const kglt::Vec3& pos, const kglt::Quaternion&) {
+            count++;
+            last = pos;
+        });
+
+        for(int i = 0; i < 10; ++i) {
+            actor->move_to(i, 0, 0);
+        }
+
+        assert_equal(0, count);
+        stage->update_transforms();
+        assert_equal(1, count);
+        assert_equal(kglt::Vec3(9, 0, 0), last);
+
+        // Nothing moved, so nothing is signalled
+        stage->update_transforms();
+        assert_equal(1, count);
+    }
+
+    void test_objects_moved_batch_and_epsilon() {
+        auto stage = window->stage(stage_id_);
+        auto parent = stage->actor(stage->new_actor());
+        auto child = stage->actor(stage->new_actor());
+        child->set_parent(parent->id());
+        stage->update_transforms();
+
+        std::vector<kglt::MoveableObject*> moved;
+        auto conn = stage->signal_objects_moved().connect([&](const std::vector<kglt::MoveableObject*>& objects) {
+            moved = objects;
+        });
+
+        // Moving the parent moves the child too, each is delivered once
+        parent->move_to(1, 0, 0);
+        parent->move_to(2, 0, 0);
+        stage->update_transforms();
+        assert_equal(2u, moved.size());
+
+        moved.clear();
+        stage->set_transform_notification_epsilon(0.5);
+        parent->move_to(2.1, 0, 0);
+        stage->update_transforms();
+        assert_true(moved.empty());
+
+        // Small moves accumulate until they pass the epsilon
+        parent->move_to(2.6, 0, 0);
+        stage->update_transforms();
+        assert_equal(2u, moved.size());
+
+        // Rotations are measured by angle, separately from the distance
+        moved.clear();
+        stage->set_transform_notification_epsilon(0.5, kglt::Degrees(10));
+        parent->rotate_to(kglt::Degrees(5));
+        stage->update_transforms();
+        assert_true(moved.empty());
+
+        parent->rotate_to(kglt::Degrees(15));
+        stage->update_transforms();
+        assert_equal(2u, moved.size());
+
+        conn.disconnect();
+        stage->set_transform_notification_epsilon(0);
+    }
+
 private:
     kglt::CameraID camera_id_;
     kglt::StageID stage_id_;
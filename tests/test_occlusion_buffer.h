@@ -0,0 +1,77 @@
+#ifndef TEST_OCCLUSION_BUFFER_H
+#define TEST_OCCLUSION_BUFFER_H
+
+#include "kglt/kglt.h"
+#include "kaztest/kaztest.h"
+#include "kglt/partitioners/impl/occlusion_buffer.h"
+
+namespace {
+
+using namespace kglt;
+
+class OcclusionBufferTest : public TestCase {
+public:
+    void set_up() {
+        // Looking down -Z from the origin
+        kmMat4PerspectiveProjection(&view_projection_, 45.0, 2.0, 1.0, 100.0);
+    }
+
+    void rasterize_wall(OcclusionBuffer& buffer, float z) {
+        // A wall much wider than the view at the given depth
+        buffer.rasterize_triangle(Vec3(-100, -100, z), Vec3(100, -100, z), Vec3(100, 100, z));
+        buffer.rasterize_triangle(Vec3(-100, -100, z), Vec3(100, 100, z), Vec3(-100, 100, z));
+    }
+
+    void test_boxes_behind_occluders_are_culled() {
+        OcclusionBuffer buffer(64, 32);
+        buffer.begin(view_projection_);
+        rasterize_wall(buffer, -10);
+        buffer.build_pyramid();
+
+        assert_true(buffer.is_occluded(AABB(Vec3(0, 0, -20), 2.0)));
+        assert_false(buffer.is_occluded(AABB(Vec3(0, 0, -5), 2.0)));
+
+        // Straddling the wall means part of it is visible
+        assert_false(buffer.is_occluded(AABB(Vec3(0, 0, -10), 2.0)));
+    }
+
+    void test_partial_occluders_dont_hide_visible_boxes() {
+        OcclusionBuffer buffer(64, 32);
+        buffer.begin(view_projection_);
+
+        // Only covers the left half of the screen
+        buffer.rasterize_triangle(Vec3(-100, -100, -10), Vec3(0, -100, -10), Vec3(0, 100, -10));
+        buffer.rasterize_triangle(Vec3(-100, -100, -10), Vec3(0, 100, -10), Vec3(-100, 100, -10));
+        buffer.build_pyramid();
+
+        assert_true(buffer.is_occluded(AABB(Vec3(-10, 0, -30), 2.0)));
+        assert_false(buffer.is_occluded(AABB(Vec3(10, 0, -30), 2.0)));
+
+        // A box spanning both halves is still partly visible, even when tested at a coarse level
+        assert_false(buffer.is_occluded(AABB(Vec3(0, 0, -30), 20.0)));
+    }
+
+    void test_near_plane_is_conservative() {
+        OcclusionBuffer buffer(64, 32);
+        buffer.begin(view_projection_);
+        rasterize_wall(buffer, -10);
+
+        // Crosses the near plane, so it's dropped rather than clipped
+        buffer.rasterize_triangle(Vec3(-100, -100, 5), Vec3(100, -100, -5), Vec3(0, 100, -5));
+        buffer.build_pyramid();
+
+        // Boxes touching the camera are never culled
+        assert_false(buffer.is_occluded(AABB(Vec3(0, 0, -20), 0.5, 0.5, 40.0)));
+        assert_true(buffer.is_occluded(AABB(Vec3(0, 0, -20), 2.0)));
+
+        // The wall covers everything, so even the coarsest level knows about it
+        assert_true(buffer.depth_at(buffer.level_count() - 1, 0, 0) < 1.0f);
+    }
+
+private:
+    Mat4 view_projection_;
+};
+
+}
+
+#endif // TEST_OCCLUSION_BUFFER_H
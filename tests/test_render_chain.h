@@ -88,6 +88,36 @@ public:
 
         assert_false(window->stage(stage)->is_being_rendered());
     }
+
+    void test_parallel_culling_matches_serial() {
+        StageID stage_id = window->new_stage();
+        CameraID cam = window->new_camera();
+
+        auto stage = window->stage(stage_id);
+        auto actor = stage->actor(stage->new_actor_with_mesh(stage->assets->new_mesh_as_cube(1.0)));
+        actor->move_to(0, 0, -10);
+        stage->update_transforms();
+
+        window->camera(cam)->set_perspective_projection(45.0, 1.0);
+
+        // Two views of the same stage, like a split screen
+        window->render(stage_id, cam);
+        window->render(stage_id, cam).with_priority(kglt::RENDER_PRIORITY_FOREGROUND);
+
+        auto sequence = window->render_sequence();
+
+        sequence->run();
+        uint32_t serial_count = window->stats->subactors_rendered();
+
+        sequence->set_parallel_culling_enabled(true);
+        sequence->run();
+        sequence->set_parallel_culling_enabled(false);
+
+        assert_true(serial_count > 0);
+        assert_equal(serial_count, window->stats->subactors_rendered());
+        assert_true(window->stats->visibility_time() >= 0.0);
+        assert_true(window->stats->draw_time() >= 0.0);
+    }
 };
 
 
@@ -141,6 +141,32 @@ public:
         assert_equal(2, render_queue->group_count(0));
     }
 
+    void test_render_priority_change_updates_queue() {
+        auto& render_queue = stage_->render_queue;
+
+        auto mesh_1 = stage_->assets->new_mesh_as_cube(1.0);
+        auto first = stage_->new_actor_with_mesh(mesh_1);
+        auto second = stage_->new_actor_with_mesh(mesh_1);
+
+        assert_equal(1, render_queue->group_count(0));
+
+        // Groups are ordered by priority first, so the actors can't share one any more
+        stage_->actor(second)->set_render_priority(kglt::RENDER_PRIORITY_FOREGROUND);
+        assert_equal(2, render_queue->group_count(0));
+
+        typedef kglt::batcher::RenderGroup RenderGroup;
+        std::vector<uint32_t> sizes;
+        render_queue->each_group(0, [&](uint32_t i, const RenderGroup& grp, const kglt::batcher::Batch& batch) {
+            sizes.push_back(batch.renderable_count());
+        });
+
+        assert_equal(1, sizes[0]);
+        assert_equal(1, sizes[1]);
+
+        stage_->actor(first)->set_render_priority(kglt::RENDER_PRIORITY_FOREGROUND);
+        assert_equal(1, render_queue->group_count(0));
+    }
+
 #ifdef KGLT_GL_VERSION_2X
     void test_shader_grouping() {
 
@@ -0,0 +1,149 @@
+#ifndef TEST_RESOURCE_EVICTION_H
+#define TEST_RESOURCE_EVICTION_H
+
+#include <vector>
+
+#include "kaztest/kaztest.h"
+
+#include "kglt/kglt.h"
+#include "global.h"
+
+namespace {
+
+class Blob;
+typedef UniqueID<std::shared_ptr<Blob>> BlobID;
+
+/* Reports whatever size it's given, so the test can see when it was measured */
+class Blob:
+    public Managed<Blob>,
+    public kglt::generic::Identifiable<BlobID> {
+
+public:
+    Blob(BlobID id):
+        kglt::generic::Identifiable<BlobID>(id) {}
+
+    std::size_t cpu_memory_usage() const { return bytes; }
+    std::size_t gpu_memory_usage() const { return 0; }
+
+    std::size_t bytes = 0;
+};
+
+typedef kglt::generic::RefCountedTemplatedManager<Blob, BlobID> BlobManager;
+
+}
+
+class ResourceEvictionTest : public KGLTTestCase {
+public:
+    void set_up() {
+        KGLTTestCase::set_up();
+        stage_id_ = window->new_stage();
+    }
+
+    void tear_down() {
+        KGLTTestCase::tear_down();
+        window->delete_stage(stage_id_);
+    }
+
+    /* Creates textures of 64x64 RGBA, using each one an update apart so the first is the oldest */
+    std::vector<kglt::TextureID> create_textures(uint32_t count) {
+        auto stage = window->stage(stage_id_);
+
+        std::vector<kglt::TextureID> ids;
+        for(uint32_t i = 0; i < count; ++i) {
+            ids.push_back(stage->assets->new_texture());
+            stage->assets->texture(ids.back())->resize(64, 64);
+        }
+
+        for(auto id: ids) {
+            stage->assets->update(0);
+            stage->assets->texture(id);
+        }
+
+        return ids;
+    }
+
+    void test_least_recently_used_are_evicted() {
+        const std::size_t texture_size = 64 * 64 * 4;
+
+        auto stage = window->stage(stage_id_);
+        stage->assets->set_memory_budget(kglt::RESOURCE_CATEGORY_TEXTURE, texture_size * 100);
+
+        auto ids = create_textures(6);
+
+        stage->assets->update(0);
+        assert_equal(texture_size * 6, stage->assets->memory_usage(kglt::RESOURCE_CATEGORY_TEXTURE).cpu_bytes);
+
+        stage->assets->set_memory_budget(kglt::RESOURCE_CATEGORY_TEXTURE, texture_size * 3);
+        stage->assets->update(0);
+
+        for(uint32_t i = 0; i < 3; ++i) {
+            assert_false(stage->assets->has_texture(ids[i]));
+        }
+
+        for(uint32_t i = 3; i < 6; ++i) {
+            assert_true(stage->assets->has_texture(ids[i]));
+        }
+
+        assert_equal(texture_size * 3, stage->assets->memory_usage(kglt::RESOURCE_CATEGORY_TEXTURE).cpu_bytes);
+        assert_equal(3, stage->assets->evicted_count(kglt::RESOURCE_CATEGORY_TEXTURE));
+    }
+
+    void test_referenced_resources_are_kept() {
+        auto stage = window->stage(stage_id_);
+        stage->assets->set_memory_budget(kglt::RESOURCE_CATEGORY_TEXTURE, 1024 * 1024);
+
+        auto ids = create_textures(4);
+
+        // With no budget, only the texture still in use should survive
+        kglt::TexturePtr held = stage->assets->texture(ids[0]);
+        stage->assets->set_memory_budget(kglt::RESOURCE_CATEGORY_TEXTURE, 0);
+
+        stage->assets->update(0);
+        stage->assets->update(0);
+
+        assert_true(stage->assets->has_texture(ids[0]));
+        for(uint32_t i = 1; i < 4; ++i) {
+            assert_false(stage->assets->has_texture(ids[i]));
+        }
+    }
+
+    void test_everything_released_is_evicted_without_a_budget() {
+        auto stage = window->stage(stage_id_);
+        stage->assets->set_memory_budget(kglt::RESOURCE_CATEGORY_TEXTURE, 1024 * 1024 * 1024);
+
+        // More than are evicted per update when there is a budget
+        auto ids = create_textures(20);
+
+        stage->assets->set_memory_budget(kglt::RESOURCE_CATEGORY_TEXTURE, 0);
+        stage->assets->update(0);
+        stage->assets->update(0);
+
+        for(auto id: ids) {
+            assert_false(stage->assets->has_texture(id));
+        }
+    }
+
+    void test_loading_resources_are_skipped() {
+        BlobManager manager;
+        manager.set_memory_budget(1);
+
+        auto id = manager.make(kglt::GARBAGE_COLLECT_PERIODIC);
+        manager.mark_as_loading(id);
+        manager.get(id).lock()->bytes = 100;
+
+        // A sweep mustn't read a resource which another thread is filling in, or evict it
+        manager.collect_step(64, 8);
+        assert_true(manager.contains(id));
+        assert_equal(0, manager.memory_usage().cpu_bytes);
+
+        manager.mark_as_loaded(id);
+        manager.set_memory_budget(1000);
+        manager.collect_step(64, 8);
+        assert_equal(100, manager.memory_usage().cpu_bytes);
+    }
+
+private:
+    kglt::StageID stage_id_;
+};
+
+#endif // TEST_RESOURCE_EVICTION_H
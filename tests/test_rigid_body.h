@@ -27,4 +27,38 @@ public:
         assert_equal(ret.first.z, 0);
     }
 
+    void test_moving_object_teleports_body() {
+        auto stage_id = window->new_stage();
+        auto stage = window->stage(stage_id);
+        auto mesh_id = window->shared_assets->new_mesh_as_box(1, 1, 1);
+        auto simulation = kglt::controllers::RigidBodySimulation::create();
+
+        auto actor = stage->actor(stage->new_actor_with_mesh(mesh_id));
+        actor->new_controller<kglt::controllers::RigidBody>(simulation);
+
+        const double step = 1.0 / 60.0;
+
+        auto run_step = [&]() {
+            actor->pre_fixed_update(step);
+            simulation->step(step);
+            actor->fixed_update(step);
+            actor->post_fixed_update(step);
+            stage->update_transforms();
+        };
+
+        run_step();
+
+        // As game code would from update(), between fixed steps
+        actor->set_absolute_position(10, 20, 30);
+
+        run_step();
+
+        // Gravity has had one step to act, but the body moved with the object
+        assert_close(10.0f, actor->absolute_position().x, 0.001f);
+        assert_close(20.0f, actor->absolute_position().y, 0.1f);
+        assert_close(30.0f, actor->absolute_position().z, 0.001f);
+
+        window->delete_stage(stage_id);
+    }
+
 };
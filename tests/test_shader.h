@@ -2,11 +2,13 @@
 
 #include "kglt/kglt.h"
 #include "kaztest/kaztest.h"
+#include "kglt/deps/kfs/kfs.h"
 
 #include "global.h"
 
 #ifndef KGLT_GL_VERSION_1X
 #include "kglt/renderers/gl2x/gpu_program.h"
+#include "kglt/renderers/gl2x/program_binary_cache.h"
 #endif
 
 class ShaderTest : public KGLTTestCase {
@@ -44,4 +46,77 @@ public:
 #endif
     }
 
+    void test_binary_cache_keys() {
+#ifndef KGLT_GL_VERSION_1X
+        auto directory = kfs::path::join(kfs::temp_dir(), "kglt_test_program_cache");
+
+        kglt::ProgramBinaryCache cache(directory, "vendor\nrenderer\n1.0");
+        kglt::ProgramBinaryCache updated(directory, "vendor\nrenderer\n1.1");
+
+        kglt::AttributeBindings bindings;
+        bindings["position"] = 0;
+
+        auto key = cache.key("hash", bindings);
+        assert_equal(key, cache.key("hash", bindings));
+        assert_true(key != cache.key("other", bindings));
+        assert_true(key != updated.key("hash", bindings));
+
+        bindings["position"] = 1;
+        assert_true(key != cache.key("hash", bindings));
+#endif
+    }
+
+    void test_binary_cache_invalidated_by_driver_change() {
+#ifndef KGLT_GL_VERSION_1X
+        auto directory = kfs::path::join(kfs::temp_dir(), "kglt_test_program_cache");
+
+        std::string key;
+        {
+            kglt::ProgramBinaryCache cache(directory, "driver one");
+            key = cache.key("hash", kglt::AttributeBindings());
+            kfs::touch(kfs::path::join(directory, key + ".bin"));
+            assert_true(cache.has_binary(key));
+        }
+
+        {
+            // Same driver, binaries survive
+            kglt::ProgramBinaryCache cache(directory, "driver one");
+            assert_true(cache.has_binary(key));
+        }
+
+        kglt::ProgramBinaryCache cache(directory, "driver two");
+        assert_false(cache.has_binary(key));
+#endif
+    }
+
+    void test_program_loads_from_binary_cache() {
+#ifndef KGLT_GL_VERSION_1X
+        if(!kglt::ProgramBinaryCache::is_supported()) {
+            return;
+        }
+
+        auto previous = kglt::GPUProgram::binary_cache();
+        auto cache = std::make_shared<kglt::ProgramBinaryCache>(
+            kfs::path::join(kfs::temp_dir(), "kglt_test_program_cache"),
+            kglt::ProgramBinaryCache::current_driver_identity()
+        );
+        cache->clear();
+        kglt::GPUProgram::set_binary_cache(cache);
+
+        const std::string vert = "attribute vec3 pos; void main(){ gl_Position = vec4(pos, 1.0); }";
+        const std::string frag = "void main(){ gl_FragColor = vec4(0.5); }";
+
+        auto first = kglt::GPUProgram::create(vert, frag);
+        first->build();
+        assert_false(first->is_from_binary_cache());
+
+        auto second = kglt::GPUProgram::create(vert, frag);
+        second->build();
+        assert_true(second->is_complete());
+        assert_true(second->is_from_binary_cache());
+
+        kglt::GPUProgram::set_binary_cache(previous);
+#endif
+    }
+
 };
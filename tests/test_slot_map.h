@@ -0,0 +1,143 @@
+#ifndef TEST_SLOT_MAP_H
+#define TEST_SLOT_MAP_H
+
+#include <unordered_map>
+#include <vector>
+
+#include "kaztest/kaztest.h"
+
+#include "kglt/kglt.h"
+#include "global.h"
+
+namespace {
+
+class Token;
+typedef UniqueID<std::shared_ptr<Token>> TokenID;
+
+/* The smallest thing a manager can hold, so that a lot of them can be created quickly */
+class Token:
+    public Managed<Token>,
+    public kglt::generic::Identifiable<TokenID> {
+
+public:
+    Token(TokenID id):
+        kglt::generic::Identifiable<TokenID>(id) {}
+
+    std::size_t cpu_memory_usage() const { return 0; }
+    std::size_t gpu_memory_usage() const { return 0; }
+};
+
+typedef kglt::generic::RefCountedTemplatedManager<Token, TokenID> TokenManager;
+
+}
+
+class SlotMapTest : public KGLTTestCase {
+public:
+    void set_up() {
+        KGLTTestCase::set_up();
+        stage_id_ = window->new_stage();
+    }
+
+    void tear_down() {
+        KGLTTestCase::tear_down();
+        window->delete_stage(stage_id_);
+    }
+
+    void test_stale_ids_dont_match_reused_slots() {
+        auto stage = window->stage(stage_id_);
+
+        // Enough that the freed indexes are reused by the next batch
+        std::vector<kglt::ActorID> first, second;
+        for(uint32_t i = 0; i < 2000; ++i) {
+            first.push_back(stage->new_actor());
+        }
+
+        for(auto id: first) {
+            stage->delete_actor(id);
+        }
+
+        for(uint32_t i = 0; i < 2000; ++i) {
+            second.push_back(stage->new_actor());
+        }
+
+        bool reused = false;
+        for(auto id: second) {
+            assert_true(stage->has_actor(id));
+            for(auto old: first) {
+                reused = reused || kglt::generic::slot_index(old.value()) == kglt::generic::slot_index(id.value());
+            }
+        }
+
+        assert_true(reused);
+
+        for(auto id: first) {
+            assert_false(stage->has_actor(id));
+        }
+    }
+
+    void test_ids_are_unique_across_managers() {
+        auto stage = window->stage(stage_id_);
+
+        auto a = window->shared_assets->new_material(kglt::GARBAGE_COLLECT_NEVER);
+        auto b = stage->assets->new_material(kglt::GARBAGE_COLLECT_NEVER);
+
+        assert_not_equal(a, b);
+        assert_true(window->shared_assets->has_material(a));
+        assert_false(window->shared_assets->has_material(b));
+
+        // Lookups which miss on the stage fall back to the window's assets
+        assert_equal(a, stage->assets->material(a)->id());
+    }
+
+    void test_lookups_find_the_same_materials() {
+        // tools/slot_map_benchmark times these lookups against a locked unordered_map
+        auto stage = window->stage(stage_id_);
+
+        std::vector<kglt::MaterialID> ids;
+        std::unordered_map<kglt::MaterialID, kglt::MaterialPtr> baseline;
+        for(uint32_t i = 0; i < 1000; ++i) {
+            auto id = stage->assets->new_material(kglt::GARBAGE_COLLECT_NEVER);
+            ids.push_back(id);
+            baseline[id] = stage->assets->material(id);
+        }
+
+        for(uint32_t i = 0; i < 100000; ++i) {
+            auto id = ids[(i * 7919) % ids.size()];
+            assert_true(baseline.at(id) == stage->assets->material(id));
+        }
+    }
+
+    void test_collected_ids_are_reused() {
+        TokenManager manager;
+
+        auto first = manager.make(kglt::GARBAGE_COLLECT_PERIODIC);
+        manager.get(first); // Used, so it can be collected straight away
+        manager.garbage_collect();
+        assert_false(manager.contains(first));
+
+        // More objects over time than there are indexes, which only works if collected IDs are released
+        const uint32_t batch = 1024;
+        bool reused = false;
+        for(uint32_t created = 0; created <= kglt::generic::SLOT_INDEX_MASK + batch; created += batch) {
+            for(uint32_t i = 0; i < batch; ++i) {
+                auto id = manager.make(kglt::GARBAGE_COLLECT_PERIODIC);
+                manager.get(id);
+
+                reused = reused || kglt::generic::slot_index(id.value()) == kglt::generic::slot_index(first.value());
+
+                // The stale ID mustn't find whatever now lives in its slot
+                assert_false(manager.contains(first));
+            }
+
+            manager.garbage_collect();
+            assert_equal(0, manager.count());
+        }
+
+        assert_true(reused);
+    }
+
+private:
+    kglt::StageID stage_id_;
+};
+
+#endif // TEST_SLOT_MAP_H
@@ -0,0 +1,109 @@
+#ifndef TEST_SPRITE_BATCHING_H
+#define TEST_SPRITE_BATCHING_H
+
+#include "kaztest/kaztest.h"
+
+#include "kglt/kglt.h"
+#include "global.h"
+
+class SpriteBatchingTest : public KGLTTestCase {
+public:
+    void set_up() {
+        KGLTTestCase::set_up();
+        stage_id_ = window->new_stage();
+
+        auto stage = window->stage(stage_id_);
+        stage->set_sprite_batching_enabled();
+
+        for(auto& region: regions_) {
+            auto tex = stage->assets->texture(stage->assets->new_texture());
+            tex->resize(64, 64);
+            region = stage->assets->new_atlas_region_from_texture(tex->id());
+        }
+    }
+
+    void tear_down() {
+        KGLTTestCase::tear_down();
+        window->delete_stage(stage_id_);
+    }
+
+    kglt::SpriteID new_sprite(const kglt::AtlasRegion& region, float x, float y) {
+        auto stage = window->stage(stage_id_);
+        auto sprite = stage->sprite(stage->new_sprite());
+        sprite->set_spritesheet(region, 32, 32);
+        sprite->move_to(x, y, 0);
+        return sprite->id();
+    }
+
+    void test_sprites_sharing_a_material_are_one_batch() {
+        auto stage = window->stage(stage_id_);
+
+        // Both regions are on the same atlas page
+        for(uint32_t i = 0; i < 500; ++i) {
+            new_sprite(regions_[i % 2], i, 0);
+        }
+
+        stage->update_transforms();
+
+        assert_equal(1, stage->sprite_batcher->batch_count());
+
+        auto actor_id = stage->sprite_batcher->batch_actor(kglt::RENDER_PRIORITY_MAIN, regions_[0].material);
+        auto mesh = stage->actor(actor_id)->mesh();
+
+        assert_equal(1, mesh->submesh_count());
+        assert_equal(500 * 4, mesh->shared_data->count());
+        assert_equal(500 * 6, mesh->first_submesh()->index_data->count());
+
+        // Vertices are written in world space, in the order the sprites were created
+        auto position = mesh->shared_data->position_at<kglt::Vec3>(4 * 10);
+        assert_close(10.0f - 0.5f, position.x, 0.0001);
+    }
+
+    void test_layers_are_separate_batches() {
+        auto stage = window->stage(stage_id_);
+
+        auto below = stage->sprite(new_sprite(regions_[0], 0, 0));
+        auto above = stage->sprite(new_sprite(regions_[1], 0, 0));
+        above->set_layer(kglt::RENDER_PRIORITY_FOREGROUND);
+
+        stage->update_transforms();
+
+        assert_equal(2, stage->sprite_batcher->batch_count());
+
+        auto actor_id = stage->sprite_batcher->batch_actor(kglt::RENDER_PRIORITY_FOREGROUND, regions_[1].material);
+        assert_equal(kglt::RENDER_PRIORITY_FOREGROUND, stage->actor(actor_id)->render_priority());
+
+        // Moving the sprite down empties the foreground batch
+        above->set_layer(kglt::RENDER_PRIORITY_MAIN);
+        stage->update_transforms();
+
+        assert_equal(0, stage->actor(actor_id)->mesh()->shared_data->count());
+        assert_false(below->actor_id());
+    }
+
+    void test_deleted_and_hidden_sprites_are_dropped() {
+        auto stage = window->stage(stage_id_);
+
+        auto first = new_sprite(regions_[0], 0, 0);
+        auto second = new_sprite(regions_[0], 1, 0);
+        new_sprite(regions_[0], 2, 0);
+
+        stage->update_transforms();
+
+        auto actor_id = stage->sprite_batcher->batch_actor(kglt::RENDER_PRIORITY_MAIN, regions_[0].material);
+        assert_equal(12, stage->actor(actor_id)->mesh()->shared_data->count());
+
+        stage->delete_sprite(first);
+        stage->sprite(second)->set_visible(false);
+        stage->update_transforms();
+
+        assert_equal(4, stage->actor(actor_id)->mesh()->shared_data->count());
+        assert_equal(2, stage->sprite_batcher->sprite_count());
+    }
+
+private:
+    kglt::StageID stage_id_;
+    kglt::AtlasRegion regions_[2];
+};
+
+#endif // TEST_SPRITE_BATCHING_H
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <cmath>
+
+#include "global.h"
+#include "kglt/kglt.h"
+#include "kglt/extra/terrain.h"
+
+
+class TerrainTest : public KGLTTestCase {
+public:
+    void set_up() {
+        KGLTTestCase::set_up();
+        camera_id_ = window->new_camera();
+        stage_id_ = window->new_stage(kglt::PARTITIONER_NULL);
+
+        // Rolling hills, gentle enough that distant chunks can be coarse
+        const int size = 257;
+        heights_.resize(size * size);
+        for(int z = 0; z < size; ++z) {
+            for(int x = 0; x < size; ++x) {
+                heights_[(z * size) + x] = 0.5f + 0.25f * std::sin(x * 0.15f) * std::cos(z * 0.11f);
+            }
+        }
+
+        lod_.chunk_size = 16;
+        lod_.max_screen_error = 40.0f;
+    }
+
+    void tear_down() {
+        KGLTTestCase::tear_down();
+        window->delete_camera(camera_id_);
+        window->delete_stage(stage_id_);
+    }
+
+    void move_camera(float x, float y, float z) {
+        kglt::Mat4 transform;
+        kmMat4Translation(&transform, x, y, z);
+        window->camera(camera_id_)->set_transform(transform);
+    }
+
+    void test_nearby_chunks_are_finer() {
+        auto stage = window->stage(stage_id_);
+        kglt::extra::Terrain terrain(stage, camera_id_, heights_, 257, 257, kglt::HeightmapSpecification(), lod_);
+
+        assert_equal(5, terrain.level_count());
+
+        move_camera(-300, 60, -300);
+        terrain.update();
+
+        assert_true(terrain.selected_chunk_count() > 1);
+        assert_true(terrain.level_at(-300, -300) > terrain.level_at(300, 300));
+
+        // From far above the whole terrain is a single chunk
+        move_camera(0, 5000, 0);
+        terrain.update();
+
+        assert_equal(1, terrain.selected_chunk_count());
+        assert_equal(0, terrain.level_at(0, 0));
+    }
+
+    void test_no_cracks_between_levels() {
+        auto stage = window->stage(stage_id_);
+        kglt::extra::Terrain terrain(stage, camera_id_, heights_, 257, 257, kglt::HeightmapSpecification(), lod_);
+
+        move_camera(250, 30, 100);
+        terrain.update();
+
+        /* Every vertex used along the edge of a chunk must also be used by the chunk on the
+         * other side of that edge, otherwise there's a T-junction and a crack */
+        std::map<std::pair<float, float>, int> uses;
+        std::vector<std::set<std::pair<float, float>>> chunk_edges;
+
+        float terrain_min = 0, terrain_max = 0;
+
+        for(auto actor_id: terrain.chunk_actors()) {
+            auto actor = stage->actor(actor_id);
+            auto submesh = actor->mesh()->first_submesh();
+            auto box = actor->mesh()->aabb();
+
+            terrain_min = std::min(terrain_min, box.min.x);
+            terrain_max = std::max(terrain_max, box.max.x);
+
+            std::set<std::pair<float, float>> edge;
+            for(auto i: submesh->index_data->all()) {
+                auto p = submesh->vertex_data->position_at<kglt::Vec3>(i);
+                if(p.x == box.min.x || p.x == box.max.x || p.z == box.min.z || p.z == box.max.z) {
+                    edge.insert(std::make_pair(p.x, p.z));
+                }
+            }
+
+            for(auto& p: edge) {
+                uses[p]++;
+            }
+
+            chunk_edges.push_back(edge);
+        }
+
+        assert_true(chunk_edges.size() > 1);
+
+        for(auto& edge: chunk_edges) {
+            for(auto& p: edge) {
+                bool outside = p.first == terrain_min || p.first == terrain_max || p.second == terrain_min || p.second == terrain_max;
+                if(!outside) {
+                    assert_true(uses[p] > 1);
+                }
+            }
+        }
+    }
+
+    void test_resident_chunks_are_limited() {
+        auto stage = window->stage(stage_id_);
+
+        lod_.max_resident_chunks = 40;
+        kglt::extra::Terrain terrain(stage, camera_id_, heights_, 257, 257, kglt::HeightmapSpecification(), lod_);
+
+        move_camera(-300, 60, -300);
+        terrain.update();
+        move_camera(250, 30, 100);
+        terrain.update();
+
+        assert_true(terrain.resident_chunk_count() <= 40);
+
+        // Chunks which are drawn are never thrown away, even over budget
+        assert_true(terrain.resident_chunk_count() >= terrain.selected_chunk_count());
+    }
+
+private:
+    kglt::CameraID camera_id_;
+    kglt::StageID stage_id_;
+
+    std::vector<float> heights_;
+    kglt::extra::TerrainLODSpecification lod_;
+};
@@ -0,0 +1,159 @@
+#ifndef TEST_TEXTURE_H
+#define TEST_TEXTURE_H
+
+#include "kaztest/kaztest.h"
+
+#include "kglt/kglt.h"
+#include "kglt/texture_streamer.h"
+#include "global.h"
+
+class TextureTest : public KGLTTestCase {
+public:
+    kglt::TexturePtr new_filled_texture(uint32_t width, uint32_t height, uint8_t value) {
+        auto tex = window->shared_assets->texture(window->shared_assets->new_texture());
+        tex->resize(width, height);
+        std::fill(tex->data().begin(), tex->data().end(), value);
+        return tex;
+    }
+
+    void test_sub_texture_into_a_large_texture() {
+        // Big enough that byte offsets don't fit in 16 bits
+        auto target = new_filled_texture(512, 512, 0);
+        auto source = new_filled_texture(64, 64, 7);
+
+        target->sub_texture(source->id(), 300, 400);
+
+        auto pixel = [&](uint32_t x, uint32_t y) {
+            return target->data()[((y * 512) + x) * 4];
+        };
+
+        assert_equal(7, pixel(300, 400));
+        assert_equal(7, pixel(363, 463));
+        assert_equal(0, pixel(299, 400));
+        assert_equal(0, pixel(364, 463));
+        assert_equal(0, pixel(300, 464));
+
+        // The first blit uploads the whole texture and keeps the data for the next one
+        assert_true(target->gl_tex());
+        assert_true(target->dirty_rects().empty());
+
+        target->sub_texture(source->id(), 0, 0);
+        assert_equal(7, pixel(0, 0));
+        assert_true(target->dirty_rects().empty());
+
+        assert_raises(std::logic_error, std::bind(&kglt::Texture::sub_texture, target.get(), source->id(), 500, 0));
+    }
+
+    void test_dirty_rects_are_merged() {
+        auto tex = new_filled_texture(256, 256, 0);
+
+        tex->mark_dirty(0, 0, 10, 10);
+        tex->mark_dirty(10, 0, 10, 10);
+        assert_equal(1, tex->dirty_rects().size());
+        assert_equal(20, tex->dirty_rects()[0].width);
+        assert_equal(10, tex->dirty_rects()[0].height);
+
+        tex->mark_dirty(100, 100, 5, 5);
+        assert_equal(2, tex->dirty_rects().size());
+
+        // Too many separate rectangles collapse into their bounds
+        for(uint32_t i = 0; i < kglt::Texture::MAX_DIRTY_RECTS; ++i) {
+            tex->mark_dirty(i * 12, 200, 4, 4);
+        }
+
+        assert_equal(1, tex->dirty_rects().size());
+        assert_equal(0, tex->dirty_rects()[0].x);
+        assert_equal(0, tex->dirty_rects()[0].y);
+        assert_equal(204, tex->dirty_rects()[0].height);
+
+        assert_raises(std::out_of_range, std::bind(&kglt::Texture::mark_dirty, tex.get(), 250, 0, 10, 1));
+
+        tex->upload(kglt::MIPMAP_GENERATE_NONE, kglt::TEXTURE_WRAP_CLAMP_TO_EDGE, kglt::TEXTURE_FILTER_NEAREST, false);
+        assert_true(tex->dirty_rects().empty());
+
+        tex->mark_dirty(16, 16, 32, 32);
+        tex->upload_dirty();
+        assert_true(tex->dirty_rects().empty());
+    }
+
+    void test_mipmap_data_is_generated() {
+        auto tex = new_filled_texture(4, 2, 0);
+
+        // One black and one white 2x2 block, so the first mipmap is a black and a white pixel
+        for(uint32_t y = 0; y < 2; ++y) {
+            for(uint32_t x = 2; x < 4; ++x) {
+                std::fill_n(tex->data().begin() + ((y * 4) + x) * 4, 4, 255);
+            }
+        }
+
+        tex->generate_mipmap_data();
+
+        assert_equal(3, tex->full_mipmap_count());
+        assert_equal(3, tex->mipmap_count());
+        assert_equal(2 * 1 * 4, tex->level_size(1));
+        assert_equal(1 * 1 * 4, tex->level_size(2));
+
+        assert_equal(0, tex->mipmap_data(1)[0]);
+        assert_equal(255, tex->mipmap_data(1)[4]);
+        assert_equal(128, tex->mipmap_data(2)[0]);
+    }
+
+#ifdef KGLT_GL_VERSION_2X
+    void test_streamed_texture_keeps_small_levels_resident() {
+        kglt::TextureStreamer& streamer = window->texture_streamer;
+
+        auto tex = new_filled_texture(256, 256, 64);
+        assert_true(streamer.add(tex, "streamed.png", kglt::TextureFlags()));
+
+        // Only the levels up to 64x64 are uploaded, and the data is given back
+        auto status = tex->streaming_status();
+        assert_true(status.streaming);
+        assert_equal(2, status.always_resident_mip);
+        assert_equal(2, status.resident_mip);
+        assert_true(tex->data().empty());
+
+        std::size_t expected = 0;
+        for(uint32_t i = 2; i < tex->full_mipmap_count(); ++i) {
+            expected += tex->level_size(i);
+        }
+        assert_equal(expected, status.resident_bytes);
+
+        // Drawn full size, but there's no room in the budget for any more detail
+        auto old_budget = streamer.memory_budget();
+        streamer.set_memory_budget(streamer.resident_bytes());
+
+        auto material = window->shared_assets->material(window->shared_assets->new_material_from_texture(tex->id()));
+        streamer._note_usage(material, 256.0f);
+        streamer.update(0.0);
+
+        streamer.set_memory_budget(old_budget);
+
+        assert_equal(2, tex->streaming_status().requested_mip);
+        assert_equal(0, streamer.loading_count());
+    }
+
+    void test_streamed_texture_can_be_prepared_off_the_gl_thread() {
+        kglt::TextureStreamer& streamer = window->texture_streamer;
+
+        auto tex = new_filled_texture(256, 256, 64);
+
+        // What an async load does on its worker, nothing is uploaded yet
+        kglt::TextureStreamer::ResidentLevels resident;
+        assert_true(streamer.prepare(tex, "streamed.png", kglt::TextureFlags(), resident));
+        assert_equal(2, resident.first_level);
+        assert_equal(tex->full_mipmap_count() - 2, resident.levels.size());
+        assert_true(tex->data().empty());
+        assert_false(tex->streaming_status().streaming);
+
+        // And then on the GL thread
+        uint32_t count = streamer.streaming_count();
+        streamer.__do_add(tex, "streamed.png", kglt::TextureFlags(), resident);
+
+        assert_true(tex->streaming_status().streaming);
+        assert_equal(2, tex->streaming_status().resident_mip);
+        assert_equal(count + 1, streamer.streaming_count());
+    }
+#endif
+};
+
+#endif // TEST_TEXTURE_H
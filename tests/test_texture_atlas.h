@@ -0,0 +1,129 @@
+#ifndef TEST_TEXTURE_ATLAS_H
+#define TEST_TEXTURE_ATLAS_H
+
+#include <vector>
+
+#include "kaztest/kaztest.h"
+
+#include "kglt/kglt.h"
+#include "global.h"
+
+class TextureAtlasTest : public KGLTTestCase {
+public:
+    void set_up() {
+        KGLTTestCase::set_up();
+        stage_id_ = window->new_stage();
+    }
+
+    void tear_down() {
+        KGLTTestCase::tear_down();
+        window->delete_stage(stage_id_);
+    }
+
+    /* A texture filled with a single colour, which keeps its data so it can be packed */
+    kglt::TextureID new_filled_texture(uint32_t width, uint32_t height, uint8_t value) {
+        auto stage = window->stage(stage_id_);
+
+        auto tex = stage->assets->texture(stage->assets->new_texture());
+        tex->resize(width, height);
+        std::fill(tex->data().begin(), tex->data().end(), value);
+        return tex->id();
+    }
+
+    void test_packed_rectangles_dont_overlap() {
+        kglt::SkylinePacker packer(256, 256);
+
+        struct Rect { uint32_t x, y, w, h; };
+        std::vector<Rect> packed;
+
+        for(uint32_t i = 0; i < 200; ++i) {
+            Rect r = {0, 0, 5 + (i * 7) % 29, 5 + (i * 13) % 23};
+            if(packer.pack(r.w, r.h, r.x, r.y)) {
+                packed.push_back(r);
+            }
+        }
+
+        assert_true(packed.size() > 50);
+        assert_true(packer.occupancy() > 0.7f);
+
+        for(std::size_t i = 0; i < packed.size(); ++i) {
+            const Rect& a = packed[i];
+            assert_true(a.x + a.w <= 256);
+            assert_true(a.y + a.h <= 256);
+
+            for(std::size_t j = i + 1; j < packed.size(); ++j) {
+                const Rect& b = packed[j];
+                bool overlap = a.x < b.x + b.w && b.x < a.x + a.w && a.y < b.y + b.h && b.y < a.y + a.h;
+                assert_false(overlap);
+            }
+        }
+
+        uint32_t x, y;
+        assert_false(packer.pack(257, 1, x, y));
+    }
+
+    void test_images_share_a_page() {
+        auto stage = window->stage(stage_id_);
+
+        auto red = stage->assets->new_atlas_region_from_texture(new_filled_texture(16, 16, 200));
+        auto blue = stage->assets->new_atlas_region_from_texture(new_filled_texture(32, 8, 100));
+
+        assert_equal(1, stage->assets->atlas()->page_count());
+        assert_equal(red.texture, blue.texture);
+        assert_equal(red.material, blue.material);
+
+        // Each image is copied into its region, with its edges repeated into the padding
+        auto page = stage->assets->texture(red.texture);
+        auto pixel = [&](uint32_t x, uint32_t y) { return page->data()[((y * page->width()) + x) * 4]; };
+
+        assert_equal(200, pixel(red.x, red.y));
+        assert_equal(200, pixel(red.x + 15, red.y + 15));
+        assert_equal(200, pixel(red.x - 1, red.y - 1));
+        assert_equal(100, pixel(blue.x + 31, blue.y + 7));
+
+        // The corners of the image map to the corners of its region
+        auto uv = red.map(1.0f, 1.0f);
+        assert_close(float(red.x + 16) / page->width(), uv.x, 0.0001);
+        assert_close(float(red.y + 16) / page->height(), uv.y, 0.0001);
+    }
+
+    void test_large_images_get_their_own_page() {
+        auto stage = window->stage(stage_id_);
+        auto size = kglt::TextureAtlas::DEFAULT_PAGE_SIZE;
+
+        auto small = stage->assets->new_atlas_region_from_texture(new_filled_texture(16, 16, 1));
+        auto large = stage->assets->new_atlas_region_from_texture(new_filled_texture(size, 4, 2));
+
+        assert_equal(2, stage->assets->atlas()->page_count());
+        assert_not_equal(small.texture, large.texture);
+        assert_close(1.0f - (2.0f / (size + 2)), large.uv_scale.x, 0.0001);
+    }
+
+    void test_sprites_from_one_atlas_share_a_material() {
+        auto stage = window->stage(stage_id_);
+
+        auto first = stage->assets->new_atlas_region_from_texture(new_filled_texture(64, 32, 10));
+        auto second = stage->assets->new_atlas_region_from_texture(new_filled_texture(32, 32, 20));
+
+        auto a = stage->sprite(stage->new_sprite());
+        auto b = stage->sprite(stage->new_sprite());
+
+        a->set_spritesheet(first, 32, 32);
+        b->set_spritesheet(second, 32, 32);
+
+        auto mesh_a = stage->actor(a->actor_id())->mesh();
+        auto mesh_b = stage->actor(b->actor_id())->mesh();
+
+        assert_equal(mesh_a->first_submesh()->material_id(), mesh_b->first_submesh()->material_id());
+
+        // The first frame of the first sprite only covers the left half of its region
+        auto uv = mesh_a->shared_data->texcoord0_at<kglt::Vec2>(1);
+        assert_true(uv.x < first.uv_offset.x + (first.uv_scale.x / 2));
+        assert_true(uv.x > first.uv_offset.x);
+    }
+
+private:
+    kglt::StageID stage_id_;
+};
+
+#endif // TEST_TEXTURE_ATLAS_H
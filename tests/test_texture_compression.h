@@ -0,0 +1,120 @@
+#ifndef TEST_TEXTURE_COMPRESSION_H
+#define TEST_TEXTURE_COMPRESSION_H
+
+#include <sstream>
+#include <vector>
+
+#include "kaztest/kaztest.h"
+
+#include "kglt/kglt.h"
+#include "kglt/texture_compression.h"
+#include "kglt/loaders/compressed_texture_loader.h"
+#include "global.h"
+
+class TextureCompressionTest : public KGLTTestCase {
+public:
+    /* An 8x8 RGBA gradient, so every block is different */
+    std::vector<uint8_t> gradient() {
+        std::vector<uint8_t> rgba(8 * 8 * 4);
+        for(uint32_t y = 0; y < 8; ++y) {
+            for(uint32_t x = 0; x < 8; ++x) {
+                uint8_t* p = &rgba[((y * 8) + x) * 4];
+                p[0] = 64 + (x * 8);
+                p[1] = 64 + (y * 8);
+                p[2] = 128;
+                p[3] = 255 - (x * 16);
+            }
+        }
+        return rgba;
+    }
+
+    void test_dxt1_block_decodes() {
+        // Red and blue end points, the first pixel uses the second colour and the rest the first
+        std::vector<uint8_t> block = {0x00, 0xF8, 0x1F, 0x00, 0x01, 0x00, 0x00, 0x00};
+        std::vector<uint8_t> rgba(4 * 4 * 4);
+
+        kglt::decompress_level(kglt::TEXTURE_FORMAT_DXT1, 4, 4, &block[0], &rgba[0]);
+
+        assert_equal(0, rgba[0]);
+        assert_equal(255, rgba[2]);
+        assert_equal(255, rgba[4]);
+        assert_equal(0, rgba[6]);
+        assert_equal(255, rgba[7]);
+    }
+
+    void test_etc_round_trip() {
+        auto rgba = gradient();
+
+        auto etc1 = kglt::compress_etc1(&rgba[0], 8, 8);
+        assert_equal(kglt::compressed_level_size(kglt::TEXTURE_FORMAT_ETC1, 8, 8), etc1.size());
+
+        auto etc2 = kglt::compress_etc2_rgba(&rgba[0], 8, 8);
+        assert_equal(kglt::compressed_level_size(kglt::TEXTURE_FORMAT_ETC2_RGBA, 8, 8), etc2.size());
+
+        std::vector<uint8_t> decoded(rgba.size());
+        kglt::decompress_level(kglt::TEXTURE_FORMAT_ETC2_RGBA, 8, 8, &etc2[0], &decoded[0]);
+
+        for(uint32_t i = 0; i < rgba.size(); ++i) {
+            assert_true(std::abs(int(rgba[i]) - int(decoded[i])) <= 24);
+        }
+    }
+
+    void test_flipping_dxt_doesnt_decode() {
+        auto tex = window->shared_assets->texture(window->shared_assets->new_texture());
+
+        // Blocks of solid colour compress exactly, so flipping can be compared with the source
+        std::vector<uint8_t> block_a = {0x00, 0xF8, 0x00, 0xF8, 0x00, 0x00, 0x00, 0x00};
+        std::vector<uint8_t> block_b = {0x1F, 0x00, 0x1F, 0x00, 0x00, 0x00, 0x00, 0x00};
+
+        kglt::Texture::Data level;
+        level.insert(level.end(), block_a.begin(), block_a.end());
+        level.insert(level.end(), block_b.begin(), block_b.end());
+
+        tex->set_compressed_data(kglt::TEXTURE_FORMAT_DXT1, 4, 8, {level});
+        tex->flip_vertically();
+
+        assert_true(tex->is_compressed());
+        assert_true(std::equal(block_b.begin(), block_b.end(), tex->data().begin()));
+        assert_true(std::equal(block_a.begin(), block_a.end(), tex->data().begin() + 8));
+
+        // Tiles can't be copied out of compressed data
+        tex->decompress();
+        assert_false(tex->is_compressed());
+        assert_equal(32, tex->bpp());
+        assert_equal(4 * 8 * 4, tex->data().size());
+        assert_equal(0, tex->data()[0]);
+        assert_equal(255, tex->data()[2]);
+    }
+
+    void test_ktx_round_trip() {
+        auto rgba = gradient();
+
+        std::vector<kglt::Texture::Data> levels = {
+            kglt::compress_etc1(&rgba[0], 8, 8),
+            kglt::compress_etc1(&rgba[0], 4, 4),
+            kglt::compress_etc1(&rgba[0], 2, 2),
+            kglt::compress_etc1(&rgba[0], 1, 1)
+        };
+
+        auto stream = std::make_shared<std::stringstream>();
+        kglt::loaders::write_ktx(*stream, kglt::TEXTURE_FORMAT_ETC1, 8, 8, levels);
+
+        auto tex = window->shared_assets->texture(window->shared_assets->new_texture());
+        kglt::loaders::CompressedTextureLoaderType().loader_for("test.ktx", stream)->into(tex);
+
+        // Written bottom-up, so it stays compressed
+        assert_true(tex->is_compressed());
+        assert_equal(kglt::TEXTURE_FORMAT_ETC1, tex->format());
+        assert_equal(8, tex->width());
+        assert_equal(8, tex->height());
+        assert_equal(4, tex->mipmap_count());
+        assert_true(levels[0] == tex->data());
+        assert_true(levels[3] == tex->mipmap_data(3));
+
+        // Upload either uses the data as it is or decompresses it, but it never fails
+        tex->upload(kglt::MIPMAP_GENERATE_COMPLETE);
+        assert_true(tex->gpu_memory_usage() > 0);
+    }
+};
+
+#endif // TEST_TEXTURE_COMPRESSION_H
@@ -0,0 +1,163 @@
+#ifndef TEST_TILEMAP_H
+#define TEST_TILEMAP_H
+
+#include "kaztest/kaztest.h"
+
+#include "kglt/kglt.h"
+#include "kglt/extra/tilemap.h"
+#include "global.h"
+
+class TileMapTest : public KGLTTestCase {
+public:
+    void set_up() {
+        KGLTTestCase::set_up();
+        stage_id_ = window->new_stage();
+
+        kfs::Path path = kfs::path::join(kfs::path::dir_name(__FILE__), "test-data");
+        window->resource_locator->add_search_path(path);
+    }
+
+    void tear_down() {
+        KGLTTestCase::tear_down();
+        window->delete_stage(stage_id_);
+    }
+
+    /* The texture coordinate of the first vertex of a tile, within a 16 x 16 chunk */
+    kglt::Vec2 first_texcoord(kglt::extra::TileMap& map, uint32_t x, uint32_t y) {
+        auto stage = window->stage(stage_id_);
+        auto mesh = stage->actor(map.chunk_actor(x, y))->mesh();
+        return mesh->shared_data->texcoord0_at<kglt::Vec2>((((y % 16) * 16) + (x % 16)) * 4);
+    }
+
+    void test_layer_is_split_into_chunks() {
+        auto stage = window->stage(stage_id_);
+        kglt::extra::TileMap map(stage, "tilemap.tmx", "ground", 1.0f, 16);
+
+        assert_equal(40, map.width());
+        assert_equal(20, map.height());
+        assert_equal(6, map.chunk_count());
+
+        // Chunks without any tiles don't have an actor
+        assert_equal(3, map.chunk_actors().size());
+        assert_false(map.chunk_actor(0, 19));
+
+        assert_not_equal(map.chunk_actor(0, 0), map.chunk_actor(16, 0));
+        assert_equal(map.chunk_actor(0, 0), map.chunk_actor(15, 15));
+
+        // Each chunk has its own bounds, so the partitioner can cull it
+        auto aabb = stage->actor(map.chunk_actor(16, 0))->mesh()->aabb();
+        assert_close(16.0f, aabb.min.x, 0.0001);
+        assert_close(32.0f, aabb.max.x, 0.0001);
+
+        assert_equal(1, map.tile(0, 0));
+        assert_equal(0, map.tile(0, 10));
+        assert_equal(3, map.tile(5, 12));
+    }
+
+    void test_changing_a_tile_rewrites_its_texcoords() {
+        auto stage = window->stage(stage_id_);
+        kglt::extra::TileMap map(stage, "tilemap.tmx", "ground", 1.0f, 16);
+
+        auto actor_id = map.chunk_actor(1, 1);
+        auto mesh = stage->actor(actor_id)->mesh();
+        auto index_count = mesh->first_submesh()->index_data->count();
+
+        map.set_tile(1, 1, 2);
+        assert_equal(2, map.tile(1, 1));
+
+        auto expected = map.tilesets()[0].texcoords(1)[0];
+        auto texcoord = first_texcoord(map, 1, 1);
+        assert_close(expected.x, texcoord.x, 0.0001);
+        assert_close(expected.y, texcoord.y, 0.0001);
+
+        // Swapping one tile for another doesn't touch the indices or the actor
+        map.update(0.0);
+        assert_equal(actor_id, map.chunk_actor(1, 1));
+        assert_equal(index_count, mesh->first_submesh()->index_data->count());
+    }
+
+    void test_filling_and_emptying_cells() {
+        auto stage = window->stage(stage_id_);
+        kglt::extra::TileMap map(stage, "tilemap.tmx", "ground", 1.0f, 16);
+
+        auto mesh = stage->actor(map.chunk_actor(0, 0))->mesh();
+        auto index_count = mesh->first_submesh()->index_data->count();
+
+        map.set_tile(0, 11, 1);
+        map.set_tile(0, 0, 0);
+        map.set_tile(1, 0, 0);
+        map.update(0.0);
+
+        assert_equal(index_count - 6, mesh->first_submesh()->index_data->count());
+
+        // Filling a chunk which was empty gives it an actor
+        map.set_tile(0, 19, 4);
+        map.update(0.0);
+
+        assert_true(map.chunk_actor(0, 19));
+        assert_equal(4, map.chunk_actors().size());
+
+        assert_raises(std::out_of_range, std::bind(&kglt::extra::TileMap::set_tile, &map, 40, 0, 1));
+        assert_raises(std::logic_error, std::bind(&kglt::extra::TileMap::set_tile, &map, 0, 0, 5));
+    }
+
+    void test_animated_tiles_change_frame() {
+        auto stage = window->stage(stage_id_);
+        kglt::extra::TileMap map(stage, "tilemap.tmx", "ground", 1.0f, 16);
+
+        const auto& tileset = map.tilesets()[0];
+        assert_equal(2, tileset.animations.at(2).size());
+
+        auto first = tileset.texcoords(2)[0];
+        auto second = tileset.texcoords(3)[0];
+
+        assert_close(first.x, first_texcoord(map, 5, 12).x, 0.0001);
+
+        map.update(0.15);
+        assert_close(second.x, first_texcoord(map, 5, 12).x, 0.0001);
+        assert_equal(3, map.tile(5, 12));
+
+        // Tiles placed later join in on the current frame
+        map.set_tile(6, 12, 3);
+        assert_close(second.x, first_texcoord(map, 6, 12).x, 0.0001);
+
+        map.update(0.1);
+        assert_close(first.x, first_texcoord(map, 5, 12).x, 0.0001);
+        assert_close(first.x, first_texcoord(map, 6, 12).x, 0.0001);
+    }
+
+    void test_stage_update_drives_the_map() {
+        auto stage = window->stage(stage_id_);
+        kglt::extra::TileMap map(stage, "tilemap.tmx", "ground", 1.0f, 16);
+
+        auto second = map.tilesets()[0].texcoords(3)[0];
+
+        // The stage's update is on the main thread, even when the simulation is threaded
+        stage->update(0.15);
+        assert_close(second.x, first_texcoord(map, 5, 12).x, 0.0001);
+    }
+
+    void test_loading_into_a_stage_gives_each_chunk_an_actor() {
+        auto stage = window->stage(stage_id_);
+
+        window->loader_for("tilemap.tmx")->into(stage, {
+            {"layer", unicode("ground")},
+            {"render_size", 1.0f},
+            {"chunk_size", uint32_t(16)}
+        });
+
+        // The same chunks as the TileMap, the empty ones don't get an actor
+        assert_equal(3, stage->actor_count());
+
+        stage->ActorManager::each([this](kglt::Actor* actor) {
+            auto aabb = actor->mesh()->aabb();
+            assert_true(aabb.width() <= 16.0001f);
+            assert_true(aabb.height() <= 16.0001f);
+        });
+    }
+
+private:
+    kglt::StageID stage_id_;
+};
+
+#endif // TEST_TILEMAP_H
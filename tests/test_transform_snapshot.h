@@ -0,0 +1,74 @@
+#ifndef TEST_TRANSFORM_SNAPSHOT_H
+#define TEST_TRANSFORM_SNAPSHOT_H
+
+#include "kglt/kglt.h"
+#include "kaztest/kaztest.h"
+
+#include "global.h"
+
+class TransformSnapshotTest : public KGLTTestCase {
+public:
+    void set_up() {
+        KGLTTestCase::set_up();
+        stage_id_ = window->new_stage();
+    }
+
+    void tear_down() {
+        KGLTTestCase::tear_down();
+        window->delete_stage(stage_id_);
+    }
+
+    void test_interpolation_between_snapshots() {
+        auto stage = window->stage(stage_id_);
+        auto actor = stage->actor(stage->new_actor());
+        auto snapshot = stage->transform_snapshot.get();
+
+        assert_false(snapshot->is_populated());
+
+        snapshot->capture(stage);
+        snapshot->publish();
+
+        actor->set_absolute_position(10, 0, 0);
+
+        snapshot->capture(stage);
+        snapshot->publish();
+
+        assert_true(snapshot->is_populated());
+
+        kglt::Mat4 result;
+        assert_true(snapshot->interpolated_transformation(actor, 0.5, result));
+        assert_close(5.0, result.mat[12], 0.0001);
+
+        assert_true(snapshot->interpolated_transformation(actor, 1.0, result));
+        assert_close(10.0, result.mat[12], 0.0001);
+
+        // Once cleared, the captured states are stale even though the actor hasn't moved
+        snapshot->clear();
+        assert_false(snapshot->interpolated_transformation(actor, 0.5, result));
+    }
+
+    void test_moved_objects_use_live_transform() {
+        auto stage = window->stage(stage_id_);
+        auto actor = stage->actor(stage->new_actor());
+        auto snapshot = stage->transform_snapshot.get();
+
+        snapshot->capture(stage);
+        snapshot->publish();
+
+        actor->set_absolute_position(0, 5, 0);
+
+        kglt::Mat4 result;
+        assert_false(snapshot->interpolated_transformation(actor, 0.5, result));
+
+        result = actor->interpolated_transformation();
+        assert_close(5.0, result.mat[13], 0.0001);
+
+        snapshot->clear();
+        assert_false(snapshot->is_populated());
+    }
+
+private:
+    kglt::StageID stage_id_;
+};
+
+#endif // TEST_TRANSFORM_SNAPSHOT_H
@@ -0,0 +1,77 @@
+#ifndef TEST_TRANSFORM_STORE_H
+#define TEST_TRANSFORM_STORE_H
+
+#include "kglt/kglt.h"
+#include "kaztest/kaztest.h"
+#include "kglt/transform_store.h"
+
+namespace {
+
+using namespace kglt;
+
+class TransformStoreTest : public TestCase {
+public:
+    void test_world_transforms_follow_parents() {
+        TransformStore store;
+
+        auto root = store.allocate();
+        auto child = store.allocate();
+
+        store.set_parent(child, root);
+        store.set_local_position(root, Vec3(1, 0, 0));
+        store.set_local_position(child, Vec3(0, 2, 0));
+
+        assert_equal(Vec3(1, 2, 0), store.world_position(child));
+
+        store.set_local_position(root, Vec3(5, 0, 0));
+        assert_true(store.is_dirty(child));
+
+        store.update();
+        assert_false(store.is_dirty(child));
+        assert_equal(Vec3(5, 2, 0), store.world_position(child));
+        assert_close(5.0, store.world_matrix(child).mat[12], 0.0001);
+    }
+
+    void test_reparenting_restores_hierarchy_order() {
+        TransformStore store;
+
+        auto child = store.allocate();
+        auto parent = store.allocate();
+
+        // The parent was allocated after the child, so the store has to reorder
+        store.set_parent(child, parent);
+        store.set_local_position(parent, Vec3(0, 0, 3));
+        store.update();
+
+        assert_true(store._dense_index(parent) < store._dense_index(child));
+        assert_equal(Vec3(0, 0, 3), store.world_position(child));
+    }
+
+    void test_release_orphans_children() {
+        TransformStore store;
+
+        auto parent = store.allocate();
+        auto child = store.allocate();
+        auto other = store.allocate();
+
+        store.set_parent(child, parent);
+        store.set_local_position(parent, Vec3(10, 0, 0));
+        store.set_local_position(child, Vec3(1, 0, 0));
+        store.set_local_position(other, Vec3(7, 0, 0));
+        store.update();
+
+        store.release(parent);
+        store.update();
+
+        assert_equal(2u, store.size());
+        assert_equal(Vec3(1, 0, 0), store.world_position(child));
+        assert_equal(Vec3(7, 0, 0), store.world_position(other));
+
+        // Released slots are reused
+        assert_equal(parent, store.allocate());
+    }
+};
+
+}
+
+#endif // TEST_TRANSFORM_STORE_H
@@ -0,0 +1,59 @@
+#ifndef TEST_UPLOAD_QUEUE_H
+#define TEST_UPLOAD_QUEUE_H
+
+#include <vector>
+
+#include "kaztest/kaztest.h"
+#include "kglt/renderers/upload_queue.h"
+
+#include "global.h"
+
+class UploadQueueTest : public KGLTTestCase {
+public:
+    void test_priority_order() {
+        kglt::UploadQueue queue;
+        std::vector<int> order;
+
+        queue.push([&]() { order.push_back(3); }, kglt::UPLOAD_PRIORITY_LOW);
+        queue.push([&]() { order.push_back(2); }, kglt::UPLOAD_PRIORITY_NORMAL);
+        queue.push([&]() { order.push_back(1); }, kglt::UPLOAD_PRIORITY_HIGH);
+
+        assert_equal(3, queue.pending_count());
+        assert_equal(3, queue.process(1000.0));
+
+        assert_equal(3, order.size());
+        assert_equal(1, order[0]);
+        assert_equal(2, order[1]);
+        assert_equal(3, order[2]);
+    }
+
+    void test_unique_keys() {
+        kglt::UploadQueue queue;
+        int key = 0;
+        int counter = 0;
+
+        assert_true(queue.push_unique(&key, [&]() { counter++; }));
+        assert_false(queue.push_unique(&key, [&]() { counter++; }));
+        assert_true(queue.is_pending(&key));
+
+        queue.process(1000.0);
+
+        assert_equal(1, counter);
+        assert_false(queue.is_pending(&key));
+    }
+
+    void test_budget_always_makes_progress() {
+        kglt::UploadQueue queue;
+        int counter = 0;
+
+        queue.push([&]() { counter++; });
+        queue.push([&]() { counter++; });
+
+        // A zero budget still runs a single task
+        assert_equal(1, queue.process(0.0));
+        assert_equal(1, counter);
+        assert_equal(1, queue.pending_count());
+    }
+};
+
+#endif // TEST_UPLOAD_QUEUE_H
@@ -41,6 +41,29 @@ public:
 
         assert_equal(sizeof(float) * 18, data.data_size());
     }
+
+    void test_packed_diffuse() {
+        // The layout nuklear (and most UI libraries) output
+        kglt::VertexSpecification spec;
+        spec.position_attribute = kglt::VERTEX_ATTRIBUTE_2F;
+        spec.texcoord0_attribute = kglt::VERTEX_ATTRIBUTE_2F;
+        spec.diffuse_attribute = kglt::VERTEX_ATTRIBUTE_4UB;
+
+        kglt::VertexData data(spec);
+        assert_equal(sizeof(float) * 4 + 4, data.stride());
+        assert_equal(sizeof(float) * 4, data.diffuse_offset());
+
+        data.position(1, 2);
+        data.tex_coord0(0.5, 0.5);
+        data.diffuse(kglt::Colour(1.0, 0.0, 0.5, 1.0));
+        data.done();
+
+        const uint8_t* colour = data.data() + data.diffuse_offset();
+        assert_equal(255, colour[0]);
+        assert_equal(0, colour[1]);
+        assert_equal(128, colour[2]);
+        assert_equal(255, colour[3]);
+    }
 };
 
 #endif // TEST_VERTEX_DATA_H
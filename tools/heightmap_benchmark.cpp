@@ -0,0 +1,86 @@
+/*
+ * Times loading a generated heightmap through ResourceManager::new_mesh_from_heightmap, with
+ * smoothing and normals, using however many threads the window's job system has.
+ *
+ * Usage: heightmap_benchmark [size] [repeats]
+ *
+ * The heightmap is size x size texels (1024 by default) and is loaded repeats times (3 by
+ * default), the fastest and average load times are reported.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#include "kglt/kglt.h"
+#include "kglt/sdl2_window.h"
+#include "kglt/deps/kfs/kfs.h"
+
+using namespace kglt;
+
+namespace {
+
+/* Writes an uncompressed 8 bit greyscale TGA of gentle hills */
+void write_heightmap(const std::string& path, uint16_t size) {
+    uint8_t header[18] = {0};
+    header[2] = 3;
+    header[12] = size & 0xFF;
+    header[13] = size >> 8;
+    header[14] = size & 0xFF;
+    header[15] = size >> 8;
+    header[16] = 8;
+
+    std::ofstream file(path, std::ios::binary);
+    file.write((char*) header, sizeof(header));
+    for(uint16_t z = 0; z < size; ++z) {
+        for(uint16_t x = 0; x < size; ++x) {
+            char v = uint8_t(128 + 100 * std::sin(x * 0.05f) * std::cos(z * 0.03f));
+            file.write(&v, 1);
+        }
+    }
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    const uint16_t size = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 1024;
+    const uint32_t repeats = std::max(1ul, (argc > 2) ? std::strtoul(argv[2], nullptr, 10) : 3ul);
+
+    const std::string path = kfs::path::join(kfs::temp_dir(), "kglt_heightmap_benchmark.tga");
+    write_heightmap(path, size);
+
+    auto window = SDL2Window::create(nullptr);
+    window->set_logging_level(LOG_LEVEL_NONE);
+
+    auto stage = window->stage(window->new_stage());
+
+    HeightmapSpecification spec;
+    spec.smooth_iterations = 4;
+
+    double best = 0.0, total = 0.0;
+    for(uint32_t i = 0; i < repeats; ++i) {
+        auto start = std::chrono::high_resolution_clock::now();
+        auto mesh_id = stage->assets->new_mesh_from_heightmap(path, spec);
+        double elapsed = std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - start
+        ).count();
+
+        best = (i == 0) ? elapsed : std::min(best, elapsed);
+        total += elapsed;
+
+        stage->assets->delete_mesh(mesh_id);
+    }
+
+    std::cout << "Loading a " << size << "x" << size << " heightmap with "
+              << window->jobs->worker_count() + 1 << " thread(s): "
+              << std::fixed << std::setprecision(2) << best << "ms best, "
+              << (total / repeats) << "ms average" << std::endl;
+
+    std::remove(path.c_str());
+    return 0;
+}
@@ -0,0 +1,74 @@
+/*
+ * Times JobSystem::parallel_for over the same workload at every thread count from 1 up to the
+ * number of hardware threads, and reports the speedup over running it on one thread.
+ *
+ * Usage: job_system_benchmark [items] [repeats]
+ *
+ * Each thread count runs the workload repeats times (3 by default) and the fastest run is
+ * reported, so a stray context switch doesn't skew the result.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "kglt/job_system.h"
+
+using namespace kglt;
+
+namespace {
+
+double run_once(JobSystem& jobs, std::vector<float>& values) {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    jobs.parallel_for(0, values.size(), [&values](uint32_t i) {
+        float v = float(i);
+        for(int j = 0; j < 32; ++j) {
+            v = std::sqrt(v + float(j));
+        }
+        values[i] = v;
+    });
+
+    return std::chrono::duration<double, std::milli>(
+        std::chrono::high_resolution_clock::now() - start
+    ).count();
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    const uint32_t items = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 2000000;
+    const uint32_t repeats = std::max(1ul, (argc > 2) ? std::strtoul(argv[2], nullptr, 10) : 3ul);
+    const uint32_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<float> values(items);
+
+    std::cout << "parallel_for over " << items << " items" << std::endl;
+
+    double single_thread = 0.0;
+    for(uint32_t threads = 1; threads <= max_threads; ++threads) {
+        // The calling thread works too, so N threads is N - 1 workers
+        JobSystem jobs(threads - 1);
+
+        double best = 0.0;
+        for(uint32_t i = 0; i < repeats; ++i) {
+            double elapsed = run_once(jobs, values);
+            best = (i == 0) ? elapsed : std::min(best, elapsed);
+        }
+
+        if(threads == 1) {
+            single_thread = best;
+        }
+
+        std::cout << std::setw(3) << threads << " thread(s): "
+                  << std::fixed << std::setprecision(2) << best << "ms, speedup "
+                  << (single_thread / best) << "x" << std::endl;
+    }
+
+    return 0;
+}
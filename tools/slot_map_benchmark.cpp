@@ -0,0 +1,89 @@
+/*
+ * Times material lookups through a ResourceManager, which keeps its objects in a SlotMap, against
+ * the same lookups in a mutex locked std::unordered_map (what the managers used before).
+ *
+ * Usage: slot_map_benchmark [lookups] [repeats]
+ *
+ * 1000 materials are looked up lookups times (1000000 by default), each side is run repeats
+ * times (3 by default) and the fastest run is reported.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "kglt/kglt.h"
+#include "kglt/sdl2_window.h"
+
+using namespace kglt;
+
+namespace {
+
+template<typename Func>
+double best_of(uint32_t repeats, Func func) {
+    double best = 0.0;
+    for(uint32_t i = 0; i < repeats; ++i) {
+        auto start = std::chrono::high_resolution_clock::now();
+        func();
+        double elapsed = std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - start
+        ).count();
+
+        best = (i == 0) ? elapsed : std::min(best, elapsed);
+    }
+    return best;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    const uint32_t lookups = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    const uint32_t repeats = std::max(1ul, (argc > 2) ? std::strtoul(argv[2], nullptr, 10) : 3ul);
+
+    auto window = SDL2Window::create(nullptr);
+    window->set_logging_level(LOG_LEVEL_NONE);
+
+    auto stage = window->stage(window->new_stage());
+
+    std::vector<MaterialID> ids;
+    std::unordered_map<MaterialID, MaterialPtr> baseline;
+    for(uint32_t i = 0; i < 1000; ++i) {
+        auto id = stage->assets->new_material(GARBAGE_COLLECT_NEVER);
+        ids.push_back(id);
+        baseline[id] = stage->assets->material(id);
+    }
+
+    // Summed so the lookups can't be optimised away, and so both sides can be checked to agree
+    uintptr_t found = 0;
+    double slot_map = best_of(repeats, [&]() {
+        found = 0;
+        for(uint32_t i = 0; i < lookups; ++i) {
+            found += (uintptr_t) stage->assets->material(ids[i % ids.size()]).get();
+        }
+    });
+
+    std::mutex lock;
+    uintptr_t baseline_found = 0;
+    double hash_map = best_of(repeats, [&]() {
+        baseline_found = 0;
+        for(uint32_t i = 0; i < lookups; ++i) {
+            std::lock_guard<std::mutex> g(lock);
+            baseline_found += (uintptr_t) baseline.find(ids[i % ids.size()])->second.get();
+        }
+    });
+
+    if(found != baseline_found) {
+        std::cerr << "Lookups found different materials" << std::endl;
+        return 1;
+    }
+
+    std::cout << lookups << " material lookups: " << std::fixed << std::setprecision(2)
+              << slot_map << "ms (locked unordered_map: " << hash_map << "ms)" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,182 @@
+/*
+ * Converts an image into a KTX file for CompressedTextureLoader, compressing it and building its
+ * mipmaps ahead of time so neither has to happen when the game loads it.
+ *
+ * Usage: texture_converter [--format dxt|dxt1|dxt5|etc1|etc2|rgba] [--no-mipmaps] input output.ktx
+ *
+ * The default "dxt" picks DXT5 for images with alpha and DXT1 otherwise. Levels are written
+ * bottom-up so the loader never has to flip them (which ETC data can't be without decoding it).
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "kglt/deps/SOIL/SOIL.h"
+extern "C" {
+#include "kglt/deps/SOIL/image_DXT.h"
+}
+
+#include "kglt/texture_compression.h"
+#include "kglt/loaders/compressed_texture_loader.h"
+
+using namespace kglt;
+
+namespace {
+
+typedef std::vector<uint8_t> Level;
+
+void usage() {
+    std::cerr << "Usage: texture_converter [--format dxt|dxt1|dxt5|etc1|etc2|rgba] [--no-mipmaps] input output.ktx" << std::endl;
+}
+
+/* Halves the level in each direction (down to 1), averaging each 2x2 block of pixels */
+Level downsample(const Level& source, uint32_t width, uint32_t height) {
+    const uint32_t new_width = std::max(width / 2, 1u);
+    const uint32_t new_height = std::max(height / 2, 1u);
+
+    Level result(new_width * new_height * 4);
+
+    for(uint32_t y = 0; y < new_height; ++y) {
+        for(uint32_t x = 0; x < new_width; ++x) {
+            const uint32_t x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+            const uint32_t y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+
+            for(uint32_t c = 0; c < 4; ++c) {
+                uint32_t total = source[((y0 * width) + x0) * 4 + c] +
+                    source[((y0 * width) + x1) * 4 + c] +
+                    source[((y1 * width) + x0) * 4 + c] +
+                    source[((y1 * width) + x1) * 4 + c];
+
+                result[((y * new_width) + x) * 4 + c] = (total + 2) / 4;
+            }
+        }
+    }
+
+    return result;
+}
+
+Level compress_dxt(TextureFormat format, const Level& rgba, uint32_t width, uint32_t height) {
+    int size = 0;
+    unsigned char* data = (format == TEXTURE_FORMAT_DXT1) ?
+        convert_image_to_DXT1(&rgba[0], width, height, 4, &size) :
+        convert_image_to_DXT5(&rgba[0], width, height, 4, &size);
+
+    if(!data) {
+        throw std::runtime_error("DXT compression failed");
+    }
+
+    Level result(data, data + size);
+    free(data);
+    return result;
+}
+
+Level compress(TextureFormat format, const Level& rgba, uint32_t width, uint32_t height) {
+    switch(format) {
+        case TEXTURE_FORMAT_DXT1:
+        case TEXTURE_FORMAT_DXT5:
+            return compress_dxt(format, rgba, width, height);
+        case TEXTURE_FORMAT_ETC1:
+            return compress_etc1(&rgba[0], width, height);
+        case TEXTURE_FORMAT_ETC2_RGBA:
+            return compress_etc2_rgba(&rgba[0], width, height);
+        default:
+            return rgba;
+    }
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    std::string format_name = "dxt";
+    bool mipmaps = true;
+    std::vector<std::string> paths;
+
+    for(int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if(arg == "--format" && i + 1 < argc) {
+            format_name = argv[++i];
+        } else if(arg == "--no-mipmaps") {
+            mipmaps = false;
+        } else if(arg.find("--") == 0) {
+            usage();
+            return 1;
+        } else {
+            paths.push_back(arg);
+        }
+    }
+
+    if(paths.size() != 2) {
+        usage();
+        return 1;
+    }
+
+    int width, height, channels;
+    unsigned char* image = SOIL_load_image(paths[0].c_str(), &width, &height, &channels, SOIL_LOAD_RGBA);
+    if(!image) {
+        std::cerr << "Unable to load " << paths[0] << ": " << SOIL_last_result() << std::endl;
+        return 1;
+    }
+
+    // SOIL loads top-down, textures are bottom-up
+    Level level(width * height * 4);
+    const uint32_t row = width * 4;
+    for(int j = 0; j < height; ++j) {
+        std::copy(image + (j * row), image + ((j + 1) * row), level.begin() + ((height - 1 - j) * row));
+    }
+    SOIL_free_image_data(image);
+
+    const bool has_alpha = (channels == 2 || channels == 4);
+
+    TextureFormat format;
+    if(format_name == "dxt") {
+        format = (has_alpha) ? TEXTURE_FORMAT_DXT5 : TEXTURE_FORMAT_DXT1;
+    } else if(format_name == "dxt1") {
+        format = TEXTURE_FORMAT_DXT1;
+    } else if(format_name == "dxt5") {
+        format = TEXTURE_FORMAT_DXT5;
+    } else if(format_name == "etc1") {
+        format = TEXTURE_FORMAT_ETC1;
+    } else if(format_name == "etc2") {
+        format = (has_alpha) ? TEXTURE_FORMAT_ETC2_RGBA : TEXTURE_FORMAT_ETC1;
+    } else if(format_name == "rgba") {
+        format = TEXTURE_FORMAT_UNCOMPRESSED;
+    } else {
+        usage();
+        return 1;
+    }
+
+    if(has_alpha && !texture_format_has_alpha(format) && format != TEXTURE_FORMAT_UNCOMPRESSED) {
+        std::cerr << "Warning: " << paths[0] << " has alpha, which " << format_name << " will discard" << std::endl;
+    }
+
+    std::vector<Level> levels;
+
+    uint32_t w = width, h = height;
+    while(true) {
+        levels.push_back(compress(format, level, w, h));
+
+        if(!mipmaps || (w == 1 && h == 1)) {
+            break;
+        }
+
+        level = downsample(level, w, h);
+        w = std::max(w / 2, 1u);
+        h = std::max(h / 2, 1u);
+    }
+
+    std::ofstream out(paths[1], std::ios::binary);
+    if(!out) {
+        std::cerr << "Unable to write " << paths[1] << std::endl;
+        return 1;
+    }
+
+    loaders::write_ktx(out, format, width, height, levels);
+
+    std::cout << "Wrote " << paths[1] << ": " << width << "x" << height << ", " << levels.size() << " level(s)" << std::endl;
+    return 0;
+}